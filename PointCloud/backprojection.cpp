@@ -0,0 +1,458 @@
+#include "backprojection.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BACKPROJECTION_X86
+#include <immintrin.h>
+#endif
+
+//// depth filter in raw depth units
+struct DepthFilterLimits
+{
+    float minDepth;
+    float maxDepth;
+    float threshold;
+    uint8_t rejectInvalid;
+    uint8_t minConfidence;
+};
+
+//// 0 - kept, otherwise the first rejecting filter: 1 invalid, 2 out of range, 3 low confidence, 4 discontinuity
+static inline uint8_t getRejection(uint16_t depth, uint16_t left, uint16_t right, uint16_t up, uint16_t down, uint8_t confidence, const DepthFilterLimits &limits)
+{
+    const float f_d = static_cast<float>(depth);
+    const float max_jump = limits.threshold * f_d;
+
+    // neighbours without a measurement do not mark an edge, nor does a pixel without one, that is up to rejectInvalid
+    const bool jump = (depth != 0) & ((left != 0 && std::abs(static_cast<float>(left) - f_d) > max_jump)
+                    | (right != 0 && std::abs(static_cast<float>(right) - f_d) > max_jump)
+                    | (up != 0 && std::abs(static_cast<float>(up) - f_d) > max_jump)
+                    | (down != 0 && std::abs(static_cast<float>(down) - f_d) > max_jump));
+
+    uint8_t rejection = (limits.threshold > 0.f && jump) ? 4 : 0;
+    rejection = confidence < limits.minConfidence ? 3 : rejection;
+    rejection = (f_d < limits.minDepth || f_d > limits.maxDepth) ? 2 : rejection;
+    // zero depth stays out of range below a min depth, rejecting it as invalid only adds to the other filters
+    rejection = (depth == 0 && limits.rejectInvalid) ? 1 : rejection;
+
+    return rejection;
+}
+
+bool DepthFilterSettings::isEnabled(bool has_confidence_mask) const
+{
+    return this->rejectInvalid || this->minDepth > 0.f || this->maxDepth > 0.f || this->discontinuityThreshold > 0.f
+        || (has_confidence_mask && this->minConfidence > 0);
+}
+
+void DepthFilterStatistics::add(const DepthFilterStatistics &statistics)
+{
+    this->inputPixelsCount += statistics.inputPixelsCount;
+    this->invalidCount += statistics.invalidCount;
+    this->outOfRangeCount += statistics.outOfRangeCount;
+    this->lowConfidenceCount += statistics.lowConfidenceCount;
+    this->discontinuityCount += statistics.discontinuityCount;
+}
+
+uint64_t DepthFilterStatistics::getRemovedCount() const
+{
+    return this->invalidCount + this->outOfRangeCount + this->lowConfidenceCount + this->discontinuityCount;
+}
+
+// constructors/destructors
+BackProjectionKernel::BackProjectionKernel()
+{
+    this->instructionSet = BackProjectionKernel::detectInstructionSet();
+    this->depthFilter = { false, 0.f, 0.f, 0.f, 0 };
+
+    this->intrinsics = { 0.f, 0.f, 1.f, 1.f, 0, 0, 1.f };
+}
+
+BackProjectionKernel::~BackProjectionKernel()
+{
+
+}
+
+// public functions
+//// getters
+InstructionSet BackProjectionKernel::getInstructionSet()
+{
+    return this->instructionSet;
+}
+
+const char *BackProjectionKernel::getInstructionSetName(InstructionSet instruction_set)
+{
+    switch(instruction_set)
+    {
+    case InstructionSet::AVX2:
+        return "AVX2";
+    case InstructionSet::SSE:
+        return "SSE";
+    default:
+        return "Scalar";
+    }
+}
+
+//// setters
+void BackProjectionKernel::setIntrinsics(const CameraIntrinsics &intrinsics)
+{
+    this->intrinsics = intrinsics;
+}
+
+void BackProjectionKernel::setInstructionSet(InstructionSet instruction_set)
+{
+    InstructionSet supported = BackProjectionKernel::detectInstructionSet();
+
+    this->instructionSet = static_cast<int>(instruction_set) <= static_cast<int>(supported) ? instruction_set : supported;
+}
+
+void BackProjectionKernel::setDepthFilter(const DepthFilterSettings &settings)
+{
+    this->depthFilter = settings;
+}
+
+//// data transformations
+FramePose BackProjectionKernel::getFramePose(float cam_x, float cam_y, float cam_z, float qx, float qy, float qz, float qw)
+{
+    // same matrix as the reference path builds per pixel
+    FramePose pose = {
+        {
+            2 * (qx * qx + qy * qy) - 1, 2 * (qy * qz - qx * qw)    , 2 * (qy * qw + qx * qz)    ,
+            2 * (qy * qz + qx * qw)    , 2 * (qx * qx + qz * qz) - 1, 2 * (qz * qw - qx * qy)    ,
+            2 * (qy * qw - qx * qz)    , 2 * (qz * qw + qx * qy)    , 2 * (qx * qx + qw * qw) - 1
+        },
+        { cam_x, cam_y, cam_z }
+    };
+
+    return pose;
+}
+
+FramePose BackProjectionKernel::getIdentityPose()
+{
+    FramePose pose = {
+        {
+            1.f, 0.f, 0.f,
+            0.f, 1.f, 0.f,
+            0.f, 0.f, 1.f
+        },
+        { 0.f, 0.f, 0.f }
+    };
+
+    return pose;
+}
+
+void BackProjectionKernel::transformPoints(const FramePose &pose, float *points, size_t points_count)
+{
+    const float *r = pose.rotation;
+    const float *t = pose.translation;
+
+    for(size_t i = 0; i < points_count; ++i)
+    {
+        float *point = points + i * 6;
+
+        float x = point[0];
+        float y = point[1];
+        float z = point[2];
+
+        point[0] = r[0] * x + r[1] * y + r[2] * z + t[0];
+        point[1] = r[3] * x + r[4] * y + r[5] * z + t[1];
+        point[2] = r[6] * x + r[7] * y + r[8] * z + t[2];
+    }
+}
+
+void BackProjectionKernel::transformFrame(const FramePose &pose, const cv::Mat &rgb_image, const cv::Mat &depth_image, std::vector<float> &frame_points,
+                                          const cv::Mat &confidence_mask, DepthFilterStatistics *statistics)
+{
+    const int image_width = depth_image.cols;
+    const int image_height = depth_image.rows;
+
+    if(rgb_image.cols != image_width || rgb_image.rows != image_height || rgb_image.type() != CV_8UC3 || depth_image.type() != CV_16UC1)
+    {
+        std::cerr << "RGB and depth images do not match!" << std::endl;
+        return;
+    }
+
+    // ray directions are shared by every frame of the same resolution
+    std::shared_ptr<const RayLookupTable> ray_table = this->rayTables.getTable(this->intrinsics, image_width, image_height);
+    const float depth_scale = this->intrinsics.depthScale;
+
+    const bool use_mask = !confidence_mask.empty();
+
+    if(use_mask && (confidence_mask.cols != image_width || confidence_mask.rows != image_height || confidence_mask.type() != CV_8UC1))
+    {
+        std::cerr << "Confidence mask does not match the depth image!" << std::endl;
+        return;
+    }
+
+    const bool filter_pixels = this->depthFilter.isEnabled(use_mask);
+    DepthFilterStatistics filter_statistics = {};
+
+    std::vector<float> x_row(image_width);
+    std::vector<float> y_row(image_width);
+    std::vector<float> z_row(image_width);
+    std::vector<uint8_t> keep_row(filter_pixels ? image_width : 0);
+
+    // sized for every pixel, trimmed to the kept ones at the end
+    size_t output_offset = frame_points.size();
+    frame_points.resize(output_offset + static_cast<size_t>(image_width) * image_height * 6);
+    float *output_begin = frame_points.data() + output_offset;
+    float *output = output_begin;
+
+    for(int v = 0; v < image_height; ++v)
+    {
+        const uint16_t *depth_row = depth_image.ptr<uint16_t>(v);
+        const uint8_t *color_row = rgb_image.ptr<uint8_t>(v);
+        const float *ray_x_row = ray_table->getRayX();
+        const float ray_y = ray_table->getRayY(v);
+
+        switch(this->instructionSet)
+        {
+        case InstructionSet::AVX2:
+            BackProjectionKernel::transformRowAVX2(pose, depth_row, ray_x_row, ray_y, depth_scale, image_width, x_row.data(), y_row.data(), z_row.data());
+            break;
+        case InstructionSet::SSE:
+            BackProjectionKernel::transformRowSSE(pose, depth_row, ray_x_row, ray_y, depth_scale, image_width, x_row.data(), y_row.data(), z_row.data());
+            break;
+        default:
+            BackProjectionKernel::transformRowScalar(pose, depth_row, ray_x_row, ray_y, depth_scale, image_width, x_row.data(), y_row.data(), z_row.data());
+            break;
+        }
+
+        if(!filter_pixels)
+        {
+            // interleave positions with BGR colour into the x, y, z, r, g, b layout
+            for(int u = 0; u < image_width; ++u)
+            {
+                output[0] = x_row[u];
+                output[1] = y_row[u];
+                output[2] = z_row[u];
+                output[3] = static_cast<float>(color_row[3 * u + 2]);
+                output[4] = static_cast<float>(color_row[3 * u + 1]);
+                output[5] = static_cast<float>(color_row[3 * u]);
+                output += 6;
+            }
+
+            continue;
+        }
+
+        // the filter reads the raw depth rows already in cache, rejected pixels are dropped while interleaving
+        BackProjectionKernel::filterRow(this->depthFilter, depth_row,
+                                        v > 0 ? depth_image.ptr<uint16_t>(v - 1) : nullptr,
+                                        v + 1 < image_height ? depth_image.ptr<uint16_t>(v + 1) : nullptr,
+                                        use_mask ? confidence_mask.ptr<uint8_t>(v) : nullptr,
+                                        depth_scale, image_width, keep_row.data(), filter_statistics);
+
+        for(int u = 0; u < image_width; ++u)
+        {
+            output[0] = x_row[u];
+            output[1] = y_row[u];
+            output[2] = z_row[u];
+            output[3] = static_cast<float>(color_row[3 * u + 2]);
+            output[4] = static_cast<float>(color_row[3 * u + 1]);
+            output[5] = static_cast<float>(color_row[3 * u]);
+            output += 6 * keep_row[u];
+        }
+    }
+
+    frame_points.resize(output_offset + static_cast<size_t>(output - output_begin));
+
+    if(statistics != nullptr)
+    {
+        filter_statistics.inputPixelsCount = static_cast<uint64_t>(image_width) * image_height;
+        statistics->add(filter_statistics);
+    }
+}
+
+void BackProjectionKernel::filterRow(const DepthFilterSettings &settings, const uint16_t *depth_row, const uint16_t *previous_row, const uint16_t *next_row,
+                                     const uint8_t *confidence_row, float depth_scale, int width, uint8_t *keep_row, DepthFilterStatistics &statistics)
+{
+    if(width <= 0)
+    {
+        return;
+    }
+
+    // limits in raw depth units; a missing neighbour row is replaced by the row itself, which never differs
+    DepthFilterLimits limits;
+    limits.minDepth = settings.minDepth / depth_scale;
+    limits.maxDepth = settings.maxDepth > 0.f ? settings.maxDepth / depth_scale : 65536.f;
+    limits.threshold = settings.discontinuityThreshold;
+    limits.rejectInvalid = settings.rejectInvalid ? 1 : 0;
+    limits.minConfidence = confidence_row != nullptr ? settings.minConfidence : 0;
+
+    const uint16_t *up_row = previous_row != nullptr ? previous_row : depth_row;
+    const uint16_t *down_row = next_row != nullptr ? next_row : depth_row;
+
+    uint32_t counts[5] = {};
+
+    // border pixels compare with themselves in place of the missing neighbour
+    const int last = width - 1;
+    uint8_t border_rejections[2] = {
+        getRejection(depth_row[0], depth_row[0], depth_row[std::min(1, last)], up_row[0], down_row[0], confidence_row != nullptr ? confidence_row[0] : 255, limits),
+        getRejection(depth_row[last], depth_row[std::max(last - 1, 0)], depth_row[last], up_row[last], down_row[last], confidence_row != nullptr ? confidence_row[last] : 255, limits)
+    };
+
+    // separate loops without per-pixel branches, so the compiler can vectorize them
+    if(confidence_row != nullptr)
+    {
+        for(int u = 1; u < last; ++u)
+        {
+            keep_row[u] = getRejection(depth_row[u], depth_row[u - 1], depth_row[u + 1], up_row[u], down_row[u], confidence_row[u], limits);
+        }
+    }
+    else
+    {
+        for(int u = 1; u < last; ++u)
+        {
+            keep_row[u] = getRejection(depth_row[u], depth_row[u - 1], depth_row[u + 1], up_row[u], down_row[u], 255, limits);
+        }
+    }
+
+    keep_row[0] = border_rejections[0];
+    keep_row[last] = border_rejections[1];
+
+    // rejection codes turn into keep flags
+    for(int u = 0; u < width; ++u)
+    {
+        const uint8_t rejection = keep_row[u];
+
+        counts[1] += rejection == 1;
+        counts[2] += rejection == 2;
+        counts[3] += rejection == 3;
+        counts[4] += rejection == 4;
+
+        keep_row[u] = rejection == 0;
+    }
+
+    statistics.invalidCount += counts[1];
+    statistics.outOfRangeCount += counts[2];
+    statistics.lowConfidenceCount += counts[3];
+    statistics.discontinuityCount += counts[4];
+}
+
+// private functions
+//// init functions
+InstructionSet BackProjectionKernel::detectInstructionSet()
+{
+#ifdef BACKPROJECTION_X86
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return InstructionSet::AVX2;
+    }
+
+    if(__builtin_cpu_supports("sse2"))
+    {
+        return InstructionSet::SSE;
+    }
+#endif
+
+    return InstructionSet::Scalar;
+}
+
+//// row kernels
+void BackProjectionKernel::transformRowScalar(const FramePose &pose, const uint16_t *depth_row, const float *ray_x_row, float ray_y, float depth_scale, int width, float *x_row, float *y_row, float *z_row)
+{
+    const float *r = pose.rotation;
+    const float *t = pose.translation;
+
+    for(int u = 0; u < width; ++u)
+    {
+        float f_d = static_cast<float>(depth_row[u]) * depth_scale;
+        float f_u = ray_y * f_d;
+        float f_v = ray_x_row[u] * f_d;
+
+        x_row[u] = r[0] * f_u + r[1] * f_v + r[2] * f_d + t[0];
+        y_row[u] = r[3] * f_u + r[4] * f_v + r[5] * f_d + t[1];
+        z_row[u] = r[6] * f_u + r[7] * f_v + r[8] * f_d + t[2];
+    }
+}
+
+#ifdef BACKPROJECTION_X86
+__attribute__((target("sse2")))
+void BackProjectionKernel::transformRowSSE(const FramePose &pose, const uint16_t *depth_row, const float *ray_x_row, float ray_y, float depth_scale, int width, float *x_row, float *y_row, float *z_row)
+{
+    const float *r = pose.rotation;
+    const float *t = pose.translation;
+
+    const __m128 scale = _mm_set1_ps(depth_scale);
+    const __m128i zero_i = _mm_setzero_si128();
+
+    const __m128 r0 = _mm_set1_ps(r[0]), r1 = _mm_set1_ps(r[1]), r2 = _mm_set1_ps(r[2]);
+    const __m128 r3 = _mm_set1_ps(r[3]), r4 = _mm_set1_ps(r[4]), r5 = _mm_set1_ps(r[5]);
+    const __m128 r6 = _mm_set1_ps(r[6]), r7 = _mm_set1_ps(r[7]), r8 = _mm_set1_ps(r[8]);
+    const __m128 t0 = _mm_set1_ps(t[0]), t1 = _mm_set1_ps(t[1]), t2 = _mm_set1_ps(t[2]);
+    const __m128 ray_y_factor = _mm_set1_ps(ray_y);
+
+    int u = 0;
+
+    for(; u + 4 <= width; u += 4)
+    {
+        __m128i depth_u16 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(depth_row + u));
+        __m128 f_d = _mm_cvtepi32_ps(_mm_unpacklo_epi16(depth_u16, zero_i));
+        f_d = _mm_mul_ps(f_d, scale);
+
+        __m128 f_u = _mm_mul_ps(ray_y_factor, f_d);
+        __m128 f_v = _mm_mul_ps(_mm_loadu_ps(ray_x_row + u), f_d);
+
+        __m128 x = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, f_u), _mm_mul_ps(r1, f_v)), _mm_mul_ps(r2, f_d)), t0);
+        __m128 y = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r3, f_u), _mm_mul_ps(r4, f_v)), _mm_mul_ps(r5, f_d)), t1);
+        __m128 z = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r6, f_u), _mm_mul_ps(r7, f_v)), _mm_mul_ps(r8, f_d)), t2);
+
+        _mm_storeu_ps(x_row + u, x);
+        _mm_storeu_ps(y_row + u, y);
+        _mm_storeu_ps(z_row + u, z);
+    }
+
+    // remaining pixels of the row
+    BackProjectionKernel::transformRowScalar(pose, depth_row + u, ray_x_row + u, ray_y, depth_scale, width - u, x_row + u, y_row + u, z_row + u);
+}
+
+__attribute__((target("avx2")))
+void BackProjectionKernel::transformRowAVX2(const FramePose &pose, const uint16_t *depth_row, const float *ray_x_row, float ray_y, float depth_scale, int width, float *x_row, float *y_row, float *z_row)
+{
+    const float *r = pose.rotation;
+    const float *t = pose.translation;
+
+    const __m256 scale = _mm256_set1_ps(depth_scale);
+
+    const __m256 r0 = _mm256_set1_ps(r[0]), r1 = _mm256_set1_ps(r[1]), r2 = _mm256_set1_ps(r[2]);
+    const __m256 r3 = _mm256_set1_ps(r[3]), r4 = _mm256_set1_ps(r[4]), r5 = _mm256_set1_ps(r[5]);
+    const __m256 r6 = _mm256_set1_ps(r[6]), r7 = _mm256_set1_ps(r[7]), r8 = _mm256_set1_ps(r[8]);
+    const __m256 t0 = _mm256_set1_ps(t[0]), t1 = _mm256_set1_ps(t[1]), t2 = _mm256_set1_ps(t[2]);
+    const __m256 ray_y_factor = _mm256_set1_ps(ray_y);
+
+    int u = 0;
+
+    for(; u + 8 <= width; u += 8)
+    {
+        __m128i depth_u16 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(depth_row + u));
+        __m256 f_d = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(depth_u16));
+        f_d = _mm256_mul_ps(f_d, scale);
+
+        __m256 f_u = _mm256_mul_ps(ray_y_factor, f_d);
+        __m256 f_v = _mm256_mul_ps(_mm256_loadu_ps(ray_x_row + u), f_d);
+
+        __m256 x = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r0, f_u), _mm256_mul_ps(r1, f_v)), _mm256_mul_ps(r2, f_d)), t0);
+        __m256 y = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r3, f_u), _mm256_mul_ps(r4, f_v)), _mm256_mul_ps(r5, f_d)), t1);
+        __m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r6, f_u), _mm256_mul_ps(r7, f_v)), _mm256_mul_ps(r8, f_d)), t2);
+
+        _mm256_storeu_ps(x_row + u, x);
+        _mm256_storeu_ps(y_row + u, y);
+        _mm256_storeu_ps(z_row + u, z);
+    }
+
+    // remaining pixels of the row
+    BackProjectionKernel::transformRowScalar(pose, depth_row + u, ray_x_row + u, ray_y, depth_scale, width - u, x_row + u, y_row + u, z_row + u);
+}
+#else
+void BackProjectionKernel::transformRowSSE(const FramePose &pose, const uint16_t *depth_row, const float *ray_x_row, float ray_y, float depth_scale, int width, float *x_row, float *y_row, float *z_row)
+{
+    BackProjectionKernel::transformRowScalar(pose, depth_row, ray_x_row, ray_y, depth_scale, width, x_row, y_row, z_row);
+}
+
+void BackProjectionKernel::transformRowAVX2(const FramePose &pose, const uint16_t *depth_row, const float *ray_x_row, float ray_y, float depth_scale, int width, float *x_row, float *y_row, float *z_row)
+{
+    BackProjectionKernel::transformRowScalar(pose, depth_row, ray_x_row, ray_y, depth_scale, width, x_row, y_row, z_row);
+}
+#endif
@@ -0,0 +1,106 @@
+#ifndef BACKPROJECTION_H
+#define BACKPROJECTION_H
+
+#include "raylookuptable.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+#include <cstdint>
+
+enum class TransformKernel
+{
+    Reference,      // per-pixel Eigen 4x4 path
+    Vectorized      // row-oriented SIMD path
+};
+
+enum class InstructionSet
+{
+    Scalar,
+    SSE,
+    AVX2
+};
+
+struct FramePose
+{
+    float rotation[9];      // row-major 3x3
+    float translation[3];
+};
+
+//// per-pixel rejection applied while a frame is transformed, every filter is off by default
+struct DepthFilterSettings
+{
+    bool rejectInvalid;             // zero depth, the sensor had no measurement
+    float minDepth;                 // camera space depth range, 0 - no limit
+    float maxDepth;
+    float discontinuityThreshold;   // depth jump to a 4-neighbour relative to the pixel depth marking a flying pixel, 0 - off
+    uint8_t minConfidence;          // lower confidence mask values are rejected, used only when a mask is given
+
+    bool isEnabled(bool has_confidence_mask) const;
+};
+
+//// every rejected pixel is counted once, by the first filter in this order
+struct DepthFilterStatistics
+{
+    uint64_t inputPixelsCount;
+    uint64_t invalidCount;
+    uint64_t outOfRangeCount;
+    uint64_t lowConfidenceCount;
+    uint64_t discontinuityCount;
+
+    void add(const DepthFilterStatistics &statistics);
+    uint64_t getRemovedCount() const;
+};
+
+class BackProjectionKernel
+{
+public:
+    // constructors/destructors
+    BackProjectionKernel();
+    ~BackProjectionKernel();
+
+    // public functions
+    //// getters
+    InstructionSet getInstructionSet();
+    static const char *getInstructionSetName(InstructionSet instruction_set);
+
+    //// setters
+    void setIntrinsics(const CameraIntrinsics &intrinsics);
+    //// forces instruction set, falls back to the best supported one if CPU lacks it
+    void setInstructionSet(InstructionSet instruction_set);
+    void setDepthFilter(const DepthFilterSettings &settings);
+
+    //// data transformations
+    ////// camera-to-world pose from a trajectory position and quaternion
+    static FramePose getFramePose(float cam_x, float cam_y, float cam_z, float qx, float qy, float qz, float qw);
+    static FramePose getIdentityPose();
+    ////// applies pose to interleaved x, y, z, r, g, b points in place
+    static void transformPoints(const FramePose &pose, float *points, size_t points_count);
+    ////// appends up to width * height points (x, y, z, r, g, b) to frame_points, pixels rejected by the depth filter are skipped;
+    ////// confidence_mask is an optional CV_8UC1 image of the depth size, rejected pixels are added to statistics if given
+    void transformFrame(const FramePose &pose, const cv::Mat &rgb_image, const cv::Mat &depth_image, std::vector<float> &frame_points,
+                        const cv::Mat &confidence_mask = cv::Mat(), DepthFilterStatistics *statistics = nullptr);
+    ////// keep flags of one depth row, previous_row and next_row are nullptr at the image border, confidence_row is nullptr without a mask
+    static void filterRow(const DepthFilterSettings &settings, const uint16_t *depth_row, const uint16_t *previous_row, const uint16_t *next_row,
+                          const uint8_t *confidence_row, float depth_scale, int width, uint8_t *keep_row, DepthFilterStatistics &statistics);
+
+private:
+    // private functions
+    //// init functions
+    static InstructionSet detectInstructionSet();
+
+    //// row kernels, write camera-to-world transformed positions into separate x, y, z rows; the ray factor of
+    //// the columns is per pixel, the one of the row is shared
+    static void transformRowScalar(const FramePose &pose, const uint16_t *depth_row, const float *ray_x_row, float ray_y, float depth_scale, int width, float *x_row, float *y_row, float *z_row);
+    static void transformRowSSE(const FramePose &pose, const uint16_t *depth_row, const float *ray_x_row, float ray_y, float depth_scale, int width, float *x_row, float *y_row, float *z_row);
+    static void transformRowAVX2(const FramePose &pose, const uint16_t *depth_row, const float *ray_x_row, float ray_y, float depth_scale, int width, float *x_row, float *y_row, float *z_row);
+
+    // private variables
+    InstructionSet instructionSet;
+    DepthFilterSettings depthFilter;
+
+    CameraIntrinsics intrinsics;
+    RayLookupTableCache rayTables;
+};
+
+#endif // BACKPROJECTION_H
@@ -0,0 +1,410 @@
+#include "datasetparser.h"
+
+#include <iostream>
+#include <charconv>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// line and token helpers working directly on the mapped file
+static bool nextLine(const char *&cursor, const char *end, const char *&line_begin, const char *&line_end)
+{
+    if(cursor >= end)
+    {
+        return false;
+    }
+
+    line_begin = cursor;
+    const char *new_line = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+    line_end = new_line != nullptr ? new_line : end;
+    cursor = new_line != nullptr ? new_line + 1 : end;
+
+    if(line_end > line_begin && line_end[-1] == '\r')
+    {
+        --line_end;
+    }
+
+    return true;
+}
+
+static bool nextToken(const char *&cursor, const char *end, std::string_view &token)
+{
+    while(cursor < end && (*cursor == ' ' || *cursor == '\t'))
+    {
+        ++cursor;
+    }
+
+    const char *token_begin = cursor;
+
+    while(cursor < end && *cursor != ' ' && *cursor != '\t')
+    {
+        ++cursor;
+    }
+
+    token = std::string_view(token_begin, cursor - token_begin);
+
+    return !token.empty();
+}
+
+template<typename T>
+static bool parseNumber(std::string_view token, T &value)
+{
+    std::from_chars_result result = std::from_chars(token.data(), token.data() + token.size(), value);
+
+    return result.ec == std::errc() && result.ptr == token.data() + token.size();
+}
+
+template<typename T>
+static bool nextNumber(const char *&cursor, const char *end, T &value)
+{
+    std::string_view token;
+
+    return nextToken(cursor, end, token) && parseNumber(token, value);
+}
+
+static bool isTimestamp(std::string_view token)
+{
+    return token.find_first_of(".eE") != std::string_view::npos;
+}
+
+static bool isSkippedLine(const char *line_begin, const char *line_end)
+{
+    while(line_begin < line_end && (*line_begin == ' ' || *line_begin == '\t'))
+    {
+        ++line_begin;
+    }
+
+    return line_begin == line_end || *line_begin == '#';
+}
+
+// FrameTable
+const FrameEntry *FrameTable::getFrame(int index) const
+{
+    if(index < 0 || static_cast<size_t>(index) >= this->frames.size())
+    {
+        return nullptr;
+    }
+
+    const FrameEntry &frame = this->frames[index];
+
+    return frame.hasPose && frame.hasImages ? &frame : nullptr;
+}
+
+// public functions
+bool DatasetParser::parse(const std::string &path_to_trajectory, const std::string &path_to_associations, FrameTable &frame_table)
+{
+    frame_table.frames.clear();
+
+    if(!frame_table.trajectoryFile.open(path_to_trajectory))
+    {
+        std::cerr << "Failed to open trajectory file: " << path_to_trajectory.c_str() << std::endl;
+        return false;
+    }
+
+    const bool read_associations = !path_to_associations.empty();
+
+    if(read_associations && !frame_table.associationsFile.open(path_to_associations))
+    {
+        std::cerr << "Failed to open associations file: " << path_to_associations.c_str() << std::endl;
+        return false;
+    }
+
+    frame_table.trajectoryFile.adviseSequential();
+
+    if(read_associations)
+    {
+        frame_table.associationsFile.adviseSequential();
+    }
+
+    std::vector<PoseRecord> poses;
+    std::vector<AssociationRecord> associations;
+    bool trajectory_timestamped = false;
+    bool associations_timestamped = false;
+
+    if(!DatasetParser::parseTrajectory(frame_table.trajectoryFile, poses, trajectory_timestamped)
+        || (read_associations && !DatasetParser::parseAssociations(frame_table.associationsFile, associations, associations_timestamped)))
+    {
+        return false;
+    }
+
+    // dense table indexed by frame id, timestamped trajectories use the line order as id; ids far beyond the number
+    // of records would only inflate the table and are reported as inconsistent
+    const size_t max_frames_count = DatasetParser::maxIdsPerRecord * (poses.size() + associations.size()) + 1;
+    int max_id = -1;
+
+    for(const PoseRecord &pose : poses)
+    {
+        if(static_cast<size_t>(pose.pose.id) < max_frames_count)
+        {
+            max_id = std::max(max_id, pose.pose.id);
+        }
+    }
+
+    frame_table.frames.resize(static_cast<size_t>(max_id + 1));
+
+    size_t duplicated_poses = 0;
+    size_t inconsistent_ids = 0;
+
+    for(const PoseRecord &pose : poses)
+    {
+        if(pose.pose.id < 0 || static_cast<size_t>(pose.pose.id) >= max_frames_count)
+        {
+            inconsistent_ids += 1;
+            continue;
+        }
+
+        FrameEntry &frame = frame_table.frames[pose.pose.id];
+
+        if(frame.hasPose)
+        {
+            duplicated_poses += 1;
+            continue;
+        }
+
+        frame.timestamp = pose.timestamp;
+        frame.pose = pose.pose;
+        frame.hasPose = true;
+    }
+
+    // timestamped images are matched to the nearest pose in time
+    const bool match_timestamps = trajectory_timestamped && associations_timestamped;
+    std::vector<int> time_order;
+
+    if(match_timestamps)
+    {
+        time_order.resize(poses.size());
+
+        for(size_t i = 0; i < poses.size(); ++i)
+        {
+            time_order[i] = static_cast<int>(i);
+        }
+
+        std::sort(time_order.begin(), time_order.end(), [&poses](int a, int b) { return poses[a].timestamp < poses[b].timestamp; });
+    }
+
+    size_t unmatched_images = 0;
+    size_t duplicated_images = 0;
+
+    for(size_t i = 0; i < associations.size(); ++i)
+    {
+        const AssociationRecord &association = associations[i];
+        int id;
+
+        if(match_timestamps)
+        {
+            int pose_index = DatasetParser::findNearestPose(poses, time_order, association.timestamp);
+
+            if(pose_index < 0)
+            {
+                unmatched_images += 1;
+                continue;
+            }
+
+            id = poses[pose_index].pose.id;
+        }
+        else if(associations_timestamped)
+        {
+            id = static_cast<int>(i);
+        }
+        else
+        {
+            if(association.rgbId != association.depthId)
+            {
+                inconsistent_ids += 1;
+            }
+
+            id = association.rgbId;
+        }
+
+        if(id < 0 || static_cast<size_t>(id) >= max_frames_count)
+        {
+            inconsistent_ids += 1;
+            continue;
+        }
+
+        if(static_cast<size_t>(id) >= frame_table.frames.size())
+        {
+            frame_table.frames.resize(static_cast<size_t>(id) + 1);
+        }
+
+        FrameEntry &frame = frame_table.frames[id];
+
+        if(frame.hasImages)
+        {
+            duplicated_images += 1;
+            continue;
+        }
+
+        if(!frame.hasPose)
+        {
+            frame.timestamp = association.timestamp;
+        }
+
+        frame.rgbPath = association.rgbPath;
+        frame.depthPath = association.depthPath;
+        frame.hasImages = true;
+    }
+
+    // cross-file validation
+    size_t poses_without_images = 0;
+    size_t images_without_pose = 0;
+
+    for(const FrameEntry &frame : frame_table.frames)
+    {
+        poses_without_images += read_associations && frame.hasPose && !frame.hasImages;
+        images_without_pose += frame.hasImages && !frame.hasPose;
+    }
+
+    if(duplicated_poses + inconsistent_ids + unmatched_images + duplicated_images + poses_without_images + images_without_pose > 0)
+    {
+        std::cerr << "Dataset validation: " << duplicated_poses << " duplicated poses, " << duplicated_images << " duplicated images, "
+                  << inconsistent_ids << " inconsistent ids, " << unmatched_images << " images without a pose within "
+                  << DatasetParser::maxTimestampDifference << " s, " << poses_without_images << " poses without images, "
+                  << images_without_pose << " images without pose" << std::endl;
+    }
+
+    return true;
+}
+
+// private functions
+bool DatasetParser::parseTrajectory(const MappedFile &trajectory_file, std::vector<PoseRecord> &poses, bool &timestamped)
+{
+    const char *cursor = trajectory_file.getData();
+    const char *end = cursor + trajectory_file.getSize();
+    const char *line_begin;
+    const char *line_end;
+
+    bool format_detected = false;
+    size_t line_number = 0;
+
+    // a pose line takes at least ~48 bytes
+    poses.reserve(trajectory_file.getSize() / 48);
+
+    while(nextLine(cursor, end, line_begin, line_end))
+    {
+        line_number += 1;
+
+        if(isSkippedLine(line_begin, line_end))
+        {
+            continue;
+        }
+
+        std::string_view id_token;
+        nextToken(line_begin, line_end, id_token);
+
+        if(!format_detected)
+        {
+            timestamped = isTimestamp(id_token);
+            format_detected = true;
+        }
+
+        PoseRecord record;
+        bool parsed;
+
+        if(timestamped)
+        {
+            parsed = parseNumber(id_token, record.timestamp);
+            record.pose.id = static_cast<int>(poses.size());
+        }
+        else
+        {
+            parsed = parseNumber(id_token, record.pose.id) && record.pose.id >= 0;
+            record.timestamp = record.pose.id;
+        }
+
+        TrajectoryData &data = record.pose;
+
+        parsed = parsed && nextNumber(line_begin, line_end, data.cam_x) && nextNumber(line_begin, line_end, data.cam_y) && nextNumber(line_begin, line_end, data.cam_z)
+                        && nextNumber(line_begin, line_end, data.qx) && nextNumber(line_begin, line_end, data.qy) && nextNumber(line_begin, line_end, data.qz)
+                        && nextNumber(line_begin, line_end, data.qw);
+
+        if(!parsed)
+        {
+            std::cerr << "Malformed trajectory line " << line_number << std::endl;
+            continue;
+        }
+
+        poses.push_back(record);
+    }
+
+    return true;
+}
+
+bool DatasetParser::parseAssociations(const MappedFile &associations_file, std::vector<AssociationRecord> &associations, bool &timestamped)
+{
+    const char *cursor = associations_file.getData();
+    const char *end = cursor + associations_file.getSize();
+    const char *line_begin;
+    const char *line_end;
+
+    bool format_detected = false;
+    size_t line_number = 0;
+
+    associations.reserve(associations_file.getSize() / 32);
+
+    while(nextLine(cursor, end, line_begin, line_end))
+    {
+        line_number += 1;
+
+        if(isSkippedLine(line_begin, line_end))
+        {
+            continue;
+        }
+
+        std::string_view rgb_token;
+        std::string_view depth_token;
+        AssociationRecord record;
+
+        bool parsed = nextToken(line_begin, line_end, rgb_token) && nextToken(line_begin, line_end, record.rgbPath)
+                   && nextToken(line_begin, line_end, depth_token) && nextToken(line_begin, line_end, record.depthPath);
+
+        if(parsed && !format_detected)
+        {
+            timestamped = isTimestamp(rgb_token);
+            format_detected = true;
+        }
+
+        if(parsed && timestamped)
+        {
+            parsed = parseNumber(rgb_token, record.timestamp);
+            record.rgbId = -1;
+            record.depthId = -1;
+        }
+        else if(parsed)
+        {
+            parsed = parseNumber(rgb_token, record.rgbId) && parseNumber(depth_token, record.depthId);
+            record.timestamp = record.rgbId;
+        }
+
+        if(!parsed)
+        {
+            std::cerr << "Malformed associations line " << line_number << std::endl;
+            continue;
+        }
+
+        associations.push_back(record);
+    }
+
+    return true;
+}
+
+int DatasetParser::findNearestPose(const std::vector<PoseRecord> &poses, const std::vector<int> &order, double timestamp)
+{
+    auto next = std::lower_bound(order.begin(), order.end(), timestamp, [&poses](int a, double value) { return poses[a].timestamp < value; });
+
+    int best = -1;
+    double best_difference = DatasetParser::maxTimestampDifference;
+
+    if(next != order.end() && std::fabs(poses[*next].timestamp - timestamp) <= best_difference)
+    {
+        best = *next;
+        best_difference = std::fabs(poses[*next].timestamp - timestamp);
+    }
+
+    if(next != order.begin() && std::fabs(poses[*(next - 1)].timestamp - timestamp) <= best_difference)
+    {
+        best = *(next - 1);
+    }
+
+    return best;
+}
@@ -0,0 +1,74 @@
+#ifndef DATASETPARSER_H
+#define DATASETPARSER_H
+
+#include "mappedfile.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct TrajectoryData
+{
+    int id;
+    float cam_x, cam_y, cam_z;             // Position
+    float qx, qy, qz, qw;      // Orientation (quaternion)
+};
+
+struct FrameEntry
+{
+    double timestamp;               // TUM timestamp, the id for indexed files
+    TrajectoryData pose;
+    std::string_view rgbPath;       // points into the mapped association file
+    std::string_view depthPath;
+    bool hasPose;
+    bool hasImages;
+};
+
+//// dense, id-indexed table of every frame, owns the mapped files its paths point into
+struct FrameTable
+{
+    std::vector<FrameEntry> frames;
+    MappedFile trajectoryFile;
+    MappedFile associationsFile;
+
+    //// frame with both a pose and images, nullptr otherwise
+    const FrameEntry *getFrame(int index) const;
+};
+
+//// parses "id x y z qx qy qz qw" / "id rgb id depth" files as well as the TUM timestamped format,
+//// where frames are matched by the nearest timestamp
+class DatasetParser
+{
+public:
+    // public functions
+    //// an empty associations path reads the poses alone, e.g. for a camera path; frames then have no images
+    static bool parse(const std::string &path_to_trajectory, const std::string &path_to_associations, FrameTable &frame_table);
+
+    //// maximum timestamp difference when matching TUM images to poses, in seconds
+    static constexpr double maxTimestampDifference = 0.02;
+    //// frame ids from this many per pose and association record on are dropped, sparse ids like every n-th frame still fit
+    static constexpr size_t maxIdsPerRecord = 64;
+
+private:
+    struct PoseRecord
+    {
+        double timestamp;
+        TrajectoryData pose;
+    };
+
+    struct AssociationRecord
+    {
+        int rgbId;
+        int depthId;
+        double timestamp;
+        std::string_view rgbPath;
+        std::string_view depthPath;
+    };
+
+    // private functions
+    static bool parseTrajectory(const MappedFile &trajectory_file, std::vector<PoseRecord> &poses, bool &timestamped);
+    static bool parseAssociations(const MappedFile &associations_file, std::vector<AssociationRecord> &associations, bool &timestamped);
+    static int findNearestPose(const std::vector<PoseRecord> &poses, const std::vector<int> &order, double timestamp);
+};
+
+#endif // DATASETPARSER_H
@@ -0,0 +1,93 @@
+#include "framequeue.h"
+
+// constructors/destructors
+FrameQueue::FrameQueue(size_t capacity)
+{
+    this->capacity = std::max<size_t>(1, capacity);
+    this->closed = false;
+}
+
+FrameQueue::~FrameQueue()
+{
+    this->close();
+}
+
+// public functions
+bool FrameQueue::push(StreamedFrame &frame)
+{
+    std::unique_lock<std::mutex> lock(this->queueMutex);
+
+    this->notFull.wait(lock, [this] { return this->closed || this->frames.size() < this->capacity; });
+
+    if(this->closed)
+    {
+        return false;
+    }
+
+    this->frames.push_back(std::move(frame));
+    lock.unlock();
+
+    this->notEmpty.notify_one();
+
+    return true;
+}
+
+bool FrameQueue::pop(StreamedFrame &frame)
+{
+    std::unique_lock<std::mutex> lock(this->queueMutex);
+
+    this->notEmpty.wait(lock, [this] { return this->closed || !this->frames.empty(); });
+
+    if(this->frames.empty())
+    {
+        return false;
+    }
+
+    frame = std::move(this->frames.front());
+    this->frames.pop_front();
+    lock.unlock();
+
+    this->notFull.notify_one();
+
+    return true;
+}
+
+bool FrameQueue::tryPop(StreamedFrame &frame)
+{
+    std::unique_lock<std::mutex> lock(this->queueMutex);
+
+    if(this->frames.empty())
+    {
+        return false;
+    }
+
+    frame = std::move(this->frames.front());
+    this->frames.pop_front();
+    lock.unlock();
+
+    this->notFull.notify_one();
+
+    return true;
+}
+
+void FrameQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->queueMutex);
+        this->closed = true;
+    }
+
+    this->notFull.notify_all();
+    this->notEmpty.notify_all();
+}
+
+FrameSink FrameQueue::getSink()
+{
+    return [this](StreamedFrame &frame) { this->push(frame); };
+}
+
+//// getters
+size_t FrameQueue::getCapacity()
+{
+    return this->capacity;
+}
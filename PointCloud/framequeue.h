@@ -0,0 +1,45 @@
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include "pointcloud.h"
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+//// bounded queue between ingestion workers and a consumer thread, producers block while it is full
+class FrameQueue
+{
+public:
+    // constructors/destructors
+    FrameQueue(size_t capacity);
+    ~FrameQueue();
+
+    // public functions
+    //// blocks while the queue is full, returns false if the queue was closed
+    bool push(StreamedFrame &frame);
+    //// blocks while the queue is empty, returns false once it is closed and drained
+    bool pop(StreamedFrame &frame);
+    //// never blocks, returns false while the queue is empty, e.g. for a render loop
+    bool tryPop(StreamedFrame &frame);
+    //// wakes up all waiting producers and consumers, call after iterateThroughImages returns
+    void close();
+
+    //// sink moving frames into this queue, for PointCloud::setFrameSink
+    FrameSink getSink();
+
+    //// getters
+    size_t getCapacity();
+
+private:
+    // private variables
+    size_t capacity;
+    bool closed;
+
+    std::mutex queueMutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<StreamedFrame> frames;
+};
+
+#endif // FRAMEQUEUE_H
@@ -0,0 +1,243 @@
+#include "imageloader.h"
+#include "profiler.h"
+
+#include <fstream>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+// constructors/destructors
+ImageLoader::ImageLoader(unsigned int io_threads_count, size_t queue_depth)
+{
+    this->ioThreadsCount = std::max(1u, io_threads_count);
+    this->imageSlots.resize(std::max<size_t>(1, queue_depth));
+
+    this->nextRequest = 0;
+    this->deliveredCount = 0;
+    this->stopping = false;
+}
+
+ImageLoader::~ImageLoader()
+{
+    this->stop();
+}
+
+// public functions
+void ImageLoader::start(std::vector<ImageRequest> requests)
+{
+    this->stop();
+
+    this->requests = std::move(requests);
+    this->nextRequest = 0;
+    this->deliveredCount = 0;
+    this->stopping = false;
+
+    this->freeSlots.clear();
+    this->readySlots.clear();
+
+    for(ImageSlot &slot : this->imageSlots)
+    {
+        this->freeSlots.push_back(&slot);
+    }
+
+    unsigned int threads_count = static_cast<unsigned int>(std::min<size_t>(this->ioThreadsCount, std::max<size_t>(1, this->requests.size())));
+
+    for(unsigned int i = 0; i < threads_count; ++i)
+    {
+        this->ioThreads.emplace_back(&ImageLoader::ioWorker, this);
+    }
+}
+
+ImageSlot *ImageLoader::acquire()
+{
+    std::unique_lock<std::mutex> lock(this->loaderMutex);
+
+    this->slotReady.wait(lock, [this] {
+        return this->stopping || !this->readySlots.empty() || this->deliveredCount == this->requests.size();
+    });
+
+    if(this->readySlots.empty())
+    {
+        return nullptr;
+    }
+
+    ImageSlot *slot = this->readySlots.front();
+    this->readySlots.pop_front();
+    this->deliveredCount += 1;
+
+    // the last delivery has to wake up consumers still waiting for frames
+    if(this->deliveredCount == this->requests.size())
+    {
+        this->slotReady.notify_all();
+    }
+
+    return slot;
+}
+
+void ImageLoader::release(ImageSlot *slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->loaderMutex);
+        this->freeSlots.push_back(slot);
+    }
+
+    this->slotFree.notify_one();
+}
+
+void ImageLoader::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->loaderMutex);
+        this->stopping = true;
+    }
+
+    this->slotFree.notify_all();
+    this->slotReady.notify_all();
+
+    for(std::thread &io_thread : this->ioThreads)
+    {
+        io_thread.join();
+    }
+
+    this->ioThreads.clear();
+}
+
+// private functions
+void ImageLoader::ioWorker()
+{
+    while(true)
+    {
+        std::unique_lock<std::mutex> lock(this->loaderMutex);
+
+        this->slotFree.wait(lock, [this] {
+            return this->stopping || this->nextRequest == this->requests.size() || !this->freeSlots.empty();
+        });
+
+        if(this->stopping || this->nextRequest == this->requests.size())
+        {
+            return;
+        }
+
+        ImageSlot *slot = this->freeSlots.front();
+        this->freeSlots.pop_front();
+        const ImageRequest &request = this->requests[this->nextRequest];
+        this->nextRequest += 1;
+
+        lock.unlock();
+
+        slot->position = request.position;
+        slot->loaded = this->loadImages(request, *slot);
+
+        lock.lock();
+        this->readySlots.push_back(slot);
+        lock.unlock();
+
+        this->slotReady.notify_one();
+    }
+}
+
+bool ImageLoader::loadImages(const ImageRequest &request, ImageSlot &slot)
+{
+    if(request.rgbPath.empty() && request.depthPath.empty())
+    {
+        return false;
+    }
+
+    ScopedTimer timer(ProfileStage::ImageRead);
+
+    bool loaded = ImageLoader::loadRGBImage(request.rgbPath, slot.rgbBuffer, slot.rgbImage)
+        && ImageLoader::loadDepthImage(request.depthPath, slot.depthBuffer, slot.depthImage);
+
+    // both kernels read the colour at the depth pixel, a smaller RGB image would be read out of bounds
+    if(loaded && (slot.rgbImage.cols != slot.depthImage.cols || slot.rgbImage.rows != slot.depthImage.rows
+                  || slot.rgbImage.type() != CV_8UC3 || slot.depthImage.type() != CV_16UC1))
+    {
+        std::cerr << "RGB and depth images do not match!" << request.depthPath.c_str() << std::endl;
+        loaded = false;
+    }
+
+    if(request.confidencePath.empty())
+    {
+        slot.confidenceImage.release();
+        slot.confidenceBuffer.clear();
+    }
+    else
+    {
+        loaded = loaded && ImageLoader::loadConfidenceImage(request.confidencePath, slot.confidenceBuffer, slot.confidenceImage);
+    }
+
+    Profiler::count(ProfileCounter::BytesRead, slot.rgbBuffer.size() + slot.depthBuffer.size() + slot.confidenceBuffer.size());
+
+    return loaded;
+}
+
+bool ImageLoader::readFile(const std::string &path_to_file, std::vector<uchar> &buffer)
+{
+    std::ifstream file(path_to_file, std::ios::binary | std::ios::ate);
+
+    if(!file.is_open())
+    {
+        return false;
+    }
+
+    std::streamsize file_size = file.tellg();
+
+    // -1 on a failed stream or the bogus size of a directory would turn into a huge allocation
+    struct stat file_stat;
+
+    if(file_size < 0 || stat(path_to_file.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || !file.seekg(0))
+    {
+        std::cerr << "Failed to read file size: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    // capacity survives between frames, so steady state reads do not allocate
+    buffer.resize(static_cast<size_t>(file_size));
+
+    return static_cast<bool>(file.read(reinterpret_cast<char *>(buffer.data()), file_size));
+}
+
+bool ImageLoader::loadRGBImage(const std::string &path_to_image, std::vector<uchar> &buffer, cv::Mat &rgb_image)
+{
+    // decoding into the slot image reuses its memory when the size does not change
+    if(!ImageLoader::readFile(path_to_image, buffer) || cv::imdecode(buffer, cv::IMREAD_COLOR, &rgb_image).empty())
+    {
+        std::cerr << "Error loading RBG image!" << path_to_image.c_str() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool ImageLoader::loadDepthImage(const std::string &path_to_image, std::vector<uchar> &buffer, cv::Mat &depth_image)
+{
+    if(!ImageLoader::readFile(path_to_image, buffer) || cv::imdecode(buffer, cv::IMREAD_UNCHANGED, &depth_image).empty())
+    {
+        std::cerr << "Error loading Depth image!" << path_to_image.c_str() << std::endl;
+        return false;
+    }
+
+    if (depth_image.depth() != CV_16U) {  // or CV_16S if it's signed
+        std::cerr << "The image is not 16-bit!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool ImageLoader::loadConfidenceImage(const std::string &path_to_image, std::vector<uchar> &buffer, cv::Mat &confidence_image)
+{
+    if(!ImageLoader::readFile(path_to_image, buffer) || cv::imdecode(buffer, cv::IMREAD_UNCHANGED, &confidence_image).empty())
+    {
+        std::cerr << "Error loading confidence image!" << path_to_image.c_str() << std::endl;
+        return false;
+    }
+
+    if(confidence_image.type() != CV_8UC1)
+    {
+        std::cerr << "The confidence image is not 8-bit single channel!" << path_to_image.c_str() << std::endl;
+        return false;
+    }
+
+    return true;
+}
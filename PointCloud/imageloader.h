@@ -0,0 +1,81 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <opencv2/opencv.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct ImageRequest
+{
+    size_t position;            // position of the frame in the processed sequence
+    std::string rgbPath;        // both paths empty - frame needs no images, slot is passed through
+    std::string depthPath;
+    std::string confidencePath; // empty - no confidence mask
+};
+
+struct ImageSlot
+{
+    size_t position;
+    bool loaded;
+
+    cv::Mat rgbImage;
+    cv::Mat depthImage;
+    cv::Mat confidenceImage;    // empty unless requested
+
+    //// encoded file contents, reused between frames
+    std::vector<uchar> rgbBuffer;
+    std::vector<uchar> depthBuffer;
+    std::vector<uchar> confidenceBuffer;
+};
+
+//// reads and decodes images on dedicated I/O threads into a bounded ring of reusable slots
+class ImageLoader
+{
+public:
+    // constructors/destructors
+    ImageLoader(unsigned int io_threads_count, size_t queue_depth);
+    ~ImageLoader();
+
+    // public functions
+    //// starts prefetching requests in order, at most queue_depth frames are decoded ahead
+    void start(std::vector<ImageRequest> requests);
+    //// blocks until a prefetched frame is ready, returns nullptr once every request was handed out
+    ImageSlot *acquire();
+    //// gives the slot back to the ring
+    void release(ImageSlot *slot);
+    void stop();
+
+private:
+    // private functions
+    void ioWorker();
+    bool loadImages(const ImageRequest &request, ImageSlot &slot);
+
+    static bool readFile(const std::string &path_to_file, std::vector<uchar> &buffer);
+    static bool loadRGBImage(const std::string &path_to_image, std::vector<uchar> &buffer, cv::Mat &rgb_image);
+    static bool loadDepthImage(const std::string &path_to_image, std::vector<uchar> &buffer, cv::Mat &depth_image);
+    static bool loadConfidenceImage(const std::string &path_to_image, std::vector<uchar> &buffer, cv::Mat &confidence_image);
+
+    // private variables
+    unsigned int ioThreadsCount;
+    std::vector<std::thread> ioThreads;
+
+    std::vector<ImageSlot> imageSlots;
+
+    std::mutex loaderMutex;
+    std::condition_variable slotFree;
+    std::condition_variable slotReady;
+    std::deque<ImageSlot *> freeSlots;
+    std::deque<ImageSlot *> readySlots;
+
+    std::vector<ImageRequest> requests;
+    size_t nextRequest;
+    size_t deliveredCount;
+    bool stopping;
+};
+
+#endif // IMAGELOADER_H
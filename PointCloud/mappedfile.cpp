@@ -0,0 +1,97 @@
+#include "mappedfile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// constructors/destructors
+MappedFile::MappedFile()
+{
+    this->opened = false;
+    this->data = nullptr;
+    this->size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+    this->close();
+}
+
+// public functions
+bool MappedFile::open(const std::string &path_to_file)
+{
+    this->close();
+
+    int file_descriptor = ::open(path_to_file.c_str(), O_RDONLY);
+
+    if(file_descriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+
+    if(fstat(file_descriptor, &file_stat) != 0)
+    {
+        ::close(file_descriptor);
+        return false;
+    }
+
+    // empty files cannot be mapped but are valid
+    if(file_stat.st_size > 0)
+    {
+        void *mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+
+        if(mapping == MAP_FAILED)
+        {
+            ::close(file_descriptor);
+            return false;
+        }
+
+        this->data = static_cast<const char *>(mapping);
+        this->size = static_cast<size_t>(file_stat.st_size);
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(file_descriptor);
+    this->opened = true;
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(this->data != nullptr)
+    {
+        munmap(const_cast<char *>(this->data), this->size);
+    }
+
+    this->opened = false;
+    this->data = nullptr;
+    this->size = 0;
+}
+
+void MappedFile::adviseSequential()
+{
+    if(this->data != nullptr)
+    {
+        madvise(const_cast<char *>(this->data), this->size, MADV_SEQUENTIAL);
+    }
+}
+
+//// getters
+bool MappedFile::isOpen() const
+{
+    return this->opened;
+}
+
+const char *MappedFile::getData() const
+{
+    return this->data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return this->size;
+}
@@ -0,0 +1,37 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+//// read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    // constructors/destructors
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // public functions
+    bool open(const std::string &path_to_file);
+    void close();
+
+    //// hints the kernel that the file will be read front to back
+    void adviseSequential();
+
+    //// getters
+    bool isOpen() const;
+    const char *getData() const;
+    size_t getSize() const;
+
+private:
+    // private variables
+    bool opened;
+    const char *data;
+    size_t size;
+};
+
+#endif // MAPPEDFILE_H
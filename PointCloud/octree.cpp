@@ -0,0 +1,549 @@
+#include "octree.h"
+
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+static const size_t floatsPerPoint = 6;
+static const size_t buildBatchPoints = 65536;
+
+// BoundingBox
+bool BoundingBox::contains(const float *point) const
+{
+    return point[0] >= this->min[0] && point[0] <= this->max[0]
+        && point[1] >= this->min[1] && point[1] <= this->max[1]
+        && point[2] >= this->min[2] && point[2] <= this->max[2];
+}
+
+bool BoundingBox::intersects(const BoundingBox &box) const
+{
+    return this->min[0] <= box.max[0] && this->max[0] >= box.min[0]
+        && this->min[1] <= box.max[1] && this->max[1] >= box.min[1]
+        && this->min[2] <= box.max[2] && this->max[2] >= box.min[2];
+}
+
+// Frustum
+Frustum Frustum::fromMatrix(const float view_projection[16])
+{
+    // rows of the column-major matrix
+    float rows[4][4];
+
+    for(int row = 0; row < 4; ++row)
+    {
+        for(int column = 0; column < 4; ++column)
+        {
+            rows[row][column] = view_projection[column * 4 + row];
+        }
+    }
+
+    Frustum frustum;
+
+    // left, right, bottom, top, near, far
+    for(int i = 0; i < 6; ++i)
+    {
+        const float sign = i % 2 == 0 ? 1.f : -1.f;
+        const float *axis_row = rows[i / 2];
+
+        for(int k = 0; k < 4; ++k)
+        {
+            frustum.planes[i][k] = rows[3][k] + sign * axis_row[k];
+        }
+
+        float length = std::sqrt(frustum.planes[i][0] * frustum.planes[i][0] + frustum.planes[i][1] * frustum.planes[i][1] + frustum.planes[i][2] * frustum.planes[i][2]);
+
+        if(length > 0.f)
+        {
+            for(int k = 0; k < 4; ++k)
+            {
+                frustum.planes[i][k] /= length;
+            }
+        }
+    }
+
+    return frustum;
+}
+
+bool Frustum::intersects(const BoundingBox &box) const
+{
+    for(int i = 0; i < 6; ++i)
+    {
+        const float *plane = this->planes[i];
+
+        // corner furthest along the plane normal
+        float x = plane[0] >= 0.f ? box.max[0] : box.min[0];
+        float y = plane[1] >= 0.f ? box.max[1] : box.min[1];
+        float z = plane[2] >= 0.f ? box.max[2] : box.min[2];
+
+        if(plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// OctreeNode
+BoundingBox OctreeNode::getBounds() const
+{
+    BoundingBox bounds;
+
+    for(int k = 0; k < 3; ++k)
+    {
+        bounds.min[k] = this->center[k] - this->halfSize;
+        bounds.max[k] = this->center[k] + this->halfSize;
+    }
+
+    return bounds;
+}
+
+// constructors/destructors
+Octree::Octree(int max_depth, int sample_grid_resolution)
+{
+    this->maxDepth = std::max(0, max_depth);
+    this->sampleGridResolution = std::max(1, sample_grid_resolution);
+    this->leafHalfSize = 0.f;
+
+    this->nodesCount = 0;
+    this->storedPointsCount = 0;
+    this->insertedPointsCount = 0;
+    this->droppedPointsCount = 0;
+    this->depth = 0;
+}
+
+Octree::~Octree()
+{
+
+}
+
+// public functions
+void Octree::integrate(const float *points, size_t points_count)
+{
+    if(points_count == 0)
+    {
+        return;
+    }
+
+    BoundingBox bounds;
+    bounds.min[0] = bounds.min[1] = bounds.min[2] = std::numeric_limits<float>::max();
+    bounds.max[0] = bounds.max[1] = bounds.max[2] = std::numeric_limits<float>::lowest();
+
+    for(size_t i = 0; i < points_count; ++i)
+    {
+        const float *point = points + i * floatsPerPoint;
+
+        if(!std::isfinite(point[0]) || !std::isfinite(point[1]) || !std::isfinite(point[2]))
+        {
+            continue;
+        }
+
+        for(int k = 0; k < 3; ++k)
+        {
+            bounds.min[k] = std::min(bounds.min[k], point[k]);
+            bounds.max[k] = std::max(bounds.max[k], point[k]);
+        }
+    }
+
+    this->insertedPointsCount += points_count;
+
+    if(bounds.min[0] > bounds.max[0])
+    {
+        this->droppedPointsCount += points_count;
+        return;
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lock(this->treeMutex);
+
+        if(this->root != nullptr && this->rootContains(bounds))
+        {
+            this->insertBatch(this->root.get(), points, points_count);
+            return;
+        }
+    }
+
+    // the root only ever grows, so it still contains the batch once the exclusive lock is gone
+    {
+        std::unique_lock<std::shared_mutex> lock(this->treeMutex);
+
+        if(this->root == nullptr)
+        {
+            this->createRoot(bounds);
+        }
+        else if(!this->rootContains(bounds))
+        {
+            this->expandRoot(bounds);
+        }
+    }
+
+    std::shared_lock<std::shared_mutex> lock(this->treeMutex);
+    this->insertBatch(this->root.get(), points, points_count);
+}
+
+void Octree::build(const float *points, size_t points_count, unsigned int threads_count)
+{
+    threads_count = std::max(1u, threads_count);
+
+    size_t batches_count = (points_count + buildBatchPoints - 1) / buildBatchPoints;
+    std::atomic<size_t> next_batch(0);
+
+    auto worker = [&]()
+    {
+        for(size_t batch = next_batch++; batch < batches_count; batch = next_batch++)
+        {
+            size_t first = batch * buildBatchPoints;
+            this->integrate(points + first * floatsPerPoint, std::min(buildBatchPoints, points_count - first));
+        }
+    };
+
+    std::vector<std::thread> workers;
+
+    for(unsigned int i = 1; i < std::min<size_t>(threads_count, batches_count); ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+
+    for(std::thread &thread : workers)
+    {
+        thread.join();
+    }
+}
+
+//// getters
+const OctreeNode *Octree::getRoot()
+{
+    return this->root.get();
+}
+
+OctreeStatistics Octree::getStatistics()
+{
+    OctreeStatistics statistics;
+    statistics.nodesCount = this->nodesCount;
+    statistics.storedPointsCount = this->storedPointsCount;
+    statistics.insertedPointsCount = this->insertedPointsCount;
+    statistics.droppedPointsCount = this->droppedPointsCount;
+    statistics.depth = this->depth;
+
+    return statistics;
+}
+
+//// queries
+void Octree::queryBox(const BoundingBox &box, std::vector<const OctreeNode *> &nodes, int max_depth)
+{
+    if(this->root != nullptr)
+    {
+        this->queryBoxNode(this->root.get(), box, max_depth, nodes);
+    }
+}
+
+void Octree::queryBoxPoints(const BoundingBox &box, std::vector<float> &points, int max_depth)
+{
+    std::vector<const OctreeNode *> nodes;
+    this->queryBox(box, nodes, max_depth);
+
+    for(const OctreeNode *node : nodes)
+    {
+        for(size_t i = 0; i < node->points.size(); i += floatsPerPoint)
+        {
+            if(box.contains(&node->points[i]))
+            {
+                points.insert(points.end(), node->points.begin() + i, node->points.begin() + i + floatsPerPoint);
+            }
+        }
+    }
+}
+
+void Octree::queryFrustum(const Frustum &frustum, const float eye[3], float lod_threshold, std::vector<const OctreeNode *> &nodes)
+{
+    if(this->root != nullptr)
+    {
+        this->queryFrustumNode(this->root.get(), frustum, eye, lod_threshold, nodes);
+    }
+}
+
+void Octree::clear()
+{
+    std::unique_lock<std::shared_mutex> lock(this->treeMutex);
+
+    this->root.reset();
+    this->leafHalfSize = 0.f;
+
+    this->nodesCount = 0;
+    this->storedPointsCount = 0;
+    this->insertedPointsCount = 0;
+    this->droppedPointsCount = 0;
+    this->depth = 0;
+}
+
+// private functions
+void Octree::insertBatch(OctreeNode *node, const float *points, size_t points_count)
+{
+    std::vector<float> child_points[8];
+    OctreeNode *children[8];
+
+    {
+        std::lock_guard<std::mutex> lock(node->mutex);
+
+        // nodes at the leaf size keep one point per cell and drop the rest
+        const bool can_split = node->halfSize > this->leafHalfSize * 1.5f;
+        size_t stored_count = 0;
+        size_t dropped_count = 0;
+
+        for(size_t i = 0; i < points_count; ++i)
+        {
+            const float *point = points + i * floatsPerPoint;
+
+            if(!std::isfinite(point[0]) || !std::isfinite(point[1]) || !std::isfinite(point[2]))
+            {
+                dropped_count += 1;
+                continue;
+            }
+
+            uint32_t cell = this->getCellIndex(node, point);
+            uint64_t cell_bit = 1ull << (cell % 64);
+
+            if((node->occupiedCells[cell / 64] & cell_bit) == 0)
+            {
+                node->occupiedCells[cell / 64] |= cell_bit;
+                node->points.insert(node->points.end(), point, point + floatsPerPoint);
+                stored_count += 1;
+            }
+            else if(can_split)
+            {
+                std::vector<float> &target = child_points[Octree::getChildIndex(node, point)];
+                target.insert(target.end(), point, point + floatsPerPoint);
+            }
+            else
+            {
+                dropped_count += 1;
+            }
+        }
+
+        for(int k = 0; k < 8; ++k)
+        {
+            if(!child_points[k].empty() && node->children[k] == nullptr)
+            {
+                float quarter = node->halfSize * 0.5f;
+                float center[3] = {
+                    node->center[0] + ((k & 1) ? quarter : -quarter),
+                    node->center[1] + ((k & 2) ? quarter : -quarter),
+                    node->center[2] + ((k & 4) ? quarter : -quarter)
+                };
+
+                node->children[k].reset(this->createNode(center, quarter, node->depth + 1));
+            }
+
+            children[k] = node->children[k].get();
+        }
+
+        this->storedPointsCount += stored_count;
+        this->droppedPointsCount += dropped_count;
+    }
+
+    // the node lock is released, other batches can pass through it while the children are filled
+    for(int k = 0; k < 8; ++k)
+    {
+        if(!child_points[k].empty())
+        {
+            this->insertBatch(children[k], child_points[k].data(), child_points[k].size() / floatsPerPoint);
+        }
+    }
+}
+
+void Octree::createRoot(const BoundingBox &bounds)
+{
+    float center[3];
+    float half_size = 0.f;
+
+    for(int k = 0; k < 3; ++k)
+    {
+        center[k] = 0.5f * (bounds.min[k] + bounds.max[k]);
+        half_size = std::max(half_size, 0.5f * (bounds.max[k] - bounds.min[k]));
+    }
+
+    // a little slack so points on the bounds stay inside after rounding
+    half_size = half_size > 0.f ? half_size * 1.001f : 0.5f;
+
+    this->root.reset(this->createNode(center, half_size, 0));
+    this->leafHalfSize = std::ldexp(half_size, -this->maxDepth);
+}
+
+void Octree::expandRoot(const BoundingBox &bounds)
+{
+    while(!this->rootContains(bounds))
+    {
+        OctreeNode *old_root = this->root.release();
+
+        // double the root towards the points outside of it
+        float center[3];
+
+        for(int k = 0; k < 3; ++k)
+        {
+            bool grow_down = bounds.min[k] < old_root->center[k] - old_root->halfSize;
+            center[k] = old_root->center[k] + (grow_down ? -old_root->halfSize : old_root->halfSize);
+        }
+
+        OctreeNode *new_root = this->createNode(center, old_root->halfSize * 2.f, 0);
+
+        Octree::increaseDepth(old_root);
+        this->depth += 1;
+        new_root->children[Octree::getChildIndex(new_root, old_root->center)].reset(old_root);
+
+        // the coarser root takes over the samples of the old root that fall into its free cells
+        std::vector<float> kept_points;
+
+        for(size_t i = 0; i < old_root->points.size(); i += floatsPerPoint)
+        {
+            const float *point = &old_root->points[i];
+            uint32_t cell = this->getCellIndex(new_root, point);
+            uint64_t cell_bit = 1ull << (cell % 64);
+
+            if((new_root->occupiedCells[cell / 64] & cell_bit) == 0)
+            {
+                new_root->occupiedCells[cell / 64] |= cell_bit;
+                new_root->points.insert(new_root->points.end(), point, point + floatsPerPoint);
+            }
+            else
+            {
+                kept_points.insert(kept_points.end(), point, point + floatsPerPoint);
+            }
+        }
+
+        old_root->points.swap(kept_points);
+
+        // cells of the samples that moved up are free again in the old root
+        std::fill(old_root->occupiedCells.begin(), old_root->occupiedCells.end(), 0);
+
+        for(size_t i = 0; i < old_root->points.size(); i += floatsPerPoint)
+        {
+            uint32_t cell = this->getCellIndex(old_root, &old_root->points[i]);
+            old_root->occupiedCells[cell / 64] |= 1ull << (cell % 64);
+        }
+
+        this->root.reset(new_root);
+    }
+}
+
+OctreeNode *Octree::createNode(const float center[3], float half_size, int depth)
+{
+    OctreeNode *node = new OctreeNode();
+    node->center[0] = center[0];
+    node->center[1] = center[1];
+    node->center[2] = center[2];
+    node->halfSize = half_size;
+    node->depth = depth;
+
+    size_t cells_count = static_cast<size_t>(this->sampleGridResolution) * this->sampleGridResolution * this->sampleGridResolution;
+    node->occupiedCells.assign((cells_count + 63) / 64, 0);
+
+    this->nodesCount += 1;
+
+    int max_depth = this->depth;
+
+    while(depth > max_depth && !this->depth.compare_exchange_weak(max_depth, depth))
+    {
+    }
+
+    return node;
+}
+
+bool Octree::rootContains(const BoundingBox &bounds)
+{
+    BoundingBox root_bounds = this->root->getBounds();
+
+    return bounds.min[0] >= root_bounds.min[0] && bounds.max[0] <= root_bounds.max[0]
+        && bounds.min[1] >= root_bounds.min[1] && bounds.max[1] <= root_bounds.max[1]
+        && bounds.min[2] >= root_bounds.min[2] && bounds.max[2] <= root_bounds.max[2];
+}
+
+uint32_t Octree::getCellIndex(const OctreeNode *node, const float *point)
+{
+    const int resolution = this->sampleGridResolution;
+    const float scale = resolution / (2.f * node->halfSize);
+
+    uint32_t cell = 0;
+
+    for(int k = 2; k >= 0; --k)
+    {
+        int coordinate = static_cast<int>((point[k] - node->center[k] + node->halfSize) * scale);
+        coordinate = std::min(std::max(coordinate, 0), resolution - 1);
+
+        cell = cell * resolution + static_cast<uint32_t>(coordinate);
+    }
+
+    return cell;
+}
+
+int Octree::getChildIndex(const OctreeNode *node, const float *point)
+{
+    return (point[0] >= node->center[0] ? 1 : 0) | (point[1] >= node->center[1] ? 2 : 0) | (point[2] >= node->center[2] ? 4 : 0);
+}
+
+void Octree::increaseDepth(OctreeNode *node)
+{
+    node->depth += 1;
+
+    for(std::unique_ptr<OctreeNode> &child : node->children)
+    {
+        if(child != nullptr)
+        {
+            Octree::increaseDepth(child.get());
+        }
+    }
+}
+
+void Octree::queryBoxNode(const OctreeNode *node, const BoundingBox &box, int max_depth, std::vector<const OctreeNode *> &nodes)
+{
+    if(!box.intersects(node->getBounds()))
+    {
+        return;
+    }
+
+    nodes.push_back(node);
+
+    if(max_depth >= 0 && node->depth >= max_depth)
+    {
+        return;
+    }
+
+    for(const std::unique_ptr<OctreeNode> &child : node->children)
+    {
+        if(child != nullptr)
+        {
+            this->queryBoxNode(child.get(), box, max_depth, nodes);
+        }
+    }
+}
+
+void Octree::queryFrustumNode(const OctreeNode *node, const Frustum &frustum, const float eye[3], float lod_threshold, std::vector<const OctreeNode *> &nodes)
+{
+    if(!frustum.intersects(node->getBounds()))
+    {
+        return;
+    }
+
+    nodes.push_back(node);
+
+    if(lod_threshold > 0.f)
+    {
+        float offset[3] = { node->center[0] - eye[0], node->center[1] - eye[1], node->center[2] - eye[2] };
+        float distance = std::sqrt(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+
+        // the eye inside a node always refines it
+        if(2.f * node->halfSize / std::max(distance, node->halfSize) < lod_threshold)
+        {
+            return;
+        }
+    }
+
+    for(const std::unique_ptr<OctreeNode> &child : node->children)
+    {
+        if(child != nullptr)
+        {
+            this->queryFrustumNode(child.get(), frustum, eye, lod_threshold, nodes);
+        }
+    }
+}
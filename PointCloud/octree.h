@@ -0,0 +1,118 @@
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+struct BoundingBox
+{
+    float min[3];
+    float max[3];
+
+    bool contains(const float *point) const;
+    bool intersects(const BoundingBox &box) const;
+};
+
+struct Frustum
+{
+    float planes[6][4];     // a * x + b * y + c * z + d >= 0 inside, normalized
+
+    //// planes of a column-major view-projection matrix, the QMatrix4x4::constData() layout
+    static Frustum fromMatrix(const float view_projection[16]);
+    bool intersects(const BoundingBox &box) const;
+};
+
+struct OctreeNode
+{
+    float center[3];
+    float halfSize;
+    int depth;
+
+    //// sample of the points inside the node, interleaved x, y, z, r, g, b, at most one per sampling grid cell
+    std::vector<float> points;
+    std::unique_ptr<OctreeNode> children[8];
+
+    BoundingBox getBounds() const;
+
+    //// insertion state
+    std::mutex mutex;
+    std::vector<uint64_t> occupiedCells;
+};
+
+struct OctreeStatistics
+{
+    size_t nodesCount;
+    size_t storedPointsCount;
+    size_t insertedPointsCount;
+    size_t droppedPointsCount;      // fell into an occupied cell of a node at the deepest level
+    int depth;
+};
+
+//// hierarchical sample of the cloud, every level is a spatially uniform level of detail of the levels below it;
+//// the root grows whenever points arrive outside of it, the deepest cell size stays fixed
+class Octree
+{
+public:
+    // constructors/destructors
+    Octree(int max_depth, int sample_grid_resolution = 32);
+    ~Octree();
+
+    // public functions
+    //// interleaved x, y, z, r, g, b points, thread safe
+    void integrate(const float *points, size_t points_count);
+    ////// splits points into batches integrated on threads_count threads
+    void build(const float *points, size_t points_count, unsigned int threads_count);
+
+    //// getters, must not run concurrently with integrate
+    const OctreeNode *getRoot();
+    OctreeStatistics getStatistics();
+
+    //// queries, must not run concurrently with integrate
+    ////// nodes intersecting box, levels below max_depth are skipped, -1 - all levels
+    void queryBox(const BoundingBox &box, std::vector<const OctreeNode *> &nodes, int max_depth = -1);
+    ////// sampled points inside box
+    void queryBoxPoints(const BoundingBox &box, std::vector<float> &points, int max_depth = -1);
+    ////// nodes intersecting frustum, a node is refined while its size over the distance to eye exceeds lod_threshold,
+    ////// 0 - all levels
+    void queryFrustum(const Frustum &frustum, const float eye[3], float lod_threshold, std::vector<const OctreeNode *> &nodes);
+
+    void clear();
+
+private:
+    // private functions
+    void insertBatch(OctreeNode *node, const float *points, size_t points_count);
+    void createRoot(const BoundingBox &bounds);
+    void expandRoot(const BoundingBox &bounds);
+    OctreeNode *createNode(const float center[3], float half_size, int depth);
+    bool rootContains(const BoundingBox &bounds);
+
+    uint32_t getCellIndex(const OctreeNode *node, const float *point);
+    static int getChildIndex(const OctreeNode *node, const float *point);
+    static void increaseDepth(OctreeNode *node);
+
+    void queryBoxNode(const OctreeNode *node, const BoundingBox &box, int max_depth, std::vector<const OctreeNode *> &nodes);
+    void queryFrustumNode(const OctreeNode *node, const Frustum &frustum, const float eye[3], float lod_threshold, std::vector<const OctreeNode *> &nodes);
+
+    // private variables
+    int maxDepth;
+    int sampleGridResolution;
+    float leafHalfSize;             // fixed by the first batch, nodes of this size are not split
+
+    std::unique_ptr<OctreeNode> root;
+    //// shared while inserting, exclusive while the root is replaced
+    std::shared_mutex treeMutex;
+
+    //// statistics
+    std::atomic<size_t> nodesCount;
+    std::atomic<size_t> storedPointsCount;
+    std::atomic<size_t> insertedPointsCount;
+    std::atomic<size_t> droppedPointsCount;
+    std::atomic<int> depth;
+};
+
+#endif // OCTREE_H
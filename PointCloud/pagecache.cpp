@@ -0,0 +1,237 @@
+#include "pagecache.h"
+
+#include <algorithm>
+#include <limits>
+
+// constructors/destructors
+PageCache::PageCache(PageCacheSettings settings)
+{
+    this->settings = settings;
+    this->settings.loaderThreadsCount = std::max(1u, settings.loaderThreadsCount);
+
+    this->pageStore = nullptr;
+    this->stopping = false;
+    this->nextRequested = 0;
+    this->requestStamp = 0;
+    this->reservedBytes = 0;
+    this->statistics = PageCacheStatistics();
+}
+
+PageCache::~PageCache()
+{
+    this->stop();
+}
+
+// public functions
+void PageCache::start(PageStore *page_store)
+{
+    this->stop();
+
+    size_t pages_count = page_store->getPages().size();
+
+    this->pageStore = page_store;
+    this->stopping = false;
+    this->requestedPages.clear();
+    this->nextRequested = 0;
+    this->requestStamp = 0;
+    this->residentPages.resize(pages_count);
+    this->residentIndexes.clear();
+    this->pageStates.assign(pages_count, PageState::Absent);
+    this->lastRequested.assign(pages_count, 0);
+    this->reservedBytes = 0;
+    this->statistics = PageCacheStatistics();
+
+    for(unsigned int i = 0; i < this->settings.loaderThreadsCount; ++i)
+    {
+        this->loaderThreads.emplace_back(&PageCache::loaderWorker, this);
+    }
+}
+
+void PageCache::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->cacheMutex);
+        this->stopping = true;
+    }
+
+    this->requestChanged.notify_all();
+
+    for(std::thread &loader_thread : this->loaderThreads)
+    {
+        loader_thread.join();
+    }
+
+    this->loaderThreads.clear();
+
+    // swapped out so that the memory is returned, clear keeps the capacity
+    std::vector<PointChunk>().swap(this->residentPages);
+    std::vector<size_t>().swap(this->residentIndexes);
+    std::vector<PageState>().swap(this->pageStates);
+    std::vector<uint64_t>().swap(this->lastRequested);
+    this->requestedPages.clear();
+    this->reservedBytes = 0;
+    this->pageStore = nullptr;
+}
+
+void PageCache::request(const std::vector<size_t> &pages)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->cacheMutex);
+
+        this->requestStamp += 1;
+        this->requestedPages.clear();
+        this->nextRequested = 0;
+
+        for(size_t page : pages)
+        {
+            if(page < this->pageStates.size())
+            {
+                this->requestedPages.push_back(page);
+                this->lastRequested[page] = this->requestStamp;
+            }
+        }
+    }
+
+    this->requestChanged.notify_all();
+}
+
+bool PageCache::copyPage(size_t page, PointChunk &chunk)
+{
+    std::lock_guard<std::mutex> lock(this->cacheMutex);
+
+    if(page >= this->pageStates.size() || this->pageStates[page] != PageState::Resident)
+    {
+        return false;
+    }
+
+    chunk = this->residentPages[page];
+
+    return true;
+}
+
+bool PageCache::isResident(size_t page)
+{
+    std::lock_guard<std::mutex> lock(this->cacheMutex);
+
+    return page < this->pageStates.size() && this->pageStates[page] == PageState::Resident;
+}
+
+//// getters
+PageCacheStatistics PageCache::getStatistics()
+{
+    std::lock_guard<std::mutex> lock(this->cacheMutex);
+
+    return this->statistics;
+}
+
+// private functions
+void PageCache::loaderWorker()
+{
+    std::unique_lock<std::mutex> lock(this->cacheMutex);
+
+    while(!this->stopping)
+    {
+        // resident, loading and failed pages of the request need nothing
+        while(this->nextRequested < this->requestedPages.size() && this->pageStates[this->requestedPages[this->nextRequested]] != PageState::Absent)
+        {
+            this->nextRequested += 1;
+        }
+
+        // lower priority pages are not loaded in place of one that does not fit, until the request changes
+        if(this->nextRequested == this->requestedPages.size() || !this->makeRoom(this->getPageBytes(this->requestedPages[this->nextRequested])))
+        {
+            this->requestChanged.wait(lock);
+            continue;
+        }
+
+        size_t page = this->requestedPages[this->nextRequested];
+        size_t bytes = this->getPageBytes(page);
+
+        this->nextRequested += 1;
+        this->pageStates[page] = PageState::Loading;
+        this->reservedBytes += bytes;
+        this->statistics.loadingPagesCount += 1;
+
+        lock.unlock();
+
+        PointChunk chunk;
+        bool loaded = this->pageStore->readPage(page, chunk);
+
+        lock.lock();
+
+        this->statistics.loadingPagesCount -= 1;
+
+        if(loaded)
+        {
+            this->residentPages[page] = std::move(chunk);
+            this->residentIndexes.push_back(page);
+            this->pageStates[page] = PageState::Resident;
+
+            this->statistics.residentPagesCount += 1;
+            this->statistics.residentBytes += bytes;
+            this->statistics.loadedPagesCount += 1;
+            this->statistics.bytesRead += bytes;
+        }
+        else
+        {
+            // not retried, the bytes go back to the loaders waiting for room
+            this->pageStates[page] = PageState::Failed;
+            this->reservedBytes -= bytes;
+            this->statistics.failedPagesCount += 1;
+
+            this->requestChanged.notify_all();
+        }
+    }
+}
+
+bool PageCache::makeRoom(size_t bytes)
+{
+    while(this->reservedBytes + bytes > this->settings.hostBudgetBytes)
+    {
+        // a page larger than the whole budget is still loaded alone
+        if(this->reservedBytes == 0)
+        {
+            return true;
+        }
+
+        size_t evicted = std::numeric_limits<size_t>::max();
+        uint64_t oldest_stamp = this->requestStamp;
+
+        for(size_t i = 0; i < this->residentIndexes.size(); ++i)
+        {
+            uint64_t stamp = this->lastRequested[this->residentIndexes[i]];
+
+            if(stamp < oldest_stamp)
+            {
+                oldest_stamp = stamp;
+                evicted = i;
+            }
+        }
+
+        if(evicted == std::numeric_limits<size_t>::max())
+        {
+            return false;
+        }
+
+        size_t page = this->residentIndexes[evicted];
+        size_t page_bytes = this->getPageBytes(page);
+
+        this->residentIndexes[evicted] = this->residentIndexes.back();
+        this->residentIndexes.pop_back();
+
+        std::vector<CompactPoint>().swap(this->residentPages[page].points);
+        this->pageStates[page] = PageState::Absent;
+        this->reservedBytes -= page_bytes;
+
+        this->statistics.residentPagesCount -= 1;
+        this->statistics.residentBytes -= page_bytes;
+        this->statistics.evictedPagesCount += 1;
+    }
+
+    return true;
+}
+
+size_t PageCache::getPageBytes(size_t page)
+{
+    return static_cast<size_t>(this->pageStore->getPages()[page].pointsCount) * sizeof(CompactPoint);
+}
@@ -0,0 +1,90 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include "pagestore.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+struct PageCacheSettings
+{
+    size_t hostBudgetBytes;         // points of resident pages, pages not requested any more are evicted beyond it
+    unsigned int loaderThreadsCount;
+};
+
+struct PageCacheStatistics
+{
+    size_t residentPagesCount;
+    size_t residentBytes;
+    size_t loadingPagesCount;
+    size_t loadedPagesCount;        // since start
+    size_t evictedPagesCount;
+    size_t failedPagesCount;
+    size_t bytesRead;
+};
+
+//// keeps pages of a PageStore in memory within a fixed budget; loader threads read the requested pages in
+//// priority order and evict the least recently requested ones, the requesting thread never waits for I/O
+class PageCache
+{
+public:
+    // constructors/destructors
+    PageCache(PageCacheSettings settings);
+    ~PageCache();
+
+    // public functions
+    //// the store has to stay open until stop
+    void start(PageStore *page_store);
+    void stop();
+
+    //// replaces the previous request, most important page first; pages of it are never evicted for each other,
+    ////// loading stops at the first one that does not fit into the budget
+    void request(const std::vector<size_t> &pages);
+    //// false while the page is not resident
+    bool copyPage(size_t page, PointChunk &chunk);
+    bool isResident(size_t page);
+
+    //// getters
+    PageCacheStatistics getStatistics();
+
+private:
+    enum class PageState : uint8_t
+    {
+        Absent,
+        Loading,
+        Resident,
+        Failed
+    };
+
+    // private functions
+    void loaderWorker();
+    ////// cacheMutex held, evicts pages outside of the current request until bytes more fit into the budget
+    bool makeRoom(size_t bytes);
+    size_t getPageBytes(size_t page);
+
+    // private variables
+    PageCacheSettings settings;
+    PageStore *pageStore;
+    std::vector<std::thread> loaderThreads;
+
+    std::mutex cacheMutex;
+    std::condition_variable requestChanged;
+    bool stopping;
+
+    std::vector<size_t> requestedPages;
+    size_t nextRequested;           // pages of the request before it are resident, loading or failed
+    uint64_t requestStamp;
+
+    std::vector<PointChunk> residentPages;
+    std::vector<size_t> residentIndexes;    // eviction candidates
+    std::vector<PageState> pageStates;
+    std::vector<uint64_t> lastRequested;    // stamp of the last request listing the page
+    size_t reservedBytes;           // resident and loading
+    PageCacheStatistics statistics;
+};
+
+#endif // PAGECACHE_H
@@ -0,0 +1,522 @@
+#include "pagestore.h"
+#include "profiler.h"
+
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <limits>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char pageStoreMagic[8] = { 'P', 'C', 'P', 'A', 'G', 'E', 'S', '\0' };
+static const uint32_t pageStoreVersion = 1;
+static const uint64_t pageAlignment = 16;
+
+//// same packing as the SpatialChunker cells, 21 bits per axis around the world origin
+static const int64_t cellCoordinateBias = int64_t(1) << 20;
+
+static uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + pageAlignment - 1) / pageAlignment * pageAlignment;
+}
+
+// constructors/destructors
+PageStore::PageStore()
+{
+    this->fileDescriptor = -1;
+    this->header = {};
+
+    this->writeChunker = nullptr;
+    this->writeSpillDescriptor = -1;
+    this->writeSpillOffset = 0;
+    this->writeSpillsInFlight = 0;
+    this->writeChunkSize = 1.f;
+    this->writePagePointsCapacity = 0;
+    this->writeBufferBytes = 0;
+    this->writeFailed = false;
+}
+
+PageStore::~PageStore()
+{
+    this->close();
+
+    // an unfinished write leaves the previous store in place
+    if(this->writeSpillDescriptor >= 0)
+    {
+        ::close(this->writeSpillDescriptor);
+        std::remove(this->writeSpillPath.c_str());
+    }
+
+    delete this->writeChunker;
+}
+
+// public functions
+//// reading
+bool PageStore::open(const std::string &path_to_pages)
+{
+    this->close();
+
+    this->fileDescriptor = ::open(path_to_pages.c_str(), O_RDONLY);
+
+    struct stat file_status;
+
+    if(this->fileDescriptor < 0 || fstat(this->fileDescriptor, &file_status) != 0
+       || !PageStore::readAt(this->fileDescriptor, &this->header, sizeof(PageStoreHeader), 0))
+    {
+        std::cerr << "Could not open page store: " << path_to_pages.c_str() << std::endl;
+        this->close();
+        return false;
+    }
+
+    uint64_t file_size = static_cast<uint64_t>(file_status.st_size);
+    uint64_t table_end = this->header.tableOffset + this->header.pagesCount * sizeof(PageEntry);
+
+    if(std::memcmp(this->header.magic, pageStoreMagic, sizeof(pageStoreMagic)) != 0 || this->header.version != pageStoreVersion
+       || this->header.tableOffset > file_size || table_end > file_size)
+    {
+        std::cerr << "Not a page store or an incompatible version: " << path_to_pages.c_str() << std::endl;
+        this->close();
+        return false;
+    }
+
+    this->pages.resize(this->header.pagesCount);
+
+    if(!PageStore::readAt(this->fileDescriptor, this->pages.data(), this->pages.size() * sizeof(PageEntry), this->header.tableOffset))
+    {
+        std::cerr << "Could not read the page table: " << path_to_pages.c_str() << std::endl;
+        this->close();
+        return false;
+    }
+
+    for(const PageEntry &page : this->pages)
+    {
+        if(page.offset + page.pointsCount * sizeof(CompactPoint) > this->header.tableOffset)
+        {
+            std::cerr << "Page store is truncated: " << path_to_pages.c_str() << std::endl;
+            this->close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void PageStore::close()
+{
+    if(this->fileDescriptor >= 0)
+    {
+        ::close(this->fileDescriptor);
+    }
+
+    this->fileDescriptor = -1;
+    this->header = {};
+    this->pages.clear();
+}
+
+bool PageStore::readPage(size_t page, PointChunk &chunk)
+{
+    if(this->fileDescriptor < 0 || page >= this->pages.size())
+    {
+        return false;
+    }
+
+    const PageEntry &entry = this->pages[page];
+
+    chunk.origin[0] = entry.origin[0];
+    chunk.origin[1] = entry.origin[1];
+    chunk.origin[2] = entry.origin[2];
+    chunk.scale = entry.scale;
+    chunk.points.resize(entry.pointsCount);
+
+    size_t size = chunk.points.size() * sizeof(CompactPoint);
+
+    if(!PageStore::readAt(this->fileDescriptor, chunk.points.data(), size, entry.offset))
+    {
+        chunk.points.clear();
+        return false;
+    }
+
+    Profiler::count(ProfileCounter::BytesRead, size);
+
+    return true;
+}
+
+//// writing
+bool PageStore::beginWrite(const std::string &path_to_pages, float chunk_size, size_t page_points_capacity, size_t buffer_bytes)
+{
+    std::lock_guard<std::mutex> lock(this->writeMutex);
+
+    if(this->writeChunker != nullptr)
+    {
+        std::cerr << "Page store is already being written: " << this->writePath.c_str() << std::endl;
+        return false;
+    }
+
+    this->writePath = path_to_pages;
+    this->writeSpillPath = path_to_pages + ".spill";
+    this->writeSpillDescriptor = ::open(this->writeSpillPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if(this->writeSpillDescriptor < 0)
+    {
+        std::cerr << "Could not create page store spill file: " << this->writeSpillPath.c_str() << std::endl;
+        return false;
+    }
+
+    this->writeChunkSize = chunk_size > 0.f ? chunk_size : 1.f;
+    this->writePagePointsCapacity = std::max<size_t>(1, page_points_capacity);
+    this->writeBufferBytes = buffer_bytes;
+    this->writeSpillOffset = 0;
+    this->writeFragments.clear();
+    this->writeFailed = false;
+    this->writeChunker = new SpatialChunker(this->writeChunkSize);
+
+    return true;
+}
+
+void PageStore::add(const float *points, size_t points_count)
+{
+    std::unique_lock<std::mutex> lock(this->writeMutex);
+
+    if(this->writeChunker == nullptr)
+    {
+        return;
+    }
+
+    this->writeChunker->add(points, points_count);
+
+    if(this->writeChunker->getPointsCount() * sizeof(CompactPoint) >= this->writeBufferBytes)
+    {
+        this->spill(lock);
+    }
+}
+
+void PageStore::add(const PointChunk &chunk)
+{
+    std::unique_lock<std::mutex> lock(this->writeMutex);
+
+    if(this->writeChunker == nullptr)
+    {
+        return;
+    }
+
+    this->writeChunker->add(chunk);
+
+    if(this->writeChunker->getPointsCount() * sizeof(CompactPoint) >= this->writeBufferBytes)
+    {
+        this->spill(lock);
+    }
+}
+
+bool PageStore::finishWrite()
+{
+    std::unique_lock<std::mutex> lock(this->writeMutex);
+
+    if(this->writeChunker == nullptr)
+    {
+        return false;
+    }
+
+    this->spill(lock);
+
+    // spills of other threads have to land before their fragments are merged
+    this->writeSpillsFinished.wait(lock, [this]() { return this->writeSpillsInFlight == 0; });
+
+    delete this->writeChunker;
+    this->writeChunker = nullptr;
+
+    std::string temporary_path = this->writePath + ".tmp";
+    int pages_descriptor = this->writeFailed ? -1 : ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    PageStoreHeader header = {};
+    std::memcpy(header.magic, pageStoreMagic, sizeof(pageStoreMagic));
+    header.version = pageStoreVersion;
+    header.pagePointsCapacity = static_cast<uint32_t>(this->writePagePointsCapacity);
+    header.chunkSize = this->writeChunkSize;
+
+    // spills of one cell are merged in the order of their spill file offsets, whichever thread finished first
+    std::sort(this->writeFragments.begin(), this->writeFragments.end(), [](const Fragment &a, const Fragment &b)
+    {
+        return a.cellKey < b.cellKey || (a.cellKey == b.cellKey && a.offset < b.offset);
+    });
+
+    std::vector<Fragment> cell_fragments;
+    std::vector<PageEntry> pages;
+    uint64_t offset = alignOffset(sizeof(PageStoreHeader));
+    bool written = pages_descriptor >= 0;
+
+    for(size_t first = 0; written && first < this->writeFragments.size();)
+    {
+        size_t last = first;
+
+        while(last < this->writeFragments.size() && this->writeFragments[last].cellKey == this->writeFragments[first].cellKey)
+        {
+            ++last;
+        }
+
+        cell_fragments.assign(this->writeFragments.begin() + first, this->writeFragments.begin() + last);
+        written = this->writePages(pages_descriptor, cell_fragments, pages, offset);
+
+        first = last;
+    }
+
+    header.pagesCount = pages.size();
+    header.tableOffset = offset;
+
+    for(const PageEntry &page : pages)
+    {
+        header.pointsCount += page.pointsCount;
+    }
+
+    written = written && PageStore::writeAt(pages_descriptor, pages.data(), pages.size() * sizeof(PageEntry), offset)
+              && PageStore::writeAt(pages_descriptor, &header, sizeof(PageStoreHeader), 0);
+
+    if(pages_descriptor >= 0)
+    {
+        written = ::close(pages_descriptor) == 0 && written;
+    }
+
+    ::close(this->writeSpillDescriptor);
+    std::remove(this->writeSpillPath.c_str());
+    this->writeSpillDescriptor = -1;
+    this->writeFragments.clear();
+
+    if(!written || std::rename(temporary_path.c_str(), this->writePath.c_str()) != 0)
+    {
+        std::cerr << "Could not write page store: " << this->writePath.c_str() << std::endl;
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+
+    std::cerr << "Page store: " << header.pagesCount << " pages, " << header.pointsCount << " points" << std::endl;
+
+    return true;
+}
+
+bool PageStore::isWriting()
+{
+    std::lock_guard<std::mutex> lock(this->writeMutex);
+
+    return this->writeChunker != nullptr;
+}
+
+//// getters
+bool PageStore::isOpen()
+{
+    return this->fileDescriptor >= 0;
+}
+
+const std::vector<PageEntry> &PageStore::getPages()
+{
+    return this->pages;
+}
+
+size_t PageStore::getPointsCount()
+{
+    return this->header.pointsCount;
+}
+
+size_t PageStore::getPagePointsCapacity()
+{
+    return this->header.pagePointsCapacity;
+}
+
+// private functions
+void PageStore::spill(std::unique_lock<std::mutex> &lock)
+{
+    SpatialChunker *chunker = this->writeChunker;
+    this->writeChunker = new SpatialChunker(this->writeChunkSize);
+    this->writeSpillsInFlight += 1;
+
+    lock.unlock();
+
+    // bounds are recomputed per page when the spills are merged
+    std::vector<PointChunk> chunks;
+    std::vector<BoundingBox> bounds;
+    chunker->finish(chunks, bounds);
+    delete chunker;
+
+    uint64_t spill_size = 0;
+
+    for(const PointChunk &chunk : chunks)
+    {
+        spill_size += chunk.points.size() * sizeof(CompactPoint);
+    }
+
+    lock.lock();
+    uint64_t offset = this->writeSpillOffset;
+    this->writeSpillOffset += spill_size;
+    lock.unlock();
+
+    std::vector<Fragment> fragments;
+    fragments.reserve(chunks.size());
+    bool written = true;
+
+    for(const PointChunk &chunk : chunks)
+    {
+        Fragment fragment;
+        fragment.cellKey = this->getCellKey(chunk.origin);
+        fragment.offset = offset;
+        fragment.pointsCount = chunk.points.size();
+        fragment.origin[0] = chunk.origin[0];
+        fragment.origin[1] = chunk.origin[1];
+        fragment.origin[2] = chunk.origin[2];
+        fragment.scale = chunk.scale;
+
+        size_t size = chunk.points.size() * sizeof(CompactPoint);
+
+        if(!PageStore::writeAt(this->writeSpillDescriptor, chunk.points.data(), size, offset))
+        {
+            written = false;
+            break;
+        }
+
+        offset += size;
+        fragments.push_back(fragment);
+    }
+
+    lock.lock();
+    this->writeFragments.insert(this->writeFragments.end(), fragments.begin(), fragments.end());
+    this->writeFailed = this->writeFailed || !written;
+    this->writeSpillsInFlight -= 1;
+    this->writeSpillsFinished.notify_all();
+}
+
+uint64_t PageStore::getCellKey(const float origin[3])
+{
+    uint64_t key = 0;
+
+    // the origin is the cell centre
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        int64_t coordinate = static_cast<int64_t>(std::floor(origin[axis] / this->writeChunkSize));
+        coordinate = std::clamp(coordinate, -cellCoordinateBias, cellCoordinateBias - 1);
+
+        key |= static_cast<uint64_t>(coordinate + cellCoordinateBias) << (21 * axis);
+    }
+
+    return key;
+}
+
+bool PageStore::writePages(int pages_descriptor, const std::vector<Fragment> &cell_fragments, std::vector<PageEntry> &pages, uint64_t &offset)
+{
+    const Fragment &cell = cell_fragments.front();
+
+    size_t points_count = 0;
+
+    for(const Fragment &fragment : cell_fragments)
+    {
+        points_count += fragment.pointsCount;
+    }
+
+    std::vector<CompactPoint> points(points_count);
+    size_t first_point = 0;
+
+    for(const Fragment &fragment : cell_fragments)
+    {
+        if(!PageStore::readAt(this->writeSpillDescriptor, points.data() + first_point, fragment.pointsCount * sizeof(CompactPoint), fragment.offset))
+        {
+            return false;
+        }
+
+        first_point += fragment.pointsCount;
+    }
+
+    // a fixed seed per cell keeps the draw order stable between runs, every page is a uniform sample of the cell
+    std::mt19937 generator(static_cast<uint32_t>(cell.cellKey ^ (cell.cellKey >> 32)));
+    std::shuffle(points.begin(), points.end(), generator);
+
+    size_t pages_count = (points_count + this->writePagePointsCapacity - 1) / this->writePagePointsCapacity;
+
+    for(size_t i = 0; i < pages_count; ++i)
+    {
+        size_t first = i * points_count / pages_count;
+        size_t count = (i + 1) * points_count / pages_count - first;
+
+        PageEntry page;
+        page.origin[0] = cell.origin[0];
+        page.origin[1] = cell.origin[1];
+        page.origin[2] = cell.origin[2];
+        page.scale = cell.scale;
+        page.offset = offset;
+        page.pointsCount = count;
+
+        // tight bounds from the quantized extent
+        int16_t min_steps[3] = { points[first].x, points[first].y, points[first].z };
+        int16_t max_steps[3] = { points[first].x, points[first].y, points[first].z };
+
+        for(size_t j = first; j < first + count; ++j)
+        {
+            const int16_t *position = &points[j].x;
+
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                min_steps[axis] = std::min(min_steps[axis], position[axis]);
+                max_steps[axis] = std::max(max_steps[axis], position[axis]);
+            }
+        }
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            page.bounds.min[axis] = cell.origin[axis] + min_steps[axis] * cell.scale;
+            page.bounds.max[axis] = cell.origin[axis] + max_steps[axis] * cell.scale;
+        }
+
+        if(!PageStore::writeAt(pages_descriptor, points.data() + first, count * sizeof(CompactPoint), offset))
+        {
+            return false;
+        }
+
+        offset = alignOffset(offset + count * sizeof(CompactPoint));
+        pages.push_back(page);
+    }
+
+    return true;
+}
+
+bool PageStore::readAt(int file_descriptor, void *data, size_t size, uint64_t offset)
+{
+    char *destination = static_cast<char *>(data);
+
+    // pread may return less than asked for, e.g. across a signal
+    while(size > 0)
+    {
+        ssize_t count = pread(file_descriptor, destination, size, static_cast<off_t>(offset));
+
+        if(count <= 0)
+        {
+            return false;
+        }
+
+        destination += count;
+        size -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+
+    return true;
+}
+
+bool PageStore::writeAt(int file_descriptor, const void *data, size_t size, uint64_t offset)
+{
+    const char *source = static_cast<const char *>(data);
+
+    while(size > 0)
+    {
+        ssize_t count = pwrite(file_descriptor, source, size, static_cast<off_t>(offset));
+
+        if(count <= 0)
+        {
+            return false;
+        }
+
+        source += count;
+        size -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+
+    return true;
+}
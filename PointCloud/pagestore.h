@@ -0,0 +1,114 @@
+#ifndef PAGESTORE_H
+#define PAGESTORE_H
+
+#include "pointformat.h"
+#include "octree.h"
+#include "spatialchunker.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+//// on-disk layout: PageStoreHeader, 16-byte aligned pages of CompactPoint, then PageEntry[pagesCount] at tableOffset
+struct PageStoreHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pagePointsCapacity;
+    float chunkSize;
+    uint32_t reserved;
+    uint64_t pagesCount;
+    uint64_t pointsCount;
+    uint64_t tableOffset;
+};
+
+struct PageEntry
+{
+    BoundingBox bounds;         // tight around the points of the page
+    float origin[3];            // PointChunk quantization, shared by the pages of one cell
+    float scale;
+    uint64_t offset;            // from the start of the file
+    uint64_t pointsCount;
+};
+
+//// a map partitioned into spatial pages on disk; only the page table is kept in memory, pages are read on demand,
+//// so maps larger than memory can be drawn through a PageCache
+class PageStore
+{
+public:
+    // constructors/destructors
+    PageStore();
+    ~PageStore();
+
+    PageStore(const PageStore &) = delete;
+    PageStore &operator=(const PageStore &) = delete;
+
+    // public functions
+    //// reading
+    bool open(const std::string &path_to_pages);
+    void close();
+    ////// thread safe, one positioned read per page
+    bool readPage(size_t page, PointChunk &chunk);
+
+    //// writing, points are grouped into the cubic cells of SpatialChunker; whenever the buffered points exceed
+    ////// buffer_bytes the cells are spilled to a temporary file, finishWrite merges the spills of every cell
+    ////// and splits it into shuffled pages of at most page_points_capacity points, replacing the store
+    bool beginWrite(const std::string &path_to_pages, float chunk_size, size_t page_points_capacity, size_t buffer_bytes);
+    ////// thread safe, world space points
+    void add(const float *points, size_t points_count);
+    void add(const PointChunk &chunk);
+    bool finishWrite();
+    bool isWriting();
+
+    //// getters
+    bool isOpen();
+    const std::vector<PageEntry> &getPages();
+    size_t getPointsCount();
+    size_t getPagePointsCapacity();
+
+private:
+    struct Fragment
+    {
+        uint64_t cellKey;
+        uint64_t offset;            // in the spill file
+        uint64_t pointsCount;
+        float origin[3];
+        float scale;
+    };
+
+    // private functions
+    ////// called with writeMutex held; the buffered cells are swapped out and the lock is released while they are
+    ////// sorted and written at a reserved offset of the spill file, so other threads keep adding meanwhile
+    void spill(std::unique_lock<std::mutex> &lock);
+    uint64_t getCellKey(const float origin[3]);
+    bool writePages(int pages_descriptor, const std::vector<Fragment> &cell_fragments, std::vector<PageEntry> &pages, uint64_t &offset);
+
+    static bool readAt(int file_descriptor, void *data, size_t size, uint64_t offset);
+    static bool writeAt(int file_descriptor, const void *data, size_t size, uint64_t offset);
+
+    // private variables
+    //// opened store
+    int fileDescriptor;
+    PageStoreHeader header;
+    std::vector<PageEntry> pages;
+
+    //// store being written
+    std::mutex writeMutex;
+    SpatialChunker *writeChunker;
+    std::string writePath;
+    std::string writeSpillPath;
+    int writeSpillDescriptor;
+    uint64_t writeSpillOffset;
+    std::vector<Fragment> writeFragments;
+    size_t writeSpillsInFlight;
+    std::condition_variable writeSpillsFinished;
+    float writeChunkSize;
+    size_t writePagePointsCapacity;
+    size_t writeBufferBytes;
+    bool writeFailed;
+};
+
+#endif // PAGESTORE_H
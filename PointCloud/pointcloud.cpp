@@ -1,4 +1,10 @@
 #include "pointcloud.h"
+#include "pointcloudcache.h"
+#include "profiler.h"
+
+#include <thread>
+#include <chrono>
+#include <algorithm>
 
 // constructors/destructors
 PointCloud::PointCloud(InputData input_data)
@@ -9,175 +15,990 @@ PointCloud::PointCloud(InputData input_data)
 
 PointCloud::~PointCloud()
 {
-    delete this->trajectoryData;
-    delete this->associationData;
+    delete this->frameTable;
     delete this->inputData;
     delete this->pointsData;
-    delete this->rgbImage;
-    delete this->depthImage;
+    delete this->pointChunks;
+    delete this->localFrames;
+    delete this->backProjectionKernel;
+    delete this->voxelGrid;
+    delete this->tsdfVolume;
+    delete this->octree;
+    delete this->pointCloudCache;
 }
 
 // public functions
 //// getters
-std::vector<float> PointCloud::getPointsData()
+PointFormat PointCloud::getPointFormat()
+{
+    return this->inputData->pointFormat;
+}
+
+CameraIntrinsics PointCloud::getCameraIntrinsics()
+{
+    return this->cameraIntrinsics;
+}
+
+size_t PointCloud::getFramesCount()
+{
+    return this->frameTable->frames.size();
+}
+
+bool PointCloud::hasFrame(int index)
+{
+    return this->frameTable->getFrame(index) != nullptr;
+}
+
+const std::vector<float> &PointCloud::getPointsData()
 {
     return *this->pointsData;
 }
 
+PointsView PointCloud::getPointsView()
+{
+    return PointsView{ this->pointsData->data(), this->pointsData->size() / PointsView::floatsPerPoint };
+}
+
+const std::vector<PointChunk> &PointCloud::getPointChunks()
+{
+    return *this->pointChunks;
+}
+
+Octree *PointCloud::getOctree()
+{
+    return this->octree;
+}
+
+TSDFVolume *PointCloud::getTSDFVolume()
+{
+    return this->tsdfVolume;
+}
+
+const std::vector<LocalFrame> &PointCloud::getLocalFrames()
+{
+    return *this->localFrames;
+}
+
+std::vector<FramePose> PointCloud::getFramePoses()
+{
+    std::vector<FramePose> poses(this->frameTable->frames.size(), BackProjectionKernel::getIdentityPose());
+
+    for(size_t i = 0; i < poses.size(); ++i)
+    {
+        if(this->frameTable->frames[i].hasPose)
+        {
+            poses[i] = this->getFramePose(i);
+        }
+    }
+
+    return poses;
+}
+
+std::vector<FramePose> PointCloud::getTrajectory()
+{
+    std::vector<FramePose> trajectory;
+    trajectory.reserve(this->frameTable->frames.size());
+
+    for(size_t i = 0; i < this->frameTable->frames.size(); ++i)
+    {
+        if(this->frameTable->frames[i].hasPose)
+        {
+            trajectory.push_back(this->getFramePose(i));
+        }
+    }
+
+    return trajectory;
+}
+
+DepthFilterStatistics PointCloud::getDepthFilterStatistics()
+{
+    std::lock_guard<std::mutex> lock(this->depthFilterMutex);
+
+    return this->depthFilterStatistics;
+}
+
+//// setters
+void PointCloud::setFrameSink(FrameSink frame_sink, bool accumulate_points)
+{
+    this->frameSink = frame_sink;
+    this->accumulatePoints = accumulate_points || !frame_sink;
+}
+
+void PointCloud::setCancelFlag(const std::atomic<bool> *cancel_flag)
+{
+    this->cancelFlag = cancel_flag;
+}
+
 //// loop function, can either use all images or just selected few passed in array of indexes
 void PointCloud::iterateThroughImages(bool imagesAll, int selectedIndexes[], size_t arraySize)
 {
     this->pointsData->clear();
+    this->pointChunks->clear();
+    this->localFrames->clear();
+
+    if(this->voxelGrid != nullptr)
+    {
+        this->voxelGrid->clear();
+    }
+
+    if(this->tsdfVolume != nullptr)
+    {
+        this->tsdfVolume->clear();
+    }
+
+    if(this->octree != nullptr)
+    {
+        this->octree->clear();
+    }
 
-    if(!imagesAll)
+    std::vector<int> frame_indexes;
+
+    if(imagesAll)
     {
-        for(size_t i = 0; i < arraySize; ++i)
+        size_t frames_count = this->frameTable->frames.size();
+
+        if(this->inputData->maxIndex > 0)
         {
-            int index = selectedIndexes[i];
-            std::string dir_path = this->inputData->pathToImagesDirectory;
+            frames_count = std::min(frames_count, static_cast<size_t>(this->inputData->maxIndex));
+        }
+
+        frame_indexes.reserve(frames_count);
 
-            std::string rgb_image_path = dir_path + this->associationData->rgbData[index];
-            std::string depth_image_path = dir_path + this->associationData->depthData[index];
+        // TUM trajectories also hold poses between the images, only frames with images and a pose are processed
+        for(size_t i = 0; i < frames_count; ++i)
+        {
+            if(this->hasFrame(static_cast<int>(i)))
+            {
+                frame_indexes.push_back(static_cast<int>(i));
+            }
+        }
+    }
+    else
+    {
+        frame_indexes.assign(selectedIndexes, selectedIndexes + arraySize);
+    }
+
+    this->processFrames(frame_indexes);
+}
+
+//// trajectory
+bool PointCloud::reloadTrajectory(const std::string &path_to_trajectory)
+{
+    auto start_time = std::chrono::steady_clock::now();
 
-            this->loadRGBImage(rgb_image_path);
-            this->loadDepthImage(depth_image_path);
+    FrameTable frame_table;
 
-            this->transformToPointCloudData(index);
+    if(!DatasetParser::parse(path_to_trajectory, this->inputData->pathToAssociationFile, frame_table))
+    {
+        std::cerr << "Failed to reload trajectory: " << path_to_trajectory.c_str() << std::endl;
+        return false;
+    }
+
+    // image paths point into the mapped files of the current table, only the poses are taken over
+    size_t posed_frames = 0;
+
+    for(size_t i = 0; i < this->frameTable->frames.size(); ++i)
+    {
+        FrameEntry &frame = this->frameTable->frames[i];
+        frame.hasPose = i < frame_table.frames.size() && frame_table.frames[i].hasPose;
+
+        if(frame.hasPose)
+        {
+            frame.pose = frame_table.frames[i].pose;
+            posed_frames += 1;
         }
     }
+
+    this->inputData->pathToTrajectoryFile = path_to_trajectory;
+
+    double reload_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::cerr << "Trajectory reloaded: " << posed_frames << " of " << this->frameTable->frames.size() << " frames posed in "
+              << reload_seconds * 1000.0 << " ms" << std::endl;
+
+    return true;
 }
 
 // private functions
 //// init functions
 void PointCloud::initializeVariables(InputData &input_data)
 {
-    this->trajectoryData = new std::vector<TrajectoryData>();
-    this->associationData = new AssociationData();
+    this->frameTable = new FrameTable();
     this->inputData = new InputData(input_data);
     this->pointsData = new std::vector<float>();
-    this->imageWidth = 0;
-    this->imageHeight = 0;
+    this->pointChunks = new std::vector<PointChunk>();
+    this->localFrames = new std::vector<LocalFrame>();
 
-    //camera matrix K
-    this->cx = 319.5f;
-    this->cy = 239.5f;
-    this->focal_x = 481.2f;
-    this->focal_y = -480.f;
-}
+    //camera matrix K, defaults match office_kt0
+    this->cameraIntrinsics.cx = 319.5f;
+    this->cameraIntrinsics.cy = 239.5f;
+    this->cameraIntrinsics.focal_x = 481.2f;
+    this->cameraIntrinsics.focal_y = -480.f;
+    this->cameraIntrinsics.width = 640;
+    this->cameraIntrinsics.height = 480;
+    this->cameraIntrinsics.depthScale = 1000.f / 65536.f;
 
-void PointCloud::loadRGBImage(const std::string &path_to_image)
-{
-    this->rgbImage = new cv::Mat(cv::imread(path_to_image, cv::IMREAD_COLOR));
+    this->backProjectionKernel = new BackProjectionKernel();
+    this->backProjectionKernel->setDepthFilter(this->inputData->depthFilter);
+    this->depthFilterStatistics = {};
+    this->frameSink = nullptr;
+    this->accumulatePoints = true;
+    this->cancelFlag = nullptr;
+    this->gatheredFramesCount = 0;
 
-    if (this->rgbImage->empty())
+    // raw frames are handed over as decoded, there are no points to cache, merge or index
+    if(this->inputData->rawFrames && (!this->inputData->pathToCacheFile.empty() || this->inputData->voxelSize > 0.f
+                                      || this->inputData->tsdfVoxelSize > 0.f || this->inputData->octreeMaxDepth > 0))
     {
-        std::cerr << "Error loading RBG image!" << path_to_image.c_str() << std::endl;
+        std::cerr << "Raw frames are not transformed, point cache, voxel grid, TSDF and octree are disabled" << std::endl;
+
+        this->inputData->pathToCacheFile = "";
+        this->inputData->voxelSize = 0.f;
+        this->inputData->tsdfVoxelSize = 0.f;
+        this->inputData->octreeMaxDepth = 0;
     }
-}
 
-void PointCloud::loadDepthImage(const std::string &path_to_image)
-{
-    this->depthImage = new cv::Mat(cv::imread(path_to_image, cv::IMREAD_UNCHANGED));
+    this->pointCloudCache = this->inputData->pathToCacheFile.empty() ? nullptr : new PointCloudCache();
 
-    if (this->depthImage->empty())
+    // merging and indexing work on world points
+    if(this->inputData->frameLocalPoints && (this->inputData->voxelSize > 0.f || this->inputData->tsdfVoxelSize > 0.f || this->inputData->octreeMaxDepth > 0))
     {
-        std::cerr << "Error loading Depth image!" << path_to_image.c_str() << std::endl;
-        return;
-    }
+        std::cerr << "Frame-local points are kept as they are, voxel grid, TSDF and octree are disabled" << std::endl;
 
-    if (this->depthImage->depth() != CV_16U) {  // or CV_16S if it's signed
-        std::cerr << "The image is not 16-bit!" << std::endl;
-        return;
+        this->inputData->voxelSize = 0.f;
+        this->inputData->tsdfVoxelSize = 0.f;
+        this->inputData->octreeMaxDepth = 0;
     }
 
-    this->imageWidth = this->depthImage->cols;
-    this->imageHeight = this->depthImage->rows;
+    this->tsdfVolume = this->inputData->tsdfVoxelSize > 0.f ? new TSDFVolume(this->inputData->tsdfVoxelSize, this->inputData->tsdfTruncation) : nullptr;
+    this->voxelGrid = this->inputData->voxelSize > 0.f && this->tsdfVolume == nullptr ? new VoxelGridAccumulator(this->inputData->voxelSize) : nullptr;
+
+    this->octree = this->inputData->octreeMaxDepth > 0 ? new Octree(static_cast<int>(this->inputData->octreeMaxDepth)) : nullptr;
+}
+
+void PointCloud::loadFrameTable(const std::string &path_to_trajectory, const std::string &path_to_associations)
+{
+    if(!DatasetParser::parse(path_to_trajectory, path_to_associations, *this->frameTable))
+    {
+        std::cerr << "Failed to load dataset, no frames will be processed" << std::endl;
+        this->frameTable->frames.clear();
+    }
 }
 
-void PointCloud::loadTrajectoryData(const std::string &path_to_trajectory)
+void PointCloud::loadCameraIntrinsics(const std::string &path_to_intrinsics)
 {
     // Open the file
-    std::ifstream file(path_to_trajectory);
+    std::ifstream file(path_to_intrinsics);
 
     if (!file.is_open())
     {
-        std::cerr << "Failed to open trajectory file: " << path_to_trajectory.c_str() << std::endl;
+        std::cerr << "Failed to open intrinsics file: " << path_to_intrinsics.c_str() << std::endl;
         return;
     }
 
+    // a calibration without width and height keys is valid for any resolution, see CameraIntrinsics
+    this->cameraIntrinsics.width = 0;
+    this->cameraIntrinsics.height = 0;
+
     std::string line;
-    TrajectoryData data;
 
-    // Read and parse the data line by line
+    // Read "key value" pairs line by line, '#' starts a comment
     while (std::getline(file, line))
     {
         std::istringstream iss(line);
 
-        // Parse the line into the struct members
-        iss >> data.id >> data.cam_x >> data.cam_y >> data.cam_z >> data.qx >> data.qy >> data.qz >> data.qw;
+        std::string key;
+        float value;
+
+        if(!(iss >> key) || key[0] == '#')
+        {
+            continue;
+        }
+
+        if(!(iss >> value))
+        {
+            std::cerr << "Missing value for intrinsics key: " << key.c_str() << std::endl;
+            continue;
+        }
 
-        this->trajectoryData->push_back(data);
+        if(key == "fx")
+        {
+            this->cameraIntrinsics.focal_x = value;
+        }
+        else if(key == "fy")
+        {
+            this->cameraIntrinsics.focal_y = value;
+        }
+        else if(key == "cx")
+        {
+            this->cameraIntrinsics.cx = value;
+        }
+        else if(key == "cy")
+        {
+            this->cameraIntrinsics.cy = value;
+        }
+        else if(key == "width")
+        {
+            this->cameraIntrinsics.width = static_cast<int>(value);
+        }
+        else if(key == "height")
+        {
+            this->cameraIntrinsics.height = static_cast<int>(value);
+        }
+        else if(key == "depth_scale")
+        {
+            this->cameraIntrinsics.depthScale = value;
+        }
+        else
+        {
+            std::cerr << "Unknown intrinsics key: " << key.c_str() << std::endl;
+        }
     }
 
     // Close the file
     file.close();
 }
 
-void PointCloud::loadAssociationsFile(const std::string &path_to_associations)
+void PointCloud::loadResources()
 {
-    // Open the file
-    std::ifstream file(path_to_associations);
+    this->loadFrameTable(this->inputData->pathToTrajectoryFile, this->inputData->pathToAssociationFile);
 
-    if (!file.is_open())
+    if(!this->inputData->pathToIntrinsicsFile.empty())
     {
-        std::cerr << "Failed to open trajectory file: " << path_to_associations.c_str() << std::endl;
+        this->loadCameraIntrinsics(this->inputData->pathToIntrinsicsFile);
+    }
+
+    this->backProjectionKernel->setIntrinsics(this->cameraIntrinsics);
+}
+
+//// ingestion pipeline
+unsigned int PointCloud::getThreadsCount(size_t frames_count)
+{
+    unsigned int threads_count = this->inputData->threadsCount;
+
+    if(threads_count == 0)
+    {
+        threads_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // no point in spawning workers that would never get a frame
+    return static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads_count, frames_count)));
+}
+
+uint64_t PointCloud::getDatasetHash()
+{
+    // everything that changes the points of every frame at once
+    uint64_t hash = PointCloudCache::hashBytes(&this->inputData->pointFormat, sizeof(PointFormat));
+    hash = PointCloudCache::hashBytes(&this->cameraIntrinsics, sizeof(CameraIntrinsics), hash);
+
+    // field by field, the struct has padding
+    const DepthFilterSettings &depth_filter = this->inputData->depthFilter;
+    hash = PointCloudCache::hashBytes(&depth_filter.rejectInvalid, sizeof(bool), hash);
+    hash = PointCloudCache::hashBytes(&depth_filter.minDepth, sizeof(float), hash);
+    hash = PointCloudCache::hashBytes(&depth_filter.maxDepth, sizeof(float), hash);
+    hash = PointCloudCache::hashBytes(&depth_filter.discontinuityThreshold, sizeof(float), hash);
+    hash = PointCloudCache::hashBytes(&depth_filter.minConfidence, sizeof(uint8_t), hash);
+    hash = PointCloudCache::hashBytes(this->inputData->pathToConfidenceDirectory.data(), this->inputData->pathToConfidenceDirectory.size(), hash);
+    hash = PointCloudCache::hashBytes(&this->inputData->frameLocalPoints, sizeof(bool), hash);
+
+    return hash;
+}
+
+uint64_t PointCloud::getFrameInputHash(int index)
+{
+    const FrameEntry *frame = this->frameTable->getFrame(index);
+
+    if(frame == nullptr)
+    {
+        return 0;
+    }
+
+    // frame-local points do not depend on the pose, a reloaded trajectory keeps the cache valid
+    uint64_t hash = this->inputData->frameLocalPoints ? 0 : PointCloudCache::hashBytes(&frame->pose, sizeof(TrajectoryData));
+    hash = PointCloudCache::hashFile(this->inputData->pathToImagesDirectory + std::string(frame->rgbPath), hash);
+    hash = PointCloudCache::hashFile(this->inputData->pathToImagesDirectory + std::string(frame->depthPath), hash);
+
+    if(!this->inputData->pathToConfidenceDirectory.empty())
+    {
+        hash = PointCloudCache::hashFile(this->getConfidencePath(*frame), hash);
+    }
+
+    return hash;
+}
+
+void PointCloud::prepareCache(const std::vector<int> &frame_indexes, std::vector<uint64_t> &input_hashes)
+{
+    input_hashes.resize(frame_indexes.size());
+
+    uint64_t dataset_hash = this->getDatasetHash();
+    this->pointCloudCache->open(this->inputData->pathToCacheFile, dataset_hash, this->inputData->pointFormat);
+
+    size_t cached_frames = 0;
+
+    for(size_t i = 0; i < frame_indexes.size(); ++i)
+    {
+        input_hashes[i] = this->getFrameInputHash(frame_indexes[i]);
+
+        if(this->pointCloudCache->hasFrame(frame_indexes[i], input_hashes[i]))
+        {
+            cached_frames += 1;
+        }
+    }
+
+    std::cerr << "Point cloud cache: " << cached_frames << " of " << frame_indexes.size() << " frames up to date" << std::endl;
+
+    // only frames with changed inputs are rebuilt, the rest is copied over from the mapped cache
+    if(cached_frames < frame_indexes.size())
+    {
+        this->pointCloudCache->beginWrite(this->inputData->pathToCacheFile, dataset_hash, this->inputData->pointFormat, this->cameraIntrinsics, frame_indexes.size());
+    }
+}
+
+void PointCloud::processFrames(const std::vector<int> &frame_indexes)
+{
+    // every frame gets its own output, so workers never touch shared pointsData outside of gatherFrame
+    std::vector<StreamedFrame> frames_output(this->accumulatePoints && this->voxelGrid == nullptr && this->tsdfVolume == nullptr ? frame_indexes.size() : 0);
+
+    this->framesDone.assign(frames_output.size(), 0);
+    this->gatheredFramesCount = 0;
+
+    if(this->inputData->pointFormat == PointFormat::Compact)
+    {
+        this->pointChunks->reserve(frames_output.size());
+    }
+
+    std::vector<uint64_t> input_hashes;
+
+    if(this->pointCloudCache != nullptr)
+    {
+        this->prepareCache(frame_indexes, input_hashes);
+    }
+
+    unsigned int threads_count = this->getThreadsCount(frame_indexes.size());
+
+    this->depthFilterStatistics = {};
+
+    // images are read and decoded ahead of the transform on separate I/O threads
+    unsigned int io_threads_count = this->inputData->ioThreadsCount > 0 ? this->inputData->ioThreadsCount : threads_count;
+    size_t prefetch_depth = this->inputData->prefetchDepth > 0 ? this->inputData->prefetchDepth : 2 * static_cast<size_t>(threads_count + io_threads_count);
+
+    ImageLoader image_loader(io_threads_count, prefetch_depth);
+    image_loader.start(this->getImageRequests(frame_indexes, input_hashes));
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads_count);
+
+    for(unsigned int i = 0; i < threads_count; ++i)
+    {
+        workers.emplace_back(&PointCloud::processFramesWorker, this, std::ref(image_loader), std::cref(frame_indexes), std::cref(input_hashes), std::ref(frames_output));
+    }
+
+    for(std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    if(this->pointCloudCache != nullptr && this->pointCloudCache->isWriting())
+    {
+        this->pointCloudCache->finishWrite();
+    }
+
+    // frames processed before cancelling stay cached, nothing is handed to the caller that gave up on them
+    if(this->cancelFlag != nullptr && *this->cancelFlag)
+    {
+        this->pointsData->clear();
+        this->pointChunks->clear();
+        this->localFrames->clear();
         return;
     }
 
-    std::string line;
+    if(!this->inputData->rawFrames && this->inputData->depthFilter.isEnabled(!this->inputData->pathToConfidenceDirectory.empty()))
+    {
+        const DepthFilterStatistics &statistics = this->depthFilterStatistics;
 
-    // Read and parse the data line by line
-    while (std::getline(file, line))
+        std::cerr << "Depth filter: " << statistics.getRemovedCount() << " of " << statistics.inputPixelsCount << " pixels removed ("
+                  << statistics.invalidCount << " invalid, " << statistics.outOfRangeCount << " out of range, "
+                  << statistics.lowConfidenceCount << " low confidence, " << statistics.discontinuityCount << " at depth discontinuities)" << std::endl;
+    }
+
+    if(this->octree != nullptr)
     {
-        std::istringstream iss(line);
+        OctreeStatistics statistics = this->octree->getStatistics();
 
-        int key;
-        std::string value;
+        std::cerr << "Octree: " << statistics.storedPointsCount << " of " << statistics.insertedPointsCount << " points sampled into "
+                  << statistics.nodesCount << " nodes, depth " << statistics.depth << std::endl;
+    }
 
-        // Parse the line into the struct members
-        iss >> key >> value;
-        this->associationData->rgbData[key] = value;
+    if(!this->accumulatePoints)
+    {
+        return;
+    }
 
-        iss >> key >> value;
-        this->associationData->depthData[key] = value;
+    ScopedTimer timer(ProfileStage::Gather);
+
+    if(this->tsdfVolume != nullptr)
+    {
+        this->gatherTSDFOutput();
+        return;
     }
 
-    // Close the file
-    file.close();
+    if(this->voxelGrid != nullptr)
+    {
+        this->gatherVoxelGridOutput();
+        return;
+    }
+
+    // per-frame outputs were gathered in frame order by the workers
 }
 
-void PointCloud::loadResources()
+void PointCloud::gatherVoxelGridOutput()
+{
+    VoxelGridStatistics statistics = this->voxelGrid->getStatistics();
+
+    std::cerr << "Voxel grid: " << statistics.framesCount << " frames, " << statistics.inputPointsCount << " points merged into "
+              << statistics.voxelsCount << " voxels (" << statistics.reductionRatio << "x reduction), "
+              << statistics.averageFrameSeconds * 1000.0 << " ms/frame average, "
+              << statistics.maxFrameSeconds * 1000.0 << " ms/frame max" << std::endl;
+
+    if(statistics.skippedPointsCount > 0)
+    {
+        std::cerr << "Voxel grid: " << statistics.skippedPointsCount << " non-finite or out of range points skipped" << std::endl;
+    }
+
+    // spatial blocks keep compact chunks small enough for a fine quantization step
+    std::vector<std::vector<float>> blocks;
+    this->voxelGrid->extractPointBlocks(64, blocks);
+
+    this->storePointBlocks(blocks, statistics.voxelsCount);
+}
+
+void PointCloud::gatherTSDFOutput()
+{
+    TSDFStatistics statistics = this->tsdfVolume->getStatistics();
+
+    std::cerr << "TSDF: " << statistics.framesCount << " frames, " << statistics.inputPointsCount << " points fused into "
+              << statistics.blocksCount << " blocks (" << statistics.memoryBytes / (1024.0 * 1024.0) << " MiB), "
+              << statistics.averageFrameSeconds * 1000.0 << " ms/frame average, "
+              << statistics.maxFrameSeconds * 1000.0 << " ms/frame max" << std::endl;
+
+    std::vector<std::vector<float>> blocks;
+    this->tsdfVolume->extractPointBlocks(64, blocks);
+
+    size_t points_count = 0;
+
+    for(const std::vector<float> &block : blocks)
+    {
+        points_count += block.size() / PointsView::floatsPerPoint;
+    }
+
+    std::cerr << "TSDF: " << points_count << " surface points extracted" << std::endl;
+
+    this->storePointBlocks(blocks, points_count);
+}
+
+void PointCloud::storePointBlocks(std::vector<std::vector<float>> &blocks, size_t points_count)
 {
-    this->loadTrajectoryData(this->inputData->pathToTrajectoryFile);
-    this->loadAssociationsFile(this->inputData->pathToAssociationFile);
+    if(this->inputData->pointFormat == PointFormat::Compact)
+    {
+        this->pointChunks->resize(blocks.size());
+
+        for(size_t i = 0; i < blocks.size(); ++i)
+        {
+            PointQuantizer::quantize(blocks[i].data(), blocks[i].size() / PointsView::floatsPerPoint, (*this->pointChunks)[i]);
+        }
+
+        return;
+    }
+
+    this->pointsData->reserve(points_count * PointsView::floatsPerPoint);
+
+    for(std::vector<float> &block : blocks)
+    {
+        this->pointsData->insert(this->pointsData->end(), block.begin(), block.end());
+        std::vector<float>().swap(block);
+    }
+}
+
+std::vector<ImageRequest> PointCloud::getImageRequests(const std::vector<int> &frame_indexes, const std::vector<uint64_t> &input_hashes)
+{
+    const std::string &dir_path = this->inputData->pathToImagesDirectory;
+
+    std::vector<ImageRequest> requests(frame_indexes.size());
+
+    for(size_t i = 0; i < frame_indexes.size(); ++i)
+    {
+        int index = frame_indexes[i];
+        requests[i].position = i;
+
+        const FrameEntry *frame = this->frameTable->getFrame(index);
+
+        // frames without data or served from the cache pass through the loader without I/O
+        if(frame == nullptr
+            || (this->pointCloudCache != nullptr && this->pointCloudCache->hasFrame(index, input_hashes[i])))
+        {
+            continue;
+        }
+
+        requests[i].rgbPath = dir_path;
+        requests[i].rgbPath += frame->rgbPath;
+        requests[i].depthPath = dir_path;
+        requests[i].depthPath += frame->depthPath;
+
+        if(!this->inputData->pathToConfidenceDirectory.empty())
+        {
+            requests[i].confidencePath = this->getConfidencePath(*frame);
+        }
+    }
+
+    return requests;
+}
+
+std::string PointCloud::getConfidencePath(const FrameEntry &frame)
+{
+    std::string path = this->inputData->pathToConfidenceDirectory;
+
+    if(!path.empty() && path.back() != '/')
+    {
+        path += "/";
+    }
+
+    size_t name_start = frame.depthPath.find_last_of('/');
+    path += frame.depthPath.substr(name_start == std::string_view::npos ? 0 : name_start + 1);
+
+    return path;
+}
+
+void PointCloud::processFramesWorker(ImageLoader &image_loader, const std::vector<int> &frame_indexes, const std::vector<uint64_t> &input_hashes, std::vector<StreamedFrame> &frames_output)
+{
+    std::vector<float> merge_points;
+
+    for(ImageSlot *slot = image_loader.acquire(); slot != nullptr; slot = image_loader.acquire())
+    {
+        if(this->cancelFlag != nullptr && *this->cancelFlag)
+        {
+            image_loader.release(slot);
+            break;
+        }
+
+        size_t position = slot->position;
+        uint64_t input_hash = this->pointCloudCache != nullptr ? input_hashes[position] : 0;
+
+        this->processFrame(position, frame_indexes[position], input_hash, *slot, frames_output, merge_points);
+
+        image_loader.release(slot);
+
+        if(!frames_output.empty())
+        {
+            this->gatherFrame(position, frames_output);
+        }
+    }
+}
+
+void PointCloud::gatherFrame(size_t position, std::vector<StreamedFrame> &frames_output)
+{
+    std::lock_guard<std::mutex> lock(this->gatherMutex);
+    ScopedTimer timer(ProfileStage::Gather);
+
+    this->framesDone[position] = 1;
+
+    for(; this->gatheredFramesCount < this->framesDone.size() && this->framesDone[this->gatheredFramesCount] != 0; ++this->gatheredFramesCount)
+    {
+        StreamedFrame &frame_output = frames_output[this->gatheredFramesCount];
+
+        if(this->inputData->pointFormat == PointFormat::Compact)
+        {
+            if(!frame_output.chunk.points.empty())
+            {
+                if(this->inputData->frameLocalPoints)
+                {
+                    this->localFrames->push_back({ frame_output.frameIndex, this->pointChunks->size(), frame_output.chunk.points.size() });
+                }
+
+                this->pointChunks->push_back(std::move(frame_output.chunk));
+            }
+
+            continue;
+        }
+
+        size_t frame_size = frame_output.points.size();
+        size_t points_size = this->pointsData->size();
+
+        // capacity for the total projected from the frames so far, growing frame by frame would copy the cloud over and over
+        if(frame_size > this->pointsData->capacity() - points_size)
+        {
+            size_t projected_size = (points_size + frame_size) / (this->gatheredFramesCount + 1) * this->framesDone.size();
+            this->pointsData->reserve(std::max(points_size + frame_size, projected_size + projected_size / 8));
+        }
+
+        if(this->inputData->frameLocalPoints && frame_size > 0)
+        {
+            this->localFrames->push_back({ frame_output.frameIndex, points_size / PointsView::floatsPerPoint, frame_size / PointsView::floatsPerPoint });
+        }
+
+        this->pointsData->insert(this->pointsData->end(), frame_output.points.begin(), frame_output.points.end());
+        std::vector<float>().swap(frame_output.points);
+    }
+}
+
+void PointCloud::processFrame(size_t position, int index, uint64_t input_hash, const ImageSlot &slot, std::vector<StreamedFrame> &frames_output, std::vector<float> &merge_points)
+{
+    const bool compact_output = this->inputData->pointFormat == PointFormat::Compact;
+    const bool keep_frames = this->accumulatePoints && this->voxelGrid == nullptr && this->tsdfVolume == nullptr;
+    const bool merge_frames = this->accumulatePoints && !keep_frames;
+    const bool index_frames = this->octree != nullptr;
+    const bool write_cache = this->pointCloudCache != nullptr && this->pointCloudCache->isWriting();
+
+    // the frame table is shared between workers and only read here
+    const FrameEntry *frame_entry = this->frameTable->getFrame(index);
+
+    if(frame_entry == nullptr)
+    {
+        std::cerr << "Missing association or trajectory data for frame: " << index << std::endl;
+        return;
+    }
+
+    StreamedFrame frame;
+    frame.frameIndex = index;
+    frame.pose = frame_entry->pose;
+
+    if(this->inputData->rawFrames)
+    {
+        // the slot is reused for the next frame once released, the sink gets its own copies
+        if(slot.loaded && this->frameSink)
+        {
+            frame.depthImage = slot.depthImage.clone();
+            frame.rgbImage = slot.rgbImage.clone();
+
+            Profiler::count(ProfileCounter::FramesIngested, 1);
+
+            this->frameSink(frame);
+        }
+
+        return;
+    }
+
+    CachedFrame cached_frame;
+    bool cached = this->pointCloudCache != nullptr && this->pointCloudCache->readFrame(index, input_hash, cached_frame);
+
+    if(cached)
+    {
+        // merging and indexing read the mapped block in place, only frames handed on are copied out of it
+        if(merge_frames || index_frames)
+        {
+            ScopedTimer timer(ProfileStage::Integrate);
+
+            const float *cached_points = cached_frame.points;
+
+            if(compact_output)
+            {
+                merge_points.clear();
+                PointQuantizer::dequantize(cached_frame.compactPoints, cached_frame.pointsCount, cached_frame.origin, cached_frame.scale, merge_points);
+                cached_points = merge_points.data();
+            }
+
+            if(merge_frames)
+            {
+                this->mergeFrame(frame.pose, cached_points, cached_frame.pointsCount);
+            }
+
+            if(index_frames)
+            {
+                this->octree->integrate(cached_points, cached_frame.pointsCount);
+            }
+        }
+
+        if(keep_frames || this->frameSink)
+        {
+            if(compact_output)
+            {
+                frame.chunk.origin[0] = cached_frame.origin[0];
+                frame.chunk.origin[1] = cached_frame.origin[1];
+                frame.chunk.origin[2] = cached_frame.origin[2];
+                frame.chunk.scale = cached_frame.scale;
+                frame.chunk.points.assign(cached_frame.compactPoints, cached_frame.compactPoints + cached_frame.pointsCount);
+            }
+            else
+            {
+                frame.points.assign(cached_frame.points, cached_frame.points + cached_frame.pointsCount * PointsView::floatsPerPoint);
+            }
+        }
+    }
+    else
+    {
+        if(!slot.loaded)
+        {
+            return;
+        }
+
+        this->transformToPointCloudData(static_cast<size_t>(index), slot, frame.points);
+
+        if(merge_frames || index_frames)
+        {
+            ScopedTimer timer(ProfileStage::Integrate);
+
+            if(merge_frames)
+            {
+                this->mergeFrame(frame.pose, frame.points.data(), frame.points.size() / PointsView::floatsPerPoint);
+            }
+
+            if(index_frames)
+            {
+                this->octree->integrate(frame.points.data(), frame.points.size() / PointsView::floatsPerPoint);
+            }
+        }
+
+        if(compact_output && (keep_frames || this->frameSink || write_cache))
+        {
+            PointQuantizer::quantize(frame.points.data(), frame.points.size() / PointsView::floatsPerPoint, frame.chunk);
+            std::vector<float>().swap(frame.points);
+        }
+    }
+
+    Profiler::count(ProfileCounter::FramesIngested, 1);
+    Profiler::count(ProfileCounter::PointsIngested, cached ? cached_frame.pointsCount : frame.chunk.points.size() + frame.points.size() / PointsView::floatsPerPoint);
+
+    // blocks of cached frames are carried over by PointCloudCache::finishWrite
+    if(write_cache && !cached)
+    {
+        this->pointCloudCache->writeFrame(index, input_hash, frame.points, frame.chunk);
+    }
+
+    if(keep_frames)
+    {
+        // sink gets the frame first, stored copy keeps the data if the sink moved it away
+        if(this->frameSink)
+        {
+            frames_output[position] = frame;
+            this->frameSink(frame);
+        }
+        else
+        {
+            frames_output[position] = std::move(frame);
+        }
+
+        return;
+    }
+
+    if(this->frameSink)
+    {
+        this->frameSink(frame);
+    }
+}
+
+void PointCloud::mergeFrame(const TrajectoryData &pose, const float *points, size_t points_count)
+{
+    if(this->tsdfVolume != nullptr)
+    {
+        // frame points already are in world space, the rays start at the camera centre of the pose
+        const float camera_position[3] = { pose.cam_x, pose.cam_y, pose.cam_z };
+
+        this->tsdfVolume->integrate(camera_position, points, points_count);
+        return;
+    }
+
+    this->voxelGrid->integrate(points, points_count);
 }
 
 //// data transformations
-void PointCloud::transformToPointCloudData(size_t index)
+FramePose PointCloud::getFramePose(size_t index)
 {
+    const TrajectoryData &trajectory = this->frameTable->frames[index].pose;
+
+    return BackProjectionKernel::getFramePose(trajectory.cam_x, trajectory.cam_y, trajectory.cam_z, trajectory.qx, trajectory.qy, trajectory.qz, trajectory.qw);
+}
+
+void PointCloud::transformToPointCloudData(size_t index, const ImageSlot &slot, std::vector<float> &frame_points)
+{
+    ScopedTimer timer(ProfileStage::Transform);
+
+    DepthFilterStatistics statistics = {};
+
+    // frame-local points stay in camera coordinates, the pose is applied later
+    FramePose pose = this->inputData->frameLocalPoints ? BackProjectionKernel::getIdentityPose() : this->getFramePose(index);
+
+    if(this->inputData->transformKernel == TransformKernel::Reference)
+    {
+        this->transformToPointCloudDataReference(pose, slot, frame_points, statistics);
+    }
+    else
+    {
+        this->backProjectionKernel->transformFrame(pose, slot.rgbImage, slot.depthImage, frame_points, slot.confidenceImage, &statistics);
+    }
+
+    std::lock_guard<std::mutex> lock(this->depthFilterMutex);
+    this->depthFilterStatistics.add(statistics);
+}
+
+void PointCloud::transformToPointCloudDataReference(const FramePose &pose, const ImageSlot &slot, std::vector<float> &frame_points, DepthFilterStatistics &statistics)
+{
+    const cv::Mat &rgb_image = slot.rgbImage;
+    const cv::Mat &depth_image = slot.depthImage;
+    const cv::Mat &confidence_image = slot.confidenceImage;
+
     Eigen::Matrix4f transformation_matrix;
     Eigen::Vector4f position_matrix;
     Eigen::Vector4f transformed_position_matrix;
 
-    for(int v = 0; v < this->imageHeight; ++v)
+    const int image_width = depth_image.cols;
+    const int image_height = depth_image.rows;
+
+    if(rgb_image.cols != image_width || rgb_image.rows != image_height || rgb_image.type() != CV_8UC3 || depth_image.type() != CV_16UC1)
     {
-        for(int u = 0; u < this->imageWidth; ++u)
+        std::cerr << "RGB and depth images do not match!" << std::endl;
+        return;
+    }
+
+    const bool use_mask = !confidence_image.empty();
+
+    if(use_mask && (confidence_image.cols != image_width || confidence_image.rows != image_height))
+    {
+        std::cerr << "Confidence mask does not match the depth image!" << std::endl;
+        return;
+    }
+
+    // rescaled like the rays of the vectorized kernel
+    const CameraIntrinsics intrinsics = RayLookupTable::getScaledIntrinsics(this->cameraIntrinsics, image_width, image_height);
+
+    // same filter as the vectorized kernel, so both paths keep the same pixels
+    const bool filter_pixels = this->inputData->depthFilter.isEnabled(use_mask);
+    std::vector<uint8_t> keep_row(filter_pixels ? image_width : 0);
+
+    //calculating transformation matrix, one pose for the whole frame
+    const float *r = pose.rotation;
+    const float *t = pose.translation;
+
+    transformation_matrix << r[0], r[1], r[2], t[0],
+                             r[3], r[4], r[5], t[1],
+                             r[6], r[7], r[8], t[2],
+                             0   , 0   , 0   , 1;
+
+    statistics.inputPixelsCount += static_cast<uint64_t>(image_width) * image_height;
+
+    frame_points.reserve(frame_points.size() + static_cast<size_t>(image_width) * image_height * 6);
+
+    for(int v = 0; v < image_height; ++v)
+    {
+        if(filter_pixels)
         {
+            BackProjectionKernel::filterRow(this->inputData->depthFilter, depth_image.ptr<uint16_t>(v),
+                                            v > 0 ? depth_image.ptr<uint16_t>(v - 1) : nullptr,
+                                            v + 1 < image_height ? depth_image.ptr<uint16_t>(v + 1) : nullptr,
+                                            use_mask ? confidence_image.ptr<uint8_t>(v) : nullptr,
+                                            this->cameraIntrinsics.depthScale, image_width, keep_row.data(), statistics);
+        }
+
+        for(int u = 0; u < image_width; ++u)
+        {
+            if(filter_pixels && keep_row[u] == 0)
+            {
+                continue;
+            }
+
             //read depth from pixel
-            uint16_t read_depth_value = this->depthImage->at<uint16_t>(v, u);
+            uint16_t read_depth_value = depth_image.at<uint16_t>(v, u);
 
             //read color of pixel
-            cv::Vec3b color = this->rgbImage->at<cv::Vec3b>(v, u);
+            cv::Vec3b color = rgb_image.at<cv::Vec3b>(v, u);
 
             //casting variables
             float val_d = static_cast<float>(read_depth_value);
@@ -189,27 +1010,13 @@ void PointCloud::transformToPointCloudData(size_t index)
             float red = static_cast<float>(color[2]);
 
             //getting real z axis value and scalled x and y values
-            float f_d = val_d * 1000 / 65536;
-            float f_v = -(val_u - this->cx) / this->focal_x * f_d;
-            float f_u = (val_v - this->cy) / this->focal_y * f_d;
+            float f_d = val_d * this->cameraIntrinsics.depthScale;
+            float f_v = -(val_u - intrinsics.cx) / intrinsics.focal_x * f_d;
+            float f_u = (val_v - intrinsics.cy) / intrinsics.focal_y * f_d;
 
             //populating position matrix
             position_matrix << f_u, f_v, f_d, 1;
 
-            //calculating transformation matrix
-            float Tx = (*this->trajectoryData)[index].cam_x;
-            float Ty = (*this->trajectoryData)[index].cam_y;
-            float Tz = (*this->trajectoryData)[index].cam_z;
-            float qx = (*this->trajectoryData)[index].qx;
-            float qy = (*this->trajectoryData)[index].qy;
-            float qz = (*this->trajectoryData)[index].qz;
-            float qw = (*this->trajectoryData)[index].qw;
-
-            transformation_matrix << 2 * (qx * qx + qy * qy) - 1, 2 * (qy * qz - qx * qw)    , 2 * (qy * qw + qx * qz)    , Tx,
-                                     2 * (qy * qz + qx * qw)    , 2 * (qx * qx + qz * qz) - 1, 2 * (qz * qw - qx * qy)    , Ty,
-                                     2 * (qy * qw - qx * qz)    , 2 * (qz * qw + qx * qy)    , 2 * (qx * qx + qw * qw) - 1, Tz,
-                                     0                          , 0                          , 0                          , 1;
-
             //transforming to real point position
             transformed_position_matrix = transformation_matrix * position_matrix;
 
@@ -219,7 +1026,7 @@ void PointCloud::transformToPointCloudData(size_t index)
             float z = transformed_position_matrix[2];
 
             //writing data to points vector
-            this->pointsData->insert(pointsData->end(), {x, y, z, red, green, blue});
+            frame_points.insert(frame_points.end(), {x, y, z, red, green, blue});
         }
     }
 }
@@ -1,35 +1,66 @@
 #ifndef POINTCLOUD_H
 #define POINTCLOUD_H
 
+#include "backprojection.h"
+#include "pointformat.h"
+#include "voxelgrid.h"
+#include "tsdfvolume.h"
+#include "octree.h"
+#include "imageloader.h"
+#include "datasetparser.h"
+
 #include <opencv2/opencv.hpp>
 
 #include <eigen3/Eigen/Dense>
 
 #include <string>
 #include <fstream>
-#include <map>
-
-struct TrajectoryData
-{
-    int id;
-    float cam_x, cam_y, cam_z;             // Position
-    float qx, qy, qz, qw;      // Orientation (quaternion)
-};
-
-struct AssociationData
-{
-    std::map<int , std::string> rgbData;
-    std::map<int , std::string> depthData;
-};
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <atomic>
 
 struct InputData
 {
     std::string pathToImagesDirectory;
     std::string pathToTrajectoryFile;
     std::string pathToAssociationFile;
-    unsigned int maxIndex;
+    std::string pathToIntrinsicsFile;   // empty - default office_kt0 intrinsics
+    std::string pathToCacheFile;        // binary point cache reused between runs, empty - no cache
+    std::string pathToConfidenceDirectory;  // confidence masks named like the depth images, empty - no masks
+    unsigned int maxIndex;          // frames [0, maxIndex) are processed, 0 - all frames from trajectory
+    unsigned int threadsCount;      // worker threads used for ingestion, 0 - all hardware threads
+    unsigned int ioThreadsCount;    // threads reading and decoding images, 0 - same as threadsCount
+    unsigned int prefetchDepth;     // frames decoded ahead of the transform, 0 - twice the number of all threads
+    TransformKernel transformKernel;
+    PointFormat pointFormat;
+    float voxelSize;                // merge points falling into the same voxel while ingesting, 0 - keep all points
+    float tsdfVoxelSize;            // fuse frames into a truncated signed distance field and keep only its surface points, 0 - no fusion, overrides voxelSize
+    float tsdfTruncation;           // distance band around measured surfaces updated by each frame, 0 - four TSDF voxels
+    unsigned int octreeMaxDepth;    // index points in an octree with this many levels below the first root while ingesting, 0 - no octree
+    bool frameLocalPoints;          // points stay in the camera coordinates of their frame and poses are applied when drawing or exporting,
+                                    // so a corrected trajectory needs no re-ingestion; voxel grid, TSDF and octree need world points and are off
+    bool rawFrames;                 // decoded depth and RGB images go to the frame sink untransformed for back-projection on the GPU,
+                                    // no points are produced; cache, voxel grid, TSDF and octree are off
+    DepthFilterSettings depthFilter;    // pixels rejected while transforming, before any point is stored
+};
+
+class PointCloudCache;
+
+struct StreamedFrame
+{
+    int frameIndex;
+    TrajectoryData pose;
+    std::vector<float> points;      // PointFormat::Float32
+    PointChunk chunk;               // PointFormat::Compact
+    cv::Mat depthImage;             // InputData::rawFrames, CV_16UC1
+    cv::Mat rgbImage;               // InputData::rawFrames, CV_8UC3
 };
 
+//// called from ingestion worker threads as soon as a frame is transformed, must be thread safe;
+//// the frame may be moved from, e.g. into a FrameQueue
+using FrameSink = std::function<void(StreamedFrame &frame)>;
+
 class PointCloud
 {
 public:
@@ -39,42 +70,117 @@ public:
 
     // public functions
     //// getters
-    std::vector<float> getPointsData();
+    PointFormat getPointFormat();
+    CameraIntrinsics getCameraIntrinsics();
+    ////// frames in the dataset, including ones missing a pose or images
+    size_t getFramesCount();
+    ////// the frame has both a pose and images and can be processed
+    bool hasFrame(int index);
+    ////// data is owned by PointCloud and stays valid until the next iterateThroughImages call
+    const std::vector<float> &getPointsData();
+    PointsView getPointsView();
+    const std::vector<PointChunk> &getPointChunks();
+    ////// nullptr unless InputData::octreeMaxDepth is set
+    Octree *getOctree();
+    ////// nullptr unless InputData::tsdfVoxelSize is set, a mesh can be extracted after iterateThroughImages
+    TSDFVolume *getTSDFVolume();
+    ////// frame of every chunk or points range while InputData::frameLocalPoints is set, empty otherwise
+    const std::vector<LocalFrame> &getLocalFrames();
+    ////// camera-to-world pose of every dataset frame indexed by frame, identity for frames without a pose
+    std::vector<FramePose> getFramePoses();
+    ////// camera-to-world poses of the frames with a pose in frame order, the camera path
+    std::vector<FramePose> getTrajectory();
+    ////// pixels removed by InputData::depthFilter during the last iterateThroughImages call, frames served from the cache are not counted
+    DepthFilterStatistics getDepthFilterStatistics();
+
+    //// setters
+    ////// streaming mode, without accumulation memory use stays bounded by frames in flight
+    void setFrameSink(FrameSink frame_sink, bool accumulate_points = false);
+    ////// checked before every frame, once it is set the remaining frames are skipped and iterateThroughImages returns
+    ////// without gathering; the flag has to outlive the iteration, nullptr - never cancelled
+    void setCancelFlag(const std::atomic<bool> *cancel_flag);
 
     //// loop function, can either use all images or just selected few passed in string as indexes
     void iterateThroughImages(bool imagesAll = true, int selectedIndexes[] = {} , size_t arraySize = 0);
 
+    //// trajectory
+    ////// replaces the poses of all frames matched through the association file, frame-local points follow without
+    ////// re-ingestion, points already in world space keep their old poses; must not be called during iterateThroughImages
+    bool reloadTrajectory(const std::string &path_to_trajectory);
+
 private:
     // private functions
     //// init functions
     void initializeVariables(InputData &input_data);
 
-    void loadRGBImage(const std::string &path_to_image);
-    void loadDepthImage(const std::string &path_to_image);
-    void loadTrajectoryData(const std::string &path_to_trajectory);
-    void loadAssociationsFile(const std::string &path_to_associations);
+    void loadFrameTable(const std::string &path_to_trajectory, const std::string &path_to_associations);
+    void loadCameraIntrinsics(const std::string &path_to_intrinsics);
     void loadResources();
 
+    //// ingestion pipeline
+    unsigned int getThreadsCount(size_t frames_count);
+    void processFrames(const std::vector<int> &frame_indexes);
+    void gatherVoxelGridOutput();
+    void gatherTSDFOutput();
+    void storePointBlocks(std::vector<std::vector<float>> &blocks, size_t points_count);
+    std::vector<ImageRequest> getImageRequests(const std::vector<int> &frame_indexes, const std::vector<uint64_t> &input_hashes);
+    ////// confidence mask with the file name of the depth image in InputData::pathToConfidenceDirectory
+    std::string getConfidencePath(const FrameEntry &frame);
+    void processFramesWorker(ImageLoader &image_loader, const std::vector<int> &frame_indexes, const std::vector<uint64_t> &input_hashes, std::vector<StreamedFrame> &frames_output);
+    void processFrame(size_t position, int index, uint64_t input_hash, const ImageSlot &slot, std::vector<StreamedFrame> &frames_output, std::vector<float> &merge_points);
+    ////// marks the frame done and moves every frame done in order into the exported data, releasing its storage;
+    ////// frames_output only holds frames finished ahead of an earlier one
+    void gatherFrame(size_t position, std::vector<StreamedFrame> &frames_output);
+    ////// fuses the frame into the TSDF volume if there is one, the voxel grid otherwise
+    void mergeFrame(const TrajectoryData &pose, const float *points, size_t points_count);
+
+    //// point cloud cache
+    uint64_t getDatasetHash();
+    uint64_t getFrameInputHash(int index);
+    void prepareCache(const std::vector<int> &frame_indexes, std::vector<uint64_t> &input_hashes);
+
     //// data transformations
-    void transformToPointCloudData(size_t index);
+    FramePose getFramePose(size_t index);
+    void transformToPointCloudData(size_t index, const ImageSlot &slot, std::vector<float> &frame_points);
+    void transformToPointCloudDataReference(const FramePose &pose, const ImageSlot &slot, std::vector<float> &frame_points, DepthFilterStatistics &statistics);
 
     // private variables
-    //// images data
-    cv::Mat *rgbImage;
-    cv::Mat *depthImage;
-
-    int imageWidth;
-    int imageHeight;
-
     //// imported data
-    std::vector<TrajectoryData> *trajectoryData;
-    AssociationData *associationData;
+    FrameTable *frameTable;
     InputData *inputData;
 
     //// exported data
     std::vector<float> *pointsData;
+    std::vector<PointChunk> *pointChunks;
+    std::vector<LocalFrame> *localFrames;
+
+    //// streaming
+    FrameSink frameSink;
+    bool accumulatePoints;
+    const std::atomic<bool> *cancelFlag;
+
+    //// frames gathered in frame order while the workers run
+    std::vector<uint8_t> framesDone;
+    size_t gatheredFramesCount;
+    std::mutex gatherMutex;
+
+    //// cross-frame deduplication
+    VoxelGridAccumulator *voxelGrid;
+    TSDFVolume *tsdfVolume;
+    Octree *octree;
+
+    //// cache of transformed frames
+    PointCloudCache *pointCloudCache;
+
+    //// transformation kernels
+    BackProjectionKernel *backProjectionKernel;
+
+    //// depth filter, shared by the workers
+    DepthFilterStatistics depthFilterStatistics;
+    std::mutex depthFilterMutex;
 
-    float cx, cy, focal_x, focal_y;
+    //// camera matrix K
+    CameraIntrinsics cameraIntrinsics;
 };
 
 #endif // POINTCLOUD_H
@@ -0,0 +1,327 @@
+#include "pointcloudcache.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <unordered_set>
+
+#include <sys/stat.h>
+
+static const char cacheMagic[8] = { 'P', 'C', 'C', 'A', 'C', 'H', 'E', '\0' };
+static const uint32_t cacheVersion = 1;
+static const uint64_t cacheBlockAlignment = 16;
+
+// constructors/destructors
+PointCloudCache::PointCloudCache()
+{
+    this->pointFormat = PointFormat::Float32;
+    this->mappedData = nullptr;
+    this->mappedSize = 0;
+    this->writeOffset = 0;
+}
+
+PointCloudCache::~PointCloudCache()
+{
+    this->close();
+
+    if(this->writeFile.is_open())
+    {
+        this->writeFile.close();
+        std::remove(this->writeTemporaryPath.c_str());
+    }
+}
+
+// public functions
+//// reading
+bool PointCloudCache::open(const std::string &path_to_cache, uint64_t dataset_hash, PointFormat point_format)
+{
+    this->close();
+
+    if(!this->mappedFile.open(path_to_cache) || this->mappedFile.getSize() < sizeof(CacheHeader))
+    {
+        this->close();
+        return false;
+    }
+
+    this->mappedData = reinterpret_cast<const uint8_t *>(this->mappedFile.getData());
+    this->mappedSize = this->mappedFile.getSize();
+
+    CacheHeader header;
+    std::memcpy(&header, this->mappedData, sizeof(CacheHeader));
+
+    size_t entries_end = sizeof(CacheHeader) + static_cast<size_t>(header.framesCount) * sizeof(CacheFrameEntry);
+
+    if(std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion
+        || header.datasetHash != dataset_hash || header.pointFormat != static_cast<uint32_t>(point_format)
+        || entries_end > this->mappedSize)
+    {
+        // cache for another dataset or layout, every frame will be rebuilt
+        this->close();
+        return false;
+    }
+
+    this->pointFormat = point_format;
+
+    const CacheFrameEntry *entries = reinterpret_cast<const CacheFrameEntry *>(this->mappedData + sizeof(CacheHeader));
+    size_t point_size = point_format == PointFormat::Compact ? sizeof(CompactPoint) : PointsView::floatsPerPoint * sizeof(float);
+
+    for(uint32_t i = 0; i < header.framesCount; ++i)
+    {
+        if(entries[i].offset + entries[i].pointsCount * point_size <= this->mappedSize)
+        {
+            this->mappedFrames[entries[i].frameIndex] = &entries[i];
+        }
+    }
+
+    // blocks are read front to back
+    this->mappedFile.adviseSequential();
+
+    return true;
+}
+
+bool PointCloudCache::hasFrame(int frame_index, uint64_t input_hash)
+{
+    return this->findFrame(frame_index, input_hash) != nullptr;
+}
+
+bool PointCloudCache::readFrame(int frame_index, uint64_t input_hash, CachedFrame &frame)
+{
+    const CacheFrameEntry *entry = this->findFrame(frame_index, input_hash);
+
+    if(entry == nullptr)
+    {
+        return false;
+    }
+
+    // blocks are 16-byte aligned within the page aligned mapping
+    const uint8_t *block = this->mappedData + entry->offset;
+
+    frame.points = this->pointFormat == PointFormat::Float32 ? reinterpret_cast<const float *>(block) : nullptr;
+    frame.compactPoints = this->pointFormat == PointFormat::Compact ? reinterpret_cast<const CompactPoint *>(block) : nullptr;
+    frame.pointsCount = entry->pointsCount;
+    frame.origin[0] = entry->origin[0];
+    frame.origin[1] = entry->origin[1];
+    frame.origin[2] = entry->origin[2];
+    frame.scale = entry->scale;
+
+    return true;
+}
+
+void PointCloudCache::close()
+{
+    this->mappedFile.close();
+
+    this->mappedData = nullptr;
+    this->mappedSize = 0;
+    this->mappedFrames.clear();
+}
+
+//// writing
+bool PointCloudCache::beginWrite(const std::string &path_to_cache, uint64_t dataset_hash, PointFormat point_format, const CameraIntrinsics &intrinsics, size_t frames_capacity)
+{
+    std::lock_guard<std::mutex> lock(this->writeMutex);
+
+    this->writePath = path_to_cache;
+    this->writeTemporaryPath = path_to_cache + ".tmp";
+    this->writeFile.open(this->writeTemporaryPath, std::ios::binary | std::ios::trunc);
+
+    if(!this->writeFile.is_open())
+    {
+        std::cerr << "Failed to create point cloud cache: " << this->writeTemporaryPath.c_str() << std::endl;
+        return false;
+    }
+
+    std::memset(&this->writeHeader, 0, sizeof(CacheHeader));
+    std::memcpy(this->writeHeader.magic, cacheMagic, sizeof(cacheMagic));
+    this->writeHeader.version = cacheVersion;
+    this->writeHeader.pointFormat = static_cast<uint32_t>(point_format);
+    this->writeHeader.datasetHash = dataset_hash;
+    this->writeHeader.cx = intrinsics.cx;
+    this->writeHeader.cy = intrinsics.cy;
+    this->writeHeader.focal_x = intrinsics.focal_x;
+    this->writeHeader.focal_y = intrinsics.focal_y;
+    this->writeHeader.width = intrinsics.width;
+    this->writeHeader.height = intrinsics.height;
+    this->writeHeader.depthScale = intrinsics.depthScale;
+
+    // room for the frames of the open cache carried over by finishWrite
+    frames_capacity += this->mappedFrames.size();
+
+    this->writeEntries.clear();
+    this->writeEntries.reserve(frames_capacity);
+
+    // header and frame table are written last, reserve their space up front
+    uint64_t table_size = sizeof(CacheHeader) + frames_capacity * sizeof(CacheFrameEntry);
+    this->writeOffset = (table_size + cacheBlockAlignment - 1) / cacheBlockAlignment * cacheBlockAlignment;
+
+    std::vector<char> zeros(this->writeOffset, 0);
+    this->writeFile.write(zeros.data(), zeros.size());
+
+    return this->writeFile.good();
+}
+
+void PointCloudCache::writeFrame(int frame_index, uint64_t input_hash, const std::vector<float> &points, const PointChunk &chunk)
+{
+    std::lock_guard<std::mutex> lock(this->writeMutex);
+
+    if(!this->writeFile.is_open() || this->writeEntries.size() == this->writeEntries.capacity())
+    {
+        return;
+    }
+
+    CacheFrameEntry entry;
+    std::memset(&entry, 0, sizeof(CacheFrameEntry));
+    entry.frameIndex = frame_index;
+    entry.inputHash = input_hash;
+    entry.offset = this->writeOffset;
+
+    const char *block;
+    uint64_t block_size;
+
+    if(this->writeHeader.pointFormat == static_cast<uint32_t>(PointFormat::Compact))
+    {
+        entry.pointsCount = chunk.points.size();
+        entry.origin[0] = chunk.origin[0];
+        entry.origin[1] = chunk.origin[1];
+        entry.origin[2] = chunk.origin[2];
+        entry.scale = chunk.scale;
+
+        block = reinterpret_cast<const char *>(chunk.points.data());
+        block_size = chunk.points.size() * sizeof(CompactPoint);
+    }
+    else
+    {
+        entry.pointsCount = points.size() / PointsView::floatsPerPoint;
+
+        block = reinterpret_cast<const char *>(points.data());
+        block_size = points.size() * sizeof(float);
+    }
+
+    uint64_t padding = (cacheBlockAlignment - block_size % cacheBlockAlignment) % cacheBlockAlignment;
+    static const char zeros[cacheBlockAlignment] = {};
+
+    this->writeFile.write(block, block_size);
+    this->writeFile.write(zeros, padding);
+    this->writeOffset += block_size + padding;
+
+    this->writeEntries.push_back(entry);
+}
+
+bool PointCloudCache::finishWrite()
+{
+    std::lock_guard<std::mutex> lock(this->writeMutex);
+
+    if(!this->writeFile.is_open())
+    {
+        return false;
+    }
+
+    // frames of the open cache that were not written again keep their blocks
+    std::unordered_set<int> written_frames;
+
+    for(const CacheFrameEntry &entry : this->writeEntries)
+    {
+        written_frames.insert(entry.frameIndex);
+    }
+
+    size_t point_size = this->writeHeader.pointFormat == static_cast<uint32_t>(PointFormat::Compact) ? sizeof(CompactPoint) : PointsView::floatsPerPoint * sizeof(float);
+    static const char zeros[cacheBlockAlignment] = {};
+
+    for(const auto &mapped_frame : this->mappedFrames)
+    {
+        if(written_frames.count(mapped_frame.first) > 0 || this->writeEntries.size() == this->writeEntries.capacity())
+        {
+            continue;
+        }
+
+        CacheFrameEntry entry = *mapped_frame.second;
+        uint64_t block_size = entry.pointsCount * point_size;
+        uint64_t padding = (cacheBlockAlignment - block_size % cacheBlockAlignment) % cacheBlockAlignment;
+
+        this->writeFile.write(reinterpret_cast<const char *>(this->mappedData + entry.offset), block_size);
+        this->writeFile.write(zeros, padding);
+
+        entry.offset = this->writeOffset;
+        this->writeOffset += block_size + padding;
+
+        this->writeEntries.push_back(entry);
+    }
+
+    this->writeHeader.framesCount = static_cast<uint32_t>(this->writeEntries.size());
+
+    this->writeFile.seekp(0);
+    this->writeFile.write(reinterpret_cast<const char *>(&this->writeHeader), sizeof(CacheHeader));
+    this->writeFile.write(reinterpret_cast<const char *>(this->writeEntries.data()), this->writeEntries.size() * sizeof(CacheFrameEntry));
+
+    bool written = this->writeFile.good();
+    this->writeFile.close();
+
+    // the old file may still be mapped, rename keeps that mapping valid
+    if(!written || std::rename(this->writeTemporaryPath.c_str(), this->writePath.c_str()) != 0)
+    {
+        std::cerr << "Failed to write point cloud cache: " << this->writePath.c_str() << std::endl;
+        std::remove(this->writeTemporaryPath.c_str());
+        return false;
+    }
+
+    this->writeEntries.clear();
+
+    return true;
+}
+
+bool PointCloudCache::isWriting()
+{
+    std::lock_guard<std::mutex> lock(this->writeMutex);
+
+    return this->writeFile.is_open();
+}
+
+//// hashing helpers
+uint64_t PointCloudCache::hashBytes(const void *data, size_t size, uint64_t hash)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+uint64_t PointCloudCache::hashFile(const std::string &path_to_file, uint64_t hash)
+{
+    hash = PointCloudCache::hashBytes(path_to_file.data(), path_to_file.size(), hash);
+
+    struct stat file_stat;
+
+    if(stat(path_to_file.c_str(), &file_stat) != 0)
+    {
+        return hash;
+    }
+
+    // size and modification time stand in for the content, reading every image would defeat the cache
+    int64_t file_size = static_cast<int64_t>(file_stat.st_size);
+    int64_t modification_seconds = static_cast<int64_t>(file_stat.st_mtim.tv_sec);
+    int64_t modification_nanoseconds = static_cast<int64_t>(file_stat.st_mtim.tv_nsec);
+
+    hash = PointCloudCache::hashBytes(&file_size, sizeof(file_size), hash);
+    hash = PointCloudCache::hashBytes(&modification_seconds, sizeof(modification_seconds), hash);
+    hash = PointCloudCache::hashBytes(&modification_nanoseconds, sizeof(modification_nanoseconds), hash);
+
+    return hash;
+}
+
+// private functions
+const CacheFrameEntry *PointCloudCache::findFrame(int frame_index, uint64_t input_hash)
+{
+    auto entry = this->mappedFrames.find(frame_index);
+
+    if(entry == this->mappedFrames.end() || entry->second->inputHash != input_hash)
+    {
+        return nullptr;
+    }
+
+    return entry->second;
+}
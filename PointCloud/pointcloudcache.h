@@ -0,0 +1,98 @@
+#ifndef POINTCLOUDCACHE_H
+#define POINTCLOUDCACHE_H
+
+#include "pointformat.h"
+#include "raylookuptable.h"
+#include "mappedfile.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+
+//// on-disk layout: CacheHeader, CacheFrameEntry[framesCount], then 16-byte aligned point blocks
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pointFormat;
+    uint64_t datasetHash;
+    float cx, cy, focal_x, focal_y;
+    int32_t width, height;
+    float depthScale;
+    uint32_t framesCount;
+};
+
+struct CacheFrameEntry
+{
+    int32_t frameIndex;
+    uint32_t reserved;
+    uint64_t inputHash;         // image paths, sizes, modification times and pose of the frame
+    uint64_t offset;            // block offset from the start of the file
+    uint64_t pointsCount;
+    float origin[3];            // PointFormat::Compact chunk parameters
+    float scale;
+};
+
+//// block of one frame inside the mapped cache, valid until the cache is closed or opened again
+struct CachedFrame
+{
+    const float *points;                // PointFormat::Float32, interleaved x, y, z, r, g, b
+    const CompactPoint *compactPoints;  // PointFormat::Compact
+    size_t pointsCount;
+    float origin[3];
+    float scale;
+};
+
+class PointCloudCache
+{
+public:
+    // constructors/destructors
+    PointCloudCache();
+    ~PointCloudCache();
+
+    // public functions
+    //// reading, maps an existing cache file, fails if it is missing or was built for another dataset
+    bool open(const std::string &path_to_cache, uint64_t dataset_hash, PointFormat point_format);
+    bool hasFrame(int frame_index, uint64_t input_hash);
+    ////// points straight out of the mapping, nothing is copied
+    bool readFrame(int frame_index, uint64_t input_hash, CachedFrame &frame);
+    void close();
+
+    //// writing, blocks are appended to a temporary file which replaces the cache on finishWrite; frames of the open
+    //// cache that were not written again are carried over, a run over part of the dataset keeps the rest cached
+    bool beginWrite(const std::string &path_to_cache, uint64_t dataset_hash, PointFormat point_format, const CameraIntrinsics &intrinsics, size_t frames_capacity);
+    ////// thread safe
+    void writeFrame(int frame_index, uint64_t input_hash, const std::vector<float> &points, const PointChunk &chunk);
+    bool finishWrite();
+    bool isWriting();
+
+    //// hashing helpers (FNV-1a)
+    static uint64_t hashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ull);
+    static uint64_t hashFile(const std::string &path_to_file, uint64_t hash);
+
+private:
+    // private functions
+    const CacheFrameEntry *findFrame(int frame_index, uint64_t input_hash);
+
+    // private variables
+    //// mapped cache
+    PointFormat pointFormat;
+    MappedFile mappedFile;
+    const uint8_t *mappedData;
+    size_t mappedSize;
+    std::unordered_map<int, const CacheFrameEntry *> mappedFrames;
+
+    //// cache being written
+    std::mutex writeMutex;
+    std::ofstream writeFile;
+    std::string writePath;
+    std::string writeTemporaryPath;
+    CacheHeader writeHeader;
+    std::vector<CacheFrameEntry> writeEntries;
+    uint64_t writeOffset;
+};
+
+#endif // POINTCLOUDCACHE_H
@@ -0,0 +1,501 @@
+#include "pointcloudio.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#pragma pack(push, 1)
+struct PLYVertex
+{
+    float x, y, z;
+    uint8_t r, g, b;
+};
+
+struct PCDPoint
+{
+    float x, y, z;
+    uint32_t rgb;               // 0x00RRGGBB
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PLYVertex) == 15, "PLYVertex must match the header written by getPLYHeader");
+static_assert(sizeof(PCDPoint) == 16, "PCDPoint must match the header written by getPCDHeader");
+
+//// records converted per batch before they are written
+static const size_t fileBatchPoints = 65536;
+//// points of a PointsView written or read by one thread at a time
+static const size_t fileSegmentPoints = 1 << 20;
+
+// public functions
+bool PointCloudIO::writePLY(const std::string &path_to_file, PointsView points_view, unsigned int threads_count)
+{
+    std::vector<size_t> segment_counts;
+
+    for(size_t first = 0; first < points_view.pointsCount; first += fileSegmentPoints)
+    {
+        segment_counts.push_back(std::min(fileSegmentPoints, points_view.pointsCount - first));
+    }
+
+    return PointCloudIO::writePoints(path_to_file, PointFileFormat::PLY, segment_counts, [&points_view](size_t segment, std::vector<float> &)
+    {
+        return points_view.data + segment * fileSegmentPoints * PointsView::floatsPerPoint;
+    }, threads_count);
+}
+
+bool PointCloudIO::writePLY(const std::string &path_to_file, const std::vector<PointChunk> &point_chunks, unsigned int threads_count)
+{
+    std::vector<size_t> segment_counts;
+
+    for(const PointChunk &chunk : point_chunks)
+    {
+        segment_counts.push_back(chunk.points.size());
+    }
+
+    return PointCloudIO::writePoints(path_to_file, PointFileFormat::PLY, segment_counts, [&point_chunks](size_t segment, std::vector<float> &scratch)
+    {
+        scratch.clear();
+        PointQuantizer::dequantize(point_chunks[segment], scratch);
+
+        return static_cast<const float *>(scratch.data());
+    }, threads_count);
+}
+
+bool PointCloudIO::writePLY(const std::string &path_to_file, PointsView points_view, const std::vector<LocalFrame> &local_frames, const std::vector<FramePose> &frame_poses,
+                            unsigned int threads_count)
+{
+    return PointCloudIO::writeLocalFrames(path_to_file, PointFileFormat::PLY, points_view, {}, local_frames, frame_poses, threads_count);
+}
+
+bool PointCloudIO::writePLY(const std::string &path_to_file, const std::vector<PointChunk> &point_chunks, const std::vector<LocalFrame> &local_frames, const std::vector<FramePose> &frame_poses,
+                            unsigned int threads_count)
+{
+    return PointCloudIO::writeLocalFrames(path_to_file, PointFileFormat::PLY, PointsView{ nullptr, 0 }, point_chunks, local_frames, frame_poses, threads_count);
+}
+
+bool PointCloudIO::writeMeshPLY(const std::string &path_to_file, const std::vector<float> &vertices, const std::vector<uint32_t> &indices)
+{
+    std::ofstream file(path_to_file, std::ios::binary | std::ios::trunc);
+
+    if(!file.is_open())
+    {
+        std::cerr << "Failed to create mesh file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    size_t vertices_count = vertices.size() / PointsView::floatsPerPoint;
+    size_t faces_count = indices.size() / 3;
+
+    file << PointCloudIO::getPLYHeader(vertices_count, faces_count);
+
+    std::vector<char> buffer(std::min(vertices_count, fileBatchPoints) * sizeof(PLYVertex));
+
+    for(size_t first = 0; first < vertices_count; first += fileBatchPoints)
+    {
+        size_t batch_count = std::min(fileBatchPoints, vertices_count - first);
+
+        PointCloudIO::encodePoints(PointFileFormat::PLY, vertices.data() + first * PointsView::floatsPerPoint, batch_count, buffer.data());
+        file.write(buffer.data(), batch_count * sizeof(PLYVertex));
+    }
+
+    // every face is a uchar count of 3 followed by its indices
+    const size_t face_size = 1 + 3 * sizeof(uint32_t);
+    buffer.resize(std::min(faces_count, fileBatchPoints) * face_size);
+
+    for(size_t first = 0; first < faces_count; first += fileBatchPoints)
+    {
+        size_t batch_count = std::min(fileBatchPoints, faces_count - first);
+        char *output = buffer.data();
+
+        for(size_t i = first; i < first + batch_count; ++i)
+        {
+            *output = 3;
+            std::memcpy(output + 1, indices.data() + i * 3, 3 * sizeof(uint32_t));
+            output += face_size;
+        }
+
+        file.write(buffer.data(), batch_count * face_size);
+    }
+
+    if(!file.good())
+    {
+        std::cerr << "Failed to write mesh file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool PointCloudIO::writePCD(const std::string &path_to_file, PointsView points_view, unsigned int threads_count)
+{
+    std::vector<size_t> segment_counts;
+
+    for(size_t first = 0; first < points_view.pointsCount; first += fileSegmentPoints)
+    {
+        segment_counts.push_back(std::min(fileSegmentPoints, points_view.pointsCount - first));
+    }
+
+    return PointCloudIO::writePoints(path_to_file, PointFileFormat::PCD, segment_counts, [&points_view](size_t segment, std::vector<float> &)
+    {
+        return points_view.data + segment * fileSegmentPoints * PointsView::floatsPerPoint;
+    }, threads_count);
+}
+
+bool PointCloudIO::writePCD(const std::string &path_to_file, const std::vector<PointChunk> &point_chunks, unsigned int threads_count)
+{
+    std::vector<size_t> segment_counts;
+
+    for(const PointChunk &chunk : point_chunks)
+    {
+        segment_counts.push_back(chunk.points.size());
+    }
+
+    return PointCloudIO::writePoints(path_to_file, PointFileFormat::PCD, segment_counts, [&point_chunks](size_t segment, std::vector<float> &scratch)
+    {
+        scratch.clear();
+        PointQuantizer::dequantize(point_chunks[segment], scratch);
+
+        return static_cast<const float *>(scratch.data());
+    }, threads_count);
+}
+
+bool PointCloudIO::writePCD(const std::string &path_to_file, PointsView points_view, const std::vector<LocalFrame> &local_frames, const std::vector<FramePose> &frame_poses,
+                            unsigned int threads_count)
+{
+    return PointCloudIO::writeLocalFrames(path_to_file, PointFileFormat::PCD, points_view, {}, local_frames, frame_poses, threads_count);
+}
+
+bool PointCloudIO::writePCD(const std::string &path_to_file, const std::vector<PointChunk> &point_chunks, const std::vector<LocalFrame> &local_frames, const std::vector<FramePose> &frame_poses,
+                            unsigned int threads_count)
+{
+    return PointCloudIO::writeLocalFrames(path_to_file, PointFileFormat::PCD, PointsView{ nullptr, 0 }, point_chunks, local_frames, frame_poses, threads_count);
+}
+
+bool PointCloudIO::readPoints(const std::string &path_to_file, std::vector<float> &points, unsigned int threads_count)
+{
+    PointFileReader reader;
+
+    if(!reader.open(path_to_file))
+    {
+        return false;
+    }
+
+    size_t points_count = reader.getPointsCount();
+    size_t segments_count = (points_count + fileSegmentPoints - 1) / fileSegmentPoints;
+
+    points.resize(points_count * PointsView::floatsPerPoint);
+
+    std::atomic<size_t> next_segment(0);
+
+    auto worker = [&]()
+    {
+        for(size_t segment = next_segment++; segment < segments_count; segment = next_segment++)
+        {
+            size_t first = segment * fileSegmentPoints;
+            reader.readPoints(first, std::min(fileSegmentPoints, points_count - first), points.data() + first * PointsView::floatsPerPoint);
+        }
+    };
+
+    std::vector<std::thread> workers;
+
+    for(unsigned int i = 1; i < PointCloudIO::getThreadsCount(threads_count, segments_count); ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+
+    for(std::thread &thread : workers)
+    {
+        thread.join();
+    }
+
+    return true;
+}
+
+bool PointCloudIO::readPoints(const std::string &path_to_file, std::vector<PointChunk> &point_chunks, unsigned int threads_count)
+{
+    PointFileReader reader;
+
+    if(!reader.open(path_to_file))
+    {
+        return false;
+    }
+
+    size_t points_count = reader.getPointsCount();
+    size_t chunks_count = (points_count + fileBatchPoints - 1) / fileBatchPoints;
+
+    point_chunks.clear();
+    point_chunks.resize(chunks_count);
+
+    std::atomic<size_t> next_chunk(0);
+
+    // every batch is decoded and quantized on its own, only one batch of floats per thread is ever expanded
+    auto worker = [&]()
+    {
+        std::vector<float> scratch(fileBatchPoints * PointsView::floatsPerPoint);
+
+        for(size_t chunk = next_chunk++; chunk < chunks_count; chunk = next_chunk++)
+        {
+            size_t first = chunk * fileBatchPoints;
+            size_t count = std::min(fileBatchPoints, points_count - first);
+
+            reader.readPoints(first, count, scratch.data());
+            PointQuantizer::quantize(scratch.data(), count, point_chunks[chunk]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+
+    for(unsigned int i = 1; i < PointCloudIO::getThreadsCount(threads_count, chunks_count); ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+
+    for(std::thread &thread : workers)
+    {
+        thread.join();
+    }
+
+    return true;
+}
+
+// private functions
+bool PointCloudIO::writePoints(const std::string &path_to_file, PointFileFormat format, const std::vector<size_t> &segment_counts,
+                               const SegmentReader &read_segment, unsigned int threads_count)
+{
+    std::vector<uint64_t> segment_offsets(segment_counts.size());
+    size_t points_count = 0;
+
+    for(size_t i = 0; i < segment_counts.size(); ++i)
+    {
+        segment_offsets[i] = points_count;
+        points_count += segment_counts[i];
+    }
+
+    const std::string header = format == PointFileFormat::PLY ? PointCloudIO::getPLYHeader(points_count) : PointCloudIO::getPCDHeader(points_count);
+    const size_t record_size = PointCloudIO::getRecordSize(format);
+
+    int file_descriptor = ::open(path_to_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if(file_descriptor < 0)
+    {
+        std::cerr << "Failed to create point cloud file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    // the final size is known from the header, threads fill disjoint ranges of it in any order
+    uint64_t file_size = header.size() + static_cast<uint64_t>(points_count) * record_size;
+
+    std::atomic<bool> failed(ftruncate(file_descriptor, static_cast<off_t>(file_size)) != 0
+                             || !PointCloudIO::writeAt(file_descriptor, header.data(), header.size(), 0));
+    std::atomic<size_t> next_segment(0);
+
+    auto worker = [&]()
+    {
+        std::vector<float> scratch;
+        std::vector<char> buffer(fileBatchPoints * record_size);
+
+        for(size_t segment = next_segment++; segment < segment_counts.size() && !failed; segment = next_segment++)
+        {
+            const float *points = read_segment(segment, scratch);
+            size_t count = segment_counts[segment];
+
+            for(size_t first = 0; first < count; first += fileBatchPoints)
+            {
+                size_t batch_count = std::min(fileBatchPoints, count - first);
+                uint64_t offset = header.size() + (segment_offsets[segment] + first) * record_size;
+
+                PointCloudIO::encodePoints(format, points + first * PointsView::floatsPerPoint, batch_count, buffer.data());
+
+                if(!PointCloudIO::writeAt(file_descriptor, buffer.data(), batch_count * record_size, offset))
+                {
+                    failed = true;
+                    break;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+
+    for(unsigned int i = 1; i < PointCloudIO::getThreadsCount(threads_count, segment_counts.size()); ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+
+    for(std::thread &thread : workers)
+    {
+        thread.join();
+    }
+
+    if(::close(file_descriptor) != 0 || failed)
+    {
+        std::cerr << "Failed to write point cloud file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool PointCloudIO::writeLocalFrames(const std::string &path_to_file, PointFileFormat format, PointsView points_view, const std::vector<PointChunk> &point_chunks,
+                                    const std::vector<LocalFrame> &local_frames, const std::vector<FramePose> &frame_poses, unsigned int threads_count)
+{
+    std::vector<size_t> segment_counts;
+
+    for(const LocalFrame &local_frame : local_frames)
+    {
+        segment_counts.push_back(local_frame.pointsCount);
+    }
+
+    // every frame is copied and posed by the thread writing it, the stored points stay frame-local
+    return PointCloudIO::writePoints(path_to_file, format, segment_counts, [&](size_t segment, std::vector<float> &scratch)
+    {
+        const LocalFrame &local_frame = local_frames[segment];
+
+        scratch.clear();
+
+        if(point_chunks.empty())
+        {
+            const float *first = points_view.data + local_frame.first * PointsView::floatsPerPoint;
+            scratch.assign(first, first + local_frame.pointsCount * PointsView::floatsPerPoint);
+        }
+        else
+        {
+            PointQuantizer::dequantize(point_chunks[local_frame.first], scratch);
+        }
+
+        size_t frame_index = static_cast<size_t>(local_frame.frameIndex);
+        FramePose pose = frame_index < frame_poses.size() ? frame_poses[frame_index] : BackProjectionKernel::getIdentityPose();
+
+        BackProjectionKernel::transformPoints(pose, scratch.data(), local_frame.pointsCount);
+
+        return static_cast<const float *>(scratch.data());
+    }, threads_count);
+}
+
+std::string PointCloudIO::getPLYHeader(size_t points_count, size_t faces_count)
+{
+    std::ostringstream header;
+
+    header << "ply\n"
+           << "format binary_little_endian 1.0\n"
+           << "element vertex " << points_count << "\n"
+           << "property float x\n"
+           << "property float y\n"
+           << "property float z\n"
+           << "property uchar red\n"
+           << "property uchar green\n"
+           << "property uchar blue\n";
+
+    if(faces_count > 0)
+    {
+        header << "element face " << faces_count << "\n"
+               << "property list uchar uint vertex_indices\n";
+    }
+
+    header << "end_header\n";
+
+    return header.str();
+}
+
+std::string PointCloudIO::getPCDHeader(size_t points_count)
+{
+    std::ostringstream header;
+
+    header << "# .PCD v0.7 - Point Cloud Data file format\n"
+           << "VERSION 0.7\n"
+           << "FIELDS x y z rgb\n"
+           << "SIZE 4 4 4 4\n"
+           << "TYPE F F F F\n"
+           << "COUNT 1 1 1 1\n"
+           << "WIDTH " << points_count << "\n"
+           << "HEIGHT 1\n"
+           << "VIEWPOINT 0 0 0 1 0 0 0\n"
+           << "POINTS " << points_count << "\n"
+           << "DATA binary\n";
+
+    return header.str();
+}
+
+size_t PointCloudIO::getRecordSize(PointFileFormat format)
+{
+    return format == PointFileFormat::PLY ? sizeof(PLYVertex) : sizeof(PCDPoint);
+}
+
+void PointCloudIO::encodePoints(PointFileFormat format, const float *points, size_t points_count, char *output)
+{
+    for(size_t i = 0; i < points_count; ++i)
+    {
+        const float *point = points + i * PointsView::floatsPerPoint;
+
+        uint8_t r = static_cast<uint8_t>(std::clamp(point[3], 0.f, 255.f));
+        uint8_t g = static_cast<uint8_t>(std::clamp(point[4], 0.f, 255.f));
+        uint8_t b = static_cast<uint8_t>(std::clamp(point[5], 0.f, 255.f));
+
+        if(format == PointFileFormat::PLY)
+        {
+            PLYVertex vertex;
+            vertex.x = point[0];
+            vertex.y = point[1];
+            vertex.z = point[2];
+            vertex.r = r;
+            vertex.g = g;
+            vertex.b = b;
+
+            std::memcpy(output, &vertex, sizeof(PLYVertex));
+            output += sizeof(PLYVertex);
+        }
+        else
+        {
+            PCDPoint pcd_point;
+            pcd_point.x = point[0];
+            pcd_point.y = point[1];
+            pcd_point.z = point[2];
+            pcd_point.rgb = (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+
+            std::memcpy(output, &pcd_point, sizeof(PCDPoint));
+            output += sizeof(PCDPoint);
+        }
+    }
+}
+
+unsigned int PointCloudIO::getThreadsCount(unsigned int threads_count, size_t tasks_count)
+{
+    if(threads_count == 0)
+    {
+        threads_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    return static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads_count, tasks_count)));
+}
+
+bool PointCloudIO::writeAt(int file_descriptor, const char *data, size_t size, uint64_t offset)
+{
+    while(size > 0)
+    {
+        ssize_t written = pwrite(file_descriptor, data, size, static_cast<off_t>(offset));
+
+        if(written <= 0)
+        {
+            return false;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+
+    return true;
+}
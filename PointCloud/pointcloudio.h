@@ -0,0 +1,63 @@
+#ifndef POINTCLOUDIO_H
+#define POINTCLOUDIO_H
+
+#include "pointformat.h"
+#include "backprojection.h"
+#include "pointfilereader.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+//// point cloud files on disk; point files are sized from their header up front and written by several threads,
+//// every one converting whole segments in batches and writing them at their own offsets, 0 threads - all hardware threads
+class PointCloudIO
+{
+public:
+    // public functions
+    //// binary little endian PLY with float x, y, z and uchar red, green, blue vertices
+    static bool writePLY(const std::string &path_to_file, PointsView points_view, unsigned int threads_count = 0);
+    ////// chunks are dequantized one at a time per thread, the whole cloud is never expanded in memory
+    static bool writePLY(const std::string &path_to_file, const std::vector<PointChunk> &point_chunks, unsigned int threads_count = 0);
+    ////// frame-local points brought to world space on the way out, frame_poses are indexed by LocalFrame::frameIndex
+    static bool writePLY(const std::string &path_to_file, PointsView points_view, const std::vector<LocalFrame> &local_frames, const std::vector<FramePose> &frame_poses,
+                         unsigned int threads_count = 0);
+    static bool writePLY(const std::string &path_to_file, const std::vector<PointChunk> &point_chunks, const std::vector<LocalFrame> &local_frames, const std::vector<FramePose> &frame_poses,
+                         unsigned int threads_count = 0);
+    ////// vertices as interleaved x, y, z, r, g, b followed by faces of three uint indices each
+    static bool writeMeshPLY(const std::string &path_to_file, const std::vector<float> &vertices, const std::vector<uint32_t> &indices);
+
+    //// binary PCD 0.7 with float x, y, z and rgb packed into four bytes the way PCL stores it, same variants as PLY
+    static bool writePCD(const std::string &path_to_file, PointsView points_view, unsigned int threads_count = 0);
+    static bool writePCD(const std::string &path_to_file, const std::vector<PointChunk> &point_chunks, unsigned int threads_count = 0);
+    static bool writePCD(const std::string &path_to_file, PointsView points_view, const std::vector<LocalFrame> &local_frames, const std::vector<FramePose> &frame_poses,
+                         unsigned int threads_count = 0);
+    static bool writePCD(const std::string &path_to_file, const std::vector<PointChunk> &point_chunks, const std::vector<LocalFrame> &local_frames, const std::vector<FramePose> &frame_poses,
+                         unsigned int threads_count = 0);
+
+    //// binary PLY or PCD, see PointFileReader, decoded in parallel straight out of the memory mapping
+    ////// interleaved x, y, z, r, g, b
+    static bool readPoints(const std::string &path_to_file, std::vector<float> &points, unsigned int threads_count = 0);
+    ////// quantized chunks of consecutive points in file order, e.g. for SpatialChunker or PointChunkRenderer::queueChunk
+    static bool readPoints(const std::string &path_to_file, std::vector<PointChunk> &point_chunks, unsigned int threads_count = 0);
+
+private:
+    ////// points of one segment as interleaved floats, either in place or converted into scratch
+    using SegmentReader = std::function<const float *(size_t segment, std::vector<float> &scratch)>;
+
+    // private functions
+    static bool writePoints(const std::string &path_to_file, PointFileFormat format, const std::vector<size_t> &segment_counts,
+                            const SegmentReader &read_segment, unsigned int threads_count);
+    static bool writeLocalFrames(const std::string &path_to_file, PointFileFormat format, PointsView points_view, const std::vector<PointChunk> &point_chunks,
+                                 const std::vector<LocalFrame> &local_frames, const std::vector<FramePose> &frame_poses, unsigned int threads_count);
+    static std::string getPLYHeader(size_t points_count, size_t faces_count = 0);
+    static std::string getPCDHeader(size_t points_count);
+    static size_t getRecordSize(PointFileFormat format);
+    ////// points_count records of the format into output
+    static void encodePoints(PointFileFormat format, const float *points, size_t points_count, char *output);
+    static unsigned int getThreadsCount(unsigned int threads_count, size_t tasks_count);
+    static bool writeAt(int file_descriptor, const char *data, size_t size, uint64_t offset);
+};
+
+#endif // POINTCLOUDIO_H
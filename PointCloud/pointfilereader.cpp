@@ -0,0 +1,491 @@
+#include "pointfilereader.h"
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+
+//// headers are searched for within this many bytes of the start of the file
+static const size_t maxHeaderBytes = 1 << 16;
+
+// constructors/destructors
+PointFileReader::PointFileReader()
+{
+    this->format = PointFileFormat::PLY;
+    this->pointsCount = 0;
+    this->dataOffset = 0;
+    this->recordSize = 0;
+
+    for(int i = 0; i < 3; ++i)
+    {
+        this->position[i] = Field{ FieldType::None, 0 };
+        this->color[i] = Field{ FieldType::None, 0 };
+    }
+}
+
+PointFileReader::~PointFileReader()
+{
+    this->close();
+}
+
+// public functions
+bool PointFileReader::open(const std::string &path_to_file)
+{
+    this->close();
+
+    if(!this->mappedFile.open(path_to_file))
+    {
+        std::cerr << "Failed to open point cloud file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    const char *data = this->mappedFile.getData();
+    size_t size = this->mappedFile.getSize();
+
+    bool parsed;
+
+    if(size >= 4 && std::memcmp(data, "ply", 3) == 0 && (data[3] == '\n' || data[3] == '\r'))
+    {
+        this->format = PointFileFormat::PLY;
+        parsed = this->parsePLYHeader(path_to_file);
+    }
+    else
+    {
+        this->format = PointFileFormat::PCD;
+        parsed = this->parsePCDHeader(path_to_file);
+    }
+
+    if(!parsed)
+    {
+        this->close();
+        return false;
+    }
+
+    if(this->position[0].type == FieldType::None || this->position[1].type == FieldType::None || this->position[2].type == FieldType::None)
+    {
+        std::cerr << "Point cloud file has no x, y, z: " << path_to_file.c_str() << std::endl;
+        this->close();
+        return false;
+    }
+
+    if(this->recordSize == 0 || (size - this->dataOffset) / this->recordSize < this->pointsCount)
+    {
+        std::cerr << "Point cloud file is truncated: " << path_to_file.c_str() << std::endl;
+        this->close();
+        return false;
+    }
+
+    // whole files are usually decoded front to back
+    this->mappedFile.adviseSequential();
+
+    return true;
+}
+
+void PointFileReader::close()
+{
+    this->mappedFile.close();
+
+    this->pointsCount = 0;
+    this->dataOffset = 0;
+    this->recordSize = 0;
+
+    for(int i = 0; i < 3; ++i)
+    {
+        this->position[i] = Field{ FieldType::None, 0 };
+        this->color[i] = Field{ FieldType::None, 0 };
+    }
+}
+
+void PointFileReader::readPoints(size_t first, size_t count, float *points) const
+{
+    const char *record = this->mappedFile.getData() + this->dataOffset + first * this->recordSize;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        float *point = points + i * PointsView::floatsPerPoint;
+
+        point[0] = PointFileReader::readValue(record, this->position[0]);
+        point[1] = PointFileReader::readValue(record, this->position[1]);
+        point[2] = PointFileReader::readValue(record, this->position[2]);
+
+        if(this->color[0].type == FieldType::PackedColor)
+        {
+            uint32_t packed;
+            std::memcpy(&packed, record + this->color[0].offset, sizeof(packed));
+
+            point[3] = static_cast<float>((packed >> 16) & 0xFF);
+            point[4] = static_cast<float>((packed >> 8) & 0xFF);
+            point[5] = static_cast<float>(packed & 0xFF);
+        }
+        else if(this->color[0].type == FieldType::None)
+        {
+            point[3] = 255.f;
+            point[4] = 255.f;
+            point[5] = 255.f;
+        }
+        else
+        {
+            point[3] = PointFileReader::readValue(record, this->color[0]);
+            point[4] = PointFileReader::readValue(record, this->color[1]);
+            point[5] = PointFileReader::readValue(record, this->color[2]);
+        }
+
+        record += this->recordSize;
+    }
+}
+
+//// getters
+bool PointFileReader::isOpen() const
+{
+    return this->mappedFile.isOpen();
+}
+
+PointFileFormat PointFileReader::getFormat() const
+{
+    return this->format;
+}
+
+size_t PointFileReader::getPointsCount() const
+{
+    return this->pointsCount;
+}
+
+bool PointFileReader::hasColors() const
+{
+    return this->color[0].type != FieldType::None;
+}
+
+// private functions
+bool PointFileReader::parsePLYHeader(const std::string &path_to_file)
+{
+    size_t header_end = this->findHeaderEnd("end_header");
+
+    if(header_end == 0)
+    {
+        std::cerr << "PLY header has no end_header: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    std::istringstream header(std::string(this->mappedFile.getData(), header_end));
+    std::string line;
+
+    bool in_vertex = false;
+    bool vertex_found = false;
+    size_t offset = 0;
+
+    while(std::getline(header, line))
+    {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+
+        if(keyword == "format")
+        {
+            std::string encoding;
+            tokens >> encoding;
+
+            if(encoding != "binary_little_endian")
+            {
+                std::cerr << "Only binary little endian PLY files are supported, not " << encoding.c_str() << ": " << path_to_file.c_str() << std::endl;
+                return false;
+            }
+        }
+        else if(keyword == "element")
+        {
+            std::string name;
+            size_t count = 0;
+            tokens >> name >> count;
+
+            // data of earlier elements would have to be skipped
+            if(!vertex_found && name != "vertex")
+            {
+                std::cerr << "PLY vertex element has to come first: " << path_to_file.c_str() << std::endl;
+                return false;
+            }
+
+            in_vertex = !vertex_found;
+            vertex_found = true;
+
+            if(in_vertex)
+            {
+                this->pointsCount = count;
+            }
+        }
+        else if(keyword == "property" && in_vertex)
+        {
+            std::string type;
+            std::string name;
+            tokens >> type >> name;
+
+            size_t type_size = 0;
+            FieldType field_type = FieldType::None;
+
+            if(type == "char" || type == "int8" || type == "uchar" || type == "uint8")
+            {
+                type_size = 1;
+                field_type = type == "uchar" || type == "uint8" ? FieldType::UInt8 : FieldType::None;
+            }
+            else if(type == "short" || type == "int16" || type == "ushort" || type == "uint16")
+            {
+                type_size = 2;
+            }
+            else if(type == "int" || type == "int32" || type == "uint" || type == "uint32")
+            {
+                type_size = 4;
+            }
+            else if(type == "float" || type == "float32")
+            {
+                type_size = 4;
+                field_type = FieldType::Float32;
+            }
+            else if(type == "double" || type == "float64")
+            {
+                type_size = 8;
+                field_type = FieldType::Float64;
+            }
+            else
+            {
+                std::cerr << "Unsupported PLY vertex property type " << type.c_str() << ": " << path_to_file.c_str() << std::endl;
+                return false;
+            }
+
+            const char *position_names[3] = { "x", "y", "z" };
+            const char *color_names[3] = { "red", "green", "blue" };
+
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                if(name == position_names[axis] && (field_type == FieldType::Float32 || field_type == FieldType::Float64))
+                {
+                    this->position[axis] = Field{ field_type, offset };
+                }
+
+                if(name == color_names[axis] && field_type == FieldType::UInt8)
+                {
+                    this->color[axis] = Field{ field_type, offset };
+                }
+            }
+
+            offset += type_size;
+        }
+        else if(keyword == "end_header")
+        {
+            break;
+        }
+    }
+
+    // all three channels or none
+    if(this->color[0].type == FieldType::None || this->color[1].type == FieldType::None || this->color[2].type == FieldType::None)
+    {
+        this->color[0].type = FieldType::None;
+    }
+
+    this->dataOffset = header_end;
+    this->recordSize = offset;
+
+    return true;
+}
+
+bool PointFileReader::parsePCDHeader(const std::string &path_to_file)
+{
+    size_t header_end = this->findHeaderEnd("DATA");
+
+    if(header_end == 0)
+    {
+        std::cerr << "Not a PLY or PCD file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    std::istringstream header(std::string(this->mappedFile.getData(), header_end));
+    std::string line;
+
+    std::vector<std::string> names;
+    std::vector<size_t> sizes;
+    std::vector<char> types;
+    std::vector<size_t> counts;
+    size_t width = 0;
+    size_t height = 1;
+    size_t points_count = 0;
+
+    while(std::getline(header, line))
+    {
+        std::istringstream tokens(line);
+        std::string keyword;
+        std::string token;
+        tokens >> keyword;
+
+        if(keyword.empty() || keyword[0] == '#')
+        {
+            continue;
+        }
+
+        if(keyword == "FIELDS")
+        {
+            while(tokens >> token)
+            {
+                names.push_back(token);
+            }
+        }
+        else if(keyword == "SIZE" || keyword == "COUNT")
+        {
+            std::vector<size_t> &values = keyword == "SIZE" ? sizes : counts;
+
+            while(tokens >> token)
+            {
+                values.push_back(static_cast<size_t>(std::strtoull(token.c_str(), nullptr, 10)));
+            }
+        }
+        else if(keyword == "TYPE")
+        {
+            while(tokens >> token)
+            {
+                types.push_back(token[0]);
+            }
+        }
+        else if(keyword == "WIDTH")
+        {
+            tokens >> width;
+        }
+        else if(keyword == "HEIGHT")
+        {
+            tokens >> height;
+        }
+        else if(keyword == "POINTS")
+        {
+            tokens >> points_count;
+        }
+        else if(keyword == "DATA")
+        {
+            tokens >> token;
+
+            if(token != "binary")
+            {
+                std::cerr << "Only binary PCD files are supported, not " << token.c_str() << ": " << path_to_file.c_str() << std::endl;
+                return false;
+            }
+        }
+    }
+
+    if(sizes.size() != names.size() || types.size() != names.size())
+    {
+        std::cerr << "PCD FIELDS, SIZE and TYPE do not match: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    counts.resize(names.size(), 1);
+
+    size_t offset = 0;
+
+    for(size_t i = 0; i < names.size(); ++i)
+    {
+        const std::string &name = names[i];
+
+        if(counts[i] == 1)
+        {
+            FieldType field_type = FieldType::None;
+
+            if(types[i] == 'F' && sizes[i] == 4)
+            {
+                field_type = FieldType::Float32;
+            }
+            else if(types[i] == 'F' && sizes[i] == 8)
+            {
+                field_type = FieldType::Float64;
+            }
+            else if(types[i] == 'U' && sizes[i] == 1)
+            {
+                field_type = FieldType::UInt8;
+            }
+
+            const char *position_names[3] = { "x", "y", "z" };
+            const char *color_names[3] = { "r", "g", "b" };
+
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                if(name == position_names[axis] && (field_type == FieldType::Float32 || field_type == FieldType::Float64))
+                {
+                    this->position[axis] = Field{ field_type, offset };
+                }
+
+                if(name == color_names[axis] && field_type == FieldType::UInt8)
+                {
+                    this->color[axis] = Field{ field_type, offset };
+                }
+            }
+
+            // PCL stores the packed bytes as a float, other writers as an unsigned int
+            if((name == "rgb" || name == "rgba") && sizes[i] == 4)
+            {
+                this->color[0] = Field{ FieldType::PackedColor, offset };
+                this->color[1].type = FieldType::PackedColor;
+                this->color[2].type = FieldType::PackedColor;
+            }
+        }
+
+        offset += sizes[i] * counts[i];
+    }
+
+    if(this->color[0].type == FieldType::None || this->color[1].type == FieldType::None || this->color[2].type == FieldType::None)
+    {
+        this->color[0].type = FieldType::None;
+    }
+
+    this->pointsCount = points_count > 0 ? points_count : width * height;
+    this->dataOffset = header_end;
+    this->recordSize = offset;
+
+    return true;
+}
+
+size_t PointFileReader::findHeaderEnd(const char *keyword)
+{
+    const char *data = this->mappedFile.getData();
+    size_t size = std::min(this->mappedFile.getSize(), maxHeaderBytes);
+    size_t keyword_length = std::strlen(keyword);
+
+    for(size_t line_start = 0; line_start < size; )
+    {
+        const char *line_end = static_cast<const char *>(std::memchr(data + line_start, '\n', size - line_start));
+
+        if(line_end == nullptr)
+        {
+            return 0;
+        }
+
+        size_t next_line = static_cast<size_t>(line_end - data) + 1;
+
+        if(next_line - line_start > keyword_length && std::memcmp(data + line_start, keyword, keyword_length) == 0
+           && std::isspace(static_cast<unsigned char>(data[line_start + keyword_length])))
+        {
+            return next_line;
+        }
+
+        line_start = next_line;
+    }
+
+    return 0;
+}
+
+float PointFileReader::readValue(const char *record, const Field &field)
+{
+    switch(field.type)
+    {
+    case FieldType::UInt8:
+        return static_cast<float>(static_cast<uint8_t>(record[field.offset]));
+    case FieldType::Float32:
+    {
+        float value;
+        std::memcpy(&value, record + field.offset, sizeof(value));
+        return value;
+    }
+    case FieldType::Float64:
+    {
+        double value;
+        std::memcpy(&value, record + field.offset, sizeof(value));
+        return static_cast<float>(value);
+    }
+    default:
+        return 0.f;
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef POINTFILEREADER_H
+#define POINTFILEREADER_H
+
+#include "mappedfile.h"
+#include "pointformat.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+enum class PointFileFormat
+{
+    PLY,                            // binary little endian, vertex element first
+    PCD                             // DATA binary
+};
+
+//// memory mapped binary PLY or PCD point file; the header is parsed on open and points are decoded straight out
+//// of the mapping, positions as float or double, colours as uchar red, green, blue or packed rgb / rgba, other
+//// properties are skipped
+class PointFileReader
+{
+public:
+    // constructors/destructors
+    PointFileReader();
+    ~PointFileReader();
+
+    PointFileReader(const PointFileReader &) = delete;
+    PointFileReader &operator=(const PointFileReader &) = delete;
+
+    // public functions
+    bool open(const std::string &path_to_file);
+    void close();
+
+    //// interleaved x, y, z, r, g, b floats with colours in [0, 255], white for files without colours;
+    ////// thread safe, disjoint ranges are decoded in parallel
+    void readPoints(size_t first, size_t count, float *points) const;
+
+    //// getters
+    bool isOpen() const;
+    PointFileFormat getFormat() const;
+    size_t getPointsCount() const;
+    bool hasColors() const;
+
+private:
+    enum class FieldType : uint8_t
+    {
+        None,
+        UInt8,
+        Float32,
+        Float64,
+        PackedColor                 // PCD rgb / rgba, 0x00RRGGBB in four bytes
+    };
+
+    struct Field
+    {
+        FieldType type;
+        size_t offset;              // within a record
+    };
+
+    // private functions
+    bool parsePLYHeader(const std::string &path_to_file);
+    bool parsePCDHeader(const std::string &path_to_file);
+    ////// end of the header line starting with keyword, 0 if there is none within the first bytes of the file
+    size_t findHeaderEnd(const char *keyword);
+    static float readValue(const char *record, const Field &field);
+
+    // private variables
+    MappedFile mappedFile;
+    PointFileFormat format;
+    size_t pointsCount;
+    size_t dataOffset;
+    size_t recordSize;
+
+    Field position[3];
+    Field color[3];                 // color[0] only for packed colours
+};
+
+#endif // POINTFILEREADER_H
@@ -0,0 +1,86 @@
+#include "pointformat.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+// public functions
+void PointQuantizer::quantize(const float *points, size_t points_count, PointChunk &chunk)
+{
+    chunk.points.resize(points_count);
+
+    if(points_count == 0)
+    {
+        chunk.origin[0] = chunk.origin[1] = chunk.origin[2] = 0.f;
+        chunk.scale = 1.f;
+        return;
+    }
+
+    // bounding box of the chunk
+    float min_corner[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float max_corner[3] = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+
+    for(size_t i = 0; i < points_count; ++i)
+    {
+        const float *point = points + i * PointsView::floatsPerPoint;
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            min_corner[axis] = std::min(min_corner[axis], point[axis]);
+            max_corner[axis] = std::max(max_corner[axis], point[axis]);
+        }
+    }
+
+    float half_extent = 0.f;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        chunk.origin[axis] = 0.5f * (min_corner[axis] + max_corner[axis]);
+        half_extent = std::max(half_extent, 0.5f * (max_corner[axis] - min_corner[axis]));
+    }
+
+    // keep one step of headroom so rounding never leaves the int16 range
+    const float max_steps = static_cast<float>(std::numeric_limits<int16_t>::max() - 1);
+    chunk.scale = half_extent > 0.f ? half_extent / max_steps : 1.f;
+
+    const float inv_scale = 1.f / chunk.scale;
+
+    for(size_t i = 0; i < points_count; ++i)
+    {
+        const float *point = points + i * PointsView::floatsPerPoint;
+        CompactPoint &compact_point = chunk.points[i];
+
+        compact_point.x = static_cast<int16_t>(std::lround((point[0] - chunk.origin[0]) * inv_scale));
+        compact_point.y = static_cast<int16_t>(std::lround((point[1] - chunk.origin[1]) * inv_scale));
+        compact_point.z = static_cast<int16_t>(std::lround((point[2] - chunk.origin[2]) * inv_scale));
+        compact_point.r = static_cast<uint8_t>(point[3]);
+        compact_point.g = static_cast<uint8_t>(point[4]);
+        compact_point.b = static_cast<uint8_t>(point[5]);
+        compact_point.a = 255;
+    }
+}
+
+void PointQuantizer::dequantize(const PointChunk &chunk, std::vector<float> &points)
+{
+    PointQuantizer::dequantize(chunk.points.data(), chunk.points.size(), chunk.origin, chunk.scale, points);
+}
+
+void PointQuantizer::dequantize(const CompactPoint *compact_points, size_t points_count, const float origin[3], float scale, std::vector<float> &points)
+{
+    size_t output_offset = points.size();
+    points.resize(output_offset + points_count * PointsView::floatsPerPoint);
+    float *output = points.data() + output_offset;
+
+    for(size_t i = 0; i < points_count; ++i)
+    {
+        const CompactPoint &compact_point = compact_points[i];
+
+        output[0] = origin[0] + compact_point.x * scale;
+        output[1] = origin[1] + compact_point.y * scale;
+        output[2] = origin[2] + compact_point.z * scale;
+        output[3] = compact_point.r;
+        output[4] = compact_point.g;
+        output[5] = compact_point.b;
+        output += PointsView::floatsPerPoint;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef POINTFORMAT_H
+#define POINTFORMAT_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+enum class PointFormat
+{
+    Float32,        // x, y, z, r, g, b as floats, 24 bytes per point
+    Compact         // int16 position relative to chunk origin + RGBA8, 10 bytes per point
+};
+
+#pragma pack(push, 1)
+struct CompactPoint
+{
+    int16_t x, y, z;            // position in chunk quantization steps
+    uint8_t r, g, b, a;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(CompactPoint) == 10, "CompactPoint must stay tightly packed");
+
+struct PointChunk
+{
+    float origin[3];            // centre of the chunk bounding box
+    float scale;                // scene units per quantization step
+    std::vector<CompactPoint> points;
+};
+
+//// points of one frame kept in the camera coordinates of that frame, see InputData::frameLocalPoints
+struct LocalFrame
+{
+    int frameIndex;             // dataset frame, its pose brings the points to world space
+    size_t first;               // first point in the points data for PointFormat::Float32, chunk for PointFormat::Compact
+    size_t pointsCount;
+};
+
+//// non-owning view over interleaved x, y, z, r, g, b floats, valid until the owner changes
+struct PointsView
+{
+    static constexpr size_t floatsPerPoint = 6;
+
+    const float *data;
+    size_t pointsCount;
+
+    const float *begin() const { return this->data; }
+    const float *end() const { return this->data + this->pointsCount * floatsPerPoint; }
+    size_t sizeInBytes() const { return this->pointsCount * floatsPerPoint * sizeof(float); }
+    bool empty() const { return this->pointsCount == 0; }
+};
+
+class PointQuantizer
+{
+public:
+    // public functions
+    //// packs interleaved float points into a chunk, step is chosen so the chunk extent fits int16
+    static void quantize(const float *points, size_t points_count, PointChunk &chunk);
+    //// appends chunk points as interleaved x, y, z, r, g, b floats
+    static void dequantize(const PointChunk &chunk, std::vector<float> &points);
+    ////// points quantized with origin and scale stored elsewhere, e.g. in a mapped file
+    static void dequantize(const CompactPoint *compact_points, size_t points_count, const float origin[3], float scale, std::vector<float> &points);
+};
+
+#endif // POINTFORMAT_H
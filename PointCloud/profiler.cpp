@@ -0,0 +1,444 @@
+#include "profiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <algorithm>
+
+static const int stagesCount = static_cast<int>(ProfileStage::Count);
+static const int countersCount = static_cast<int>(ProfileCounter::Count);
+
+static const char *stageNames[stagesCount] = {
+    "image_read", "transform", "integrate", "gather", "upload", "render_frame", "gpu_points", "gpu_overlay", "readback"
+};
+
+static const char *counterNames[countersCount] = {
+    "frames_ingested", "points_ingested", "bytes_read", "bytes_uploaded", "points_drawn"
+};
+
+//// samples of one stage, a ring of the most recent ones plus exact totals
+struct ProfileStageState
+{
+    std::mutex mutex;
+    std::vector<float> samples;
+    size_t nextSample = 0;
+    size_t samplesCount = 0;
+    double totalMilliseconds = 0.0;
+    double frameMilliseconds = 0.0;
+};
+
+struct ProfileFrameState
+{
+    std::mutex mutex;
+    std::vector<ProfileFrame> frames;
+    size_t nextFrame = 0;
+    size_t framesCount = 0;
+    uint64_t lastCounters[countersCount] = {};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+static ProfileStageState stageStates[stagesCount];
+static ProfileFrameState frameState;
+
+std::atomic<bool> Profiler::enabled(false);
+std::atomic<uint64_t> Profiler::counters[countersCount];
+
+// public functions
+void Profiler::setEnabled(bool enabled)
+{
+    if(enabled && !Profiler::isEnabled())
+    {
+        Profiler::reset();
+    }
+
+    Profiler::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::record(ProfileStage stage, double milliseconds)
+{
+    if(!Profiler::isEnabled())
+    {
+        return;
+    }
+
+    ProfileStageState &state = stageStates[static_cast<int>(stage)];
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    if(state.samples.size() < Profiler::samplesCapacity)
+    {
+        state.samples.push_back(static_cast<float>(milliseconds));
+    }
+    else
+    {
+        state.samples[state.nextSample] = static_cast<float>(milliseconds);
+    }
+
+    state.nextSample = (state.nextSample + 1) % Profiler::samplesCapacity;
+    state.samplesCount += 1;
+    state.totalMilliseconds += milliseconds;
+    state.frameMilliseconds += milliseconds;
+}
+
+void Profiler::endFrame()
+{
+    if(!Profiler::isEnabled())
+    {
+        return;
+    }
+
+    ProfileFrame frame;
+
+    for(int i = 0; i < stagesCount; ++i)
+    {
+        std::lock_guard<std::mutex> lock(stageStates[i].mutex);
+        frame.stageMilliseconds[i] = static_cast<float>(stageStates[i].frameMilliseconds);
+        stageStates[i].frameMilliseconds = 0.0;
+    }
+
+    std::lock_guard<std::mutex> lock(frameState.mutex);
+
+    // counters only grow, a frame gets the difference to the previous one
+    for(int i = 0; i < countersCount; ++i)
+    {
+        uint64_t total = Profiler::counters[i].load(std::memory_order_relaxed);
+        frame.counters[i] = total - frameState.lastCounters[i];
+        frameState.lastCounters[i] = total;
+    }
+
+    frame.frameIndex = frameState.framesCount;
+    frame.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameState.start).count();
+
+    if(frameState.frames.size() < Profiler::framesCapacity)
+    {
+        frameState.frames.push_back(frame);
+    }
+    else
+    {
+        frameState.frames[frameState.nextFrame] = frame;
+    }
+
+    frameState.nextFrame = (frameState.nextFrame + 1) % Profiler::framesCapacity;
+    frameState.framesCount += 1;
+}
+
+void Profiler::reset()
+{
+    for(ProfileStageState &state : stageStates)
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.samples.clear();
+        state.nextSample = 0;
+        state.samplesCount = 0;
+        state.totalMilliseconds = 0.0;
+        state.frameMilliseconds = 0.0;
+    }
+
+    std::lock_guard<std::mutex> lock(frameState.mutex);
+
+    for(int i = 0; i < countersCount; ++i)
+    {
+        Profiler::counters[i].store(0, std::memory_order_relaxed);
+        frameState.lastCounters[i] = 0;
+    }
+
+    frameState.frames.clear();
+    frameState.nextFrame = 0;
+    frameState.framesCount = 0;
+    frameState.start = std::chrono::steady_clock::now();
+}
+
+//// getters
+const char *Profiler::getStageName(ProfileStage stage)
+{
+    return stageNames[static_cast<int>(stage)];
+}
+
+const char *Profiler::getCounterName(ProfileCounter counter)
+{
+    return counterNames[static_cast<int>(counter)];
+}
+
+std::vector<ProfileStageSummary> Profiler::getStageSummaries()
+{
+    std::vector<ProfileStageSummary> summaries;
+    std::vector<float> samples;
+
+    for(int i = 0; i < stagesCount; ++i)
+    {
+        size_t samples_count;
+        double total_milliseconds;
+
+        {
+            std::lock_guard<std::mutex> lock(stageStates[i].mutex);
+            samples = stageStates[i].samples;
+            samples_count = stageStates[i].samplesCount;
+            total_milliseconds = stageStates[i].totalMilliseconds;
+        }
+
+        if(samples_count > 0)
+        {
+            summaries.push_back(Profiler::getSummary(stageNames[i], samples, samples_count, total_milliseconds));
+        }
+    }
+
+    return summaries;
+}
+
+std::vector<ProfileStageSummary> Profiler::getFrameSummaries(size_t frames_count)
+{
+    std::vector<ProfileFrame> frames = Profiler::getFrames();
+    size_t first = frames.size() - std::min(frames.size(), frames_count);
+
+    std::vector<ProfileStageSummary> summaries;
+    std::vector<float> samples;
+
+    for(int i = 0; i < stagesCount; ++i)
+    {
+        samples.clear();
+        double total_milliseconds = 0.0;
+
+        for(size_t j = first; j < frames.size(); ++j)
+        {
+            samples.push_back(frames[j].stageMilliseconds[i]);
+            total_milliseconds += frames[j].stageMilliseconds[i];
+        }
+
+        if(total_milliseconds > 0.0)
+        {
+            summaries.push_back(Profiler::getSummary(stageNames[i], samples, samples.size(), total_milliseconds));
+        }
+    }
+
+    return summaries;
+}
+
+std::vector<ProfileCounterSummary> Profiler::getCounterSummaries()
+{
+    double seconds = std::max(Profiler::getElapsedSeconds(), 1e-9);
+
+    std::vector<ProfileCounterSummary> summaries(countersCount);
+
+    for(int i = 0; i < countersCount; ++i)
+    {
+        summaries[i].name = counterNames[i];
+        summaries[i].total = Profiler::counters[i].load(std::memory_order_relaxed);
+        summaries[i].perSecond = summaries[i].total / seconds;
+    }
+
+    return summaries;
+}
+
+std::vector<ProfileFrame> Profiler::getFrames()
+{
+    std::lock_guard<std::mutex> lock(frameState.mutex);
+
+    if(frameState.frames.size() < Profiler::framesCapacity)
+    {
+        return frameState.frames;
+    }
+
+    std::vector<ProfileFrame> frames;
+    frames.reserve(frameState.frames.size());
+    frames.insert(frames.end(), frameState.frames.begin() + frameState.nextFrame, frameState.frames.end());
+    frames.insert(frames.end(), frameState.frames.begin(), frameState.frames.begin() + frameState.nextFrame);
+
+    return frames;
+}
+
+//// export
+bool Profiler::write(const std::string &path_to_file)
+{
+    size_t extension = path_to_file.rfind('.');
+
+    if(extension != std::string::npos && path_to_file.compare(extension, std::string::npos, ".csv") == 0)
+    {
+        return Profiler::writeCSV(path_to_file);
+    }
+
+    return Profiler::writeJSON(path_to_file);
+}
+
+bool Profiler::writeJSON(const std::string &path_to_file)
+{
+    std::ofstream file(path_to_file, std::ios::trunc);
+
+    if(!file.is_open())
+    {
+        std::cerr << "Failed to create profile file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    file << "{\n  \"seconds\": " << Profiler::getElapsedSeconds() << ",\n  \"stages\": [";
+
+    std::vector<ProfileStageSummary> stages = Profiler::getStageSummaries();
+
+    for(size_t i = 0; i < stages.size(); ++i)
+    {
+        const ProfileStageSummary &stage = stages[i];
+
+        file << (i > 0 ? "," : "") << "\n    { \"name\": \"" << stage.name << "\", \"samples\": " << stage.samplesCount
+             << ", \"total_ms\": " << stage.totalMilliseconds << ", \"mean_ms\": " << stage.meanMilliseconds
+             << ", \"p50_ms\": " << stage.p50Milliseconds << ", \"p90_ms\": " << stage.p90Milliseconds
+             << ", \"p99_ms\": " << stage.p99Milliseconds << ", \"max_ms\": " << stage.maxMilliseconds << " }";
+    }
+
+    file << "\n  ],\n  \"counters\": [";
+
+    std::vector<ProfileCounterSummary> counter_summaries = Profiler::getCounterSummaries();
+
+    for(size_t i = 0; i < counter_summaries.size(); ++i)
+    {
+        file << (i > 0 ? "," : "") << "\n    { \"name\": \"" << counter_summaries[i].name << "\", \"total\": " << counter_summaries[i].total
+             << ", \"per_second\": " << counter_summaries[i].perSecond << " }";
+    }
+
+    file << "\n  ],\n  \"frames\": [";
+
+    std::vector<ProfileFrame> frames = Profiler::getFrames();
+
+    for(size_t i = 0; i < frames.size(); ++i)
+    {
+        file << (i > 0 ? "," : "") << "\n    { \"frame\": " << frames[i].frameIndex << ", \"seconds\": " << frames[i].seconds;
+
+        for(int j = 0; j < stagesCount; ++j)
+        {
+            file << ", \"" << stageNames[j] << "_ms\": " << frames[i].stageMilliseconds[j];
+        }
+
+        for(int j = 0; j < countersCount; ++j)
+        {
+            file << ", \"" << counterNames[j] << "\": " << frames[i].counters[j];
+        }
+
+        file << " }";
+    }
+
+    file << "\n  ]\n}\n";
+
+    if(!file.good())
+    {
+        std::cerr << "Failed to write profile file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Profiler::writeCSV(const std::string &path_to_file)
+{
+    std::ofstream file(path_to_file, std::ios::trunc);
+
+    if(!file.is_open())
+    {
+        std::cerr << "Failed to create profile file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    file << "kind,name,count,total,mean_ms,p50_ms,p90_ms,p99_ms,max_ms,per_second\n";
+
+    for(const ProfileStageSummary &stage : Profiler::getStageSummaries())
+    {
+        file << "stage," << stage.name << "," << stage.samplesCount << "," << stage.totalMilliseconds << "," << stage.meanMilliseconds << ","
+             << stage.p50Milliseconds << "," << stage.p90Milliseconds << "," << stage.p99Milliseconds << "," << stage.maxMilliseconds << ",\n";
+    }
+
+    for(const ProfileCounterSummary &counter : Profiler::getCounterSummaries())
+    {
+        file << "counter," << counter.name << ",," << counter.total << ",,,,,," << counter.perSecond << "\n";
+    }
+
+    if(!file.good())
+    {
+        std::cerr << "Failed to write profile file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Profiler::writeFramesCSV(const std::string &path_to_file)
+{
+    std::ofstream file(path_to_file, std::ios::trunc);
+
+    if(!file.is_open())
+    {
+        std::cerr << "Failed to create profile file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    file << "frame,seconds";
+
+    for(int i = 0; i < stagesCount; ++i)
+    {
+        file << "," << stageNames[i] << "_ms";
+    }
+
+    for(int i = 0; i < countersCount; ++i)
+    {
+        file << "," << counterNames[i];
+    }
+
+    file << "\n";
+
+    for(const ProfileFrame &frame : Profiler::getFrames())
+    {
+        file << frame.frameIndex << "," << frame.seconds;
+
+        for(int i = 0; i < stagesCount; ++i)
+        {
+            file << "," << frame.stageMilliseconds[i];
+        }
+
+        for(int i = 0; i < countersCount; ++i)
+        {
+            file << "," << frame.counters[i];
+        }
+
+        file << "\n";
+    }
+
+    if(!file.good())
+    {
+        std::cerr << "Failed to write profile file: " << path_to_file.c_str() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// private functions
+ProfileStageSummary Profiler::getSummary(const char *name, std::vector<float> &samples, size_t samples_count, double total_milliseconds)
+{
+    ProfileStageSummary summary = {};
+    summary.name = name;
+    summary.samplesCount = samples_count;
+    summary.totalMilliseconds = total_milliseconds;
+    summary.meanMilliseconds = total_milliseconds / std::max<size_t>(1, samples_count);
+
+    if(samples.empty())
+    {
+        return summary;
+    }
+
+    // nearest rank percentiles of the retained samples
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&samples](double p)
+    {
+        return static_cast<double>(samples[static_cast<size_t>(p * (samples.size() - 1) + 0.5)]);
+    };
+
+    summary.p50Milliseconds = percentile(0.5);
+    summary.p90Milliseconds = percentile(0.9);
+    summary.p99Milliseconds = percentile(0.99);
+    summary.maxMilliseconds = samples.back();
+
+    return summary;
+}
+
+double Profiler::getElapsedSeconds()
+{
+    std::lock_guard<std::mutex> lock(frameState.mutex);
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - frameState.start).count();
+}
@@ -0,0 +1,153 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+enum class ProfileStage
+{
+    ImageRead,          // reading and decoding one frame on an I/O thread
+    Transform,          // back-projection of one frame
+    Integrate,          // voxel grid and octree merge of one frame
+    Gather,             // per-frame outputs appended to the accumulated cloud
+    Upload,             // CPU side of the GPU uploads of one render frame
+    RenderFrame,        // CPU side of one render frame
+    GpuPoints,          // GPU passes, measured with GL_TIME_ELAPSED queries
+    GpuOverlay,
+    Readback,           // offscreen frame copied back to the host
+    Count
+};
+
+enum class ProfileCounter
+{
+    FramesIngested,
+    PointsIngested,
+    BytesRead,
+    BytesUploaded,
+    PointsDrawn,
+    Count
+};
+
+struct ProfileStageSummary
+{
+    const char *name;
+    size_t samplesCount;
+    double totalMilliseconds;
+    double meanMilliseconds;
+    double p50Milliseconds;
+    double p90Milliseconds;
+    double p99Milliseconds;
+    double maxMilliseconds;
+};
+
+struct ProfileCounterSummary
+{
+    const char *name;
+    uint64_t total;
+    double perSecond;               // over the time since profiling was enabled or reset
+};
+
+struct ProfileFrame
+{
+    size_t frameIndex;
+    double seconds;                 // end of the frame since profiling was enabled or reset
+    float stageMilliseconds[static_cast<int>(ProfileStage::Count)];
+    uint64_t counters[static_cast<int>(ProfileCounter::Count)];    // added during the frame
+};
+
+//// process-wide stage timers and counters, thread safe; while disabled every call is a single relaxed atomic load
+class Profiler
+{
+public:
+    // public functions
+    static void setEnabled(bool enabled);
+    static bool isEnabled()
+    {
+        return Profiler::enabled.load(std::memory_order_relaxed);
+    }
+
+    static void record(ProfileStage stage, double milliseconds);
+    static void count(ProfileCounter counter, uint64_t value)
+    {
+        if(Profiler::isEnabled())
+        {
+            Profiler::counters[static_cast<int>(counter)].fetch_add(value, std::memory_order_relaxed);
+        }
+    }
+
+    //// closes the current render frame, stage times and counters recorded since the previous call make up its row
+    static void endFrame();
+    static void reset();
+
+    //// getters
+    static const char *getStageName(ProfileStage stage);
+    static const char *getCounterName(ProfileCounter counter);
+    ////// percentiles of the most recent samples of every stage, stages without samples are skipped
+    static std::vector<ProfileStageSummary> getStageSummaries();
+    ////// percentiles of per-frame stage totals over the last frames_count frames
+    static std::vector<ProfileStageSummary> getFrameSummaries(size_t frames_count);
+    static std::vector<ProfileCounterSummary> getCounterSummaries();
+    ////// oldest first, at most the last framesCapacity frames
+    static std::vector<ProfileFrame> getFrames();
+
+    //// export, write() picks CSV for a .csv extension and JSON otherwise
+    static bool write(const std::string &path_to_file);
+    ////// aggregate stages and counters plus the retained frames
+    static bool writeJSON(const std::string &path_to_file);
+    ////// one row per stage and counter
+    static bool writeCSV(const std::string &path_to_file);
+    ////// one row per retained frame
+    static bool writeFramesCSV(const std::string &path_to_file);
+
+    static const size_t samplesCapacity = 1 << 16;     // per stage, older samples are overwritten
+    static const size_t framesCapacity = 1024;
+
+private:
+    // private functions
+    static ProfileStageSummary getSummary(const char *name, std::vector<float> &samples, size_t samples_count, double total_milliseconds);
+    static double getElapsedSeconds();
+
+    // private variables
+    static std::atomic<bool> enabled;
+    static std::atomic<uint64_t> counters[static_cast<int>(ProfileCounter::Count)];
+};
+
+//// times its scope into a stage, nothing is measured if profiling was disabled when it was created
+class ScopedTimer
+{
+public:
+    // constructors/destructors
+    explicit ScopedTimer(ProfileStage stage)
+    {
+        this->stage = stage;
+        this->running = Profiler::isEnabled();
+
+        if(this->running)
+        {
+            this->start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer()
+    {
+        if(this->running)
+        {
+            Profiler::record(this->stage, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->start).count());
+        }
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    // private variables
+    ProfileStage stage;
+    bool running;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // PROFILER_H
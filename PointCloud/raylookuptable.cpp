@@ -0,0 +1,107 @@
+#include "raylookuptable.h"
+
+// constructors/destructors
+RayLookupTable::RayLookupTable(const CameraIntrinsics &intrinsics, int width, int height)
+{
+    this->width = width;
+    this->height = height;
+
+    CameraIntrinsics scaled = RayLookupTable::getScaledIntrinsics(intrinsics, width, height);
+
+    float cx = scaled.cx;
+    float cy = scaled.cy;
+    float focal_x = scaled.focal_x;
+    float focal_y = scaled.focal_y;
+
+    this->rayX.resize(static_cast<size_t>(width));
+    this->rayY.resize(static_cast<size_t>(height));
+
+    for(int u = 0; u < width; ++u)
+    {
+        this->rayX[u] = -(static_cast<float>(u) - cx) / focal_x;
+    }
+
+    for(int v = 0; v < height; ++v)
+    {
+        this->rayY[v] = (static_cast<float>(v) - cy) / focal_y;
+    }
+}
+
+RayLookupTable::~RayLookupTable()
+{
+
+}
+
+// public functions
+CameraIntrinsics RayLookupTable::getScaledIntrinsics(const CameraIntrinsics &intrinsics, int width, int height)
+{
+    CameraIntrinsics scaled = intrinsics;
+
+    if(intrinsics.width > 0 && intrinsics.height > 0 && (intrinsics.width != width || intrinsics.height != height))
+    {
+        float scale_x = static_cast<float>(width) / static_cast<float>(intrinsics.width);
+        float scale_y = static_cast<float>(height) / static_cast<float>(intrinsics.height);
+
+        scaled.cx *= scale_x;
+        scaled.cy *= scale_y;
+        scaled.focal_x *= scale_x;
+        scaled.focal_y *= scale_y;
+        scaled.width = width;
+        scaled.height = height;
+    }
+
+    return scaled;
+}
+
+//// getters
+int RayLookupTable::getWidth() const
+{
+    return this->width;
+}
+
+int RayLookupTable::getHeight() const
+{
+    return this->height;
+}
+
+const float *RayLookupTable::getRayX() const
+{
+    return this->rayX.data();
+}
+
+float RayLookupTable::getRayY(int v) const
+{
+    return this->rayY[v];
+}
+
+// constructors/destructors
+RayLookupTableCache::RayLookupTableCache()
+{
+
+}
+
+RayLookupTableCache::~RayLookupTableCache()
+{
+
+}
+
+// public functions
+std::shared_ptr<const RayLookupTable> RayLookupTableCache::getTable(const CameraIntrinsics &intrinsics, int width, int height)
+{
+    auto key = std::make_tuple(intrinsics.cx, intrinsics.cy, intrinsics.focal_x, intrinsics.focal_y,
+                               intrinsics.width, intrinsics.height, width, height);
+
+    std::lock_guard<std::mutex> lock(this->tablesMutex);
+
+    auto table = this->tables.find(key);
+
+    if(table != this->tables.end())
+    {
+        return table->second;
+    }
+
+    std::shared_ptr<const RayLookupTable> new_table = std::make_shared<RayLookupTable>(intrinsics, width, height);
+    this->tables.emplace(key, new_table);
+
+    return new_table;
+}
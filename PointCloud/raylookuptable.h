@@ -0,0 +1,62 @@
+#ifndef RAYLOOKUPTABLE_H
+#define RAYLOOKUPTABLE_H
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <mutex>
+
+struct CameraIntrinsics
+{
+    float cx, cy;               // principal point
+    float focal_x, focal_y;     // focal lengths in pixels
+    int width, height;          // calibration resolution, 0 - valid for any resolution
+    float depthScale;           // raw 16-bit depth value to scene units
+};
+
+class RayLookupTable
+{
+public:
+    // constructors/destructors
+    RayLookupTable(const CameraIntrinsics &intrinsics, int width, int height);
+    ~RayLookupTable();
+
+    // public functions
+    //// intrinsics calibrated for another resolution of the same sensor rescaled to width x height
+    static CameraIntrinsics getScaledIntrinsics(const CameraIntrinsics &intrinsics, int width, int height);
+
+    //// getters
+    int getWidth() const;
+    int getHeight() const;
+    ////// the rays are separable, point in camera space of pixel (u, v) is (getRayY(v) * d, getRayX()[u] * d, d)
+    const float *getRayX() const;
+    float getRayY(int v) const;
+
+private:
+    // private variables
+    int width;
+    int height;
+
+    std::vector<float> rayX;    // -(u - cx) / fx, one per column
+    std::vector<float> rayY;    // (v - cy) / fy, one per row
+};
+
+class RayLookupTableCache
+{
+public:
+    // constructors/destructors
+    RayLookupTableCache();
+    ~RayLookupTableCache();
+
+    // public functions
+    //// returns table for given intrinsics and resolution, builds it on first use, thread safe
+    std::shared_ptr<const RayLookupTable> getTable(const CameraIntrinsics &intrinsics, int width, int height);
+
+private:
+    // private variables
+    std::mutex tablesMutex;
+    std::map<std::tuple<float, float, float, float, int, int, int, int>, std::shared_ptr<const RayLookupTable>> tables;
+};
+
+#endif // RAYLOOKUPTABLE_H
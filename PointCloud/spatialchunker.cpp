@@ -0,0 +1,157 @@
+#include "spatialchunker.h"
+
+#include <algorithm>
+#include <random>
+#include <limits>
+#include <cmath>
+
+//// points dequantized per block when chunks are regrouped
+static const size_t chunkerBlockPoints = 65536;
+
+//// cell coordinates are packed into 21 bits per axis around the world origin
+static const int64_t cellCoordinateBias = int64_t(1) << 20;
+
+// constructors/destructors
+SpatialChunker::SpatialChunker(float chunk_size)
+{
+    this->chunkSize = chunk_size > 0.f ? chunk_size : 1.f;
+    this->inverseChunkSize = 1.f / this->chunkSize;
+    this->pointsCount = 0;
+}
+
+// public functions
+void SpatialChunker::add(const float *points, size_t points_count)
+{
+    const float max_steps = static_cast<float>(std::numeric_limits<int16_t>::max() - 1);
+
+    for(size_t i = 0; i < points_count; ++i)
+    {
+        const float *point = points + i * PointsView::floatsPerPoint;
+
+        if(!std::isfinite(point[0]) || !std::isfinite(point[1]) || !std::isfinite(point[2]))
+        {
+            continue;
+        }
+
+        size_t cell = this->getCell(point);
+        PointChunk &chunk = this->cells[cell];
+        BoundingBox &bounds = this->cellBounds[cell];
+
+        CompactPoint compact_point;
+        int16_t *position = &compact_point.x;
+        const float inv_scale = 1.f / chunk.scale;
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            float steps = std::round((point[axis] - chunk.origin[axis]) * inv_scale);
+            position[axis] = static_cast<int16_t>(std::clamp(steps, -max_steps, max_steps));
+
+            bounds.min[axis] = std::min(bounds.min[axis], point[axis]);
+            bounds.max[axis] = std::max(bounds.max[axis], point[axis]);
+        }
+
+        compact_point.r = static_cast<uint8_t>(std::clamp(point[3], 0.f, 255.f));
+        compact_point.g = static_cast<uint8_t>(std::clamp(point[4], 0.f, 255.f));
+        compact_point.b = static_cast<uint8_t>(std::clamp(point[5], 0.f, 255.f));
+        compact_point.a = 255;
+
+        chunk.points.push_back(compact_point);
+        ++this->pointsCount;
+    }
+}
+
+void SpatialChunker::add(const PointChunk &chunk)
+{
+    PointChunk block;
+    block.origin[0] = chunk.origin[0];
+    block.origin[1] = chunk.origin[1];
+    block.origin[2] = chunk.origin[2];
+    block.scale = chunk.scale;
+
+    for(size_t first = 0; first < chunk.points.size(); first += chunkerBlockPoints)
+    {
+        size_t block_count = std::min(chunkerBlockPoints, chunk.points.size() - first);
+
+        block.points.assign(chunk.points.begin() + first, chunk.points.begin() + first + block_count);
+
+        this->dequantizedPoints.clear();
+        PointQuantizer::dequantize(block, this->dequantizedPoints);
+
+        this->add(this->dequantizedPoints.data(), block_count);
+    }
+}
+
+void SpatialChunker::finish(std::vector<PointChunk> &chunks, std::vector<BoundingBox> &bounds)
+{
+    for(size_t i = 0; i < this->cells.size(); ++i)
+    {
+        // a fixed seed per cell keeps the draw order stable between runs
+        std::mt19937 generator(static_cast<uint32_t>(this->cellKeys[i] ^ (this->cellKeys[i] >> 32)));
+        std::shuffle(this->cells[i].points.begin(), this->cells[i].points.end(), generator);
+
+        chunks.push_back(std::move(this->cells[i]));
+        bounds.push_back(this->cellBounds[i]);
+    }
+
+    this->cellIndexes.clear();
+    this->cellKeys.clear();
+    this->cells.clear();
+    this->cellBounds.clear();
+    this->pointsCount = 0;
+}
+
+//// getters
+size_t SpatialChunker::getChunksCount()
+{
+    return this->cells.size();
+}
+
+size_t SpatialChunker::getPointsCount()
+{
+    return this->pointsCount;
+}
+
+// private functions
+size_t SpatialChunker::getCell(const float *point)
+{
+    int64_t coordinates[3];
+    uint64_t key = 0;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        int64_t coordinate = static_cast<int64_t>(std::floor(point[axis] * this->inverseChunkSize));
+        coordinates[axis] = std::clamp(coordinate, -cellCoordinateBias, cellCoordinateBias - 1);
+
+        key |= static_cast<uint64_t>(coordinates[axis] + cellCoordinateBias) << (21 * axis);
+    }
+
+    auto found = this->cellIndexes.find(key);
+
+    if(found != this->cellIndexes.end())
+    {
+        return found->second;
+    }
+
+    // the chunk origin is the cell centre, half of the cell spans the int16 range
+    PointChunk chunk;
+    chunk.scale = 0.5f * this->chunkSize / static_cast<float>(std::numeric_limits<int16_t>::max() - 1);
+
+    BoundingBox cell_bounds;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        chunk.origin[axis] = (static_cast<float>(coordinates[axis]) + 0.5f) * this->chunkSize;
+
+        cell_bounds.min[axis] = std::numeric_limits<float>::max();
+        cell_bounds.max[axis] = std::numeric_limits<float>::lowest();
+    }
+
+    size_t cell = this->cells.size();
+
+    this->cellIndexes.emplace(key, cell);
+    this->cellKeys.push_back(key);
+    this->cells.push_back(std::move(chunk));
+    this->cellBounds.push_back(cell_bounds);
+
+    return cell;
+}
@@ -0,0 +1,51 @@
+#ifndef SPATIALCHUNKER_H
+#define SPATIALCHUNKER_H
+
+#include "pointformat.h"
+#include "octree.h"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+//// regroups points into cubic cells of a world-aligned grid, every occupied cell becomes one compact chunk;
+//// points are quantized straight into their cell, the cloud is never expanded to floats as a whole
+class SpatialChunker
+{
+public:
+    // constructors/destructors
+    SpatialChunker(float chunk_size);
+
+    // public functions
+    //// interleaved x, y, z, r, g, b points
+    void add(const float *points, size_t points_count);
+    ////// dequantized in blocks
+    void add(const PointChunk &chunk);
+
+    //// moves the cells out and resets the chunker, points of every chunk are shuffled so that any prefix
+    //// is a spatially uniform sample of the whole chunk, bounds are tight around the points
+    void finish(std::vector<PointChunk> &chunks, std::vector<BoundingBox> &bounds);
+
+    //// getters
+    size_t getChunksCount();
+    size_t getPointsCount();
+
+private:
+    // private functions
+    size_t getCell(const float *point);
+
+    // private variables
+    float chunkSize;
+    float inverseChunkSize;
+    size_t pointsCount;
+
+    std::unordered_map<uint64_t, size_t> cellIndexes;
+    std::vector<uint64_t> cellKeys;
+    std::vector<PointChunk> cells;
+    std::vector<BoundingBox> cellBounds;
+
+    std::vector<float> dequantizedPoints;
+};
+
+#endif // SPATIALCHUNKER_H
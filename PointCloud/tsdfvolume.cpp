@@ -0,0 +1,632 @@
+#include "tsdfvolume.h"
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+
+// block and voxel indexes are packed into 21 bits per axis, centred around the origin
+static const int blockKeyBits = 21;
+static const int64_t blockKeyOffset = int64_t(1) << (blockKeyBits - 1);
+static const uint64_t blockKeyMask = (uint64_t(1) << blockKeyBits) - 1;
+
+// weight of a voxel stops growing here, so later frames can still correct it
+static const float maxVoxelWeight = 1000.f;
+
+static inline int64_t floorDivide(int64_t value, int64_t divisor)
+{
+    return value >= 0 ? value / divisor : -((-value - 1) / divisor) - 1;
+}
+
+static inline uint64_t packKey(const int64_t index[3])
+{
+    uint64_t key = 0;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        key = (key << blockKeyBits) | (static_cast<uint64_t>(index[axis] + blockKeyOffset) & blockKeyMask);
+    }
+
+    return key;
+}
+
+// constructors/destructors
+TSDFVolume::TSDFVolume(float voxel_size, float truncation_distance, unsigned int shards_count)
+{
+    this->voxelSize = voxel_size;
+    this->inverseVoxelSize = 1.f / voxel_size;
+    this->truncationDistance = truncation_distance > 0.f ? std::max(truncation_distance, voxel_size) : 4.f * voxel_size;
+
+    this->shardsCount = std::max(1u, shards_count);
+    this->shards.reset(new Shard[this->shardsCount]);
+
+    this->framesCount = 0;
+    this->inputPointsCount = 0;
+    this->totalFrameSeconds = 0.0;
+    this->maxFrameSeconds = 0.0;
+}
+
+TSDFVolume::~TSDFVolume()
+{
+
+}
+
+// public functions
+void TSDFVolume::integrate(const float camera_position[3], const float *points, size_t points_count)
+{
+    auto start_time = std::chrono::steady_clock::now();
+
+    // points of one frame falling into the same voxel share a ray, far surfaces collapse to a fraction of the pixels
+    struct RayBundle
+    {
+        float positionSum[3];
+        float colorSum[3];
+        float pointsCount;
+    };
+
+    std::unordered_map<uint64_t, RayBundle> bundles;
+    bundles.reserve(points_count / 4 + 1);
+
+    for(size_t i = 0; i < points_count; ++i)
+    {
+        const float *point = points + i * 6;
+
+        int64_t voxel[3];
+        this->getVoxel(point, voxel);
+
+        RayBundle &bundle = bundles.try_emplace(packKey(voxel), RayBundle{}).first->second;
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            bundle.positionSum[axis] += point[axis];
+            bundle.colorSum[axis] += point[axis + 3];
+        }
+
+        bundle.pointsCount += 1.f;
+    }
+
+    // updates are bucketed by shard first, so every shard is locked only once per frame
+    std::vector<std::vector<TSDFUpdate>> shard_updates(this->shardsCount);
+
+    const float step = 0.5f * this->voxelSize;
+
+    for(const std::pair<const uint64_t, RayBundle> &bundle_entry : bundles)
+    {
+        const RayBundle &bundle = bundle_entry.second;
+        float inverse_count = 1.f / bundle.pointsCount;
+
+        float direction[3];
+        float color[3];
+        float distance = 0.f;
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            direction[axis] = bundle.positionSum[axis] * inverse_count - camera_position[axis];
+            color[axis] = bundle.colorSum[axis] * inverse_count;
+            distance += direction[axis] * direction[axis];
+        }
+
+        distance = std::sqrt(distance);
+
+        if(distance < this->voxelSize)
+        {
+            continue;
+        }
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            direction[axis] /= distance;
+        }
+
+        // only the band of truncationDistance around the measured surface is touched, free space further out is not carved
+        int64_t previous_voxel[3] = { INT64_MIN, INT64_MIN, INT64_MIN };
+
+        for(float t = std::max(distance - this->truncationDistance, 0.f); t <= distance + this->truncationDistance; t += step)
+        {
+            float position[3] = {
+                camera_position[0] + direction[0] * t,
+                camera_position[1] + direction[1] * t,
+                camera_position[2] + direction[2] * t
+            };
+
+            int64_t voxel[3];
+            this->getVoxel(position, voxel);
+
+            if(voxel[0] == previous_voxel[0] && voxel[1] == previous_voxel[1] && voxel[2] == previous_voxel[2])
+            {
+                continue;
+            }
+
+            std::copy(voxel, voxel + 3, previous_voxel);
+
+            float center[3];
+            this->getVoxelCenter(voxel, center);
+
+            // projective distance along the ray, positive in front of the surface
+            float voxel_distance = (center[0] - camera_position[0]) * direction[0]
+                                 + (center[1] - camera_position[1]) * direction[1]
+                                 + (center[2] - camera_position[2]) * direction[2];
+
+            int64_t block[3];
+            int64_t local[3];
+
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                block[axis] = floorDivide(voxel[axis], TSDFVolume::blockSize);
+                local[axis] = voxel[axis] - block[axis] * TSDFVolume::blockSize;
+            }
+
+            TSDFUpdate update;
+            update.blockKey = TSDFVolume::getBlockKey(block);
+            update.voxelIndex = static_cast<uint32_t>((local[0] * TSDFVolume::blockSize + local[1]) * TSDFVolume::blockSize + local[2]);
+            update.distance = std::clamp(distance - voxel_distance, -this->truncationDistance, this->truncationDistance);
+            update.weight = bundle.pointsCount;
+            std::copy(color, color + 3, update.color);
+
+            shard_updates[this->getShard(update.blockKey)].push_back(update);
+        }
+    }
+
+    for(unsigned int shard = 0; shard < this->shardsCount; ++shard)
+    {
+        if(shard_updates[shard].empty())
+        {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(this->shards[shard].mutex);
+        std::unordered_map<uint64_t, std::unique_ptr<TSDFBlock>> &blocks = this->shards[shard].blocks;
+
+        uint64_t block_key = 0;
+        TSDFBlock *block = nullptr;
+
+        for(const TSDFUpdate &update : shard_updates[shard])
+        {
+            // consecutive updates of one ray mostly stay in the same block
+            if(block == nullptr || update.blockKey != block_key)
+            {
+                std::unique_ptr<TSDFBlock> &block_entry = blocks[update.blockKey];
+
+                if(!block_entry)
+                {
+                    block_entry.reset(new TSDFBlock());
+                }
+
+                block_key = update.blockKey;
+                block = block_entry.get();
+            }
+
+            TSDFVoxel &voxel = block->voxels[update.voxelIndex];
+            float weight = voxel.weight + update.weight;
+            float inverse_weight = 1.f / weight;
+
+            voxel.distance = (voxel.distance * voxel.weight + update.distance * update.weight) * inverse_weight;
+
+            for(int channel = 0; channel < 3; ++channel)
+            {
+                float color = (voxel.color[channel] * voxel.weight + update.color[channel] * update.weight) * inverse_weight;
+                voxel.color[channel] = static_cast<uint8_t>(std::clamp(color + 0.5f, 0.f, 255.f));
+            }
+
+            voxel.weight = std::min(weight, maxVoxelWeight);
+        }
+    }
+
+    double frame_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::lock_guard<std::mutex> lock(this->statisticsMutex);
+
+    this->framesCount += 1;
+    this->inputPointsCount += points_count;
+    this->totalFrameSeconds += frame_seconds;
+    this->maxFrameSeconds = std::max(this->maxFrameSeconds, frame_seconds);
+}
+
+//// getters
+float TSDFVolume::getVoxelSize()
+{
+    return this->voxelSize;
+}
+
+float TSDFVolume::getTruncationDistance()
+{
+    return this->truncationDistance;
+}
+
+TSDFStatistics TSDFVolume::getStatistics()
+{
+    size_t blocks_count = 0;
+
+    for(unsigned int shard = 0; shard < this->shardsCount; ++shard)
+    {
+        std::lock_guard<std::mutex> lock(this->shards[shard].mutex);
+        blocks_count += this->shards[shard].blocks.size();
+    }
+
+    std::lock_guard<std::mutex> lock(this->statisticsMutex);
+
+    TSDFStatistics statistics;
+    statistics.framesCount = this->framesCount;
+    statistics.inputPointsCount = this->inputPointsCount;
+    statistics.blocksCount = blocks_count;
+    statistics.memoryBytes = blocks_count * sizeof(TSDFBlock);
+    statistics.averageFrameSeconds = this->framesCount > 0 ? this->totalFrameSeconds / this->framesCount : 0.0;
+    statistics.maxFrameSeconds = this->maxFrameSeconds;
+
+    return statistics;
+}
+
+//// extraction
+void TSDFVolume::extractPointBlocks(int block_voxels, std::vector<std::vector<float>> &blocks)
+{
+    block_voxels = std::max(1, block_voxels);
+
+    // shards are read only now, every thread scans its own share of them
+    unsigned int threads_count = std::max(1u, std::min(std::thread::hardware_concurrency(), this->shardsCount));
+    std::vector<std::unordered_map<uint64_t, std::vector<float>>> thread_blocks(threads_count);
+    std::vector<std::thread> threads;
+
+    for(unsigned int thread_index = 0; thread_index < threads_count; ++thread_index)
+    {
+        threads.emplace_back([this, thread_index, threads_count, block_voxels, &thread_blocks]()
+        {
+            std::unordered_map<uint64_t, std::vector<float>> &output = thread_blocks[thread_index];
+
+            for(unsigned int shard = thread_index; shard < this->shardsCount; shard += threads_count)
+            {
+                for(const std::pair<const uint64_t, std::unique_ptr<TSDFBlock>> &block_entry : this->shards[shard].blocks)
+                {
+                    int64_t block[3];
+                    TSDFVolume::decodeBlockKey(block_entry.first, block);
+
+                    for(int i = 0; i < TSDFVolume::blockSize * TSDFVolume::blockSize * TSDFVolume::blockSize; ++i)
+                    {
+                        const TSDFVoxel &voxel = block_entry.second->voxels[i];
+
+                        if(voxel.weight <= 0.f)
+                        {
+                            continue;
+                        }
+
+                        int64_t index[3] = {
+                            block[0] * TSDFVolume::blockSize + i / (TSDFVolume::blockSize * TSDFVolume::blockSize),
+                            block[1] * TSDFVolume::blockSize + (i / TSDFVolume::blockSize) % TSDFVolume::blockSize,
+                            block[2] * TSDFVolume::blockSize + i % TSDFVolume::blockSize
+                        };
+
+                        float center[3];
+                        this->getVoxelCenter(index, center);
+
+                        // every edge is visited once, from its voxel with the lower index
+                        for(int axis = 0; axis < 3; ++axis)
+                        {
+                            int64_t neighbour_index[3] = { index[0], index[1], index[2] };
+                            neighbour_index[axis] += 1;
+
+                            const TSDFVoxel *neighbour = this->findVoxel(neighbour_index);
+                            float neighbour_center[3] = { center[0], center[1], center[2] };
+                            neighbour_center[axis] += this->voxelSize;
+
+                            float crossing[6];
+
+                            if(neighbour == nullptr || !this->getCrossing(voxel, *neighbour, center, neighbour_center, crossing))
+                            {
+                                continue;
+                            }
+
+                            int64_t output_block[3] = {
+                                floorDivide(index[0], block_voxels),
+                                floorDivide(index[1], block_voxels),
+                                floorDivide(index[2], block_voxels)
+                            };
+
+                            std::vector<float> &output_points = output[packKey(output_block)];
+                            output_points.insert(output_points.end(), crossing, crossing + 6);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    for(std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    std::unordered_map<uint64_t, size_t> block_indexes;
+
+    for(std::unordered_map<uint64_t, std::vector<float>> &output : thread_blocks)
+    {
+        for(std::pair<const uint64_t, std::vector<float>> &output_block : output)
+        {
+            auto block_index = block_indexes.find(output_block.first);
+
+            if(block_index == block_indexes.end())
+            {
+                block_indexes.emplace(output_block.first, blocks.size());
+                blocks.push_back(std::move(output_block.second));
+                continue;
+            }
+
+            std::vector<float> &block = blocks[block_index->second];
+            block.insert(block.end(), output_block.second.begin(), output_block.second.end());
+        }
+    }
+}
+
+void TSDFVolume::extractMesh(std::vector<float> &vertices, std::vector<uint32_t> &indices)
+{
+    vertices.clear();
+    indices.clear();
+
+    // corners of a cube of eight voxels and its twelve edges
+    static const int corners[8][3] = { {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}, {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1} };
+    static const int edges[12][2] = { {0, 1}, {2, 3}, {4, 5}, {6, 7}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {0, 4}, {1, 5}, {2, 6}, {3, 7} };
+
+    // surface nets, one vertex per cube with a sign change at the mean of its edge crossings
+    std::unordered_map<uint64_t, uint32_t> cube_vertices;
+
+    for(unsigned int shard = 0; shard < this->shardsCount; ++shard)
+    {
+        for(const std::pair<const uint64_t, std::unique_ptr<TSDFBlock>> &block_entry : this->shards[shard].blocks)
+        {
+            int64_t block[3];
+            TSDFVolume::decodeBlockKey(block_entry.first, block);
+
+            for(int i = 0; i < TSDFVolume::blockSize * TSDFVolume::blockSize * TSDFVolume::blockSize; ++i)
+            {
+                if(block_entry.second->voxels[i].weight <= 0.f)
+                {
+                    continue;
+                }
+
+                int64_t index[3] = {
+                    block[0] * TSDFVolume::blockSize + i / (TSDFVolume::blockSize * TSDFVolume::blockSize),
+                    block[1] * TSDFVolume::blockSize + (i / TSDFVolume::blockSize) % TSDFVolume::blockSize,
+                    block[2] * TSDFVolume::blockSize + i % TSDFVolume::blockSize
+                };
+
+                const TSDFVoxel *cube[8];
+                float centers[8][3];
+                bool complete = true;
+
+                for(int corner = 0; corner < 8 && complete; ++corner)
+                {
+                    int64_t corner_index[3] = { index[0] + corners[corner][0], index[1] + corners[corner][1], index[2] + corners[corner][2] };
+
+                    cube[corner] = this->findVoxel(corner_index);
+                    complete = cube[corner] != nullptr;
+
+                    this->getVoxelCenter(corner_index, centers[corner]);
+                }
+
+                if(!complete)
+                {
+                    continue;
+                }
+
+                float vertex[6] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+                int crossings_count = 0;
+
+                for(const int *edge : edges)
+                {
+                    float crossing[6];
+
+                    if(!this->getCrossing(*cube[edge[0]], *cube[edge[1]], centers[edge[0]], centers[edge[1]], crossing))
+                    {
+                        continue;
+                    }
+
+                    for(int j = 0; j < 6; ++j)
+                    {
+                        vertex[j] += crossing[j];
+                    }
+
+                    crossings_count += 1;
+                }
+
+                if(crossings_count == 0)
+                {
+                    continue;
+                }
+
+                for(int j = 0; j < 6; ++j)
+                {
+                    vertex[j] /= crossings_count;
+                }
+
+                cube_vertices.emplace(packKey(index), static_cast<uint32_t>(vertices.size() / 6));
+                vertices.insert(vertices.end(), vertex, vertex + 6);
+            }
+        }
+    }
+
+    // every voxel edge crossing the surface joins the four cubes around it into a quad
+    for(unsigned int shard = 0; shard < this->shardsCount; ++shard)
+    {
+        for(const std::pair<const uint64_t, std::unique_ptr<TSDFBlock>> &block_entry : this->shards[shard].blocks)
+        {
+            int64_t block[3];
+            TSDFVolume::decodeBlockKey(block_entry.first, block);
+
+            for(int i = 0; i < TSDFVolume::blockSize * TSDFVolume::blockSize * TSDFVolume::blockSize; ++i)
+            {
+                const TSDFVoxel &voxel = block_entry.second->voxels[i];
+
+                if(voxel.weight <= 0.f)
+                {
+                    continue;
+                }
+
+                int64_t index[3] = {
+                    block[0] * TSDFVolume::blockSize + i / (TSDFVolume::blockSize * TSDFVolume::blockSize),
+                    block[1] * TSDFVolume::blockSize + (i / TSDFVolume::blockSize) % TSDFVolume::blockSize,
+                    block[2] * TSDFVolume::blockSize + i % TSDFVolume::blockSize
+                };
+
+                float center[3];
+                this->getVoxelCenter(index, center);
+
+                for(int axis = 0; axis < 3; ++axis)
+                {
+                    int64_t neighbour_index[3] = { index[0], index[1], index[2] };
+                    neighbour_index[axis] += 1;
+
+                    const TSDFVoxel *neighbour = this->findVoxel(neighbour_index);
+                    float neighbour_center[3] = { center[0], center[1], center[2] };
+                    neighbour_center[axis] += this->voxelSize;
+
+                    float crossing[6];
+
+                    if(neighbour == nullptr || !this->getCrossing(voxel, *neighbour, center, neighbour_center, crossing))
+                    {
+                        continue;
+                    }
+
+                    // cyclic axes keep the winding consistent, faces point to the positive, observed free space side
+                    int first_axis = (axis + 1) % 3;
+                    int second_axis = (axis + 2) % 3;
+
+                    const int offsets[4][2] = { {0, 0}, {-1, 0}, {-1, -1}, {0, -1} };
+                    uint32_t quad[4];
+                    bool complete = true;
+
+                    for(int corner = 0; corner < 4 && complete; ++corner)
+                    {
+                        int64_t cube_index[3] = { index[0], index[1], index[2] };
+                        cube_index[first_axis] += offsets[corner][0];
+                        cube_index[second_axis] += offsets[corner][1];
+
+                        auto cube_vertex = cube_vertices.find(packKey(cube_index));
+                        complete = cube_vertex != cube_vertices.end();
+
+                        if(complete)
+                        {
+                            quad[corner] = cube_vertex->second;
+                        }
+                    }
+
+                    if(!complete)
+                    {
+                        continue;
+                    }
+
+                    if(voxel.distance < 0.f)
+                    {
+                        indices.insert(indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+                    }
+                    else
+                    {
+                        indices.insert(indices.end(), { quad[0], quad[2], quad[1], quad[0], quad[3], quad[2] });
+                    }
+                }
+            }
+        }
+    }
+}
+
+void TSDFVolume::clear()
+{
+    for(unsigned int shard = 0; shard < this->shardsCount; ++shard)
+    {
+        std::lock_guard<std::mutex> lock(this->shards[shard].mutex);
+        this->shards[shard].blocks.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(this->statisticsMutex);
+
+    this->framesCount = 0;
+    this->inputPointsCount = 0;
+    this->totalFrameSeconds = 0.0;
+    this->maxFrameSeconds = 0.0;
+}
+
+// private functions
+unsigned int TSDFVolume::getShard(uint64_t block_key)
+{
+    return static_cast<unsigned int>((block_key * 0x9E3779B97F4A7C15ull) >> 40) % this->shardsCount;
+}
+
+void TSDFVolume::getVoxel(const float *position, int64_t voxel[3])
+{
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        voxel[axis] = static_cast<int64_t>(std::floor(position[axis] * this->inverseVoxelSize));
+    }
+}
+
+const TSDFVolume::TSDFVoxel *TSDFVolume::findVoxel(const int64_t voxel[3])
+{
+    int64_t block[3];
+    int64_t local[3];
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        block[axis] = floorDivide(voxel[axis], TSDFVolume::blockSize);
+        local[axis] = voxel[axis] - block[axis] * TSDFVolume::blockSize;
+    }
+
+    uint64_t block_key = TSDFVolume::getBlockKey(block);
+    const std::unordered_map<uint64_t, std::unique_ptr<TSDFBlock>> &blocks = this->shards[this->getShard(block_key)].blocks;
+
+    auto block_entry = blocks.find(block_key);
+
+    if(block_entry == blocks.end())
+    {
+        return nullptr;
+    }
+
+    const TSDFVoxel &found = block_entry->second->voxels[(local[0] * TSDFVolume::blockSize + local[1]) * TSDFVolume::blockSize + local[2]];
+
+    return found.weight > 0.f ? &found : nullptr;
+}
+
+void TSDFVolume::getVoxelCenter(const int64_t voxel[3], float center[3])
+{
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        center[axis] = (static_cast<float>(voxel[axis]) + 0.5f) * this->voxelSize;
+    }
+}
+
+bool TSDFVolume::getCrossing(const TSDFVoxel &first, const TSDFVoxel &second, const float first_center[3], const float second_center[3], float crossing[6])
+{
+    if((first.distance < 0.f) == (second.distance < 0.f))
+    {
+        return false;
+    }
+
+    // neighbours on both sides of a real surface differ by at most about a voxel, a jump between
+    // truncated values is the edge of an observed band, not a surface
+    float difference = first.distance - second.distance;
+
+    if(std::abs(difference) > 2.f * this->voxelSize)
+    {
+        return false;
+    }
+
+    float t = first.distance / difference;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        crossing[axis] = first_center[axis] + t * (second_center[axis] - first_center[axis]);
+        crossing[axis + 3] = static_cast<float>(first.color[axis]) + t * (static_cast<float>(second.color[axis]) - static_cast<float>(first.color[axis]));
+    }
+
+    return true;
+}
+
+uint64_t TSDFVolume::getBlockKey(const int64_t block[3])
+{
+    return packKey(block);
+}
+
+void TSDFVolume::decodeBlockKey(uint64_t key, int64_t block[3])
+{
+    for(int axis = 2; axis >= 0; --axis)
+    {
+        block[axis] = static_cast<int64_t>(key & blockKeyMask) - blockKeyOffset;
+        key >>= blockKeyBits;
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef TSDFVOLUME_H
+#define TSDFVOLUME_H
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+struct TSDFStatistics
+{
+    size_t framesCount;
+    size_t inputPointsCount;
+    size_t blocksCount;
+    size_t memoryBytes;             // voxel blocks only, grows with the observed surface, not with the number of frames
+    double averageFrameSeconds;     // time spent fusing one frame
+    double maxFrameSeconds;
+};
+
+//// sparse truncated signed distance field in hashed blocks of blockSize^3 voxels, only blocks near observed surfaces exist;
+//// frames are fused along the rays from the camera to their points, so transformed, filtered or cached frames can be used
+class TSDFVolume
+{
+public:
+    static const int blockSize = 8;
+
+    // constructors/destructors
+    //// truncation_distance 0 - four voxels
+    TSDFVolume(float voxel_size, float truncation_distance = 0.f, unsigned int shards_count = 64);
+    ~TSDFVolume();
+
+    // public functions
+    //// fuses interleaved world space x, y, z, r, g, b points of one frame seen from camera_position, thread safe
+    void integrate(const float camera_position[3], const float *points, size_t points_count);
+
+    //// getters
+    float getVoxelSize();
+    float getTruncationDistance();
+    TSDFStatistics getStatistics();
+
+    //// extraction, must not run concurrently with integrate
+    ////// surface points where the distance changes sign between neighbouring voxels, interleaved x, y, z, r, g, b,
+    ////// grouped into cubic blocks of block_voxels^3 voxels
+    void extractPointBlocks(int block_voxels, std::vector<std::vector<float>> &blocks);
+    ////// surface nets mesh, vertices as interleaved x, y, z, r, g, b, three indices per triangle
+    void extractMesh(std::vector<float> &vertices, std::vector<uint32_t> &indices);
+
+    void clear();
+
+private:
+    struct TSDFVoxel
+    {
+        float distance;             // signed distance along the camera rays, truncated
+        float weight;               // 0 - never observed
+        uint8_t color[3];
+    };
+
+    struct TSDFBlock
+    {
+        TSDFVoxel voxels[blockSize * blockSize * blockSize];
+    };
+
+    struct TSDFUpdate
+    {
+        uint64_t blockKey;
+        uint32_t voxelIndex;
+        float distance;
+        float weight;
+        float color[3];
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, std::unique_ptr<TSDFBlock>> blocks;
+    };
+
+    // private functions
+    unsigned int getShard(uint64_t block_key);
+    void getVoxel(const float *position, int64_t voxel[3]);
+    ////// nullptr for voxels in blocks that were never allocated or voxels without observations
+    const TSDFVoxel *findVoxel(const int64_t voxel[3]);
+    void getVoxelCenter(const int64_t voxel[3], float center[3]);
+    ////// interpolated zero crossing between two voxels of opposite signs, false for truncated sign changes
+    bool getCrossing(const TSDFVoxel &first, const TSDFVoxel &second, const float first_center[3], const float second_center[3], float crossing[6]);
+
+    static uint64_t getBlockKey(const int64_t block[3]);
+    static void decodeBlockKey(uint64_t key, int64_t block[3]);
+
+    // private variables
+    float voxelSize;
+    float inverseVoxelSize;
+    float truncationDistance;
+
+    unsigned int shardsCount;
+    std::unique_ptr<Shard[]> shards;
+
+    //// statistics
+    std::mutex statisticsMutex;
+    size_t framesCount;
+    size_t inputPointsCount;
+    double totalFrameSeconds;
+    double maxFrameSeconds;
+};
+
+#endif // TSDFVOLUME_H
@@ -0,0 +1,215 @@
+#include "voxelgrid.h"
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+// voxel indexes are packed into 21 bits per axis, centred around the origin; points farther than 2^20 voxels
+// from it would alias voxels on the other side and are skipped instead
+static const int voxelKeyBits = 21;
+static const int64_t voxelKeyOffset = int64_t(1) << (voxelKeyBits - 1);
+static const uint64_t voxelKeyMask = (uint64_t(1) << voxelKeyBits) - 1;
+
+// constructors/destructors
+VoxelGridAccumulator::VoxelGridAccumulator(float voxel_size, unsigned int shards_count)
+{
+    this->voxelSize = voxel_size;
+    this->inverseVoxelSize = 1.f / voxel_size;
+
+    this->shardsCount = std::max(1u, shards_count);
+    this->shards.reset(new Shard[this->shardsCount]);
+
+    this->framesCount = 0;
+    this->inputPointsCount = 0;
+    this->skippedPointsCount = 0;
+    this->totalFrameSeconds = 0.0;
+    this->maxFrameSeconds = 0.0;
+}
+
+VoxelGridAccumulator::~VoxelGridAccumulator()
+{
+
+}
+
+// public functions
+void VoxelGridAccumulator::integrate(const float *points, size_t points_count)
+{
+    auto start_time = std::chrono::steady_clock::now();
+
+    // bucket points by shard first, so every shard is locked only once per frame
+    std::vector<std::vector<std::pair<uint64_t, size_t>>> shard_points(this->shardsCount);
+    size_t skipped_points = 0;
+
+    for(size_t i = 0; i < points_count; ++i)
+    {
+        uint64_t key;
+
+        if(!this->getVoxelKey(points + i * 6, key))
+        {
+            skipped_points += 1;
+            continue;
+        }
+
+        unsigned int shard = static_cast<unsigned int>((key * 0x9E3779B97F4A7C15ull) >> 40) % this->shardsCount;
+
+        shard_points[shard].emplace_back(key, i);
+    }
+
+    for(unsigned int shard = 0; shard < this->shardsCount; ++shard)
+    {
+        if(shard_points[shard].empty())
+        {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(this->shards[shard].mutex);
+        std::unordered_map<uint64_t, VoxelCell> &cells = this->shards[shard].cells;
+
+        for(const std::pair<uint64_t, size_t> &shard_point : shard_points[shard])
+        {
+            const float *point = points + shard_point.second * 6;
+            VoxelCell &cell = cells[shard_point.first];
+
+            cell.positionSum[0] += point[0];
+            cell.positionSum[1] += point[1];
+            cell.positionSum[2] += point[2];
+            cell.colorSum[0] += point[3];
+            cell.colorSum[1] += point[4];
+            cell.colorSum[2] += point[5];
+            cell.pointsCount += 1;
+        }
+    }
+
+    double frame_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::lock_guard<std::mutex> lock(this->statisticsMutex);
+
+    this->framesCount += 1;
+    this->inputPointsCount += points_count;
+    this->skippedPointsCount += skipped_points;
+    this->totalFrameSeconds += frame_seconds;
+    this->maxFrameSeconds = std::max(this->maxFrameSeconds, frame_seconds);
+}
+
+//// getters
+float VoxelGridAccumulator::getVoxelSize()
+{
+    return this->voxelSize;
+}
+
+VoxelGridStatistics VoxelGridAccumulator::getStatistics()
+{
+    size_t voxels_count = 0;
+
+    for(unsigned int shard = 0; shard < this->shardsCount; ++shard)
+    {
+        std::lock_guard<std::mutex> lock(this->shards[shard].mutex);
+        voxels_count += this->shards[shard].cells.size();
+    }
+
+    std::lock_guard<std::mutex> lock(this->statisticsMutex);
+
+    VoxelGridStatistics statistics;
+    statistics.framesCount = this->framesCount;
+    statistics.inputPointsCount = this->inputPointsCount;
+    statistics.skippedPointsCount = this->skippedPointsCount;
+    statistics.voxelsCount = voxels_count;
+    statistics.reductionRatio = voxels_count > 0 ? static_cast<double>(this->inputPointsCount) / voxels_count : 0.0;
+    statistics.averageFrameSeconds = this->framesCount > 0 ? this->totalFrameSeconds / this->framesCount : 0.0;
+    statistics.maxFrameSeconds = this->maxFrameSeconds;
+
+    return statistics;
+}
+
+void VoxelGridAccumulator::extractPointBlocks(int block_voxels, std::vector<std::vector<float>> &blocks)
+{
+    std::unordered_map<uint64_t, size_t> block_indexes;
+    block_voxels = std::max(1, block_voxels);
+
+    for(unsigned int shard = 0; shard < this->shardsCount; ++shard)
+    {
+        std::lock_guard<std::mutex> lock(this->shards[shard].mutex);
+
+        for(const std::pair<const uint64_t, VoxelCell> &cell : this->shards[shard].cells)
+        {
+            int64_t voxel[3];
+            VoxelGridAccumulator::decodeVoxelKey(cell.first, voxel);
+
+            // floor division keeps negative voxels in the right block
+            uint64_t block_key = 0;
+
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                int64_t block = voxel[axis] >= 0 ? voxel[axis] / block_voxels : -((-voxel[axis] - 1) / block_voxels) - 1;
+                block_key = (block_key << voxelKeyBits) | (static_cast<uint64_t>(block + voxelKeyOffset) & voxelKeyMask);
+            }
+
+            auto block_index = block_indexes.find(block_key);
+
+            if(block_index == block_indexes.end())
+            {
+                block_index = block_indexes.emplace(block_key, blocks.size()).first;
+                blocks.emplace_back();
+            }
+
+            const VoxelCell &voxel_cell = cell.second;
+            double inverse_count = 1.0 / voxel_cell.pointsCount;
+
+            blocks[block_index->second].insert(blocks[block_index->second].end(), {
+                static_cast<float>(voxel_cell.positionSum[0] * inverse_count),
+                static_cast<float>(voxel_cell.positionSum[1] * inverse_count),
+                static_cast<float>(voxel_cell.positionSum[2] * inverse_count),
+                static_cast<float>(voxel_cell.colorSum[0] * inverse_count),
+                static_cast<float>(voxel_cell.colorSum[1] * inverse_count),
+                static_cast<float>(voxel_cell.colorSum[2] * inverse_count)
+            });
+        }
+    }
+}
+
+void VoxelGridAccumulator::clear()
+{
+    for(unsigned int shard = 0; shard < this->shardsCount; ++shard)
+    {
+        std::lock_guard<std::mutex> lock(this->shards[shard].mutex);
+        this->shards[shard].cells.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(this->statisticsMutex);
+
+    this->framesCount = 0;
+    this->inputPointsCount = 0;
+    this->skippedPointsCount = 0;
+    this->totalFrameSeconds = 0.0;
+    this->maxFrameSeconds = 0.0;
+}
+
+// private functions
+bool VoxelGridAccumulator::getVoxelKey(const float *point, uint64_t &key)
+{
+    key = 0;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        float voxel = std::floor(point[axis] * this->inverseVoxelSize);
+
+        // also false for NaN, casting it or an infinity to an integer is undefined
+        if(!(voxel >= static_cast<float>(-voxelKeyOffset) && voxel < static_cast<float>(voxelKeyOffset)))
+        {
+            return false;
+        }
+
+        key = (key << voxelKeyBits) | (static_cast<uint64_t>(static_cast<int64_t>(voxel) + voxelKeyOffset) & voxelKeyMask);
+    }
+
+    return true;
+}
+
+void VoxelGridAccumulator::decodeVoxelKey(uint64_t key, int64_t voxel[3])
+{
+    for(int axis = 2; axis >= 0; --axis)
+    {
+        voxel[axis] = static_cast<int64_t>(key & voxelKeyMask) - voxelKeyOffset;
+        key >>= voxelKeyBits;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef VOXELGRID_H
+#define VOXELGRID_H
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+struct VoxelGridStatistics
+{
+    size_t framesCount;
+    size_t inputPointsCount;
+    size_t skippedPointsCount;      // non-finite or beyond the voxel key range, not merged
+    size_t voxelsCount;
+    double reductionRatio;          // input points per stored voxel
+    double averageFrameSeconds;     // time spent merging one frame
+    double maxFrameSeconds;
+};
+
+class VoxelGridAccumulator
+{
+public:
+    // constructors/destructors
+    VoxelGridAccumulator(float voxel_size, unsigned int shards_count = 64);
+    ~VoxelGridAccumulator();
+
+    // public functions
+    //// merges interleaved x, y, z, r, g, b points of one frame, thread safe
+    void integrate(const float *points, size_t points_count);
+
+    //// getters
+    float getVoxelSize();
+    VoxelGridStatistics getStatistics();
+
+    //// averaged voxels as interleaved x, y, z, r, g, b points, grouped into cubic blocks of block_voxels^3 voxels
+    void extractPointBlocks(int block_voxels, std::vector<std::vector<float>> &blocks);
+
+    void clear();
+
+private:
+    struct VoxelCell
+    {
+        double positionSum[3];
+        double colorSum[3];         // float sums lose whole colour steps after a few million points
+        uint32_t pointsCount;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, VoxelCell> cells;
+    };
+
+    // private functions
+    ////// false for points that do not fit the key, see voxelKeyBits
+    bool getVoxelKey(const float *point, uint64_t &key);
+    static void decodeVoxelKey(uint64_t key, int64_t voxel[3]);
+
+    // private variables
+    float voxelSize;
+    float inverseVoxelSize;
+
+    unsigned int shardsCount;
+    std::unique_ptr<Shard[]> shards;
+
+    //// statistics
+    std::mutex statisticsMutex;
+    size_t framesCount;
+    size_t inputPointsCount;
+    size_t skippedPointsCount;
+    double totalFrameSeconds;
+    double maxFrameSeconds;
+};
+
+#endif // VOXELGRID_H
@@ -0,0 +1,416 @@
+#include "depthframerenderer.h"
+#include "renderstate.h"
+#include "profiler.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+// constructors/destructors
+DepthFrameRenderer::DepthFrameRenderer(QOpenGLFunctions_3_3_Core *gl_functions, DepthFrameRendererSettings settings)
+{
+    this->gl = gl_functions;
+    this->settings = settings;
+
+    this->intrinsics = {};
+    this->depthFilter = {};
+
+    this->shaderProgram = nullptr;
+    this->vao = 0;
+    this->maxTexelsCount = 0;
+    this->modelMatrixLocation = -1;
+    this->framePoseLocation = -1;
+    this->frameOffsetLocation = -1;
+    this->frameSizeLocation = -1;
+    this->intrinsicsLocation = -1;
+    this->depthFilterLocation = -1;
+    this->rejectInvalidLocation = -1;
+    this->pointSizeLocation = -1;
+
+    this->pixelsCount = 0;
+
+    this->statistics = {};
+}
+
+DepthFrameRenderer::~DepthFrameRenderer()
+{
+    this->clear();
+
+    if(this->vao != 0)
+    {
+        this->gl->glDeleteVertexArrays(1, &this->vao);
+    }
+
+    delete this->shaderProgram;
+}
+
+// public functions
+bool DepthFrameRenderer::initialize()
+{
+    this->shaderProgram = RenderState::createProgram(this->gl, "Visualizer/Shaders/DepthFrameVertexShader.vert", "Visualizer/Shaders/PointCloudFragmentShader.frag");
+
+    if(this->shaderProgram == nullptr)
+    {
+        return false;
+    }
+
+    GLuint program_id = this->shaderProgram->programId();
+
+    this->modelMatrixLocation = this->gl->glGetUniformLocation(program_id, "modelMatrix");
+    this->framePoseLocation = this->gl->glGetUniformLocation(program_id, "framePose");
+    this->frameOffsetLocation = this->gl->glGetUniformLocation(program_id, "frameOffset");
+    this->frameSizeLocation = this->gl->glGetUniformLocation(program_id, "frameSize");
+    this->intrinsicsLocation = this->gl->glGetUniformLocation(program_id, "intrinsics");
+    this->depthFilterLocation = this->gl->glGetUniformLocation(program_id, "depthFilter");
+    this->rejectInvalidLocation = this->gl->glGetUniformLocation(program_id, "rejectInvalid");
+    this->pointSizeLocation = this->gl->glGetUniformLocation(program_id, "pointSize");
+
+    // depth on texture unit 0, colour on unit 1
+    this->gl->glUseProgram(program_id);
+    this->gl->glUniform1i(this->gl->glGetUniformLocation(program_id, "depthTexels"), 0);
+    this->gl->glUniform1i(this->gl->glGetUniformLocation(program_id, "colorTexels"), 1);
+    this->gl->glUseProgram(0);
+
+    this->gl->glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &this->maxTexelsCount);
+    this->gl->glGenVertexArrays(1, &this->vao);
+
+    return true;
+}
+
+void DepthFrameRenderer::setIntrinsics(const CameraIntrinsics &intrinsics)
+{
+    this->intrinsics = intrinsics;
+
+    for(FrameRange &range : this->frames)
+    {
+        this->updateRangeBounds(range);
+    }
+}
+
+void DepthFrameRenderer::setDepthFilter(const DepthFilterSettings &settings)
+{
+    this->depthFilter = settings;
+}
+
+void DepthFrameRenderer::setPoses(const std::vector<FramePose> &poses)
+{
+    this->poseMatrices.resize(poses.size());
+
+    for(size_t i = 0; i < poses.size(); ++i)
+    {
+        const float *r = poses[i].rotation;
+        const float *t = poses[i].translation;
+
+        this->poseMatrices[i] = QMatrix4x4(r[0], r[1], r[2], t[0],
+                                           r[3], r[4], r[5], t[1],
+                                           r[6], r[7], r[8], t[2],
+                                           0.f , 0.f , 0.f , 1.f);
+    }
+
+    for(FrameRange &range : this->frames)
+    {
+        this->updateRangeBounds(range);
+    }
+}
+
+void DepthFrameRenderer::clear()
+{
+    for(FrameBuffer &buffer : this->buffers)
+    {
+        this->gl->glDeleteTextures(1, &buffer.depthTexture);
+        this->gl->glDeleteTextures(1, &buffer.colorTexture);
+        this->gl->glDeleteBuffers(1, &buffer.depthBuffer);
+        this->gl->glDeleteBuffers(1, &buffer.colorBuffer);
+    }
+
+    this->buffers.clear();
+    this->frames.clear();
+    this->queuedFrames.clear();
+    this->pixelsCount = 0;
+
+    this->statistics.framesCount = 0;
+    this->statistics.pixelsCount = 0;
+    this->statistics.queuedFramesCount = 0;
+}
+
+void DepthFrameRenderer::queueFrame(int frame_index, const cv::Mat &depth_image, const cv::Mat &rgb_image)
+{
+    if(depth_image.empty() || depth_image.type() != CV_16UC1 || rgb_image.type() != CV_8UC3
+       || rgb_image.cols != depth_image.cols || rgb_image.rows != depth_image.rows)
+    {
+        std::cerr << "RGB and depth images do not match!" << std::endl;
+        return;
+    }
+
+    QueuedFrame queued_frame;
+
+    // the writers copy rows straight out of the images
+    queued_frame.depthImage = depth_image.isContinuous() ? depth_image : depth_image.clone();
+    queued_frame.rgbImage = rgb_image.isContinuous() ? rgb_image : rgb_image.clone();
+    queued_frame.reserved = false;
+    queued_frame.uploadedDepthPixels = 0;
+    queued_frame.uploadedColorPixels = 0;
+
+    FrameRange &range = queued_frame.range;
+    range.frameIndex = frame_index;
+    range.width = depth_image.cols;
+    range.height = depth_image.rows;
+    range.bufferIndex = 0;
+    range.first = 0;
+
+    // depth range of the measured pixels bounds the frame along the view direction
+    const uint16_t *depth = queued_frame.depthImage.ptr<uint16_t>(0);
+    const size_t count = queued_frame.depthImage.total();
+    uint16_t min_depth = UINT16_MAX;
+    uint16_t max_depth = 0;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        min_depth = depth[i] != 0 ? std::min(min_depth, depth[i]) : min_depth;
+        max_depth = std::max(max_depth, depth[i]);
+    }
+
+    // unmeasured pixels land on the camera centre unless they are rejected
+    min_depth = this->depthFilter.rejectInvalid ? std::min(min_depth, max_depth) : 0;
+
+    range.minDepth = static_cast<float>(min_depth) * this->intrinsics.depthScale;
+    range.maxDepth = static_cast<float>(max_depth) * this->intrinsics.depthScale;
+
+    this->updateRangeBounds(range);
+
+    this->queuedFrames.push_back(std::move(queued_frame));
+    this->statistics.queuedFramesCount = this->queuedFrames.size();
+}
+
+bool DepthFrameRenderer::uploadQueuedFrames(StreamingUploader &uploader)
+{
+    while(!this->queuedFrames.empty())
+    {
+        QueuedFrame &queued_frame = this->queuedFrames.front();
+
+        if(!queued_frame.reserved && !this->reserveRange(queued_frame))
+        {
+            this->queuedFrames.pop_front();
+            this->statistics.queuedFramesCount = this->queuedFrames.size();
+            continue;
+        }
+
+        const FrameRange &range = queued_frame.range;
+        const FrameBuffer &buffer = this->buffers[range.bufferIndex];
+        const size_t count = static_cast<size_t>(range.width) * static_cast<size_t>(range.height);
+        const size_t first = static_cast<size_t>(range.first);
+
+        // depth first, the colour follows within the same budget
+        if(queued_frame.uploadedDepthPixels < count)
+        {
+            const uint16_t *source = queued_frame.depthImage.ptr<uint16_t>(0) + queued_frame.uploadedDepthPixels;
+
+            queued_frame.uploadedDepthPixels += uploader.upload(buffer.depthBuffer, (first + queued_frame.uploadedDepthPixels) * sizeof(uint16_t),
+                                                                count - queued_frame.uploadedDepthPixels, sizeof(uint16_t),
+                                                                [source](void *destination, size_t first_element, size_t elements_count)
+            {
+                std::memcpy(destination, source + first_element, elements_count * sizeof(uint16_t));
+            });
+        }
+
+        if(queued_frame.uploadedDepthPixels == count && queued_frame.uploadedColorPixels < count)
+        {
+            const uint8_t *source = queued_frame.rgbImage.ptr<uint8_t>(0) + 3 * queued_frame.uploadedColorPixels;
+
+            queued_frame.uploadedColorPixels += uploader.upload(buffer.colorBuffer, 3 * (first + queued_frame.uploadedColorPixels),
+                                                                count - queued_frame.uploadedColorPixels, 3,
+                                                                [source](void *destination, size_t first_element, size_t elements_count)
+            {
+                std::memcpy(destination, source + 3 * first_element, 3 * elements_count);
+            });
+        }
+
+        if(queued_frame.uploadedColorPixels < count)
+        {
+            return false;
+        }
+
+        this->frames.push_back(range);
+        this->pixelsCount += count;
+        this->queuedFrames.pop_front();
+
+        this->statistics.framesCount = this->frames.size();
+        this->statistics.pixelsCount = this->pixelsCount;
+        this->statistics.queuedFramesCount = this->queuedFrames.size();
+    }
+
+    return true;
+}
+
+void DepthFrameRenderer::render(const QMatrix4x4 &projection_matrix, const QMatrix4x4 &view_matrix, const QMatrix4x4 &model_matrix)
+{
+    this->statistics.visibleFramesCount = 0;
+    this->statistics.drawnPixelsCount = 0;
+
+    if(this->shaderProgram == nullptr || this->frames.empty())
+    {
+        return;
+    }
+
+    // frame bounds live in model space, test them against the frustum brought into that space
+    QMatrix4x4 model_view_projection = projection_matrix * view_matrix * model_matrix;
+    Frustum frustum = Frustum::fromMatrix(model_view_projection.constData());
+
+    // the filter in the raw depth units the shader reads
+    const float depth_scale = this->intrinsics.depthScale;
+    const float depth_filter[4] = {
+        depth_scale,
+        this->depthFilter.minDepth / depth_scale,
+        this->depthFilter.maxDepth > 0.f ? this->depthFilter.maxDepth / depth_scale : 65536.f,
+        this->depthFilter.discontinuityThreshold
+    };
+    const float intrinsics[4] = { this->intrinsics.cx, this->intrinsics.cy, this->intrinsics.focal_x, this->intrinsics.focal_y };
+
+    this->gl->glEnable(GL_PROGRAM_POINT_SIZE);
+    this->gl->glUseProgram(this->shaderProgram->programId());
+    this->gl->glBindVertexArray(this->vao);
+
+    this->gl->glUniformMatrix4fv(this->modelMatrixLocation, 1, GL_FALSE, model_matrix.constData());
+    this->gl->glUniform4fv(this->intrinsicsLocation, 1, intrinsics);
+    this->gl->glUniform4fv(this->depthFilterLocation, 1, depth_filter);
+    this->gl->glUniform1i(this->rejectInvalidLocation, this->depthFilter.rejectInvalid ? 1 : 0);
+    this->gl->glUniform1f(this->pointSizeLocation, this->settings.pointSize);
+
+    size_t bound_buffer = this->buffers.size();
+
+    for(const FrameRange &range : this->frames)
+    {
+        if(!frustum.intersects(range.bounds))
+        {
+            continue;
+        }
+
+        if(range.bufferIndex != bound_buffer)
+        {
+            bound_buffer = range.bufferIndex;
+
+            this->gl->glActiveTexture(GL_TEXTURE0);
+            this->gl->glBindTexture(GL_TEXTURE_BUFFER, this->buffers[bound_buffer].depthTexture);
+            this->gl->glActiveTexture(GL_TEXTURE1);
+            this->gl->glBindTexture(GL_TEXTURE_BUFFER, this->buffers[bound_buffer].colorTexture);
+        }
+
+        bool has_pose = range.frameIndex >= 0 && static_cast<size_t>(range.frameIndex) < this->poseMatrices.size();
+        QMatrix4x4 frame_pose = has_pose ? this->poseMatrices[static_cast<size_t>(range.frameIndex)] : QMatrix4x4();
+
+        GLsizei count = range.width * range.height;
+
+        this->gl->glUniformMatrix4fv(this->framePoseLocation, 1, GL_FALSE, frame_pose.constData());
+        this->gl->glUniform1i(this->frameOffsetLocation, range.first);
+        this->gl->glUniform2i(this->frameSizeLocation, range.width, range.height);
+        this->gl->glDrawArrays(GL_POINTS, 0, count);
+
+        this->statistics.visibleFramesCount += 1;
+        this->statistics.drawnPixelsCount += static_cast<size_t>(count);
+    }
+
+    this->gl->glActiveTexture(GL_TEXTURE1);
+    this->gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+    this->gl->glActiveTexture(GL_TEXTURE0);
+    this->gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+    this->gl->glBindVertexArray(0);
+    this->gl->glUseProgram(0);
+
+    Profiler::count(ProfileCounter::PointsDrawn, this->statistics.drawnPixelsCount);
+}
+
+//// getters
+DepthFrameRenderStatistics DepthFrameRenderer::getStatistics()
+{
+    return this->statistics;
+}
+
+// private functions
+size_t DepthFrameRenderer::createBuffer(size_t pixels_capacity)
+{
+    FrameBuffer buffer;
+    buffer.capacity = pixels_capacity;
+    buffer.usedPixels = 0;
+
+    // raw 16-bit depth, one texel per pixel
+    this->gl->glGenBuffers(1, &buffer.depthBuffer);
+    this->gl->glBindBuffer(GL_TEXTURE_BUFFER, buffer.depthBuffer);
+    this->gl->glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(pixels_capacity * sizeof(uint16_t)), nullptr, GL_STATIC_DRAW);
+
+    // BGR bytes as they come from the decoder, three texels per pixel since there is no three-channel buffer format
+    this->gl->glGenBuffers(1, &buffer.colorBuffer);
+    this->gl->glBindBuffer(GL_TEXTURE_BUFFER, buffer.colorBuffer);
+    this->gl->glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(pixels_capacity * 3), nullptr, GL_STATIC_DRAW);
+    this->gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    this->gl->glGenTextures(1, &buffer.depthTexture);
+    this->gl->glBindTexture(GL_TEXTURE_BUFFER, buffer.depthTexture);
+    this->gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, buffer.depthBuffer);
+
+    this->gl->glGenTextures(1, &buffer.colorTexture);
+    this->gl->glBindTexture(GL_TEXTURE_BUFFER, buffer.colorTexture);
+    this->gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_R8, buffer.colorBuffer);
+    this->gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    this->buffers.push_back(buffer);
+
+    return this->buffers.size() - 1;
+}
+
+bool DepthFrameRenderer::reserveRange(QueuedFrame &queued_frame)
+{
+    size_t count = static_cast<size_t>(queued_frame.range.width) * static_cast<size_t>(queued_frame.range.height);
+
+    // the colour buffer holds three texels per pixel, both have to stay within the texel limit
+    size_t capacity = std::max(this->settings.bufferPixelsCapacity, count);
+    capacity = this->maxTexelsCount > 0 ? std::min(capacity, static_cast<size_t>(this->maxTexelsCount) / 3) : capacity;
+
+    if(capacity < count)
+    {
+        std::cerr << "Frame of " << count << " pixels exceeds the texture buffer limit of " << this->maxTexelsCount << " texels, it is skipped" << std::endl;
+        return false;
+    }
+
+    // appended frames fill the last buffer, a new one is allocated once it has no room left
+    if(this->buffers.empty() || this->buffers.back().capacity - this->buffers.back().usedPixels < count)
+    {
+        this->createBuffer(std::max(capacity, count));
+    }
+
+    FrameBuffer &buffer = this->buffers.back();
+
+    queued_frame.range.bufferIndex = this->buffers.size() - 1;
+    queued_frame.range.first = static_cast<GLint>(buffer.usedPixels);
+    queued_frame.reserved = true;
+
+    buffer.usedPixels += count;
+
+    return true;
+}
+
+void DepthFrameRenderer::updateRangeBounds(FrameRange &range)
+{
+    // camera space corners of the image between the depth extremes, x follows the rows and y the columns
+    const float ray_y[2] = { -(0.f - this->intrinsics.cx) / this->intrinsics.focal_x,
+                             -(static_cast<float>(range.width - 1) - this->intrinsics.cx) / this->intrinsics.focal_x };
+    const float ray_x[2] = { (0.f - this->intrinsics.cy) / this->intrinsics.focal_y,
+                             (static_cast<float>(range.height - 1) - this->intrinsics.cy) / this->intrinsics.focal_y };
+    const float depths[2] = { range.minDepth, range.maxDepth };
+
+    bool has_pose = range.frameIndex >= 0 && static_cast<size_t>(range.frameIndex) < this->poseMatrices.size();
+    QMatrix4x4 pose = has_pose ? this->poseMatrices[static_cast<size_t>(range.frameIndex)] : QMatrix4x4();
+
+    // world box around all eight posed corners
+    for(int corner = 0; corner < 8; ++corner)
+    {
+        float d = depths[(corner >> 2) & 1];
+        QVector3D point = pose.map(QVector3D(ray_x[corner & 1] * d, ray_y[(corner >> 1) & 1] * d, d));
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            range.bounds.min[axis] = corner == 0 ? point[axis] : std::min(range.bounds.min[axis], point[axis]);
+            range.bounds.max[axis] = corner == 0 ? point[axis] : std::max(range.bounds.max[axis], point[axis]);
+        }
+    }
+}
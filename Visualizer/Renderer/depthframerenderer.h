@@ -0,0 +1,135 @@
+#ifndef DEPTHFRAMERENDERER_H
+#define DEPTHFRAMERENDERER_H
+
+#include "backprojection.h"
+#include "octree.h"
+#include "streaminguploader.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+#include <deque>
+#include <cstddef>
+
+struct DepthFrameRendererSettings
+{
+    float pointSize;                // pixels
+    size_t bufferPixelsCapacity;    // pixels per depth and colour buffer pair, a frame never spans two buffers
+};
+
+struct DepthFrameRenderStatistics
+{
+    size_t framesCount;
+    size_t pixelsCount;
+    size_t visibleFramesCount;
+    size_t drawnPixelsCount;        // vertices issued, pixels rejected by the depth filter are among them
+    size_t queuedFramesCount;       // waiting for upload, not drawn yet
+};
+
+//// draws raw depth and RGB frames back-projected on the GPU; 16-bit depth and BGR bytes are uploaded into buffer
+//// textures and the vertex shader builds one point per pixel from gl_VertexID, the intrinsics and the frame pose
+class DepthFrameRenderer
+{
+public:
+    // constructors/destructors
+    //// functions of the owning widget, its context has to be current in every call including the destructor
+    DepthFrameRenderer(QOpenGLFunctions_3_3_Core *gl_functions, DepthFrameRendererSettings settings);
+    ~DepthFrameRenderer();
+
+    // public functions
+    bool initialize();
+
+    //// setters, frames drawn from then on use them
+    void setIntrinsics(const CameraIntrinsics &intrinsics);
+    ////// minConfidence is not applied, confidence masks are not uploaded
+    void setDepthFilter(const DepthFilterSettings &settings);
+    ////// camera-to-world poses indexed by frame, see PointCloud::getFramePoses
+    void setPoses(const std::vector<FramePose> &poses);
+
+    void clear();
+
+    //// streaming, frames are appended through the uploader within its frame budget and drawn once complete;
+    //// depth_image is CV_16UC1 and rgb_image CV_8UC3 of the same size, both are only referenced until uploaded
+    void queueFrame(int frame_index, const cv::Mat &depth_image, const cv::Mat &rgb_image);
+    ////// returns false while frames are still queued
+    bool uploadQueuedFrames(StreamingUploader &uploader);
+
+    //// the camera block of RenderState has to hold the same projection and view, they are used here for culling
+    void render(const QMatrix4x4 &projection_matrix, const QMatrix4x4 &view_matrix, const QMatrix4x4 &model_matrix);
+
+    //// getters
+    DepthFrameRenderStatistics getStatistics();
+
+private:
+    struct FrameRange
+    {
+        int frameIndex;
+        int width;
+        int height;
+        float minDepth;             // scene units, of the valid pixels
+        float maxDepth;
+        BoundingBox bounds;         // camera frustum between minDepth and maxDepth in world space
+        size_t bufferIndex;
+        GLint first;                // pixel
+    };
+
+    struct FrameBuffer
+    {
+        GLuint depthBuffer;
+        GLuint colorBuffer;
+        GLuint depthTexture;
+        GLuint colorTexture;
+        size_t capacity;
+        size_t usedPixels;
+    };
+
+    struct QueuedFrame
+    {
+        cv::Mat depthImage;
+        cv::Mat rgbImage;
+        FrameRange range;
+        bool reserved;
+        size_t uploadedDepthPixels;
+        size_t uploadedColorPixels;
+    };
+
+    // private functions
+    size_t createBuffer(size_t pixels_capacity);
+    ////// false for a frame larger than the texture buffers can address, it is never drawn
+    bool reserveRange(QueuedFrame &queued_frame);
+    void updateRangeBounds(FrameRange &range);
+
+    // private variables
+    QOpenGLFunctions_3_3_Core *gl;
+    DepthFrameRendererSettings settings;
+
+    CameraIntrinsics intrinsics;
+    DepthFilterSettings depthFilter;
+    std::vector<QMatrix4x4> poseMatrices;
+
+    QOpenGLShaderProgram *shaderProgram;
+    GLuint vao;                     // core profile draws need one, even without attributes
+    GLint maxTexelsCount;
+    GLint modelMatrixLocation;
+    GLint framePoseLocation;
+    GLint frameOffsetLocation;
+    GLint frameSizeLocation;
+    GLint intrinsicsLocation;
+    GLint depthFilterLocation;
+    GLint rejectInvalidLocation;
+    GLint pointSizeLocation;
+
+    std::vector<FrameBuffer> buffers;
+    std::vector<FrameRange> frames;
+    size_t pixelsCount;
+
+    std::deque<QueuedFrame> queuedFrames;
+
+    DepthFrameRenderStatistics statistics;
+};
+
+#endif // DEPTHFRAMERENDERER_H
@@ -0,0 +1,113 @@
+#include "gpuprofiler.h"
+
+// constructors/destructors
+GpuProfiler::GpuProfiler(QOpenGLFunctions_3_3_Core *gl_functions)
+{
+    this->gl = gl_functions;
+
+    for(int i = 0; i < GpuProfiler::framesCount; ++i)
+    {
+        this->passesCount[i] = 0;
+
+        for(int j = 0; j < GpuProfiler::maxPassesCount; ++j)
+        {
+            this->queries[i][j] = 0;
+        }
+    }
+
+    this->frame = 0;
+    this->passOpen = false;
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    if(this->queries[0][0] != 0)
+    {
+        this->gl->glDeleteQueries(GpuProfiler::framesCount * GpuProfiler::maxPassesCount, &this->queries[0][0]);
+    }
+}
+
+// public functions
+bool GpuProfiler::initialize()
+{
+    this->gl->glGenQueries(GpuProfiler::framesCount * GpuProfiler::maxPassesCount, &this->queries[0][0]);
+
+    return this->gl->glGetError() == GL_NO_ERROR;
+}
+
+void GpuProfiler::beginFrame()
+{
+    if(this->queries[0][0] == 0)
+    {
+        return;
+    }
+
+    // the slot about to be reused was issued framesCount frames ago
+    this->frame = (this->frame + 1) % GpuProfiler::framesCount;
+    this->readFrame(this->frame, false);
+    this->passesCount[this->frame] = 0;
+}
+
+void GpuProfiler::beginPass(ProfileStage stage)
+{
+    int &passes_count = this->passesCount[this->frame];
+
+    if(this->queries[0][0] == 0 || this->passOpen || passes_count == GpuProfiler::maxPassesCount || !Profiler::isEnabled())
+    {
+        return;
+    }
+
+    this->passStages[this->frame][passes_count] = stage;
+    this->gl->glBeginQuery(GL_TIME_ELAPSED, this->queries[this->frame][passes_count]);
+    this->passOpen = true;
+}
+
+void GpuProfiler::endPass()
+{
+    if(!this->passOpen)
+    {
+        return;
+    }
+
+    this->gl->glEndQuery(GL_TIME_ELAPSED);
+    this->passesCount[this->frame] += 1;
+    this->passOpen = false;
+}
+
+void GpuProfiler::finish()
+{
+    if(this->queries[0][0] == 0 || this->passOpen)
+    {
+        return;
+    }
+
+    // oldest first, the current frame last
+    for(int i = 1; i <= GpuProfiler::framesCount; ++i)
+    {
+        int frame = (this->frame + i) % GpuProfiler::framesCount;
+
+        this->readFrame(frame, true);
+        this->passesCount[frame] = 0;
+    }
+}
+
+// private functions
+void GpuProfiler::readFrame(int frame, bool wait)
+{
+    for(int i = 0; i < this->passesCount[frame]; ++i)
+    {
+        GLuint available = 0;
+        this->gl->glGetQueryObjectuiv(this->queries[frame][i], GL_QUERY_RESULT_AVAILABLE, &available);
+
+        // a result still in flight is dropped rather than waited for
+        if(available == 0 && !wait)
+        {
+            continue;
+        }
+
+        GLuint64 elapsed = 0;
+        this->gl->glGetQueryObjectui64v(this->queries[frame][i], GL_QUERY_RESULT, &elapsed);
+
+        Profiler::record(this->passStages[frame][i], static_cast<double>(elapsed) * 1e-6);
+    }
+}
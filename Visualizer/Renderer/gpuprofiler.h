@@ -0,0 +1,48 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include "profiler.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+
+//// GL_TIME_ELAPSED queries around render passes, results are read a few frames later without stalling
+//// and recorded into the Profiler stages of the passes; passes must not nest, GL_TIMESTAMP counters inside them are fine
+class GpuProfiler
+{
+public:
+    // constructors/destructors
+    //// functions of the owning widget, its context has to be current in every call including the destructor
+    GpuProfiler(QOpenGLFunctions_3_3_Core *gl_functions);
+    ~GpuProfiler();
+
+    // public functions
+    bool initialize();
+
+    //// once per frame before the first pass
+    void beginFrame();
+    ////// no-ops while the Profiler is disabled
+    void beginPass(ProfileStage stage);
+    void endPass();
+
+    //// records the passes of every frame still in flight, waiting for their results; offscreen rendering calls it
+    ////// after glFinish so that GPU times land in the same Profiler frame as the CPU side
+    void finish();
+
+private:
+    static const int framesCount = 4;
+    static const int maxPassesCount = 8;
+
+    // private functions
+    void readFrame(int frame, bool wait);
+
+    // private variables
+    QOpenGLFunctions_3_3_Core *gl;
+
+    GLuint queries[framesCount][maxPassesCount];
+    ProfileStage passStages[framesCount][maxPassesCount];
+    int passesCount[framesCount];
+    int frame;
+    bool passOpen;
+};
+
+#endif // GPUPROFILER_H
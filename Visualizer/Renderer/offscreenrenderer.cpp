@@ -0,0 +1,252 @@
+#include "offscreenrenderer.h"
+#include "rendererdefaults.h"
+
+#include <QSurfaceFormat>
+#include <QOpenGLFramebufferObjectFormat>
+#include <QImage>
+#include <QString>
+
+#include <iostream>
+#include <algorithm>
+
+// constructors/destructors
+OffscreenRenderer::OffscreenRenderer(OffscreenRendererSettings settings)
+{
+    this->settings = settings;
+
+    this->context = nullptr;
+    this->surface = nullptr;
+    this->framebuffer = nullptr;
+    this->renderState = nullptr;
+    this->chunkRenderer = nullptr;
+    this->trajectoryPass = nullptr;
+    this->gpuProfiler = nullptr;
+    this->uploader = nullptr;
+    this->pageStreamer = nullptr;
+
+    this->projectionMatrix.setToIdentity();
+    this->projectionMatrix.perspective(this->settings.fieldOfView, static_cast<float>(this->settings.width) / static_cast<float>(std::max(this->settings.height, 1)), 0.05f, 1000.f);
+    this->viewMatrix.setToIdentity();
+    this->modelMatrix.setToIdentity();
+}
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+    // GL objects are released with the context current
+    if(this->context != nullptr && this->surface != nullptr && this->context->makeCurrent(this->surface))
+    {
+        delete this->pageStreamer;
+        delete this->uploader;
+        delete this->gpuProfiler;
+        delete this->trajectoryPass;
+        delete this->chunkRenderer;
+        delete this->renderState;
+        delete this->framebuffer;
+        this->context->doneCurrent();
+    }
+
+    delete this->surface;
+    delete this->context;
+}
+
+// public functions
+bool OffscreenRenderer::initialize()
+{
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+
+    this->context = new QOpenGLContext();
+    this->context->setFormat(format);
+
+    if(!this->context->create())
+    {
+        std::cerr << "Could not create an OpenGL 3.3 core context" << std::endl;
+        return false;
+    }
+
+    this->surface = new QOffscreenSurface();
+    this->surface->setFormat(this->context->format());
+    this->surface->create();
+
+    // the context stays current for the lifetime of the renderer, all calls come from the creating thread
+    if(!this->surface->isValid() || !this->context->makeCurrent(this->surface))
+    {
+        std::cerr << "Could not make the offscreen surface current" << std::endl;
+        return false;
+    }
+
+    initializeOpenGLFunctions();
+
+    QOpenGLFramebufferObjectFormat framebuffer_format;
+    framebuffer_format.setAttachment(QOpenGLFramebufferObject::Depth);
+
+    this->framebuffer = new QOpenGLFramebufferObject(this->settings.width, this->settings.height, framebuffer_format);
+
+    if(!this->framebuffer->isValid())
+    {
+        std::cerr << "Could not create a " << this->settings.width << "x" << this->settings.height << " framebuffer" << std::endl;
+        return false;
+    }
+
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+
+    this->renderState = new RenderState(this);
+    this->gpuProfiler = new GpuProfiler(this);
+
+    // a fixed budget, frame times are what is measured here and must not feed back into the points drawn
+    PointChunkRendererSettings chunk_renderer_settings = RendererDefaults::getPointChunkRendererSettings();
+    chunk_renderer_settings.minPointBudget = this->settings.pointBudget;
+    chunk_renderer_settings.maxPointBudget = this->settings.pointBudget;
+    chunk_renderer_settings.pointSize = this->settings.pointSize;
+    chunk_renderer_settings.renderMode = this->settings.renderMode;
+
+    // only the density of the render mode in use is replaced, the other one stays the widget's
+    if(this->settings.pointsPerPixel > 0.f && this->settings.renderMode == PointRenderMode::Points)
+    {
+        chunk_renderer_settings.pointsPerPixel = this->settings.pointsPerPixel;
+    }
+    else if(this->settings.pointsPerPixel > 0.f)
+    {
+        chunk_renderer_settings.splatPointsPerPixel = this->settings.pointsPerPixel;
+    }
+
+    this->chunkRenderer = new PointChunkRenderer(this, chunk_renderer_settings);
+
+    this->trajectoryPass = new TrajectoryPass(this, RendererDefaults::getTrajectoryPassSettings());
+
+    return this->renderState->initialize() && this->gpuProfiler->initialize()
+           && this->chunkRenderer->initialize() && this->trajectoryPass->initialize();
+}
+
+void OffscreenRenderer::setChunks(const std::vector<PointChunk> &chunks, const std::vector<BoundingBox> &bounds)
+{
+    this->chunkRenderer->setChunks(chunks, bounds);
+}
+
+void OffscreenRenderer::setTrajectory(const std::vector<FramePose> &poses, const CameraIntrinsics &intrinsics)
+{
+    this->trajectoryPass->clear();
+    this->trajectoryPass->setIntrinsics(intrinsics);
+    this->trajectoryPass->appendPoses(poses);
+}
+
+bool OffscreenRenderer::openPageStore(const std::string &path_to_pages, PageStreamerSettings page_streamer_settings)
+{
+    if(this->uploader == nullptr)
+    {
+        // the budget of the widget, so that pages arrive at the same pace
+        this->uploader = new StreamingUploader(this, RendererDefaults::getStreamingUploaderSettings());
+
+        if(!this->uploader->initialize())
+        {
+            return false;
+        }
+    }
+
+    delete this->pageStreamer;
+
+    this->chunkRenderer->clear();
+    this->pageStreamer = new PageStreamer(this->chunkRenderer, page_streamer_settings);
+
+    return this->pageStreamer->open(path_to_pages);
+}
+
+void OffscreenRenderer::setCamera(const FramePose &pose)
+{
+    const float *rotation = pose.rotation;
+
+    // columns of the rotation, the optical axis and the image rows, which point down
+    QVector3D forward(rotation[2], rotation[5], rotation[8]);
+    QVector3D up(-rotation[0], -rotation[3], -rotation[6]);
+    QVector3D eye = QVector3D(pose.translation[0], pose.translation[1], pose.translation[2]) - forward * this->settings.followDistance;
+
+    this->viewMatrix.setToIdentity();
+    this->viewMatrix.lookAt(eye, eye + forward, up);
+}
+
+void OffscreenRenderer::renderFrame()
+{
+    {
+        ScopedTimer frame_timer(ProfileStage::RenderFrame);
+
+        if(this->pageStreamer != nullptr)
+        {
+            ScopedTimer upload_timer(ProfileStage::Upload);
+            this->uploader->beginFrame();
+            this->pageStreamer->update(this->projectionMatrix, this->viewMatrix, this->modelMatrix, *this->uploader);
+        }
+
+        this->framebuffer->bind();
+
+        glViewport(0, 0, this->settings.width, this->settings.height);
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        this->gpuProfiler->beginFrame();
+
+        this->renderState->setCamera(this->projectionMatrix, this->viewMatrix, this->settings.width, this->settings.height);
+
+        this->gpuProfiler->beginPass(ProfileStage::GpuPoints);
+        this->chunkRenderer->render(this->projectionMatrix, this->viewMatrix, this->modelMatrix, this->settings.height);
+        this->gpuProfiler->endPass();
+
+        if(this->settings.showTrajectory)
+        {
+            this->gpuProfiler->beginPass(ProfileStage::GpuOverlay);
+            this->trajectoryPass->render(this->projectionMatrix, this->viewMatrix, this->modelMatrix, this->settings.height);
+            this->gpuProfiler->endPass();
+        }
+    }
+
+    // nothing is presented, without the wait the driver would queue frames and the GPU times would trail behind
+    glFinish();
+    this->gpuProfiler->finish();
+}
+
+bool OffscreenRenderer::saveFrame(const std::string &path_to_image)
+{
+    QImage image;
+
+    {
+        ScopedTimer readback_timer(ProfileStage::Readback);
+        image = this->framebuffer->toImage();
+    }
+
+    if(!image.save(QString::fromStdString(path_to_image)))
+    {
+        std::cerr << "Could not write frame: " << path_to_image.c_str() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+//// getters
+PointChunkRenderStatistics OffscreenRenderer::getRenderStatistics()
+{
+    return this->chunkRenderer->getStatistics();
+}
+
+TrajectoryRenderStatistics OffscreenRenderer::getTrajectoryStatistics()
+{
+    return this->trajectoryPass->getStatistics();
+}
+
+PageStreamerStatistics OffscreenRenderer::getPageStatistics()
+{
+    if(this->pageStreamer == nullptr)
+    {
+        return {};
+    }
+
+    return this->pageStreamer->getStatistics();
+}
+
+std::string OffscreenRenderer::getDeviceName()
+{
+    const GLubyte *renderer = glGetString(GL_RENDERER);
+
+    return renderer != nullptr ? reinterpret_cast<const char *>(renderer) : "";
+}
@@ -0,0 +1,90 @@
+#ifndef OFFSCREENRENDERER_H
+#define OFFSCREENRENDERER_H
+
+#include "renderstate.h"
+#include "pointchunkrenderer.h"
+#include "trajectorypass.h"
+#include "gpuprofiler.h"
+#include "streaminguploader.h"
+#include "pagestreamer.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QOpenGLFramebufferObject>
+#include <QMatrix4x4>
+#include <QVector3D>
+
+#include <vector>
+#include <string>
+
+struct OffscreenRendererSettings
+{
+    int width;                      // pixels of the framebuffer
+    int height;
+    float fieldOfView;              // vertical, degrees
+    float followDistance;           // the camera is moved back along its optical axis, 0 - the view of the pose
+    size_t pointBudget;             // points drawn per frame, fixed so that runs stay comparable
+    float pointsPerPixel;           // see PointChunkRendererSettings, for the render mode in use, 0 - as in the widget
+    float pointSize;                // pixels
+    PointRenderMode renderMode;
+    bool showTrajectory;
+};
+
+//// renders spatial chunks and the camera path into a framebuffer object of an offscreen surface, no window
+//// or display needed, e.g. QT_QPA_PLATFORM=offscreen with Mesa llvmpipe; frames are timed like the widget ones:
+//// RenderFrame for the submission, GpuPoints and GpuOverlay for the passes and Readback for saved frames
+class OffscreenRenderer : protected QOpenGLFunctions_3_3_Core
+{
+public:
+    // constructors/destructors
+    //// needs a QGuiApplication
+    OffscreenRenderer(OffscreenRendererSettings settings);
+    ~OffscreenRenderer();
+
+    // public functions
+    bool initialize();
+
+    //// see SpatialChunker, the chunks are uploaded at once
+    void setChunks(const std::vector<PointChunk> &chunks, const std::vector<BoundingBox> &bounds);
+    //// camera-to-world poses in capture order, drawn when OffscreenRendererSettings::showTrajectory is set
+    void setTrajectory(const std::vector<FramePose> &poses, const CameraIntrinsics &intrinsics);
+    //// draws a page store instead of set chunks, pages are streamed in for every rendered frame within the budgets
+    bool openPageStore(const std::string &path_to_pages, PageStreamerSettings page_streamer_settings);
+
+    //// camera-to-world pose, the view looks along its optical axis with image rows pointing down
+    void setCamera(const FramePose &pose);
+
+    //// draws one frame and waits for the GPU, so that its times belong to the Profiler frame being recorded
+    void renderFrame();
+    ////// the last rendered frame, the format follows the file extension
+    bool saveFrame(const std::string &path_to_image);
+
+    //// getters
+    PointChunkRenderStatistics getRenderStatistics();
+    TrajectoryRenderStatistics getTrajectoryStatistics();
+    PageStreamerStatistics getPageStatistics();
+    ////// GL_RENDERER of the context, e.g. to tell a software rasterizer in reports
+    std::string getDeviceName();
+
+private:
+    // private variables
+    OffscreenRendererSettings settings;
+
+    QOpenGLContext *context;
+    QOffscreenSurface *surface;
+    QOpenGLFramebufferObject *framebuffer;
+
+    RenderState *renderState;
+    PointChunkRenderer *chunkRenderer;
+    TrajectoryPass *trajectoryPass;
+    GpuProfiler *gpuProfiler;
+    StreamingUploader *uploader;            // page streaming only
+    PageStreamer *pageStreamer;
+
+    QMatrix4x4 projectionMatrix;
+    QMatrix4x4 viewMatrix;
+    QMatrix4x4 modelMatrix;
+};
+
+#endif // OFFSCREENRENDERER_H
@@ -0,0 +1,182 @@
+#include "overlaypass.h"
+#include "renderstate.h"
+
+#include <cstddef>
+
+// constructors/destructors
+OverlayPass::OverlayPass(QOpenGLFunctions_3_3_Core *gl_functions)
+{
+    this->gl = gl_functions;
+
+    this->shaderProgram = nullptr;
+    this->modelMatrixLocation = -1;
+
+    this->vao = 0;
+    this->vbo = 0;
+    this->capacity = 0;
+
+    this->layersChanged = false;
+}
+
+OverlayPass::~OverlayPass()
+{
+    if(this->vao != 0)
+    {
+        this->gl->glDeleteVertexArrays(1, &this->vao);
+        this->gl->glDeleteBuffers(1, &this->vbo);
+    }
+
+    delete this->shaderProgram;
+}
+
+// public functions
+bool OverlayPass::initialize()
+{
+    this->shaderProgram = RenderState::createProgram(this->gl, "Visualizer/Shaders/OverlayVertexShader.vert", "Visualizer/Shaders/OverlayFragmentShader.frag");
+
+    if(this->shaderProgram == nullptr)
+    {
+        return false;
+    }
+
+    this->modelMatrixLocation = this->gl->glGetUniformLocation(this->shaderProgram->programId(), "model");
+
+    this->gl->glGenVertexArrays(1, &this->vao);
+    this->gl->glBindVertexArray(this->vao);
+
+    this->gl->glGenBuffers(1, &this->vbo);
+    this->gl->glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+
+    this->gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), reinterpret_cast<const void *>(offsetof(OverlayVertex, position)));
+    this->gl->glEnableVertexAttribArray(0);
+    this->gl->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), reinterpret_cast<const void *>(offsetof(OverlayVertex, color)));
+    this->gl->glEnableVertexAttribArray(1);
+
+    this->gl->glBindVertexArray(0);
+    this->gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return true;
+}
+
+void OverlayPass::setLines(size_t layer, const std::vector<OverlayVertex> &vertices)
+{
+    if(layer >= this->layers.size())
+    {
+        this->layers.resize(layer + 1, { {}, 0, true });
+    }
+
+    this->layers[layer].vertices = vertices;
+    this->layersChanged = true;
+}
+
+void OverlayPass::setLayerVisible(size_t layer, bool visible)
+{
+    if(layer < this->layers.size())
+    {
+        this->layers[layer].visible = visible;
+    }
+}
+
+void OverlayPass::draw(const QMatrix4x4 &model_matrix)
+{
+    if(this->shaderProgram == nullptr)
+    {
+        return;
+    }
+
+    this->bind(model_matrix);
+
+    // runs of visible layers are contiguous in the buffer and go out as one call
+    GLint run_first = 0;
+    GLsizei run_count = 0;
+
+    for(const OverlayLayer &layer : this->layers)
+    {
+        GLsizei count = static_cast<GLsizei>(layer.vertices.size());
+
+        if(layer.visible && count > 0)
+        {
+            if(run_count == 0)
+            {
+                run_first = layer.first;
+            }
+
+            run_count += count;
+            continue;
+        }
+
+        if(!layer.visible && run_count > 0)
+        {
+            this->gl->glDrawArrays(GL_LINES, run_first, run_count);
+            run_count = 0;
+        }
+    }
+
+    if(run_count > 0)
+    {
+        this->gl->glDrawArrays(GL_LINES, run_first, run_count);
+    }
+
+    this->gl->glBindVertexArray(0);
+    this->gl->glUseProgram(0);
+}
+
+void OverlayPass::drawLayer(const QMatrix4x4 &model_matrix, size_t layer)
+{
+    if(this->shaderProgram == nullptr || layer >= this->layers.size() || this->layers[layer].vertices.empty())
+    {
+        return;
+    }
+
+    this->bind(model_matrix);
+
+    this->gl->glDrawArrays(GL_LINES, this->layers[layer].first, static_cast<GLsizei>(this->layers[layer].vertices.size()));
+
+    this->gl->glBindVertexArray(0);
+    this->gl->glUseProgram(0);
+}
+
+// private functions
+void OverlayPass::upload()
+{
+    size_t vertices_count = 0;
+
+    for(OverlayLayer &layer : this->layers)
+    {
+        layer.first = static_cast<GLint>(vertices_count);
+        vertices_count += layer.vertices.size();
+    }
+
+    this->gl->glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+
+    if(vertices_count > this->capacity)
+    {
+        this->capacity = vertices_count;
+        this->gl->glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(this->capacity * sizeof(OverlayVertex)), nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    for(const OverlayLayer &layer : this->layers)
+    {
+        if(!layer.vertices.empty())
+        {
+            this->gl->glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(layer.first * sizeof(OverlayVertex)),
+                                      static_cast<GLsizeiptr>(layer.vertices.size() * sizeof(OverlayVertex)), layer.vertices.data());
+        }
+    }
+
+    this->gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    this->layersChanged = false;
+}
+
+void OverlayPass::bind(const QMatrix4x4 &model_matrix)
+{
+    if(this->layersChanged)
+    {
+        this->upload();
+    }
+
+    this->gl->glUseProgram(this->shaderProgram->programId());
+    this->gl->glUniformMatrix4fv(this->modelMatrixLocation, 1, GL_FALSE, model_matrix.constData());
+    this->gl->glBindVertexArray(this->vao);
+}
@@ -0,0 +1,64 @@
+#ifndef OVERLAYPASS_H
+#define OVERLAYPASS_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+
+#include <vector>
+
+struct OverlayVertex
+{
+    float position[3];
+    float color[3];                 // 0 - 1
+};
+
+//// line overlays such as the grid, axes and trajectory; all layers share one program and one vertex buffer,
+//// adjacent visible layers are drawn with a single call
+class OverlayPass
+{
+public:
+    // constructors/destructors
+    //// functions of the owning widget, its context has to be current in every call including the destructor
+    OverlayPass(QOpenGLFunctions_3_3_Core *gl_functions);
+    ~OverlayPass();
+
+    // public functions
+    bool initialize();
+
+    //// layers are numbered by the caller, every pair of vertices is one segment; uploaded on the next draw
+    void setLines(size_t layer, const std::vector<OverlayVertex> &vertices);
+    void setLayerVisible(size_t layer, bool visible);
+
+    //// draws all visible layers
+    void draw(const QMatrix4x4 &model_matrix);
+    //// draws one layer regardless of its visibility
+    void drawLayer(const QMatrix4x4 &model_matrix, size_t layer);
+
+private:
+    struct OverlayLayer
+    {
+        std::vector<OverlayVertex> vertices;
+        GLint first;
+        bool visible;
+    };
+
+    // private functions
+    void upload();
+    void bind(const QMatrix4x4 &model_matrix);
+
+    // private variables
+    QOpenGLFunctions_3_3_Core *gl;
+
+    QOpenGLShaderProgram *shaderProgram;
+    GLint modelMatrixLocation;
+
+    GLuint vao;
+    GLuint vbo;
+    size_t capacity;                // vertices the buffer holds before it is reallocated
+
+    std::vector<OverlayLayer> layers;
+    bool layersChanged;
+};
+
+#endif // OVERLAYPASS_H
@@ -0,0 +1,273 @@
+#include "pagestreamer.h"
+
+#include <QVector3D>
+
+#include <algorithm>
+#include <cmath>
+
+// constructors/destructors
+PageStreamer::PageStreamer(PointChunkRenderer *chunk_renderer, PageStreamerSettings settings)
+{
+    this->chunkRenderer = chunk_renderer;
+    this->settings = settings;
+
+    PageCacheSettings cache_settings;
+    cache_settings.hostBudgetBytes = settings.hostBudgetBytes;
+    cache_settings.loaderThreadsCount = settings.loaderThreadsCount;
+
+    this->pageStore = new PageStore();
+    this->pageCache = new PageCache(cache_settings);
+
+    this->frame = 0;
+    this->gpuBytes = 0;
+    this->statistics = PageStreamerStatistics();
+}
+
+PageStreamer::~PageStreamer()
+{
+    this->close();
+
+    delete this->pageCache;
+    delete this->pageStore;
+}
+
+// public functions
+bool PageStreamer::open(const std::string &path_to_pages)
+{
+    this->close();
+
+    if(!this->pageStore->open(path_to_pages))
+    {
+        return false;
+    }
+
+    size_t pages_count = this->pageStore->getPages().size();
+
+    this->frame = 0;
+    this->lastWanted.assign(pages_count, 0);
+    this->onGpu.assign(pages_count, false);
+    this->gpuPages.clear();
+    this->gpuBytes = 0;
+
+    this->statistics = PageStreamerStatistics();
+    this->statistics.pagesCount = pages_count;
+
+    this->pageCache->start(this->pageStore);
+
+    return true;
+}
+
+void PageStreamer::close()
+{
+    if(!this->pageStore->isOpen())
+    {
+        return;
+    }
+
+    for(size_t page : this->gpuPages)
+    {
+        this->chunkRenderer->removeChunk(static_cast<int>(page));
+    }
+
+    this->pageCache->stop();
+    this->pageStore->close();
+
+    std::vector<uint64_t>().swap(this->lastWanted);
+    std::vector<bool>().swap(this->onGpu);
+    std::vector<PagePriority>().swap(this->priorities);
+    this->gpuPages.clear();
+    this->gpuBytes = 0;
+
+    this->statistics = PageStreamerStatistics();
+}
+
+bool PageStreamer::isOpen()
+{
+    return this->pageStore->isOpen();
+}
+
+void PageStreamer::update(const QMatrix4x4 &projection_matrix, const QMatrix4x4 &view_matrix, const QMatrix4x4 &model_matrix, StreamingUploader &uploader)
+{
+    if(!this->pageStore->isOpen())
+    {
+        return;
+    }
+
+    const std::vector<PageEntry> &pages = this->pageStore->getPages();
+
+    this->frame += 1;
+
+    // page bounds live in model space like the chunk ones, see PointChunkRenderer::render
+    QMatrix4x4 model_view_projection = projection_matrix * view_matrix * model_matrix;
+    Frustum frustum = Frustum::fromMatrix(model_view_projection.constData());
+
+    QVector3D eye = (view_matrix * model_matrix).inverted().map(QVector3D(0.f, 0.f, 0.f));
+    const float eye_position[3] = { eye.x(), eye.y(), eye.z() };
+
+    // pages outside of the frustum follow the visible ones, nearest first, so turning around finds them loaded
+    const double outside_offset = 1e12;
+
+    this->priorities.resize(pages.size());
+    this->statistics.visiblePagesCount = 0;
+
+    size_t total_bytes = 0;
+
+    for(size_t i = 0; i < pages.size(); ++i)
+    {
+        const BoundingBox &bounds = pages[i].bounds;
+        double distance_squared = 0.0;
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            float outside = std::max(bounds.min[axis] - eye_position[axis], eye_position[axis] - bounds.max[axis]);
+            distance_squared += outside > 0.f ? static_cast<double>(outside) * outside : 0.0;
+        }
+
+        bool visible = frustum.intersects(bounds);
+
+        this->priorities[i].key = std::sqrt(distance_squared) + (visible ? 0.0 : outside_offset);
+        this->priorities[i].page = i;
+
+        this->statistics.visiblePagesCount += visible ? 1 : 0;
+        total_bytes += this->getPageBytes(i);
+    }
+
+    // only the leading pages fitting into the budgets are ordered, twice the average count leaves room for small ones
+    size_t average_bytes = std::max<size_t>(1, total_bytes / std::max<size_t>(1, pages.size()));
+    size_t budget_pages = std::min(pages.size(), 2 * (std::max(this->settings.hostBudgetBytes, this->settings.gpuBudgetBytes) / average_bytes) + 16);
+
+    auto closer = [](const PagePriority &first, const PagePriority &second)
+    {
+        return first.key < second.key;
+    };
+
+    std::nth_element(this->priorities.begin(), this->priorities.begin() + static_cast<std::ptrdiff_t>(budget_pages), this->priorities.end(), closer);
+    std::sort(this->priorities.begin(), this->priorities.begin() + static_cast<std::ptrdiff_t>(budget_pages), closer);
+
+    this->requestedPages.clear();
+
+    size_t requested_bytes = 0;
+    size_t wanted_bytes = 0;
+    size_t wanted_count = 0;
+
+    for(size_t i = 0; i < budget_pages; ++i)
+    {
+        size_t page = this->priorities[i].page;
+        size_t bytes = this->getPageBytes(page);
+
+        if(requested_bytes + bytes > this->settings.hostBudgetBytes && !this->requestedPages.empty())
+        {
+            break;
+        }
+
+        requested_bytes += bytes;
+        this->requestedPages.push_back(page);
+
+        if(wanted_count == i && (wanted_bytes + bytes <= this->settings.gpuBudgetBytes || wanted_count == 0))
+        {
+            wanted_bytes += bytes;
+            wanted_count += 1;
+            this->lastWanted[page] = this->frame;
+        }
+    }
+
+    this->pageCache->request(this->requestedPages);
+
+    // resident wanted pages go to the GPU in priority order, copies waiting for upload stay within one frame budget
+    size_t upload_budget = uploader.getRemainingBudget();
+    size_t queued_bytes = 0;
+    size_t pending_count = 0;
+
+    for(size_t i = 0; i < wanted_count; ++i)
+    {
+        size_t page = this->requestedPages[i];
+
+        if(this->onGpu[page])
+        {
+            continue;
+        }
+
+        pending_count += 1;
+
+        size_t bytes = this->getPageBytes(page);
+
+        if(queued_bytes >= upload_budget || !this->pageCache->isResident(page))
+        {
+            continue;
+        }
+
+        while(this->gpuBytes + bytes > this->settings.gpuBudgetBytes && this->evictGpuPage())
+        {
+        }
+
+        PointChunk chunk;
+
+        if((this->gpuBytes + bytes > this->settings.gpuBudgetBytes && !this->gpuPages.empty()) || !this->pageCache->copyPage(page, chunk))
+        {
+            continue;
+        }
+
+        this->chunkRenderer->queueChunk(std::move(chunk), pages[page].bounds, -1, static_cast<int>(page));
+
+        this->onGpu[page] = true;
+        this->gpuPages.push_back(page);
+        this->gpuBytes += bytes;
+        queued_bytes += bytes;
+    }
+
+    this->chunkRenderer->uploadQueuedChunks(uploader);
+
+    this->statistics.requestedPagesCount = this->requestedPages.size();
+    this->statistics.wantedPagesCount = wanted_count;
+    this->statistics.pendingPagesCount = pending_count;
+    this->statistics.gpuPagesCount = this->gpuPages.size();
+    this->statistics.gpuBytes = this->gpuBytes;
+}
+
+//// getters
+PageStreamerStatistics PageStreamer::getStatistics()
+{
+    this->statistics.cache = this->pageCache->getStatistics();
+
+    return this->statistics;
+}
+
+// private functions
+bool PageStreamer::evictGpuPage()
+{
+    size_t evicted = this->gpuPages.size();
+    uint64_t oldest_frame = this->frame;
+
+    for(size_t i = 0; i < this->gpuPages.size(); ++i)
+    {
+        uint64_t wanted_frame = this->lastWanted[this->gpuPages[i]];
+
+        if(wanted_frame < oldest_frame)
+        {
+            oldest_frame = wanted_frame;
+            evicted = i;
+        }
+    }
+
+    if(evicted == this->gpuPages.size())
+    {
+        return false;
+    }
+
+    size_t page = this->gpuPages[evicted];
+
+    this->chunkRenderer->removeChunk(static_cast<int>(page));
+
+    this->gpuPages[evicted] = this->gpuPages.back();
+    this->gpuPages.pop_back();
+    this->onGpu[page] = false;
+    this->gpuBytes -= this->getPageBytes(page);
+    this->statistics.gpuEvictedPagesCount += 1;
+
+    return true;
+}
+
+size_t PageStreamer::getPageBytes(size_t page)
+{
+    return static_cast<size_t>(this->pageStore->getPages()[page].pointsCount) * sizeof(CompactPoint);
+}
@@ -0,0 +1,92 @@
+#ifndef PAGESTREAMER_H
+#define PAGESTREAMER_H
+
+#include "pagestore.h"
+#include "pagecache.h"
+#include "pointchunkrenderer.h"
+#include "streaminguploader.h"
+
+#include <QMatrix4x4>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+struct PageStreamerSettings
+{
+    size_t hostBudgetBytes;         // pages kept in memory, see PageCache
+    size_t gpuBudgetBytes;          // pages kept in the vertex buffers of the chunk renderer
+    unsigned int loaderThreadsCount;
+};
+
+struct PageStreamerStatistics
+{
+    size_t pagesCount;
+    size_t visiblePagesCount;
+    size_t requestedPagesCount;     // fitting into the host budget, most important first
+    size_t wantedPagesCount;        // fitting into the GPU budget
+    size_t pendingPagesCount;       // wanted but not on the GPU yet, still loading or queued
+    size_t gpuPagesCount;
+    size_t gpuBytes;
+    size_t gpuEvictedPagesCount;
+    PageCacheStatistics cache;
+};
+
+//// draws a PageStore larger than host and GPU memory through a PointChunkRenderer; every frame pages are prioritized,
+//// visible ones by distance to the eye before the rest, the leading ones fitting into the budgets are requested from
+//// the PageCache and resident ones are queued for upload, the least recently wanted pages make room on the GPU
+class PageStreamer
+{
+public:
+    // constructors/destructors
+    //// the chunk renderer is used for pages only while a store is open
+    PageStreamer(PointChunkRenderer *chunk_renderer, PageStreamerSettings settings);
+    ~PageStreamer();
+
+    // public functions
+    bool open(const std::string &path_to_pages);
+    //// removes the pages from the chunk renderer, its context has to be current
+    void close();
+    bool isOpen();
+
+    //// once per frame on the render thread before drawing, after StreamingUploader::beginFrame; never waits for I/O,
+    ////// resident pages are copied for upload only up to the remaining budget of the uploader
+    void update(const QMatrix4x4 &projection_matrix, const QMatrix4x4 &view_matrix, const QMatrix4x4 &model_matrix, StreamingUploader &uploader);
+
+    //// getters
+    PageStreamerStatistics getStatistics();
+
+private:
+    struct PagePriority
+    {
+        double key;                 // distance to the eye, pages outside of the frustum after all visible ones
+        size_t page;
+    };
+
+    // private functions
+    ////// evicts the least recently wanted page not wanted this frame, false if there is none
+    bool evictGpuPage();
+    size_t getPageBytes(size_t page);
+
+    // private variables
+    PointChunkRenderer *chunkRenderer;
+    PageStreamerSettings settings;
+
+    PageStore *pageStore;
+    PageCache *pageCache;
+
+    uint64_t frame;
+    std::vector<uint64_t> lastWanted;   // frame in which the page was last wanted on the GPU
+    std::vector<bool> onGpu;            // queued or uploaded
+    std::vector<size_t> gpuPages;
+    size_t gpuBytes;
+
+    //// per frame
+    std::vector<PagePriority> priorities;
+    std::vector<size_t> requestedPages;
+
+    PageStreamerStatistics statistics;
+};
+
+#endif // PAGESTREAMER_H
@@ -0,0 +1,789 @@
+#include "pointchunkrenderer.h"
+#include "renderstate.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstddef>
+
+// constructors/destructors
+PointChunkRenderer::PointChunkRenderer(QOpenGLFunctions_3_3_Core *gl_functions, PointChunkRendererSettings settings)
+{
+    this->gl = gl_functions;
+    this->settings = settings;
+
+    for(PointProgram &program : this->programs)
+    {
+        program = { nullptr, -1, -1, -1, -1, -1, -1 };
+    }
+
+    this->pointsCount = 0;
+
+    for(int i = 0; i < PointChunkRenderer::timerFramesCount; ++i)
+    {
+        this->timerQueries[i][0] = 0;
+        this->timerQueries[i][1] = 0;
+        this->timerPending[i] = false;
+    }
+
+    this->timerFrame = 0;
+
+    // start low, the budget grows within a few frames while the GPU keeps up
+    this->pointBudget = static_cast<float>(std::max(this->settings.minPointBudget, this->settings.maxPointBudget / 8));
+    this->budgetLimited = false;
+
+    this->statistics = {};
+    this->statistics.pointBudget = static_cast<size_t>(this->pointBudget);
+}
+
+PointChunkRenderer::~PointChunkRenderer()
+{
+    this->clear();
+
+    if(this->timerQueries[0][0] != 0)
+    {
+        this->gl->glDeleteQueries(2 * PointChunkRenderer::timerFramesCount, &this->timerQueries[0][0]);
+    }
+
+    for(PointProgram &program : this->programs)
+    {
+        delete program.shaderProgram;
+    }
+}
+
+// public functions
+bool PointChunkRenderer::initialize()
+{
+    bool created = this->createProgram(PointRenderMode::Points, "Visualizer/Shaders/PointCloudVertexShader.vert", "Visualizer/Shaders/PointCloudFragmentShader.frag")
+                   && this->createProgram(PointRenderMode::Splats, "Visualizer/Shaders/PointSplatVertexShader.vert", "Visualizer/Shaders/PointSplatFragmentShader.frag")
+                   && this->createProgram(PointRenderMode::DepthSplats, "Visualizer/Shaders/PointSplatVertexShader.vert", "Visualizer/Shaders/PointSplatDepthFragmentShader.frag");
+
+    if(!created)
+    {
+        return false;
+    }
+
+    this->gl->glGenQueries(2 * PointChunkRenderer::timerFramesCount, &this->timerQueries[0][0]);
+
+    return true;
+}
+
+void PointChunkRenderer::setChunks(const std::vector<PointChunk> &chunks, const std::vector<BoundingBox> &bounds)
+{
+    this->clear();
+
+    // assign chunks to buffers first so every buffer is allocated once with its final size
+    std::vector<size_t> buffer_sizes;
+    std::vector<size_t> chunk_indexes;
+
+    for(size_t i = 0; i < chunks.size() && i < bounds.size(); ++i)
+    {
+        size_t count = chunks[i].points.size();
+
+        if(count == 0)
+        {
+            continue;
+        }
+
+        if(buffer_sizes.empty() || buffer_sizes.back() + count > this->settings.bufferPointsCapacity)
+        {
+            buffer_sizes.push_back(0);
+        }
+
+        ChunkRange range = this->getChunkRange(chunks[i], bounds[i], -1);
+        range.bufferIndex = buffer_sizes.size() - 1;
+        range.first = static_cast<GLint>(buffer_sizes.back());
+
+        buffer_sizes.back() += count;
+
+        this->chunks.push_back(range);
+        chunk_indexes.push_back(i);
+        this->pointsCount += count;
+    }
+
+    for(size_t buffer_size : buffer_sizes)
+    {
+        size_t buffer_index = this->createBuffer(buffer_size);
+        this->buffers[buffer_index].usedPoints = buffer_size;
+    }
+
+    for(size_t i = 0; i < this->chunks.size(); ++i)
+    {
+        const ChunkRange &range = this->chunks[i];
+        const PointChunk &chunk = chunks[chunk_indexes[i]];
+
+        this->gl->glBindBuffer(GL_ARRAY_BUFFER, this->buffers[range.bufferIndex].vbo);
+        this->gl->glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(range.first) * sizeof(CompactPoint),
+                                  static_cast<GLsizeiptr>(range.count) * sizeof(CompactPoint), chunk.points.data());
+
+        Profiler::count(ProfileCounter::BytesUploaded, static_cast<uint64_t>(range.count) * sizeof(CompactPoint));
+    }
+
+    this->gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    this->statistics.chunksCount = this->chunks.size();
+    this->statistics.pointsCount = this->pointsCount;
+}
+
+void PointChunkRenderer::clear()
+{
+    for(ChunkBuffer &buffer : this->buffers)
+    {
+        this->gl->glDeleteVertexArrays(1, &buffer.vao);
+        this->gl->glDeleteBuffers(1, &buffer.vbo);
+    }
+
+    this->buffers.clear();
+    this->chunks.clear();
+    this->queuedChunks.clear();
+    this->pointsCount = 0;
+
+    this->statistics.chunksCount = 0;
+    this->statistics.pointsCount = 0;
+    this->statistics.queuedChunksCount = 0;
+}
+
+void PointChunkRenderer::queueChunk(PointChunk &&chunk, int pose_index)
+{
+    if(chunk.points.empty())
+    {
+        return;
+    }
+
+    // tight bounds from the quantized extent
+    int16_t min_steps[3] = { chunk.points[0].x, chunk.points[0].y, chunk.points[0].z };
+    int16_t max_steps[3] = { chunk.points[0].x, chunk.points[0].y, chunk.points[0].z };
+
+    for(const CompactPoint &point : chunk.points)
+    {
+        min_steps[0] = std::min(min_steps[0], point.x);
+        min_steps[1] = std::min(min_steps[1], point.y);
+        min_steps[2] = std::min(min_steps[2], point.z);
+        max_steps[0] = std::max(max_steps[0], point.x);
+        max_steps[1] = std::max(max_steps[1], point.y);
+        max_steps[2] = std::max(max_steps[2], point.z);
+    }
+
+    BoundingBox bounds;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        bounds.min[axis] = chunk.origin[axis] + min_steps[axis] * chunk.scale;
+        bounds.max[axis] = chunk.origin[axis] + max_steps[axis] * chunk.scale;
+    }
+
+    this->queueChunk(std::move(chunk), bounds, pose_index);
+}
+
+void PointChunkRenderer::queueChunk(PointChunk &&chunk, const BoundingBox &bounds, int pose_index, int chunk_id)
+{
+    if(chunk.points.empty())
+    {
+        return;
+    }
+
+    QueuedChunk queued_chunk;
+    queued_chunk.chunk = std::move(chunk);
+    queued_chunk.bounds = bounds;
+    queued_chunk.poseIndex = pose_index;
+    queued_chunk.id = chunk_id;
+    queued_chunk.reserved = false;
+    queued_chunk.uploadedPoints = 0;
+
+    // a prime stride not dividing the count visits every point once
+    const size_t strides[] = { 7919, 104729, 1299709 };
+    size_t count = queued_chunk.chunk.points.size();
+    queued_chunk.stride = 1;
+
+    for(size_t stride : strides)
+    {
+        if(count % stride != 0)
+        {
+            queued_chunk.stride = stride % count;
+            break;
+        }
+    }
+
+    this->queuedChunks.push_back(std::move(queued_chunk));
+    this->statistics.queuedChunksCount = this->queuedChunks.size();
+}
+
+bool PointChunkRenderer::uploadQueuedChunks(StreamingUploader &uploader)
+{
+    while(!this->queuedChunks.empty())
+    {
+        QueuedChunk &queued_chunk = this->queuedChunks.front();
+
+        if(!queued_chunk.reserved)
+        {
+            this->reserveRange(queued_chunk);
+        }
+
+        const ChunkRange &range = queued_chunk.range;
+        const CompactPoint *source = queued_chunk.chunk.points.data();
+        const size_t count = static_cast<size_t>(range.count);
+        const size_t stride = queued_chunk.stride;
+        const size_t uploaded_points = queued_chunk.uploadedPoints;
+
+        size_t uploaded = uploader.upload(this->buffers[range.bufferIndex].vbo, (static_cast<size_t>(range.first) + uploaded_points) * sizeof(CompactPoint),
+                                          count - uploaded_points, sizeof(CompactPoint),
+                                          [source, count, stride, uploaded_points](void *destination, size_t first_element, size_t elements_count)
+        {
+            CompactPoint *output = static_cast<CompactPoint *>(destination);
+            size_t index = ((uploaded_points + first_element) % count) * stride % count;
+
+            for(size_t i = 0; i < elements_count; ++i)
+            {
+                output[i] = source[index];
+
+                index += stride;
+                index = index >= count ? index - count : index;
+            }
+        });
+
+        queued_chunk.uploadedPoints += uploaded;
+
+        if(queued_chunk.uploadedPoints < count)
+        {
+            return false;
+        }
+
+        this->chunks.push_back(range);
+        this->pointsCount += count;
+        this->queuedChunks.pop_front();
+
+        this->statistics.chunksCount = this->chunks.size();
+        this->statistics.pointsCount = this->pointsCount;
+        this->statistics.queuedChunksCount = this->queuedChunks.size();
+    }
+
+    return true;
+}
+
+bool PointChunkRenderer::removeChunk(int chunk_id)
+{
+    if(chunk_id < 0)
+    {
+        return false;
+    }
+
+    for(auto it = this->queuedChunks.begin(); it != this->queuedChunks.end(); ++it)
+    {
+        if(it->id == chunk_id)
+        {
+            // copies into a reserved range are already ordered before any later reuse of it
+            if(it->reserved)
+            {
+                this->releaseRange(it->range);
+            }
+
+            this->queuedChunks.erase(it);
+            this->statistics.queuedChunksCount = this->queuedChunks.size();
+
+            return true;
+        }
+    }
+
+    for(size_t i = 0; i < this->chunks.size(); ++i)
+    {
+        if(this->chunks[i].id == chunk_id)
+        {
+            this->releaseRange(this->chunks[i]);
+            this->pointsCount -= static_cast<size_t>(this->chunks[i].count);
+
+            this->chunks[i] = this->chunks.back();
+            this->chunks.pop_back();
+
+            this->statistics.chunksCount = this->chunks.size();
+            this->statistics.pointsCount = this->pointsCount;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void PointChunkRenderer::setPoses(const std::vector<FramePose> &poses)
+{
+    this->poseMatrices.resize(poses.size());
+
+    for(size_t i = 0; i < poses.size(); ++i)
+    {
+        const float *r = poses[i].rotation;
+        const float *t = poses[i].translation;
+
+        this->poseMatrices[i] = QMatrix4x4(r[0], r[1], r[2], t[0],
+                                           r[3], r[4], r[5], t[1],
+                                           r[6], r[7], r[8], t[2],
+                                           0.f , 0.f , 0.f , 1.f);
+    }
+
+    // only the culling bounds follow, the points stay where they are in the buffers
+    for(ChunkRange &range : this->chunks)
+    {
+        if(range.poseIndex >= 0)
+        {
+            this->updateRangeBounds(range);
+        }
+    }
+}
+
+void PointChunkRenderer::setRenderMode(PointRenderMode render_mode)
+{
+    this->settings.renderMode = render_mode;
+}
+
+void PointChunkRenderer::render(const QMatrix4x4 &projection_matrix, const QMatrix4x4 &view_matrix, const QMatrix4x4 &model_matrix, int viewport_height)
+{
+    this->readFrameTimers();
+
+    this->statistics.visibleChunksCount = 0;
+    this->statistics.drawnPointsCount = 0;
+    this->statistics.pointBudget = static_cast<size_t>(this->pointBudget);
+
+    const PointProgram &program = this->programs[static_cast<int>(this->settings.renderMode)];
+    bool splats = this->settings.renderMode != PointRenderMode::Points;
+
+    if(program.shaderProgram == nullptr || this->chunks.empty())
+    {
+        return;
+    }
+
+    // chunk bounds live in model space, test them against the frustum and eye brought into that space
+    QMatrix4x4 model_view_projection = projection_matrix * view_matrix * model_matrix;
+    Frustum frustum = Frustum::fromMatrix(model_view_projection.constData());
+
+    QVector3D eye = (view_matrix * model_matrix).inverted().map(QVector3D(0.f, 0.f, 0.f));
+
+    // pixels covered by a unit radius at unit distance
+    const float pixels_per_unit = 0.5f * static_cast<float>(viewport_height) * projection_matrix(1, 1);
+    const float pi = 3.14159265f;
+    const float points_per_pixel = splats ? this->settings.splatPointsPerPixel : this->settings.pointsPerPixel;
+
+    this->visibleChunks.clear();
+    this->wantedCounts.clear();
+
+    float wanted_total = 0.f;
+
+    for(size_t i = 0; i < this->chunks.size(); ++i)
+    {
+        const ChunkRange &range = this->chunks[i];
+
+        if(!frustum.intersects(range.bounds))
+        {
+            continue;
+        }
+
+        float dx = range.center[0] - eye.x();
+        float dy = range.center[1] - eye.y();
+        float dz = range.center[2] - eye.z();
+        float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - range.radius;
+
+        float wanted = static_cast<float>(range.count);
+
+        // the eye inside the bounding sphere sees the whole chunk up close
+        if(distance > 0.f)
+        {
+            float projected_radius = range.radius / distance * pixels_per_unit;
+            wanted = std::min(wanted, std::max(1.f, points_per_pixel * pi * projected_radius * projected_radius));
+        }
+
+        this->visibleChunks.push_back(i);
+        this->wantedCounts.push_back(wanted);
+        wanted_total += wanted;
+    }
+
+    // every chunk gives up the same share of its points, so the budget follows the projected sizes
+    float budget_factor = wanted_total > this->pointBudget ? this->pointBudget / wanted_total : 1.f;
+    this->budgetLimited = wanted_total > this->pointBudget;
+
+    this->gl->glQueryCounter(this->timerQueries[this->timerFrame][0], GL_TIMESTAMP);
+
+    this->gl->glEnable(GL_PROGRAM_POINT_SIZE);
+    this->gl->glUseProgram(program.shaderProgram->programId());
+    this->gl->glUniformMatrix4fv(program.modelMatrixLocation, 1, GL_FALSE, model_matrix.constData());
+
+    if(splats)
+    {
+        this->gl->glUniform1f(program.pointSizeLocation, this->settings.pointSize);
+        this->gl->glUniform1f(program.maxPointSizeLocation, this->settings.maxSplatSize);
+    }
+
+    size_t bound_buffer = this->buffers.size();
+    int bound_pose = -2;
+
+    for(size_t i = 0; i < this->visibleChunks.size(); ++i)
+    {
+        const ChunkRange &range = this->chunks[this->visibleChunks[i]];
+
+        GLsizei draw_count = std::min(range.count, static_cast<GLsizei>(std::ceil(this->wantedCounts[i] * budget_factor)));
+
+        if(draw_count <= 0)
+        {
+            continue;
+        }
+
+        if(range.bufferIndex != bound_buffer)
+        {
+            bound_buffer = range.bufferIndex;
+            this->gl->glBindVertexArray(this->buffers[bound_buffer].vao);
+        }
+
+        // a thinned chunk draws larger points to cover the same surface, splats are sized in scene units
+        ////// by the spacing of the drawn prefix and scaled with distance in the shader
+        float thinning = static_cast<float>(range.count) / static_cast<float>(draw_count);
+        float point_size = this->settings.pointSize * std::min(std::sqrt(thinning), 4.f);
+        float splat_size = this->settings.splatScale * range.spacing / std::sqrt(static_cast<float>(draw_count));
+
+        // chunks of one frame are drawn one after another, the pose changes at most once per frame
+        if(range.poseIndex != bound_pose)
+        {
+            bound_pose = range.poseIndex;
+
+            bool has_pose = bound_pose >= 0 && static_cast<size_t>(bound_pose) < this->poseMatrices.size();
+            QMatrix4x4 chunk_pose = has_pose ? this->poseMatrices[static_cast<size_t>(bound_pose)] : QMatrix4x4();
+
+            this->gl->glUniformMatrix4fv(program.chunkPoseLocation, 1, GL_FALSE, chunk_pose.constData());
+        }
+
+        this->gl->glUniform4fv(program.chunkOriginLocation, 1, range.origin);
+
+        if(splats)
+        {
+            this->gl->glUniform1f(program.splatSizeLocation, splat_size);
+        }
+        else
+        {
+            this->gl->glUniform1f(program.pointSizeLocation, point_size);
+        }
+
+        this->gl->glDrawArrays(GL_POINTS, range.first, draw_count);
+
+        this->statistics.visibleChunksCount += 1;
+        this->statistics.drawnPointsCount += static_cast<size_t>(draw_count);
+    }
+
+    this->gl->glBindVertexArray(0);
+    this->gl->glUseProgram(0);
+
+    Profiler::count(ProfileCounter::PointsDrawn, this->statistics.drawnPointsCount);
+
+    this->gl->glQueryCounter(this->timerQueries[this->timerFrame][1], GL_TIMESTAMP);
+    this->timerPending[this->timerFrame] = true;
+    this->timerFrame = (this->timerFrame + 1) % PointChunkRenderer::timerFramesCount;
+}
+
+//// getters
+PointChunkRenderStatistics PointChunkRenderer::getStatistics()
+{
+    return this->statistics;
+}
+
+PointRenderMode PointChunkRenderer::getRenderMode()
+{
+    return this->settings.renderMode;
+}
+
+// private functions
+bool PointChunkRenderer::createProgram(PointRenderMode render_mode, const QString &path_to_vertex_shader, const QString &path_to_fragment_shader)
+{
+    PointProgram &program = this->programs[static_cast<int>(render_mode)];
+    program.shaderProgram = RenderState::createProgram(this->gl, path_to_vertex_shader, path_to_fragment_shader);
+
+    if(program.shaderProgram == nullptr)
+    {
+        return false;
+    }
+
+    GLuint program_id = program.shaderProgram->programId();
+
+    program.modelMatrixLocation = this->gl->glGetUniformLocation(program_id, "modelMatrix");
+    program.chunkOriginLocation = this->gl->glGetUniformLocation(program_id, "chunkOrigin");
+    program.pointSizeLocation = this->gl->glGetUniformLocation(program_id, "pointSize");
+    program.chunkPoseLocation = this->gl->glGetUniformLocation(program_id, "chunkPose");
+    program.maxPointSizeLocation = this->gl->glGetUniformLocation(program_id, "maxPointSize");
+    program.splatSizeLocation = this->gl->glGetUniformLocation(program_id, "splatSize");
+
+    return true;
+}
+
+size_t PointChunkRenderer::createBuffer(size_t points_capacity)
+{
+    ChunkBuffer buffer;
+    buffer.capacity = points_capacity;
+    buffer.usedPoints = 0;
+
+    this->gl->glGenVertexArrays(1, &buffer.vao);
+    this->gl->glBindVertexArray(buffer.vao);
+
+    this->gl->glGenBuffers(1, &buffer.vbo);
+    this->gl->glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+    this->gl->glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(points_capacity * sizeof(CompactPoint)), nullptr, GL_STATIC_DRAW);
+
+    // int16 position in quantization steps of the chunk, normalized RGBA8 color
+    this->gl->glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(CompactPoint), reinterpret_cast<const void *>(offsetof(CompactPoint, x)));
+    this->gl->glEnableVertexAttribArray(0);
+    this->gl->glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactPoint), reinterpret_cast<const void *>(offsetof(CompactPoint, r)));
+    this->gl->glEnableVertexAttribArray(1);
+
+    this->gl->glBindVertexArray(0);
+    this->gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    this->buffers.push_back(buffer);
+
+    return this->buffers.size() - 1;
+}
+
+PointChunkRenderer::ChunkRange PointChunkRenderer::getChunkRange(const PointChunk &chunk, const BoundingBox &bounds, int pose_index)
+{
+    ChunkRange range;
+    range.localBounds = bounds;
+    range.poseIndex = pose_index;
+
+    this->updateRangeBounds(range);
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        range.origin[axis] = chunk.origin[axis];
+    }
+
+    range.origin[3] = chunk.scale;
+    range.spacing = PointChunkRenderer::getPointSpacing(chunk);
+    range.bufferIndex = 0;
+    range.first = 0;
+    range.count = static_cast<GLsizei>(chunk.points.size());
+    range.id = -1;
+
+    return range;
+}
+
+float PointChunkRenderer::getPointSpacing(const PointChunk &chunk)
+{
+    const size_t max_samples_count = 64;
+
+    size_t points_count = chunk.points.size();
+    size_t samples_count = std::min(points_count, max_samples_count);
+
+    if(samples_count < 2)
+    {
+        return 0.f;
+    }
+
+    // evenly spread indexes, streamed chunks are in image order rather than shuffled
+    std::vector<float> nearest(samples_count, std::numeric_limits<float>::max());
+
+    for(size_t i = 0; i < samples_count; ++i)
+    {
+        const CompactPoint &a = chunk.points[i * points_count / samples_count];
+
+        for(size_t j = i + 1; j < samples_count; ++j)
+        {
+            const CompactPoint &b = chunk.points[j * points_count / samples_count];
+
+            float dx = static_cast<float>(a.x - b.x);
+            float dy = static_cast<float>(a.y - b.y);
+            float dz = static_cast<float>(a.z - b.z);
+            float distance_squared = dx * dx + dy * dy + dz * dz;
+
+            nearest[i] = std::min(nearest[i], distance_squared);
+            nearest[j] = std::min(nearest[j], distance_squared);
+        }
+    }
+
+    // the median ignores duplicates and outliers, for randomly spread points it is sqrt(ln 2 / pi) of the
+    ////// side of the area per point
+    std::nth_element(nearest.begin(), nearest.begin() + samples_count / 2, nearest.end());
+
+    const float median_to_spacing = 2.1289f;
+
+    // points of a surface thin out with the square root of their count
+    return std::sqrt(nearest[samples_count / 2]) * chunk.scale * median_to_spacing * std::sqrt(static_cast<float>(samples_count));
+}
+
+void PointChunkRenderer::updateRangeBounds(ChunkRange &range)
+{
+    range.bounds = range.localBounds;
+
+    if(range.poseIndex >= 0 && static_cast<size_t>(range.poseIndex) < this->poseMatrices.size())
+    {
+        const QMatrix4x4 &pose = this->poseMatrices[static_cast<size_t>(range.poseIndex)];
+        const BoundingBox &local = range.localBounds;
+
+        // world box around all eight posed corners
+        for(int corner = 0; corner < 8; ++corner)
+        {
+            QVector3D point = pose.map(QVector3D(corner & 1 ? local.max[0] : local.min[0],
+                                                 corner & 2 ? local.max[1] : local.min[1],
+                                                 corner & 4 ? local.max[2] : local.min[2]));
+
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                range.bounds.min[axis] = corner == 0 ? point[axis] : std::min(range.bounds.min[axis], point[axis]);
+                range.bounds.max[axis] = corner == 0 ? point[axis] : std::max(range.bounds.max[axis], point[axis]);
+            }
+        }
+    }
+
+    range.radius = 0.f;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        float half_extent = 0.5f * (range.bounds.max[axis] - range.bounds.min[axis]);
+
+        range.center[axis] = range.bounds.min[axis] + half_extent;
+        range.radius += half_extent * half_extent;
+    }
+
+    range.radius = std::sqrt(range.radius);
+}
+
+void PointChunkRenderer::reserveRange(QueuedChunk &queued_chunk)
+{
+    size_t count = queued_chunk.chunk.points.size();
+
+    queued_chunk.range = this->getChunkRange(queued_chunk.chunk, queued_chunk.bounds, queued_chunk.poseIndex);
+    queued_chunk.range.id = queued_chunk.id;
+    queued_chunk.reserved = true;
+
+    // first fit into the ranges of removed chunks or the unused end of a buffer, pages of one store are of similar sizes
+    for(size_t buffer_index = 0; buffer_index < this->buffers.size(); ++buffer_index)
+    {
+        ChunkBuffer &buffer = this->buffers[buffer_index];
+        std::vector<FreeRange> &free_ranges = buffer.freeRanges;
+
+        queued_chunk.range.bufferIndex = buffer_index;
+
+        for(size_t i = 0; i < free_ranges.size(); ++i)
+        {
+            if(static_cast<size_t>(free_ranges[i].count) >= count)
+            {
+                queued_chunk.range.first = free_ranges[i].first;
+
+                free_ranges[i].first += static_cast<GLint>(count);
+                free_ranges[i].count -= static_cast<GLsizei>(count);
+
+                if(free_ranges[i].count == 0)
+                {
+                    free_ranges.erase(free_ranges.begin() + static_cast<std::ptrdiff_t>(i));
+                }
+
+                return;
+            }
+        }
+
+        if(buffer.capacity - buffer.usedPoints >= count)
+        {
+            queued_chunk.range.first = static_cast<GLint>(buffer.usedPoints);
+            buffer.usedPoints += count;
+
+            return;
+        }
+    }
+
+    // a new buffer once none has room left
+    size_t buffer_index = this->createBuffer(std::max(this->settings.bufferPointsCapacity, count));
+
+    queued_chunk.range.bufferIndex = buffer_index;
+    queued_chunk.range.first = 0;
+
+    this->buffers[buffer_index].usedPoints = count;
+}
+
+void PointChunkRenderer::releaseRange(const ChunkRange &range)
+{
+    ChunkBuffer &buffer = this->buffers[range.bufferIndex];
+    std::vector<FreeRange> &free_ranges = buffer.freeRanges;
+
+    auto it = std::lower_bound(free_ranges.begin(), free_ranges.end(), range.first, [](const FreeRange &free_range, GLint first)
+    {
+        return free_range.first < first;
+    });
+
+    it = free_ranges.insert(it, FreeRange{ range.first, range.count });
+
+    // merge with the following and the preceding neighbour
+    if(it + 1 != free_ranges.end() && it->first + it->count == (it + 1)->first)
+    {
+        it->count += (it + 1)->count;
+        free_ranges.erase(it + 1);
+    }
+
+    if(it != free_ranges.begin() && (it - 1)->first + (it - 1)->count == it->first)
+    {
+        (it - 1)->count += it->count;
+        it = free_ranges.erase(it) - 1;
+    }
+
+    // a free tail is given back to the unused end of the buffer
+    if(static_cast<size_t>(it->first + it->count) == buffer.usedPoints)
+    {
+        buffer.usedPoints = static_cast<size_t>(it->first);
+        free_ranges.erase(it);
+    }
+}
+
+void PointChunkRenderer::readFrameTimers()
+{
+    // oldest frame first, a frame whose result is not ready yet keeps every newer one waiting too
+    for(int i = 0; i < PointChunkRenderer::timerFramesCount; ++i)
+    {
+        int frame = (this->timerFrame + i) % PointChunkRenderer::timerFramesCount;
+
+        if(!this->timerPending[frame])
+        {
+            continue;
+        }
+
+        GLint available = 0;
+        this->gl->glGetQueryObjectiv(this->timerQueries[frame][1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if(!available)
+        {
+            // the slot is about to be reused, its measurement is dropped
+            if(frame == this->timerFrame)
+            {
+                this->timerPending[frame] = false;
+            }
+
+            break;
+        }
+
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        this->gl->glGetQueryObjectui64v(this->timerQueries[frame][0], GL_QUERY_RESULT, &start);
+        this->gl->glGetQueryObjectui64v(this->timerQueries[frame][1], GL_QUERY_RESULT, &end);
+
+        this->timerPending[frame] = false;
+
+        // software rasterizers may stamp both ends of a pass at once, such frames say nothing about the load
+        if(end <= start)
+        {
+            continue;
+        }
+
+        this->statistics.gpuMilliseconds = static_cast<float>(end - start) * 1e-6f;
+
+        this->updatePointBudget();
+    }
+}
+
+void PointChunkRenderer::updatePointBudget()
+{
+    float target = this->settings.targetFrameMilliseconds;
+    float measured = std::max(this->statistics.gpuMilliseconds, 1e-3f);
+
+    if(measured > target)
+    {
+        this->pointBudget *= std::max(0.5f, target / measured);
+    }
+    else if(this->budgetLimited && measured < 0.85f * target)
+    {
+        // grow only while the budget is what limits the picture
+        this->pointBudget *= std::min(1.25f, target / measured);
+    }
+
+    this->pointBudget = std::clamp(this->pointBudget, static_cast<float>(this->settings.minPointBudget),
+                                   static_cast<float>(this->settings.maxPointBudget));
+}
@@ -0,0 +1,186 @@
+#ifndef POINTCHUNKRENDERER_H
+#define POINTCHUNKRENDERER_H
+
+#include "pointformat.h"
+#include "backprojection.h"
+#include "octree.h"
+#include "streaminguploader.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+
+#include <vector>
+#include <deque>
+#include <cstddef>
+
+enum class PointRenderMode
+{
+    Points,                         // square points of a fixed size, growing for thinned chunks
+    Splats,                         // round sprites sized by distance and the density of the drawn points
+    DepthSplats,                    // splats with the depth of a sphere around every point, slower without early depth test
+    Count
+};
+
+struct PointChunkRendererSettings
+{
+    float targetFrameMilliseconds;  // GPU time per frame the point budget adapts to
+    size_t minPointBudget;          // points drawn per frame are kept within [min, max]
+    size_t maxPointBudget;
+    float pointsPerPixel;           // points of a chunk drawn per pixel of its projected area, before the budget applies
+    float pointSize;                // pixels, grows for thinned chunks to close the gaps
+    size_t bufferPointsCapacity;    // points per vertex buffer, a chunk never spans two buffers
+    PointRenderMode renderMode;
+    float splatPointsPerPixel;      // replaces pointsPerPixel while drawing splats, every one covers several pixels
+    float splatScale;               // splat diameter relative to the side of the area per drawn point
+    float maxSplatSize;             // pixels
+};
+
+struct PointChunkRenderStatistics
+{
+    size_t chunksCount;
+    size_t pointsCount;
+    size_t visibleChunksCount;
+    size_t drawnPointsCount;
+    size_t queuedChunksCount;       // waiting for upload, not drawn yet
+    size_t pointBudget;
+    float gpuMilliseconds;          // last measured frame, results arrive a few frames late
+};
+
+//// draws spatial point chunks stored as CompactPoint in shared vertex buffers; every frame chunks outside of the frustum
+//// are skipped and the remaining ones draw a prefix of their shuffled points sized by projected area and frame time
+class PointChunkRenderer
+{
+public:
+    // constructors/destructors
+    //// functions of the owning widget, its context has to be current in every call including the destructor
+    PointChunkRenderer(QOpenGLFunctions_3_3_Core *gl_functions, PointChunkRendererSettings settings);
+    ~PointChunkRenderer();
+
+    // public functions
+    bool initialize();
+
+    //// replaces uploaded chunks, points of every chunk should be shuffled, see SpatialChunker
+    void setChunks(const std::vector<PointChunk> &chunks, const std::vector<BoundingBox> &bounds);
+    void clear();
+
+    //// streaming, queued chunks are appended through the uploader within its frame budget and drawn once complete;
+    //// points are written in a strided order, so prefixes of unshuffled chunks are spread over the whole chunk too;
+    //// chunks with a pose index are frame-local and drawn through that pose of setPoses, -1 - already in world space
+    void queueChunk(PointChunk &&chunk, int pose_index = -1);
+    ////// chunks with an id can be removed again, e.g. pages evicted by PageStreamer
+    void queueChunk(PointChunk &&chunk, const BoundingBox &bounds, int pose_index = -1, int chunk_id = -1);
+    ////// returns false while chunks are still queued
+    bool uploadQueuedChunks(StreamingUploader &uploader);
+    //// drops a queued or uploaded chunk, its range is reused by later chunks of the same or a smaller size
+    bool removeChunk(int chunk_id);
+
+    //// camera-to-world poses of frame-local chunks, replacing them moves the chunks without touching their buffers
+    void setPoses(const std::vector<FramePose> &poses);
+
+    //// programs of all modes are built in initialize, switching is free
+    void setRenderMode(PointRenderMode render_mode);
+
+    //// the camera block of RenderState has to hold the same projection and view, they are used here for culling
+    void render(const QMatrix4x4 &projection_matrix, const QMatrix4x4 &view_matrix, const QMatrix4x4 &model_matrix, int viewport_height);
+
+    //// getters
+    PointChunkRenderStatistics getStatistics();
+    PointRenderMode getRenderMode();
+
+private:
+    struct ChunkRange
+    {
+        BoundingBox localBounds;    // in the coordinates of the chunk points
+        int poseIndex;
+        BoundingBox bounds;         // localBounds brought to world space by the pose
+        float center[3];
+        float radius;
+        float origin[4];            // x, y, z, scale of the chunk quantization
+        float spacing;              // side of the area per point times sqrt(count), for a prefix of n points spacing / sqrt(n)
+        size_t bufferIndex;
+        GLint first;
+        GLsizei count;
+        int id;
+    };
+
+    struct FreeRange
+    {
+        GLint first;
+        GLsizei count;
+    };
+
+    struct PointProgram
+    {
+        QOpenGLShaderProgram *shaderProgram;
+        GLint modelMatrixLocation;
+        GLint chunkOriginLocation;
+        GLint pointSizeLocation;
+        GLint chunkPoseLocation;
+        GLint maxPointSizeLocation; // splats only
+        GLint splatSizeLocation;
+    };
+
+    struct ChunkBuffer
+    {
+        GLuint vao;
+        GLuint vbo;
+        size_t capacity;
+        size_t usedPoints;
+        std::vector<FreeRange> freeRanges;  // below usedPoints, sorted and coalesced
+    };
+
+    struct QueuedChunk
+    {
+        PointChunk chunk;
+        BoundingBox bounds;
+        int poseIndex;
+        int id;
+        bool reserved;
+        ChunkRange range;
+        size_t uploadedPoints;
+        size_t stride;              // coprime with the points count, point i of the range is source point i * stride mod count
+    };
+
+    // private functions
+    bool createProgram(PointRenderMode render_mode, const QString &path_to_vertex_shader, const QString &path_to_fragment_shader);
+    size_t createBuffer(size_t points_capacity);
+    ChunkRange getChunkRange(const PointChunk &chunk, const BoundingBox &bounds, int pose_index);
+    ////// median nearest neighbour distance within an even sample of the points
+    static float getPointSpacing(const PointChunk &chunk);
+    void updateRangeBounds(ChunkRange &range);
+    void reserveRange(QueuedChunk &queued_chunk);
+    void releaseRange(const ChunkRange &range);
+    void readFrameTimers();
+    void updatePointBudget();
+
+    // private variables
+    QOpenGLFunctions_3_3_Core *gl;
+    PointChunkRendererSettings settings;
+
+    PointProgram programs[static_cast<int>(PointRenderMode::Count)];
+
+    std::vector<ChunkBuffer> buffers;
+    std::vector<ChunkRange> chunks;
+    size_t pointsCount;
+
+    std::vector<QMatrix4x4> poseMatrices;
+
+    std::deque<QueuedChunk> queuedChunks;
+
+    //// per frame selection
+    std::vector<size_t> visibleChunks;
+    std::vector<float> wantedCounts;
+
+    //// GPU frame time, timestamps of the frame start and end in a ring so reading never stalls
+    static const int timerFramesCount = 4;
+    GLuint timerQueries[timerFramesCount][2];
+    bool timerPending[timerFramesCount];
+    int timerFrame;
+
+    float pointBudget;
+    bool budgetLimited;
+    PointChunkRenderStatistics statistics;
+};
+
+#endif // POINTCHUNKRENDERER_H
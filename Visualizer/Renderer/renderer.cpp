@@ -1,16 +1,41 @@
 #include "renderer.h"
+#include "rendererdefaults.h"
+
+#include <QPainter>
+
+#include <algorithm>
 
 // constructors/destructors
 Renderer::Renderer(QWidget *parent)
 {
     this->initVariables();
+
+    // key presses need focus
+    this->setFocusPolicy(Qt::StrongFocus);
+
+    // profiling a whole session, e.g. on a machine without a debugger
+    this->pathToProfile = qEnvironmentVariable("MAP_RENDERER_PROFILE").toStdString();
+
+    if(!this->pathToProfile.empty())
+    {
+        Profiler::setEnabled(true);
+    }
 }
 
 Renderer::~Renderer()
 {
-    delete this->gridShaderProgram;
-    delete this->cordsShaderProgram;
-    delete this->trajectoryShaderProgram;
+    if(!this->pathToProfile.empty())
+    {
+        Profiler::write(this->pathToProfile);
+    }
+
+    // GL objects are released with the widget context current
+    this->makeCurrent();
+    delete this->gpuProfiler;
+    delete this->trajectoryPass;
+    delete this->overlayPass;
+    delete this->renderState;
+    this->doneCurrent();
 }
 
 // protected functions
@@ -60,43 +85,69 @@ void Renderer::mouseMoveEvent(QMouseEvent *event)
     }
 
     this->lastMousePosition = event->pos();
+
+    this->update();
 }
 
 void Renderer::wheelEvent(QWheelEvent *event)
 {
     int delta = event->angleDelta().y();
     this->position += this->forward * this->zoomSpeed * delta;
+
+    this->update();
 }
 
-//// visualization tools
-void Renderer::showGrid()
+void Renderer::keyPressEvent(QKeyEvent *event)
+{
+    if(event->key() != Qt::Key_P)
+    {
+        QOpenGLWidget::keyPressEvent(event);
+        return;
+    }
+
+    this->profilerOverlayVisible = !this->profilerOverlayVisible;
+
+    // a session profile keeps running when the overlay is hidden
+    Profiler::setEnabled(this->profilerOverlayVisible || !this->pathToProfile.empty());
+
+    this->update();
+}
+
+void Renderer::updateViewMatrix()
 {
-    // Use the shader program
-    glUseProgram(this->gridShaderProgram->programId());
+    this->viewMatrix.setToIdentity();
+    this->viewMatrix.lookAt(this->position, this->position + this->forward, this->up);
+}
 
-    // Bind the VAO
-    glBindVertexArray(this->gridVAO);
+//// shared render state
+void Renderer::initializeRenderState()
+{
+    this->renderState = new RenderState(this);
+    this->renderState->initialize();
 
-    // Get the location of the uniform variable in the fragment shader
-    GLint colorUniformLocation = glGetUniformLocation(this->gridShaderProgram->programId(), "color");
-    GLint modelMatrixUniformLocation = glGetUniformLocation(this->gridShaderProgram->programId(), "model");
-    GLint viewMatrixUniformLocation = glGetUniformLocation(this->gridShaderProgram->programId(), "view");
-    GLint projectionMatrixUniformLocation = glGetUniformLocation(this->gridShaderProgram->programId(), "projection");
+    this->overlayPass = new OverlayPass(this);
+    this->overlayPass->initialize();
 
-    // Set the uniform values
-    glUniform3fv(colorUniformLocation, 1, this->gridColor);
-    glUniformMatrix4fv(modelMatrixUniformLocation, 1, GL_FALSE, this->modelMatrix.data());
-    glUniformMatrix4fv(viewMatrixUniformLocation, 1, GL_FALSE, this->viewMatrix.data());
-    glUniformMatrix4fv(projectionMatrixUniformLocation, 1, GL_FALSE, this->projectionMatrix.data());
+    this->trajectoryPass = new TrajectoryPass(this, this->trajectorySettings);
+    this->trajectoryPass->initialize();
 
-    // Draw
-    glDrawArrays(GL_LINES, 0, this->gridVertices.size());
+    this->gpuProfiler = new GpuProfiler(this);
+    this->gpuProfiler->initialize();
+}
 
-    // Unbind the VAO
-    glBindVertexArray(0);
+void Renderer::updateRenderState()
+{
+    this->updateViewMatrix();
 
-    // release shader program
-    glUseProgram(0);
+    this->renderState->setCamera(this->projectionMatrix, this->viewMatrix,
+                                 static_cast<int>(this->width() * this->devicePixelRatio()),
+                                 static_cast<int>(this->height() * this->devicePixelRatio()));
+}
+
+//// visualization tools
+void Renderer::showGrid()
+{
+    this->overlayPass->drawLayer(this->modelMatrix, GridLayer);
 }
 
 void Renderer::populateGrid(int gridSize, float gridSpacing, float setGridColor[3])
@@ -109,56 +160,12 @@ void Renderer::populateGrid(int gridSize, float gridSpacing, float setGridColor[
     this->gridColor[1] = setGridColor[1];
     this->gridColor[2] = setGridColor[2];
 
-    // setup shader program
-    this->gridShaderProgram = new QOpenGLShaderProgram();
-    this->gridShaderProgram->addShaderFromSourceFile(QOpenGLShader::Vertex, "Visualizer/Shaders/GridVertexShader.vert");
-    this->gridShaderProgram->addShaderFromSourceFile(QOpenGLShader::Fragment, "Visualizer/Shaders/GridFragmentShader.frag");
-
-    // Generate VAO
-    glGenVertexArrays(1, &this->gridVAO);
-    glBindVertexArray(this->gridVAO);
-
-    // Generate VBO
-    glGenBuffers(1, &this->gridVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, this->gridVBO);
-    glBufferData(GL_ARRAY_BUFFER, this->gridVertices.size(), this->gridVertices.data(), GL_STATIC_DRAW);
-
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-
-    // Unbind VAO
-    glBindVertexArray(0);
+    this->overlayPass->setLines(GridLayer, Renderer::getOverlayVertices(this->gridVertices, this->gridColor));
 }
 
 void Renderer::showCordsSystem()
 {
-    // Use the shader program
-    glUseProgram(this->cordsShaderProgram->programId());
-
-    // Bind the VAO
-    glBindVertexArray(this->cordsVAO);
-
-    // Get the location of the uniform variable in the fragment shader
-    GLint colorUniformLocation = glGetUniformLocation(this->cordsShaderProgram->programId(), "color");
-    GLint modelMatrixUniformLocation = glGetUniformLocation(this->cordsShaderProgram->programId(), "model");
-    GLint viewMatrixUniformLocation = glGetUniformLocation(this->cordsShaderProgram->programId(), "view");
-    GLint projectionMatrixUniformLocation = glGetUniformLocation(this->cordsShaderProgram->programId(), "projection");
-
-    // Set the uniform values
-    glUniform3fv(colorUniformLocation, 1, this->cordsColor);
-    glUniformMatrix4fv(modelMatrixUniformLocation, 1, GL_FALSE, this->modelMatrix.data());
-    glUniformMatrix4fv(viewMatrixUniformLocation, 1, GL_FALSE, this->viewMatrix.data());
-    glUniformMatrix4fv(projectionMatrixUniformLocation, 1, GL_FALSE, this->projectionMatrix.data());
-
-    // Draw
-    glDrawArrays(GL_LINES, 0, this->cordsVertices.size());
-
-    // Unbind the VAO
-    glBindVertexArray(0);
-
-    // release shader program
-    glUseProgram(0);
+    this->overlayPass->drawLayer(this->modelMatrix, CordsLayer);
 }
 
 void Renderer::populateCordsSystem(float axisLength, float setCordsColor[3])
@@ -166,54 +173,98 @@ void Renderer::populateCordsSystem(float axisLength, float setCordsColor[3])
     // generate cords vertices data
     this->cordsVertices = this->generateCoordinateSystemVertices(axisLength);
 
-    // set grid color
+    // set cords color
     this->cordsColor[0] = setCordsColor[0];
     this->cordsColor[1] = setCordsColor[1];
     this->cordsColor[2] = setCordsColor[2];
 
-    // setup shader program
-    this->cordsShaderProgram = new QOpenGLShaderProgram();
-    this->cordsShaderProgram->addShaderFromSourceFile(QOpenGLShader::Vertex, "Visualizer/Shaders/CordsVertexShader.vert");
-    this->cordsShaderProgram->addShaderFromSourceFile(QOpenGLShader::Fragment, "Visualizer/Shaders/CordsFragmentShader.frag");
-
-    // Generate VAO
-    glGenVertexArrays(1, &this->cordsVAO);
-    glBindVertexArray(this->cordsVAO);
-
-    // Generate VBO
-    glGenBuffers(1, &this->cordsVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, this->cordsVBO);
-    glBufferData(GL_ARRAY_BUFFER, this->cordsVertices.size(), this->cordsVertices.data(), GL_STATIC_DRAW);
-
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-
-    // Unbind VAO
-    glBindVertexArray(0);
+    this->overlayPass->setLines(CordsLayer, Renderer::getOverlayVertices(this->cordsVertices, this->cordsColor));
 }
 
 void Renderer::showTrajectory()
 {
+    this->trajectoryPass->render(this->projectionMatrix, this->viewMatrix, this->modelMatrix,
+                                 static_cast<int>(this->height() * this->devicePixelRatio()));
+}
 
+void Renderer::populateTrajectory(const std::vector<FramePose> &poses, const CameraIntrinsics &intrinsics, float setTrajectoryColor[3])
+{
+    this->trajectoryPass->clear();
+    this->trajectoryPass->setIntrinsics(intrinsics);
+    this->trajectoryPass->setPathColor(setTrajectoryColor);
+    this->trajectoryPass->appendPoses(poses);
 }
 
-void Renderer::populateTrajectory()
+void Renderer::appendTrajectory(const std::vector<FramePose> &poses)
 {
-    // setup shader program
-    this->trajectoryShaderProgram = new QOpenGLShaderProgram();
-    this->trajectoryShaderProgram->addShaderFromSourceFile(QOpenGLShader::Vertex, "Visualizer/Shaders/TrajectoryVertexShader.vert");
-    this->trajectoryShaderProgram->addShaderFromSourceFile(QOpenGLShader::Fragment, "Visualizer/Shaders/TrajectoryFragmentShader.frag");
+    this->trajectoryPass->appendPoses(poses);
 }
 
 void Renderer::showTools()
 {
-
+    this->overlayPass->draw(this->modelMatrix);
 }
 
 void Renderer::populateTools()
 {
+    float grid_color[3] = {0.3f, 0.3f, 0.3f};
+    float cords_color[3] = {1.f, 1.f, 1.f};
+
+    this->populateGrid(10, 1.f, grid_color);
+    this->populateCordsSystem(1.f, cords_color);
+}
+
+//// profiling
+void Renderer::showProfilerOverlay()
+{
+    if(!this->profilerOverlayVisible)
+    {
+        return;
+    }
+
+    // recent frames only, so a slowdown shows up while it happens
+    const size_t frames_count = 120;
+
+    // live numbers need frames to keep coming
+    this->update();
+
+    std::vector<ProfileFrame> frames = Profiler::getFrames();
+    size_t first = frames.size() - std::min(frames.size(), frames_count);
 
+    QPainter painter(this);
+    painter.setPen(Qt::white);
+    painter.setFont(QFont("monospace", 9));
+
+    int line_height = painter.fontMetrics().height();
+    int y = line_height;
+
+    for(const ProfileStageSummary &stage : Profiler::getFrameSummaries(frames_count))
+    {
+        painter.drawText(8, y, QString::asprintf("%-14s mean %7.2f  p50 %7.2f  p99 %7.2f  max %7.2f ms", stage.name,
+                                                 stage.meanMilliseconds, stage.p50Milliseconds, stage.p99Milliseconds, stage.maxMilliseconds));
+        y += line_height;
+    }
+
+    if(frames.size() - first < 2)
+    {
+        return;
+    }
+
+    double seconds = std::max(frames.back().seconds - frames[first].seconds, 1e-9);
+
+    for(int i = 0; i < static_cast<int>(ProfileCounter::Count); ++i)
+    {
+        uint64_t total = 0;
+
+        // the first frame only marks the start of the window
+        for(size_t j = first + 1; j < frames.size(); ++j)
+        {
+            total += frames[j].counters[i];
+        }
+
+        painter.drawText(8, y, QString::asprintf("%-14s %12.0f /s", Profiler::getCounterName(static_cast<ProfileCounter>(i)), total / seconds));
+        y += line_height;
+    }
 }
 
 // private functions
@@ -221,13 +272,20 @@ void Renderer::populateTools()
 void Renderer::initVariables()
 {
     this->lastMousePosition = {0, 0};
+    // looking along the optical axis of a camera with identity pose, image rows grow along x
     this->position = {0.f, 0.f, 0.f};
-    this->forward = {0.f, 0.f, 0.f};
-    this->up = {0.f, 0.f, 0.f};
-    this->right = {0.f, 0.f, 0.f};
-    this->moveSpeed = 0.f;
-    this->rotationSpeed = 0.f;
-    this->zoomSpeed = 0.f;
+    this->forward = {0.f, 0.f, 1.f};
+    this->up = {-1.f, 0.f, 0.f};
+    this->right = {0.f, -1.f, 0.f};
+    this->moveSpeed = 0.01f;
+    this->rotationSpeed = 0.2f;
+    this->zoomSpeed = 0.002f;
+    this->renderState = nullptr;
+    this->overlayPass = nullptr;
+    this->trajectoryPass = nullptr;
+    this->gpuProfiler = nullptr;
+    this->profilerOverlayVisible = false;
+    this->trajectorySettings = RendererDefaults::getTrajectoryPassSettings();
     this->transformMatrix = { 1.f, 0.f, 0.f, 0.f,
                               0.f, 1.f, 0.f, 0.f,
                               0.f, 0.f, 1.f, 0.f,
@@ -313,3 +371,15 @@ std::vector<GLfloat> Renderer::generateCoordinateSystemVertices(float axis_lengt
 
     return vertices;
 }
+
+std::vector<OverlayVertex> Renderer::getOverlayVertices(const std::vector<GLfloat> &positions, const GLfloat color[3])
+{
+    std::vector<OverlayVertex> vertices(positions.size() / 3);
+
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        vertices[i] = { { positions[3 * i], positions[3 * i + 1], positions[3 * i + 2] }, { color[0], color[1], color[2] } };
+    }
+
+    return vertices;
+}
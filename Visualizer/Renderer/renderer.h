@@ -6,11 +6,18 @@
 #include <QOpenGLWidget>
 
 #include <QMouseEvent>
+#include <QKeyEvent>
 #include <QVector3D>
 #include <QMatrix4x4>
 #include <QOpenGLShader>
 
+#include "renderstate.h"
+#include "overlaypass.h"
+#include "trajectorypass.h"
+#include "gpuprofiler.h"
+
 #include <vector>
+#include <string>
 
 class Renderer : public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core
 {
@@ -32,17 +39,34 @@ protected:
     void mousePressEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
     void wheelEvent(QWheelEvent* event) override;
+    void updateViewMatrix();
+
+    //// P toggles profiling together with its overlay
+    void keyPressEvent(QKeyEvent* event) override;
 
-    //// visualization tools
+    //// shared render state, call initializeRenderState from initializeGL after initializeOpenGLFunctions
+    ////// and updateRenderState once per frame before any pass draws
+    void initializeRenderState();
+    void updateRenderState();
+
+    //// visualization tools, all of them share one overlay program
     void showGrid();
     void populateGrid(int gridSize, float gridSpacing,  float setGridColor[3]);
     void showCordsSystem();
     void populateCordsSystem(float axisLength, float setCordsColor[3]);
+    ////// drawn with its own pass, simplified to the zoom level; call after the other tools
     void showTrajectory();
-    void populateTrajectory();
+    ////// camera-to-world poses in capture order replace the path, appended ones extend it
+    void populateTrajectory(const std::vector<FramePose> &poses, const CameraIntrinsics &intrinsics, float setTrajectoryColor[3]);
+    void appendTrajectory(const std::vector<FramePose> &poses);
+    ////// every populated tool in a single draw call
     void showTools();
     void populateTools();
 
+    //// profiling, passes are timed with gpuProfiler; the overlay is painted with QPainter over the finished frame,
+    ////// so it is called last in paintGL and the next frame cannot rely on GL state left from the previous one
+    void showProfilerOverlay();
+
     // protected variables
     //// OpenGL variables
     QMatrix4x4 transformMatrix;
@@ -50,6 +74,11 @@ protected:
     QMatrix4x4 viewMatrix;
     QMatrix4x4 projectionMatrix;
 
+    RenderState *renderState;
+    OverlayPass *overlayPass;
+    TrajectoryPass *trajectoryPass;
+    GpuProfiler *gpuProfiler;
+
 private:
     // private functions
     //// common functions
@@ -62,6 +91,9 @@ private:
     ////// cords system
     std::vector<GLfloat> generateCoordinateSystemVertices(float axis_length);
 
+    ////// overlay vertices of x, y, z triples in a single color
+    static std::vector<OverlayVertex> getOverlayVertices(const std::vector<GLfloat> &positions, const GLfloat color[3]);
+
     // private variables
     //// camera variables
     QPoint lastMousePosition;
@@ -75,27 +107,27 @@ private:
     float rotationSpeed;
     float zoomSpeed;
 
-    //// tools variables
+    //// profiling variables
+    bool profilerOverlayVisible;
+    std::string pathToProfile;      // MAP_RENDERER_PROFILE, written when the renderer is destroyed
+
+    //// tools variables, layers of the overlay pass
+    enum ToolLayer
+    {
+        GridLayer,
+        CordsLayer
+    };
+
     ////// grid
-    GLuint gridVAO;
-    GLuint gridVBO;
-    QOpenGLShaderProgram *gridShaderProgram;
     std::vector<GLfloat> gridVertices;
     GLfloat gridColor[3];
 
     ////// cords system
-    GLuint cordsVAO;
-    GLuint cordsVBO;
-    QOpenGLShaderProgram *cordsShaderProgram;
     std::vector<GLfloat> cordsVertices;
     GLfloat cordsColor[3];
 
     ////// trajectory
-    GLuint trajectoryVAO;
-    GLuint trajectoryVBO;
-    QOpenGLShaderProgram *trajectoryShaderProgram;
-    std::vector<GLfloat> trajectoryVertices;
-    GLfloat trajectoryColor[3];
+    TrajectoryPassSettings trajectorySettings;
 };
 
 #endif // RENDERER_H
@@ -0,0 +1,58 @@
+#include "rendererdefaults.h"
+
+PointChunkRendererSettings RendererDefaults::getPointChunkRendererSettings()
+{
+    PointChunkRendererSettings settings;
+    settings.targetFrameMilliseconds = 12.f;
+    settings.minPointBudget = 500000;
+    settings.maxPointBudget = 100000000;
+    settings.pointsPerPixel = 1.f;
+    settings.pointSize = 1.f;
+    settings.bufferPointsCapacity = 1 << 22;
+    settings.renderMode = PointRenderMode::Points;
+    settings.splatPointsPerPixel = 0.1f;
+    settings.splatScale = 2.5f;
+    settings.maxSplatSize = 32.f;
+
+    return settings;
+}
+
+TrajectoryPassSettings RendererDefaults::getTrajectoryPassSettings()
+{
+    TrajectoryPassSettings settings;
+    settings.pixelTolerance = 1.f;
+    settings.segmentPosesCount = 4096;
+    settings.keyframeDistance = 0.5f;
+    settings.keyframeAngle = 30.f;
+    settings.frustumSize = 0.1f;
+    settings.minFrustumPixels = 4.f;
+    settings.pathColor[0] = 1.f;
+    settings.pathColor[1] = 0.8f;
+    settings.pathColor[2] = 0.f;
+    settings.frustumColor[0] = 0.f;
+    settings.frustumColor[1] = 0.8f;
+    settings.frustumColor[2] = 1.f;
+
+    return settings;
+}
+
+StreamingUploaderSettings RendererDefaults::getStreamingUploaderSettings()
+{
+    StreamingUploaderSettings settings;
+    settings.segmentBytes = 4 << 20;
+    settings.segmentsCount = 4;
+    settings.frameBudgetBytes = 8 << 20;
+    settings.orphanWhenBusy = true;
+
+    return settings;
+}
+
+PageStreamerSettings RendererDefaults::getPageStreamerSettings()
+{
+    PageStreamerSettings settings;
+    settings.hostBudgetBytes = size_t(1) << 30;
+    settings.gpuBudgetBytes = size_t(512) << 20;
+    settings.loaderThreadsCount = 2;
+
+    return settings;
+}
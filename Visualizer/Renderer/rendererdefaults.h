@@ -0,0 +1,18 @@
+#ifndef RENDERERDEFAULTS_H
+#define RENDERERDEFAULTS_H
+
+#include "pointchunkrenderer.h"
+#include "trajectorypass.h"
+#include "streaminguploader.h"
+#include "pagestreamer.h"
+
+//// settings shared by the widgets and the offscreen renderer, so a headless flythrough measures what the window draws
+struct RendererDefaults
+{
+    static PointChunkRendererSettings getPointChunkRendererSettings();
+    static TrajectoryPassSettings getTrajectoryPassSettings();
+    static StreamingUploaderSettings getStreamingUploaderSettings();
+    static PageStreamerSettings getPageStreamerSettings();
+};
+
+#endif // RENDERERDEFAULTS_H
@@ -0,0 +1,90 @@
+#include "renderstate.h"
+
+#include <iostream>
+#include <cstring>
+
+// constructors/destructors
+RenderState::RenderState(QOpenGLFunctions_3_3_Core *gl_functions)
+{
+    this->gl = gl_functions;
+    this->cameraBuffer = 0;
+
+    std::memset(&this->camera, 0, sizeof(CameraBlock));
+}
+
+RenderState::~RenderState()
+{
+    if(this->cameraBuffer != 0)
+    {
+        this->gl->glDeleteBuffers(1, &this->cameraBuffer);
+    }
+}
+
+// public functions
+bool RenderState::initialize()
+{
+    this->gl->glGenBuffers(1, &this->cameraBuffer);
+    this->gl->glBindBuffer(GL_UNIFORM_BUFFER, this->cameraBuffer);
+    this->gl->glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+    this->gl->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // stays bound for the lifetime of the context, programs only refer to the binding point
+    this->gl->glBindBufferBase(GL_UNIFORM_BUFFER, RenderState::cameraBindingPoint, this->cameraBuffer);
+
+    return this->gl->glGetError() == GL_NO_ERROR;
+}
+
+void RenderState::setCamera(const QMatrix4x4 &projection_matrix, const QMatrix4x4 &view_matrix, int viewport_width, int viewport_height)
+{
+    QMatrix4x4 view_projection = projection_matrix * view_matrix;
+    QVector3D eye = view_matrix.inverted().map(QVector3D(0.f, 0.f, 0.f));
+
+    std::memcpy(this->camera.projection, projection_matrix.constData(), sizeof(this->camera.projection));
+    std::memcpy(this->camera.view, view_matrix.constData(), sizeof(this->camera.view));
+    std::memcpy(this->camera.viewProjection, view_projection.constData(), sizeof(this->camera.viewProjection));
+
+    this->camera.eye[0] = eye.x();
+    this->camera.eye[1] = eye.y();
+    this->camera.eye[2] = eye.z();
+    this->camera.eye[3] = 1.f;
+
+    this->camera.viewport[0] = static_cast<float>(viewport_width);
+    this->camera.viewport[1] = static_cast<float>(viewport_height);
+    this->camera.viewport[2] = viewport_width > 0 ? 1.f / viewport_width : 0.f;
+    this->camera.viewport[3] = viewport_height > 0 ? 1.f / viewport_height : 0.f;
+
+    this->gl->glBindBuffer(GL_UNIFORM_BUFFER, this->cameraBuffer);
+    this->gl->glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &this->camera);
+    this->gl->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+QOpenGLShaderProgram *RenderState::createProgram(QOpenGLFunctions_3_3_Core *gl_functions, const QString &path_to_vertex_shader, const QString &path_to_fragment_shader)
+{
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+
+    if(!program->addShaderFromSourceFile(QOpenGLShader::Vertex, path_to_vertex_shader)
+        || !program->addShaderFromSourceFile(QOpenGLShader::Fragment, path_to_fragment_shader)
+        || !program->link())
+    {
+        std::cerr << "Failed to build shader program " << path_to_vertex_shader.toStdString() << ", "
+                  << path_to_fragment_shader.toStdString() << ": " << program->log().toStdString() << std::endl;
+
+        delete program;
+        return nullptr;
+    }
+
+    GLuint block_index = gl_functions->glGetUniformBlockIndex(program->programId(), "Camera");
+
+    if(block_index != GL_INVALID_INDEX)
+    {
+        gl_functions->glUniformBlockBinding(program->programId(), block_index, RenderState::cameraBindingPoint);
+    }
+
+    return program;
+}
+
+//// getters
+const CameraBlock &RenderState::getCamera()
+{
+    return this->camera;
+}
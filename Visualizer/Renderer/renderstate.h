@@ -0,0 +1,51 @@
+#ifndef RENDERSTATE_H
+#define RENDERSTATE_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QString>
+
+//// std140 layout of the Camera uniform block declared by every shader
+struct CameraBlock
+{
+    float projection[16];
+    float view[16];
+    float viewProjection[16];
+    float eye[4];                   // x, y, z, 1
+    float viewport[4];              // width, height in pixels, 1 / width, 1 / height
+};
+
+//// state shared by all passes of a frame; the camera lives in one uniform buffer updated once per frame
+//// and bound to a fixed binding point every program resolves its Camera block to at link time
+class RenderState
+{
+public:
+    static const GLuint cameraBindingPoint = 0;
+
+    // constructors/destructors
+    //// functions of the owning widget, its context has to be current in every call including the destructor
+    RenderState(QOpenGLFunctions_3_3_Core *gl_functions);
+    ~RenderState();
+
+    // public functions
+    bool initialize();
+
+    //// once per frame before any pass draws
+    void setCamera(const QMatrix4x4 &projection_matrix, const QMatrix4x4 &view_matrix, int viewport_width, int viewport_height);
+
+    //// builds and links a program and binds its Camera block, nullptr on failure
+    static QOpenGLShaderProgram *createProgram(QOpenGLFunctions_3_3_Core *gl_functions, const QString &path_to_vertex_shader, const QString &path_to_fragment_shader);
+
+    //// getters
+    const CameraBlock &getCamera();
+
+private:
+    // private variables
+    QOpenGLFunctions_3_3_Core *gl;
+
+    GLuint cameraBuffer;
+    CameraBlock camera;
+};
+
+#endif // RENDERSTATE_H
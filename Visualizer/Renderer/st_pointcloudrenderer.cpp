@@ -1,4 +1,8 @@
 #include "st_pointcloudrenderer.h"
+#include "spatialchunker.h"
+#include "rendererdefaults.h"
+
+#include <algorithm>
 
 // constructors/destructors
 ST_PointCloudRenderer::ST_PointCloudRenderer(QWidget *parent)
@@ -11,17 +15,170 @@ ST_PointCloudRenderer::ST_PointCloudRenderer(QWidget *parent)
 
 ST_PointCloudRenderer::~ST_PointCloudRenderer()
 {
+    this->stopIngestion();
+
+    // GL objects are released with the widget context current
+    this->makeCurrent();
+    delete this->pageStreamer;
+    delete this->chunkRenderer;
+    delete this->frameRenderer;
+    delete this->depthFrameRenderer;
+    delete this->uploader;
+    this->doneCurrent();
+
     delete this->pointCloud;
+    delete this->frameQueue;
 }
 
 // public functions
+//// getters
+PointChunkRenderStatistics ST_PointCloudRenderer::getRenderStatistics()
+{
+    if(this->chunkRenderer == nullptr)
+    {
+        return {};
+    }
+
+    return this->chunkRenderer->getStatistics();
+}
+
+StreamingUploadStatistics ST_PointCloudRenderer::getUploadStatistics()
+{
+    if(this->uploader == nullptr)
+    {
+        return {};
+    }
+
+    return this->uploader->getStatistics();
+}
+
+DepthFrameRenderStatistics ST_PointCloudRenderer::getDepthFrameStatistics()
+{
+    if(this->depthFrameRenderer == nullptr)
+    {
+        return {};
+    }
+
+    return this->depthFrameRenderer->getStatistics();
+}
+
+PageStreamerStatistics ST_PointCloudRenderer::getPageStatistics()
+{
+    if(this->pageStreamer == nullptr)
+    {
+        return {};
+    }
+
+    return this->pageStreamer->getStatistics();
+}
+
 //// setter functions
-void ST_PointCloudRenderer::setData()
+void ST_PointCloudRenderer::setData(InputData input_data)
+{
+    this->stopIngestion();
+
+    this->inputData = input_data;
+
+    delete this->pointCloud;
+    this->pointCloud = new PointCloud(this->inputData);
+
+    this->ingestionCancelled = false;
+    this->pointCloud->setCancelFlag(&this->ingestionCancelled);
+
+    delete this->frameQueue;
+    this->frameQueue = new FrameQueue(this->frameQueueCapacity);
+
+    this->ingestionFinished = false;
+    this->mapChunks.clear();
+    this->mapChunkBounds.clear();
+    this->mapChunkPoses.clear();
+    this->mapChunksQueued = false;
+    this->pathToPages.clear();
+
+    if(this->chunkRenderer != nullptr)
+    {
+        this->makeCurrent();
+        this->pageStreamer->close();
+        this->chunkRenderer->clear();
+        this->frameRenderer->clear();
+        this->depthFrameRenderer->clear();
+        this->depthFrameRenderer->setIntrinsics(this->pointCloud->getCameraIntrinsics());
+        this->depthFrameRenderer->setDepthFilter(this->inputData.depthFilter);
+        this->doneCurrent();
+
+        this->applyFramePoses();
+    }
+
+    FrameQueue *frame_queue = this->frameQueue;
+
+    // frames are packed on the ingestion workers, the render thread only copies them out; raw frames carry only images
+    this->pointCloud->setFrameSink([frame_queue](StreamedFrame &frame)
+    {
+        if(frame.chunk.points.empty() && !frame.points.empty())
+        {
+            PointQuantizer::quantize(frame.points.data(), frame.points.size() / PointsView::floatsPerPoint, frame.chunk);
+            std::vector<float>().swap(frame.points);
+        }
+
+        frame_queue->push(frame);
+    }, !this->inputData.rawFrames);
+
+    this->ingestionThread = std::thread(&ST_PointCloudRenderer::ingestPointCloud, this);
+
+    this->update();
+}
+
+bool ST_PointCloudRenderer::reloadTrajectory(const std::string &path_to_trajectory)
 {
-    this->inputData.pathToImagesDirectory = "/home/rezzec/build-CUDA_Map_Renderer-Desktop_Qt_6_5_1_GCC_64bit-Debug/office_kt0";
-    this->inputData.pathToTrajectoryFile = "/home/rezzec/build-CUDA_Map_Renderer-Desktop_Qt_6_5_1_GCC_64bit-Debug/office_kt0/traj0.txt";
-    this->inputData.pathToAssociationFile = "/home/rezzec/build-CUDA_Map_Renderer-Desktop_Qt_6_5_1_GCC_64bit-Debug/office_kt0/associations.txt";
-    this->inputData.maxIndex = 1508;
+    // ingestion workers read the poses while they transform
+    if(this->ingestionThread.joinable())
+    {
+        std::cerr << "Trajectory can not be reloaded while ingesting" << std::endl;
+        return false;
+    }
+
+    if(!this->pointCloud->reloadTrajectory(path_to_trajectory))
+    {
+        return false;
+    }
+
+    this->inputData.pathToTrajectoryFile = path_to_trajectory;
+
+    if(this->chunkRenderer != nullptr)
+    {
+        this->applyFramePoses();
+    }
+
+    this->update();
+
+    return true;
+}
+
+bool ST_PointCloudRenderer::setPageStore(const std::string &path_to_pages)
+{
+    this->stopIngestion();
+
+    this->mapChunks.clear();
+    this->mapChunkBounds.clear();
+    this->mapChunkPoses.clear();
+    this->pathToPages = path_to_pages;
+
+    if(this->chunkRenderer == nullptr)
+    {
+        return true;
+    }
+
+    this->makeCurrent();
+    this->chunkRenderer->clear();
+    this->frameRenderer->clear();
+    this->depthFrameRenderer->clear();
+
+    bool opened = this->pageStreamer->open(this->pathToPages);
+
+    this->doneCurrent();
+    this->update();
+
+    return opened;
 }
 
 // protected functions
@@ -29,17 +186,121 @@ void ST_PointCloudRenderer::setData()
 void ST_PointCloudRenderer::initializeGL()
 {
     initializeOpenGLFunctions();
+
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+
+    this->initializeRenderState();
+    this->populateTools();
+
+    this->uploader = new StreamingUploader(this, this->uploaderSettings);
+    this->uploader->initialize();
+
+    this->chunkRenderer = new PointChunkRenderer(this, this->chunkRendererSettings);
+    this->chunkRenderer->initialize();
+
+    this->frameRenderer = new PointChunkRenderer(this, this->chunkRendererSettings);
+    this->frameRenderer->initialize();
+
+    this->depthFrameRenderer = new DepthFrameRenderer(this, this->depthFrameRendererSettings);
+    this->depthFrameRenderer->initialize();
+    this->depthFrameRenderer->setIntrinsics(this->pointCloud->getCameraIntrinsics());
+    this->depthFrameRenderer->setDepthFilter(this->inputData.depthFilter);
+
+    this->pageStreamer = new PageStreamer(this->chunkRenderer, this->pageStreamerSettings);
+
+    if(!this->pathToPages.empty())
+    {
+        this->pageStreamer->open(this->pathToPages);
+    }
+
+    this->applyFramePoses();
 }
 
 void ST_PointCloudRenderer::resizeGL(int w, int h)
 {
+    this->viewportHeight = static_cast<int>(h * this->devicePixelRatio());
 
+    this->projectionMatrix.setToIdentity();
+    this->projectionMatrix.perspective(60.f, static_cast<float>(w) / static_cast<float>(std::max(h, 1)), 0.05f, 1000.f);
 }
 
 void ST_PointCloudRenderer::paintGL()
 {
-    // Clear the screen
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    {
+        ScopedTimer frame_timer(ProfileStage::RenderFrame);
+
+        // the profiler overlay paints with QPainter, which leaves its own state behind
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+
+        // Clear the screen
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        this->gpuProfiler->beginFrame();
+
+        {
+            ScopedTimer upload_timer(ProfileStage::Upload);
+            if(this->pageStreamer->isOpen())
+            {
+                this->streamPages();
+            }
+            else if(this->inputData.rawFrames)
+            {
+                this->streamRawFrames();
+            }
+            else
+            {
+                this->streamFrames();
+            }
+        }
+
+        this->updateRenderState();
+
+        this->gpuProfiler->beginPass(ProfileStage::GpuPoints);
+        this->chunkRenderer->render(this->projectionMatrix, this->viewMatrix, this->modelMatrix, this->viewportHeight);
+        this->frameRenderer->render(this->projectionMatrix, this->viewMatrix, this->modelMatrix, this->viewportHeight);
+        this->depthFrameRenderer->render(this->projectionMatrix, this->viewMatrix, this->modelMatrix);
+        this->gpuProfiler->endPass();
+
+        this->gpuProfiler->beginPass(ProfileStage::GpuOverlay);
+        this->showTools();
+        this->showTrajectory();
+        this->gpuProfiler->endPass();
+    }
+
+    Profiler::endFrame();
+    this->showProfilerOverlay();
+
+    // keep drawing while data is on its way
+    if(this->ingestionThread.joinable() || this->chunkRenderer->getStatistics().queuedChunksCount > 0
+       || this->depthFrameRenderer->getStatistics().queuedFramesCount > 0 || this->pageStreamer->getStatistics().pendingPagesCount > 0)
+    {
+        this->update();
+    }
+}
+
+void ST_PointCloudRenderer::keyPressEvent(QKeyEvent *event)
+{
+    // S cycles through points, splats and depth-correct splats, e.g. to compare them in the profiler overlay
+    if(event->key() == Qt::Key_S && this->chunkRenderer != nullptr)
+    {
+        int modes_count = static_cast<int>(PointRenderMode::Count);
+        PointRenderMode render_mode = static_cast<PointRenderMode>((static_cast<int>(this->chunkRenderer->getRenderMode()) + 1) % modes_count);
+
+        this->chunkRenderer->setRenderMode(render_mode);
+        this->frameRenderer->setRenderMode(render_mode);
+        this->update();
+        return;
+    }
+
+    if(event->key() != Qt::Key_R || !(this->inputData.frameLocalPoints || this->inputData.rawFrames))
+    {
+        Renderer::keyPressEvent(event);
+        return;
+    }
+
+    this->reloadTrajectory(this->inputData.pathToTrajectoryFile);
 }
 
 // private functions
@@ -49,5 +310,216 @@ void ST_PointCloudRenderer::initVariables()
     this->inputData.pathToImagesDirectory = "";
     this->inputData.pathToTrajectoryFile = "";
     this->inputData.pathToAssociationFile = "";
+    this->inputData.pathToIntrinsicsFile = "";
+    this->inputData.pathToCacheFile = "";
+    this->inputData.pathToConfidenceDirectory = "";
     this->inputData.maxIndex = 0;
+    this->inputData.threadsCount = 0;
+    this->inputData.ioThreadsCount = 0;
+    this->inputData.prefetchDepth = 0;
+    this->inputData.transformKernel = TransformKernel::Vectorized;
+    this->inputData.pointFormat = PointFormat::Compact;
+    this->inputData.voxelSize = 0.f;
+    this->inputData.tsdfVoxelSize = 0.f;
+    this->inputData.tsdfTruncation = 0.f;
+    this->inputData.octreeMaxDepth = 0;
+    this->inputData.frameLocalPoints = false;
+    this->inputData.rawFrames = false;
+    this->inputData.depthFilter = { true, 0.f, 0.f, 0.05f, 1 };
+
+    this->frameQueue = nullptr;
+    this->frameQueueCapacity = 8;
+    this->ingestionFinished = false;
+    this->ingestionCancelled = false;
+    this->mapChunksQueued = false;
+
+    this->chunkRenderer = nullptr;
+    this->frameRenderer = nullptr;
+    this->chunkRendererSettings = RendererDefaults::getPointChunkRendererSettings();
+
+    this->depthFrameRenderer = nullptr;
+    this->depthFrameRendererSettings.pointSize = 1.f;
+    this->depthFrameRendererSettings.bufferPixelsCapacity = 1 << 22;
+
+    this->uploader = nullptr;
+    this->uploaderSettings = RendererDefaults::getStreamingUploaderSettings();
+
+    this->pageStreamer = nullptr;
+    this->pageStreamerSettings = RendererDefaults::getPageStreamerSettings();
+
+    this->chunkSize = 1.f;
+    this->viewportHeight = 1;
+}
+
+//// ingestion
+void ST_PointCloudRenderer::ingestPointCloud()
+{
+    this->pointCloud->iterateThroughImages();
+    this->frameQueue->close();
+
+    if(this->ingestionCancelled)
+    {
+        return;
+    }
+
+    // raw frames are drawn as they were streamed, there is no cloud to regroup
+    if(this->inputData.rawFrames)
+    {
+        this->ingestionFinished = true;
+        return;
+    }
+
+    // frame-local points can not be regrouped in space, every frame stays a chunk drawn through its pose
+    if(this->inputData.frameLocalPoints)
+    {
+        const std::vector<LocalFrame> &local_frames = this->pointCloud->getLocalFrames();
+
+        this->mapChunks.resize(local_frames.size());
+        this->mapChunkPoses.resize(local_frames.size());
+
+        for(size_t i = 0; i < local_frames.size(); ++i)
+        {
+            const LocalFrame &local_frame = local_frames[i];
+
+            if(this->pointCloud->getPointFormat() == PointFormat::Compact)
+            {
+                this->mapChunks[i] = this->pointCloud->getPointChunks()[local_frame.first];
+            }
+            else
+            {
+                const float *points = this->pointCloud->getPointsView().data + local_frame.first * PointsView::floatsPerPoint;
+                PointQuantizer::quantize(points, local_frame.pointsCount, this->mapChunks[i]);
+            }
+
+            this->mapChunkPoses[i] = local_frame.frameIndex;
+        }
+
+        this->ingestionFinished = true;
+        return;
+    }
+
+    // regroup the whole cloud while the render thread keeps showing the streamed frames
+    SpatialChunker chunker(this->chunkSize);
+
+    if(this->pointCloud->getPointFormat() == PointFormat::Compact)
+    {
+        for(const PointChunk &chunk : this->pointCloud->getPointChunks())
+        {
+            chunker.add(chunk);
+        }
+    }
+    else
+    {
+        PointsView points_view = this->pointCloud->getPointsView();
+        chunker.add(points_view.data, points_view.pointsCount);
+    }
+
+    chunker.finish(this->mapChunks, this->mapChunkBounds);
+
+    this->ingestionFinished = true;
+}
+
+void ST_PointCloudRenderer::stopIngestion()
+{
+    if(!this->ingestionThread.joinable())
+    {
+        return;
+    }
+
+    // workers skip the frames they have not started yet, ones blocked on a full queue resume once it is closed
+    this->ingestionCancelled = true;
+    this->frameQueue->close();
+    this->ingestionThread.join();
+}
+
+//// streaming
+void ST_PointCloudRenderer::streamFrames()
+{
+    this->uploader->beginFrame();
+
+    // one frame is pulled at a time, the bounded queue holds back ingestion while the budget is spent
+    bool frames_uploaded = this->frameRenderer->uploadQueuedChunks(*this->uploader);
+    StreamedFrame frame;
+
+    while(frames_uploaded && !this->mapChunksQueued && this->uploader->getRemainingBudget() > 0
+          && this->frameQueue != nullptr && this->frameQueue->tryPop(frame))
+    {
+        this->frameRenderer->queueChunk(std::move(frame.chunk), this->inputData.frameLocalPoints ? frame.frameIndex : -1);
+        frames_uploaded = this->frameRenderer->uploadQueuedChunks(*this->uploader);
+    }
+
+    if(this->ingestionFinished && !this->mapChunksQueued)
+    {
+        this->ingestionThread.join();
+
+        for(size_t i = 0; i < this->mapChunks.size(); ++i)
+        {
+            if(this->mapChunkPoses.empty())
+            {
+                this->chunkRenderer->queueChunk(std::move(this->mapChunks[i]), this->mapChunkBounds[i]);
+            }
+            else
+            {
+                this->chunkRenderer->queueChunk(std::move(this->mapChunks[i]), this->mapChunkPoses[i]);
+            }
+        }
+
+        this->mapChunks.clear();
+        this->mapChunkBounds.clear();
+        this->mapChunkPoses.clear();
+        this->mapChunksQueued = true;
+    }
+
+    // once the whole cloud is on the GPU the streamed frames only duplicate it
+    if(this->mapChunksQueued && this->chunkRenderer->uploadQueuedChunks(*this->uploader) && this->frameRenderer->getStatistics().chunksCount > 0)
+    {
+        this->frameRenderer->clear();
+    }
+}
+
+void ST_PointCloudRenderer::streamRawFrames()
+{
+    this->uploader->beginFrame();
+
+    bool frames_uploaded = this->depthFrameRenderer->uploadQueuedFrames(*this->uploader);
+    bool queue_drained = false;
+    StreamedFrame frame;
+
+    while(frames_uploaded && this->uploader->getRemainingBudget() > 0 && this->frameQueue != nullptr)
+    {
+        if(!this->frameQueue->tryPop(frame))
+        {
+            queue_drained = true;
+            break;
+        }
+
+        this->depthFrameRenderer->queueFrame(frame.frameIndex, frame.depthImage, frame.rgbImage);
+        frames_uploaded = this->depthFrameRenderer->uploadQueuedFrames(*this->uploader);
+    }
+
+    // the queue is closed before ingestion finishes, frames still in it keep the thread joinable and frames drawn
+    if(this->ingestionFinished && queue_drained && this->ingestionThread.joinable())
+    {
+        this->ingestionThread.join();
+    }
+}
+
+void ST_PointCloudRenderer::streamPages()
+{
+    this->uploader->beginFrame();
+    this->pageStreamer->update(this->projectionMatrix, this->viewMatrix, this->modelMatrix, *this->uploader);
+}
+
+void ST_PointCloudRenderer::applyFramePoses()
+{
+    std::vector<FramePose> frame_poses = this->pointCloud->getFramePoses();
+
+    this->chunkRenderer->setPoses(frame_poses);
+    this->frameRenderer->setPoses(frame_poses);
+    this->depthFrameRenderer->setPoses(frame_poses);
+
+    // the camera path follows the poses too, it is uploaded on the next draw
+    float trajectory_color[3] = {1.f, 0.8f, 0.f};
+
+    this->populateTrajectory(this->pointCloud->getTrajectory(), this->pointCloud->getCameraIntrinsics(), trajectory_color);
 }
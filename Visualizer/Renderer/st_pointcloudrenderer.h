@@ -3,6 +3,14 @@
 
 #include "renderer.h"
 #include "pointcloud.h"
+#include "framequeue.h"
+#include "pointchunkrenderer.h"
+#include "depthframerenderer.h"
+#include "streaminguploader.h"
+#include "pagestreamer.h"
+
+#include <thread>
+#include <atomic>
 
 class ST_PointCloudRenderer : public Renderer
 {
@@ -12,8 +20,22 @@ public:
     ~ST_PointCloudRenderer();
 
     // public functions
+    //// getters
+    PointChunkRenderStatistics getRenderStatistics();
+    StreamingUploadStatistics getUploadStatistics();
+    DepthFrameRenderStatistics getDepthFrameStatistics();
+    PageStreamerStatistics getPageStatistics();
+
     //// setter functions
-    void setData();
+    ////// replaces the point cloud with one built from input_data; frames are ingested on a background thread and shown
+    ////// as they arrive, once ingestion finishes they are replaced by spatial chunks of the whole cloud
+    void setData(InputData input_data);
+    ////// with InputData::frameLocalPoints or InputData::rawFrames the shown points move to the new poses without
+    ////// re-ingestion, R reloads the current trajectory file; fails while ingesting
+    bool reloadTrajectory(const std::string &path_to_trajectory);
+    ////// replaces the point cloud with a page store written by mapbuilder --pages, which may exceed memory; pages around
+    ////// the camera are streamed in within the budgets of PageStreamerSettings, setData closes the store again
+    bool setPageStore(const std::string &path_to_pages);
 
 protected:
     // protected functions
@@ -22,18 +44,57 @@ protected:
     void resizeGL(int w, int h) override;
     void paintGL() override;
 
+    //// S cycles the point render modes of both chunk renderers
+    void keyPressEvent(QKeyEvent *event) override;
+
 private:
     // private functions
     //// init functions
     void initVariables();
 
+    //// ingestion
+    void ingestPointCloud();
+    void stopIngestion();
+
+    //// streaming, within the upload budget of one frame
+    void streamFrames();
+    ////// InputData::rawFrames, the images are uploaded as they are and back-projected while drawing
+    void streamRawFrames();
+    ////// pages of the open store, prioritized for the camera of the previous frame
+    void streamPages();
+
+    //// poses of frame-local chunks for both chunk renderers, of the raw frames and of the camera path
+    void applyFramePoses();
+
     // private variables
     //// Point Cloud data
     InputData inputData;
     PointCloud *pointCloud;
 
+    //// ingestion thread
+    std::thread ingestionThread;
+    FrameQueue *frameQueue;
+    std::atomic<bool> ingestionFinished;
+    std::atomic<bool> ingestionCancelled;   // set by stopIngestion, the workers skip their remaining frames
+    std::vector<PointChunk> mapChunks;      // spatial chunks of the whole cloud, written by the ingestion thread
+    std::vector<BoundingBox> mapChunkBounds;   // empty for frame-local chunks, which keep one chunk per frame
+    std::vector<int> mapChunkPoses;
+    bool mapChunksQueued;
+
     //// OpenGL variables
-    float pointsData[];
+    PointChunkRenderer *chunkRenderer;      // spatial chunks of the whole cloud
+    PointChunkRenderer *frameRenderer;      // frames streamed in while ingesting
+    PointChunkRendererSettings chunkRendererSettings;
+    DepthFrameRenderer *depthFrameRenderer; // raw frames back-projected on the GPU
+    DepthFrameRendererSettings depthFrameRendererSettings;
+    StreamingUploader *uploader;
+    StreamingUploaderSettings uploaderSettings;
+    PageStreamer *pageStreamer;             // draws through chunkRenderer while a page store is open
+    PageStreamerSettings pageStreamerSettings;
+    std::string pathToPages;                // opened once the context exists
+    size_t frameQueueCapacity;
+    float chunkSize;                        // edge of the cubic spatial chunks in scene units
+    int viewportHeight;
 };
 
 #endif // ST_POINTCLOUDRENDERER_H
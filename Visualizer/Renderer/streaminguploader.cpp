@@ -0,0 +1,195 @@
+#include "streaminguploader.h"
+#include "profiler.h"
+
+#include <iostream>
+#include <algorithm>
+
+// constructors/destructors
+StreamingUploader::StreamingUploader(QOpenGLFunctions_3_3_Core *gl_functions, StreamingUploaderSettings settings)
+{
+    this->gl = gl_functions;
+    this->settings = settings;
+    this->settings.segmentsCount = std::max<size_t>(2, this->settings.segmentsCount);
+
+    this->stagingBuffer = 0;
+    this->segmentFences.assign(this->settings.segmentsCount, nullptr);
+    this->segment = 0;
+    this->segmentOffset = 0;
+    this->segmentAcquired = false;
+
+    this->remainingBudget = this->settings.frameBudgetBytes;
+    this->orphanedThisFrame = false;
+    this->statistics = {};
+}
+
+StreamingUploader::~StreamingUploader()
+{
+    for(GLsync &fence : this->segmentFences)
+    {
+        if(fence != nullptr)
+        {
+            this->gl->glDeleteSync(fence);
+        }
+    }
+
+    if(this->stagingBuffer != 0)
+    {
+        this->gl->glDeleteBuffers(1, &this->stagingBuffer);
+    }
+}
+
+// public functions
+bool StreamingUploader::initialize()
+{
+    this->gl->glGenBuffers(1, &this->stagingBuffer);
+    this->gl->glBindBuffer(GL_COPY_READ_BUFFER, this->stagingBuffer);
+    this->gl->glBufferData(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(this->settings.segmentBytes * this->settings.segmentsCount), nullptr, GL_STREAM_DRAW);
+    this->gl->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    if(this->gl->glGetError() != GL_NO_ERROR)
+    {
+        std::cerr << "Failed to allocate staging buffer of " << this->settings.segmentBytes * this->settings.segmentsCount << " bytes" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void StreamingUploader::beginFrame()
+{
+    this->remainingBudget = this->settings.frameBudgetBytes;
+    this->orphanedThisFrame = false;
+    this->statistics.frameBytes = 0;
+}
+
+size_t StreamingUploader::upload(GLuint target_buffer, size_t target_offset, size_t count, size_t element_size, const UploadWriter &writer)
+{
+    if(this->stagingBuffer == 0 || element_size == 0 || element_size > this->settings.segmentBytes)
+    {
+        return 0;
+    }
+
+    size_t uploaded = 0;
+
+    this->gl->glBindBuffer(GL_COPY_READ_BUFFER, this->stagingBuffer);
+    this->gl->glBindBuffer(GL_COPY_WRITE_BUFFER, target_buffer);
+
+    while(uploaded < count && this->remainingBudget >= element_size)
+    {
+        if(!this->segmentAcquired && !this->acquireSegment())
+        {
+            break;
+        }
+
+        size_t batch = std::min({ count - uploaded,
+                                  (this->settings.segmentBytes - this->segmentOffset) / element_size,
+                                  this->remainingBudget / element_size });
+
+        if(batch == 0)
+        {
+            this->closeSegment();
+            continue;
+        }
+
+        size_t bytes = batch * element_size;
+        size_t staging_offset = this->segment * this->settings.segmentBytes + this->segmentOffset;
+
+        // the fence of this segment has signalled, nothing in flight reads the range being written
+        void *mapped = this->gl->glMapBufferRange(GL_COPY_READ_BUFFER, static_cast<GLintptr>(staging_offset), static_cast<GLsizeiptr>(bytes),
+                                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+        if(mapped == nullptr)
+        {
+            std::cerr << "Failed to map staging buffer range of " << bytes << " bytes" << std::endl;
+            break;
+        }
+
+        writer(mapped, uploaded, batch);
+
+        // the data store was lost, the same elements are written again on the next call
+        if(this->gl->glUnmapBuffer(GL_COPY_READ_BUFFER) == GL_FALSE)
+        {
+            break;
+        }
+
+        this->gl->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(staging_offset),
+                                      static_cast<GLintptr>(target_offset + uploaded * element_size), static_cast<GLsizeiptr>(bytes));
+
+        this->segmentOffset += bytes;
+        this->remainingBudget -= bytes;
+        this->statistics.frameBytes += bytes;
+        this->statistics.totalBytes += bytes;
+        Profiler::count(ProfileCounter::BytesUploaded, bytes);
+        uploaded += batch;
+    }
+
+    this->gl->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    this->gl->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    return uploaded;
+}
+
+//// getters
+size_t StreamingUploader::getRemainingBudget()
+{
+    return this->remainingBudget;
+}
+
+StreamingUploadStatistics StreamingUploader::getStatistics()
+{
+    return this->statistics;
+}
+
+// private functions
+bool StreamingUploader::acquireSegment()
+{
+    GLsync &fence = this->segmentFences[this->segment];
+
+    if(fence != nullptr)
+    {
+        GLenum status = this->gl->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+        if(status == GL_TIMEOUT_EXPIRED)
+        {
+            this->statistics.busySegments += 1;
+
+            if(!this->settings.orphanWhenBusy || this->orphanedThisFrame)
+            {
+                return false;
+            }
+
+            // fresh storage for the whole ring, the old one lives on until the copies reading it complete
+            this->gl->glBufferData(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(this->settings.segmentBytes * this->settings.segmentsCount), nullptr, GL_STREAM_DRAW);
+
+            for(GLsync &segment_fence : this->segmentFences)
+            {
+                if(segment_fence != nullptr)
+                {
+                    this->gl->glDeleteSync(segment_fence);
+                    segment_fence = nullptr;
+                }
+            }
+
+            this->orphanedThisFrame = true;
+            this->statistics.orphanedBuffers += 1;
+        }
+        else
+        {
+            this->gl->glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    this->segmentOffset = 0;
+    this->segmentAcquired = true;
+
+    return true;
+}
+
+void StreamingUploader::closeSegment()
+{
+    this->segmentFences[this->segment] = this->gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    this->segment = (this->segment + 1) % this->settings.segmentsCount;
+    this->segmentAcquired = false;
+}
@@ -0,0 +1,73 @@
+#ifndef STREAMINGUPLOADER_H
+#define STREAMINGUPLOADER_H
+
+#include <QOpenGLFunctions_3_3_Core>
+
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+struct StreamingUploaderSettings
+{
+    size_t segmentBytes;            // staging ring segment, one fence guards every copy out of it
+    size_t segmentsCount;
+    size_t frameBudgetBytes;        // bytes copied per rendered frame, bursts are spread over the following frames
+    bool orphanWhenBusy;            // replace the staging storage instead of waiting when the ring wraps onto copies in flight
+};
+
+struct StreamingUploadStatistics
+{
+    size_t frameBytes;              // uploaded since beginFrame
+    size_t totalBytes;
+    size_t busySegments;            // ring wrapped onto a segment the GPU still read
+    size_t orphanedBuffers;
+};
+
+//// fills count elements starting at first_element of the source into destination
+using UploadWriter = std::function<void(void *destination, size_t first_element, size_t count)>;
+
+//// copies data into buffer objects through a ring of staging segments; segments are written through
+//// unsynchronized, invalidating maps and reused only once the fence after their last copy has signalled
+class StreamingUploader
+{
+public:
+    // constructors/destructors
+    //// functions of the owning widget, its context has to be current in every call including the destructor
+    StreamingUploader(QOpenGLFunctions_3_3_Core *gl_functions, StreamingUploaderSettings settings);
+    ~StreamingUploader();
+
+    // public functions
+    bool initialize();
+
+    //// resets the per-frame budget, call once per rendered frame before uploading
+    void beginFrame();
+
+    //// copies elements produced by writer into target_buffer starting at target_offset bytes, returns the number of
+    //// elements copied, fewer than count once the frame budget is spent or the ring is still in flight
+    size_t upload(GLuint target_buffer, size_t target_offset, size_t count, size_t element_size, const UploadWriter &writer);
+
+    //// getters
+    size_t getRemainingBudget();
+    StreamingUploadStatistics getStatistics();
+
+private:
+    // private functions
+    bool acquireSegment();
+    void closeSegment();
+
+    // private variables
+    QOpenGLFunctions_3_3_Core *gl;
+    StreamingUploaderSettings settings;
+
+    GLuint stagingBuffer;
+    std::vector<GLsync> segmentFences;
+    size_t segment;
+    size_t segmentOffset;
+    bool segmentAcquired;
+
+    size_t remainingBudget;
+    bool orphanedThisFrame;
+    StreamingUploadStatistics statistics;
+};
+
+#endif // STREAMINGUPLOADER_H
@@ -0,0 +1,640 @@
+#include "trajectorypass.h"
+#include "renderstate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// constructors/destructors
+TrajectoryPass::TrajectoryPass(QOpenGLFunctions_3_3_Core *gl_functions, TrajectoryPassSettings settings)
+{
+    this->gl = gl_functions;
+    this->settings = settings;
+
+    // keyframe frustums collapse to their apex until the loaded intrinsics are set
+    for(int i = 0; i < 4; ++i)
+    {
+        this->frustumCorners[i][0] = 0.f;
+        this->frustumCorners[i][1] = 0.f;
+        this->frustumCorners[i][2] = 0.f;
+    }
+
+    this->shaderProgram = nullptr;
+    this->modelMatrixLocation = -1;
+
+    this->pathVao = 0;
+    this->frustumVao = 0;
+    this->pathBuffer = 0;
+    this->indexBuffer = 0;
+    this->frustumBuffer = 0;
+    this->pathCapacity = 0;
+    this->indexCapacity = 0;
+    this->frustumCapacity = 0;
+
+    this->statistics = {};
+
+    this->clear();
+}
+
+TrajectoryPass::~TrajectoryPass()
+{
+    if(this->pathVao != 0)
+    {
+        this->gl->glDeleteVertexArrays(1, &this->pathVao);
+        this->gl->glDeleteVertexArrays(1, &this->frustumVao);
+    }
+
+    this->gl->glDeleteBuffers(1, &this->pathBuffer);
+    this->gl->glDeleteBuffers(1, &this->indexBuffer);
+    this->gl->glDeleteBuffers(1, &this->frustumBuffer);
+
+    delete this->shaderProgram;
+}
+
+// public functions
+bool TrajectoryPass::initialize()
+{
+    // the overlay program, colours come from a constant attribute instead of per-vertex data
+    this->shaderProgram = RenderState::createProgram(this->gl, "Visualizer/Shaders/OverlayVertexShader.vert", "Visualizer/Shaders/OverlayFragmentShader.frag");
+
+    if(this->shaderProgram == nullptr)
+    {
+        return false;
+    }
+
+    this->modelMatrixLocation = this->gl->glGetUniformLocation(this->shaderProgram->programId(), "model");
+
+    this->gl->glGenVertexArrays(1, &this->pathVao);
+    this->gl->glGenVertexArrays(1, &this->frustumVao);
+
+    return true;
+}
+
+void TrajectoryPass::setIntrinsics(const CameraIntrinsics &intrinsics)
+{
+    float width = intrinsics.width > 0 ? static_cast<float>(intrinsics.width) : 2.f * intrinsics.cx + 1.f;
+    float height = intrinsics.height > 0 ? static_cast<float>(intrinsics.height) : 2.f * intrinsics.cy + 1.f;
+
+    // image corners in order around the frame, camera x follows the rows and y the columns like the back-projection
+    const float pixels[4][2] = { { 0.f, 0.f }, { width - 1.f, 0.f }, { width - 1.f, height - 1.f }, { 0.f, height - 1.f } };
+
+    for(int i = 0; i < 4; ++i)
+    {
+        this->frustumCorners[i][0] = (pixels[i][1] - intrinsics.cy) / intrinsics.focal_y;
+        this->frustumCorners[i][1] = -(pixels[i][0] - intrinsics.cx) / intrinsics.focal_x;
+        this->frustumCorners[i][2] = 1.f;
+    }
+}
+
+void TrajectoryPass::setPathColor(const float path_color[3])
+{
+    for(int i = 0; i < 3; ++i)
+    {
+        this->settings.pathColor[i] = path_color[i];
+    }
+}
+
+void TrajectoryPass::appendPoses(const std::vector<FramePose> &poses)
+{
+    if(poses.empty())
+    {
+        return;
+    }
+
+    for(const FramePose &pose : poses)
+    {
+        this->appendPose(pose);
+    }
+
+    // closed segments were simplified while closing, the open one once per call
+    this->simplifyOpenSegment();
+}
+
+void TrajectoryPass::clear()
+{
+    // GPU buffers keep their capacity, their contents are overwritten from the start
+    this->pendingPositions.clear();
+    this->pendingFrustumVertices.clear();
+    this->pendingClosedIndices.clear();
+    this->openIndices.clear();
+    this->uploadedPosesCount = 0;
+    this->uploadedFrustumVerticesCount = 0;
+    this->uploadedClosedIndicesCount = 0;
+    this->openIndicesChanged = false;
+
+    this->segments.clear();
+    this->openPositions.clear();
+    this->posesCount = 0;
+    this->closedIndicesCount = 0;
+    this->keyframesCount = 0;
+    this->lastKeyframe = BackProjectionKernel::getIdentityPose();
+
+    this->statistics.posesCount = 0;
+    this->statistics.keyframesCount = 0;
+    this->statistics.segmentsCount = 0;
+}
+
+void TrajectoryPass::render(const QMatrix4x4 &projection_matrix, const QMatrix4x4 &view_matrix, const QMatrix4x4 &model_matrix, int viewport_height)
+{
+    this->statistics.visibleSegmentsCount = 0;
+    this->statistics.drawnVerticesCount = 0;
+    this->statistics.drawnKeyframesCount = 0;
+
+    if(this->shaderProgram == nullptr || this->segments.empty())
+    {
+        return;
+    }
+
+    this->upload();
+
+    // segment bounds live in model space, test them against the frustum and eye brought into that space
+    QMatrix4x4 model_view_projection = projection_matrix * view_matrix * model_matrix;
+    Frustum frustum = Frustum::fromMatrix(model_view_projection.constData());
+
+    QVector3D eye = (view_matrix * model_matrix).inverted().map(QVector3D(0.f, 0.f, 0.f));
+
+    // pixels covered by a unit length at unit distance
+    const float pixels_per_unit = 0.5f * static_cast<float>(viewport_height) * projection_matrix(1, 1);
+
+    this->gl->glUseProgram(this->shaderProgram->programId());
+    this->gl->glUniformMatrix4fv(this->modelMatrixLocation, 1, GL_FALSE, model_matrix.constData());
+
+    this->gl->glBindVertexArray(this->pathVao);
+    this->gl->glVertexAttrib3fv(1, this->settings.pathColor);
+
+    // keyframe runs of the segments close enough for their frustums to show, adjacent runs are merged
+    std::vector<GLint> frustum_firsts;
+    std::vector<GLsizei> frustum_counts;
+
+    for(const TrajectorySegment &segment : this->segments)
+    {
+        if(!frustum.intersects(segment.bounds))
+        {
+            continue;
+        }
+
+        // the nearest point of the segment decides how much of it is needed
+        float distance_squared = 0.f;
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            float outside = std::max({ segment.bounds.min[axis] - eye[axis], 0.f, eye[axis] - segment.bounds.max[axis] });
+            distance_squared += outside * outside;
+        }
+
+        float distance = std::max(std::sqrt(distance_squared), 1e-3f);
+        float world_tolerance = this->settings.pixelTolerance * distance / pixels_per_unit;
+
+        int level = 0;
+
+        while(level < segment.levelsCount && segment.levelTolerances[level] > world_tolerance)
+        {
+            ++level;
+        }
+
+        if(level < segment.levelsCount)
+        {
+            this->gl->glDrawElements(GL_LINE_STRIP, segment.levelCounts[level], GL_UNSIGNED_INT,
+                                     reinterpret_cast<const void *>(static_cast<size_t>(segment.levelFirsts[level]) * sizeof(GLuint)));
+            this->statistics.drawnVerticesCount += static_cast<size_t>(segment.levelCounts[level]);
+        }
+        else
+        {
+            this->gl->glDrawArrays(GL_LINE_STRIP, segment.firstPose, segment.posesCount);
+            this->statistics.drawnVerticesCount += static_cast<size_t>(segment.posesCount);
+        }
+
+        this->statistics.visibleSegmentsCount += 1;
+
+        if(segment.keyframesCount == 0 || this->settings.frustumSize * pixels_per_unit / distance < this->settings.minFrustumPixels)
+        {
+            continue;
+        }
+
+        if(!frustum_firsts.empty() && frustum_firsts.back() + frustum_counts.back() == segment.firstKeyframe)
+        {
+            frustum_counts.back() += segment.keyframesCount;
+        }
+        else
+        {
+            frustum_firsts.push_back(segment.firstKeyframe);
+            frustum_counts.push_back(segment.keyframesCount);
+        }
+    }
+
+    if(!frustum_firsts.empty())
+    {
+        this->gl->glBindVertexArray(this->frustumVao);
+        this->gl->glVertexAttrib3fv(1, this->settings.frustumColor);
+
+        // eight lines per keyframe
+        for(size_t i = 0; i < frustum_firsts.size(); ++i)
+        {
+            this->gl->glDrawArrays(GL_LINES, 16 * frustum_firsts[i], 16 * frustum_counts[i]);
+            this->statistics.drawnKeyframesCount += static_cast<size_t>(frustum_counts[i]);
+        }
+    }
+
+    this->gl->glBindVertexArray(0);
+    this->gl->glUseProgram(0);
+}
+
+//// getters
+TrajectoryRenderStatistics TrajectoryPass::getStatistics()
+{
+    return this->statistics;
+}
+
+// private functions
+void TrajectoryPass::appendPose(const FramePose &pose)
+{
+    const float *position = pose.translation;
+
+    // a full segment closes with its final simplification, the next one starts at its last pose
+    if(this->segments.empty() || static_cast<size_t>(this->segments.back().posesCount) >= this->settings.segmentPosesCount)
+    {
+        bool continued = !this->segments.empty();
+
+        if(continued)
+        {
+            this->simplifyOpenSegment();
+
+            this->closedIndicesCount += this->openIndices.size();
+            this->pendingClosedIndices.insert(this->pendingClosedIndices.end(), this->openIndices.begin(), this->openIndices.end());
+            this->openIndices.clear();
+            this->openIndicesChanged = false;
+
+            this->openPositions.erase(this->openPositions.begin(), this->openPositions.end() - 3);
+        }
+
+        TrajectorySegment segment;
+        segment.firstPose = static_cast<GLint>(continued ? this->posesCount - 1 : this->posesCount);
+        segment.posesCount = continued ? 1 : 0;
+        segment.levelsCount = 0;
+        segment.firstKeyframe = static_cast<GLint>(this->keyframesCount);
+        segment.keyframesCount = 0;
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            segment.bounds.min[axis] = continued ? this->openPositions[axis] : position[axis];
+            segment.bounds.max[axis] = segment.bounds.min[axis];
+        }
+
+        this->segments.push_back(segment);
+        this->statistics.segmentsCount = this->segments.size();
+    }
+
+    TrajectorySegment &segment = this->segments.back();
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        segment.bounds.min[axis] = std::min(segment.bounds.min[axis], position[axis]);
+        segment.bounds.max[axis] = std::max(segment.bounds.max[axis], position[axis]);
+    }
+
+    this->pendingPositions.insert(this->pendingPositions.end(), position, position + 3);
+    this->openPositions.insert(this->openPositions.end(), position, position + 3);
+    segment.posesCount += 1;
+    this->posesCount += 1;
+
+    if(this->isKeyframe(pose))
+    {
+        this->appendKeyframe(pose);
+    }
+
+    this->statistics.posesCount = this->posesCount;
+}
+
+bool TrajectoryPass::isKeyframe(const FramePose &pose)
+{
+    if(this->keyframesCount == 0)
+    {
+        return true;
+    }
+
+    float distance_squared = 0.f;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        float delta = pose.translation[axis] - this->lastKeyframe.translation[axis];
+        distance_squared += delta * delta;
+    }
+
+    // trace of the relative rotation gives its angle
+    float trace = 0.f;
+
+    for(int i = 0; i < 9; ++i)
+    {
+        trace += pose.rotation[i] * this->lastKeyframe.rotation[i];
+    }
+
+    float angle = std::acos(std::clamp(0.5f * (trace - 1.f), -1.f, 1.f)) * 180.f / 3.14159265f;
+
+    return distance_squared >= this->settings.keyframeDistance * this->settings.keyframeDistance || angle >= this->settings.keyframeAngle;
+}
+
+void TrajectoryPass::appendKeyframe(const FramePose &pose)
+{
+    const float *r = pose.rotation;
+    const float *t = pose.translation;
+    const float size = this->settings.frustumSize;
+
+    float corners[4][3];
+
+    for(int i = 0; i < 4; ++i)
+    {
+        const float *c = this->frustumCorners[i];
+
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            corners[i][axis] = (r[3 * axis] * c[0] + r[3 * axis + 1] * c[1] + r[3 * axis + 2] * c[2]) * size + t[axis];
+        }
+    }
+
+    // camera centre to every corner, then the image rectangle
+    for(int i = 0; i < 4; ++i)
+    {
+        this->pendingFrustumVertices.insert(this->pendingFrustumVertices.end(), t, t + 3);
+        this->pendingFrustumVertices.insert(this->pendingFrustumVertices.end(), corners[i], corners[i] + 3);
+    }
+
+    for(int i = 0; i < 4; ++i)
+    {
+        this->pendingFrustumVertices.insert(this->pendingFrustumVertices.end(), corners[i], corners[i] + 3);
+        this->pendingFrustumVertices.insert(this->pendingFrustumVertices.end(), corners[(i + 1) % 4], corners[(i + 1) % 4] + 3);
+    }
+
+    TrajectorySegment &segment = this->segments.back();
+
+    for(int i = 0; i < 4; ++i)
+    {
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            segment.bounds.min[axis] = std::min(segment.bounds.min[axis], corners[i][axis]);
+            segment.bounds.max[axis] = std::max(segment.bounds.max[axis], corners[i][axis]);
+        }
+    }
+
+    segment.keyframesCount += 1;
+    this->keyframesCount += 1;
+    this->lastKeyframe = pose;
+
+    this->statistics.keyframesCount = this->keyframesCount;
+}
+
+void TrajectoryPass::simplifyOpenSegment()
+{
+    if(this->segments.empty())
+    {
+        return;
+    }
+
+    TrajectorySegment &segment = this->segments.back();
+    const float *positions = this->openPositions.data();
+    const size_t count = this->openPositions.size() / 3;
+
+    this->openIndices.clear();
+    this->openIndicesChanged = true;
+    segment.levelsCount = 0;
+
+    if(count < 3)
+    {
+        return;
+    }
+
+    // tolerances shrink four times per level starting from a quarter of the path extent
+    float diagonal_squared = 0.f;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        float min_value = positions[axis];
+        float max_value = positions[axis];
+
+        for(size_t i = 1; i < count; ++i)
+        {
+            min_value = std::min(min_value, positions[3 * i + axis]);
+            max_value = std::max(max_value, positions[3 * i + axis]);
+        }
+
+        diagonal_squared += (max_value - min_value) * (max_value - min_value);
+    }
+
+    const float diagonal = std::sqrt(diagonal_squared);
+    const float finest_tolerance = diagonal / std::pow(4.f, static_cast<float>(TrajectoryPass::maxLevelsCount));
+
+    if(diagonal <= 0.f)
+    {
+        return;
+    }
+
+    // Douglas-Peucker error of every pose, clamped by the error of the split above it, so keeping the poses
+    // above a tolerance gives the same path as running the simplification with that tolerance
+    std::vector<float> errors(count, 0.f);
+    errors[0] = std::numeric_limits<float>::infinity();
+    errors[count - 1] = std::numeric_limits<float>::infinity();
+
+    struct Split
+    {
+        size_t first;
+        size_t last;
+        float error;
+    };
+
+    std::vector<Split> splits;
+    splits.push_back({ 0, count - 1, std::numeric_limits<float>::infinity() });
+
+    while(!splits.empty())
+    {
+        Split split = splits.back();
+        splits.pop_back();
+
+        const float *a = positions + 3 * split.first;
+        const float *b = positions + 3 * split.last;
+        const float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        const float ab_squared = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+
+        size_t farthest = split.first;
+        float farthest_squared = 0.f;
+
+        for(size_t i = split.first + 1; i < split.last; ++i)
+        {
+            const float *p = positions + 3 * i;
+            const float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+
+            // distance to the segment, not the infinite line, a path may turn back on itself
+            float along = ab_squared > 0.f ? std::clamp((ap[0] * ab[0] + ap[1] * ab[1] + ap[2] * ab[2]) / ab_squared, 0.f, 1.f) : 0.f;
+            float dx = ap[0] - along * ab[0];
+            float dy = ap[1] - along * ab[1];
+            float dz = ap[2] - along * ab[2];
+            float distance_squared = dx * dx + dy * dy + dz * dz;
+
+            if(distance_squared > farthest_squared)
+            {
+                farthest_squared = distance_squared;
+                farthest = i;
+            }
+        }
+
+        float error = std::min(std::sqrt(farthest_squared), split.error);
+
+        if(farthest == split.first || error <= finest_tolerance)
+        {
+            continue;
+        }
+
+        errors[farthest] = error;
+        splits.push_back({ split.first, farthest, error });
+        splits.push_back({ farthest, split.last, error });
+    }
+
+    // a level is worth its indices only while it drops at least half of the poses
+    float tolerance = diagonal;
+    size_t previous_count = 0;
+
+    for(int level = 0; level < TrajectoryPass::maxLevelsCount; ++level)
+    {
+        tolerance *= 0.25f;
+
+        size_t level_count = static_cast<size_t>(std::count_if(errors.begin(), errors.end(), [tolerance](float error) { return error > tolerance; }));
+
+        if(2 * level_count > count)
+        {
+            break;
+        }
+
+        // the same poses meet the finer tolerance as well
+        if(level_count == previous_count)
+        {
+            segment.levelTolerances[segment.levelsCount - 1] = tolerance;
+            continue;
+        }
+
+        segment.levelTolerances[segment.levelsCount] = tolerance;
+        segment.levelFirsts[segment.levelsCount] = static_cast<GLint>(this->closedIndicesCount + this->openIndices.size());
+        segment.levelCounts[segment.levelsCount] = static_cast<GLsizei>(level_count);
+        segment.levelsCount += 1;
+
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(errors[i] > tolerance)
+            {
+                this->openIndices.push_back(static_cast<GLuint>(segment.firstPose) + static_cast<GLuint>(i));
+            }
+        }
+
+        previous_count = level_count;
+    }
+}
+
+void TrajectoryPass::upload()
+{
+    bool reallocated = false;
+
+    if(!this->pendingPositions.empty())
+    {
+        size_t offset = this->uploadedPosesCount * 3 * sizeof(float);
+        size_t bytes = this->pendingPositions.size() * sizeof(float);
+
+        reallocated |= this->reserveBuffer(this->pathBuffer, this->pathCapacity, offset, offset + bytes);
+
+        this->gl->glBindBuffer(GL_COPY_WRITE_BUFFER, this->pathBuffer);
+        this->gl->glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), this->pendingPositions.data());
+
+        this->uploadedPosesCount += this->pendingPositions.size() / 3;
+        this->pendingPositions.clear();
+    }
+
+    if(!this->pendingClosedIndices.empty() || this->openIndicesChanged)
+    {
+        size_t offset = this->uploadedClosedIndicesCount * sizeof(GLuint);
+        size_t closed_bytes = this->pendingClosedIndices.size() * sizeof(GLuint);
+        size_t open_bytes = this->openIndices.size() * sizeof(GLuint);
+
+        reallocated |= this->reserveBuffer(this->indexBuffer, this->indexCapacity, offset, offset + closed_bytes + open_bytes);
+
+        this->gl->glBindBuffer(GL_COPY_WRITE_BUFFER, this->indexBuffer);
+
+        if(closed_bytes > 0)
+        {
+            this->gl->glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(closed_bytes), this->pendingClosedIndices.data());
+        }
+
+        if(open_bytes > 0)
+        {
+            this->gl->glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset + closed_bytes), static_cast<GLsizeiptr>(open_bytes), this->openIndices.data());
+        }
+
+        this->uploadedClosedIndicesCount = this->closedIndicesCount;
+        this->pendingClosedIndices.clear();
+        this->openIndicesChanged = false;
+    }
+
+    if(!this->pendingFrustumVertices.empty())
+    {
+        size_t offset = this->uploadedFrustumVerticesCount * 3 * sizeof(float);
+        size_t bytes = this->pendingFrustumVertices.size() * sizeof(float);
+
+        reallocated |= this->reserveBuffer(this->frustumBuffer, this->frustumCapacity, offset, offset + bytes);
+
+        this->gl->glBindBuffer(GL_COPY_WRITE_BUFFER, this->frustumBuffer);
+        this->gl->glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), this->pendingFrustumVertices.data());
+
+        this->uploadedFrustumVerticesCount += this->pendingFrustumVertices.size() / 3;
+        this->pendingFrustumVertices.clear();
+    }
+
+    this->gl->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if(reallocated)
+    {
+        this->updateVertexArrays();
+    }
+}
+
+bool TrajectoryPass::reserveBuffer(GLuint &buffer, size_t &capacity, size_t used_bytes, size_t required_bytes)
+{
+    if(required_bytes <= capacity)
+    {
+        return false;
+    }
+
+    // doubling keeps appends amortized, what is on the GPU is copied over without a round trip
+    size_t new_capacity = std::max({ required_bytes, 2 * capacity, static_cast<size_t>(64 << 10) });
+
+    GLuint new_buffer = 0;
+    this->gl->glGenBuffers(1, &new_buffer);
+    this->gl->glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+    this->gl->glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(new_capacity), nullptr, GL_DYNAMIC_DRAW);
+
+    if(buffer != 0 && used_bytes > 0)
+    {
+        this->gl->glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        this->gl->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(used_bytes));
+        this->gl->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    this->gl->glDeleteBuffers(1, &buffer);
+
+    buffer = new_buffer;
+    capacity = new_capacity;
+
+    return true;
+}
+
+void TrajectoryPass::updateVertexArrays()
+{
+    // positions only, attribute 1 stays disabled and takes the colour set before each draw
+    this->gl->glBindVertexArray(this->pathVao);
+    this->gl->glBindBuffer(GL_ARRAY_BUFFER, this->pathBuffer);
+    this->gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+    this->gl->glEnableVertexAttribArray(0);
+    this->gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBuffer);
+
+    this->gl->glBindVertexArray(this->frustumVao);
+    this->gl->glBindBuffer(GL_ARRAY_BUFFER, this->frustumBuffer);
+    this->gl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+    this->gl->glEnableVertexAttribArray(0);
+
+    this->gl->glBindVertexArray(0);
+    this->gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
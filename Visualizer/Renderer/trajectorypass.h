@@ -0,0 +1,132 @@
+#ifndef TRAJECTORYPASS_H
+#define TRAJECTORYPASS_H
+
+#include "backprojection.h"
+#include "octree.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+
+#include <vector>
+#include <cstddef>
+
+struct TrajectoryPassSettings
+{
+    float pixelTolerance;           // screen space deviation of the simplified path from the full one
+    size_t segmentPosesCount;       // poses per segment, segments are culled and simplified on their own
+    float keyframeDistance;         // camera travel starting a new keyframe, scene units
+    float keyframeAngle;            // or camera rotation, degrees
+    float frustumSize;              // depth of the keyframe frustums, scene units
+    float minFrustumPixels;         // keyframe frustums projected smaller than this are not drawn
+    float pathColor[3];             // 0 - 1
+    float frustumColor[3];
+};
+
+struct TrajectoryRenderStatistics
+{
+    size_t posesCount;
+    size_t keyframesCount;
+    size_t segmentsCount;
+    size_t visibleSegmentsCount;
+    size_t drawnVerticesCount;      // path vertices after simplification
+    size_t drawnKeyframesCount;
+};
+
+//// camera path drawn as a line strip with keyframe frustums; poses are appended into growable buffers, every
+//// segment keeps Douglas-Peucker simplifications of itself and the coarsest one within the pixel tolerance is drawn,
+//// so a path of millions of poses costs a few thousand vertices from afar
+class TrajectoryPass
+{
+public:
+    // constructors/destructors
+    //// functions of the owning widget, its context has to be current in initialize, render and the destructor
+    TrajectoryPass(QOpenGLFunctions_3_3_Core *gl_functions, TrajectoryPassSettings settings);
+    ~TrajectoryPass();
+
+    // public functions
+    bool initialize();
+
+    //// setters, frustums already built keep their shape
+    void setIntrinsics(const CameraIntrinsics &intrinsics);
+    void setPathColor(const float path_color[3]);
+
+    //// camera-to-world poses in capture order, extend the path; uploaded on the next draw
+    void appendPoses(const std::vector<FramePose> &poses);
+    void clear();
+
+    //// the camera block of RenderState has to hold the same projection and view
+    void render(const QMatrix4x4 &projection_matrix, const QMatrix4x4 &view_matrix, const QMatrix4x4 &model_matrix, int viewport_height);
+
+    //// getters
+    TrajectoryRenderStatistics getStatistics();
+
+private:
+    static const int maxLevelsCount = 8;
+
+    struct TrajectorySegment
+    {
+        GLint firstPose;            // shared with the last pose of the previous segment
+        GLsizei posesCount;
+        BoundingBox bounds;         // including the keyframe frustums
+        int levelsCount;            // simplifications, coarsest first
+        float levelTolerances[maxLevelsCount];
+        GLint levelFirsts[maxLevelsCount];     // index
+        GLsizei levelCounts[maxLevelsCount];
+        GLint firstKeyframe;
+        GLsizei keyframesCount;
+    };
+
+    // private functions
+    void appendPose(const FramePose &pose);
+    bool isKeyframe(const FramePose &pose);
+    void appendKeyframe(const FramePose &pose);
+    void simplifyOpenSegment();
+
+    void upload();
+    ////// true when the buffer was replaced, vertex arrays have to point to the new one
+    bool reserveBuffer(GLuint &buffer, size_t &capacity, size_t used_bytes, size_t required_bytes);
+    void updateVertexArrays();
+
+    // private variables
+    QOpenGLFunctions_3_3_Core *gl;
+    TrajectoryPassSettings settings;
+
+    float frustumCorners[4][3];     // camera space at unit depth
+
+    QOpenGLShaderProgram *shaderProgram;
+    GLint modelMatrixLocation;
+
+    //// path vertices, keyframe frustum lines and simplification indices, each in a buffer growing by doubling
+    GLuint pathVao;
+    GLuint frustumVao;
+    GLuint pathBuffer;
+    GLuint indexBuffer;
+    GLuint frustumBuffer;
+    size_t pathCapacity;            // bytes
+    size_t indexCapacity;
+    size_t frustumCapacity;
+
+    //// uploaded on the next draw, appended poses only ever add data past what is on the GPU
+    ////// except for the indices of the open segment, which are rewritten while it grows
+    std::vector<float> pendingPositions;
+    std::vector<float> pendingFrustumVertices;
+    std::vector<GLuint> pendingClosedIndices;
+    std::vector<GLuint> openIndices;
+    size_t uploadedPosesCount;
+    size_t uploadedFrustumVerticesCount;
+    size_t uploadedClosedIndicesCount;
+    bool openIndicesChanged;
+
+    //// path state
+    std::vector<TrajectorySegment> segments;
+    std::vector<float> openPositions;       // positions of the last segment, simplified again on every append
+    size_t posesCount;
+    size_t closedIndicesCount;
+    size_t keyframesCount;
+    FramePose lastKeyframe;
+
+    TrajectoryRenderStatistics statistics;
+};
+
+#endif // TRAJECTORYPASS_H
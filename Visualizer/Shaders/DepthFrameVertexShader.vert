@@ -0,0 +1,67 @@
+#version 330 core
+
+// no vertex attributes, every vertex is one pixel of a raw frame picked by gl_VertexID
+
+layout(std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    vec4 eye;
+    vec4 viewport;
+};
+
+out vec3 fragColor;
+
+uniform usamplerBuffer depthTexels;         // raw 16-bit depth of all frames in the buffer
+uniform samplerBuffer colorTexels;          // normalized BGR bytes, three texels per pixel
+
+uniform mat4 modelMatrix;
+uniform mat4 framePose;                     // camera to world
+uniform int frameOffset;                    // first pixel of the frame in both buffers
+uniform ivec2 frameSize;
+uniform vec4 intrinsics;                    // cx, cy, focal_x, focal_y
+uniform vec4 depthFilter;                   // depth scale, min and max raw depth, discontinuity threshold
+uniform bool rejectInvalid;
+uniform float pointSize;
+
+float fetchDepth(int u, int v) {
+    ivec2 pixel = clamp(ivec2(u, v), ivec2(0), frameSize - 1);
+    return float(texelFetch(depthTexels, frameOffset + pixel.y * frameSize.x + pixel.x).r);
+}
+
+void main() {
+    int u = gl_VertexID % frameSize.x;
+    int v = gl_VertexID / frameSize.x;
+    int pixel = frameOffset + gl_VertexID;
+
+    float depth = fetchDepth(u, v);
+
+    // same rejection as the CPU depth filter, neighbours outside the image are the pixel itself
+    float max_jump = depthFilter.w * depth;
+    float left = fetchDepth(u - 1, v);
+    float right = fetchDepth(u + 1, v);
+    float up = fetchDepth(u, v - 1);
+    float down = fetchDepth(u, v + 1);
+
+    bool jump = depth != 0.0 && ((left != 0.0 && abs(left - depth) > max_jump) || (right != 0.0 && abs(right - depth) > max_jump)
+             || (up != 0.0 && abs(up - depth) > max_jump) || (down != 0.0 && abs(down - depth) > max_jump));
+
+    bool rejected = (depthFilter.w > 0.0 && jump) || depth < depthFilter.y || depth > depthFilter.z;
+    rejected = rejected || (depth == 0.0 && rejectInvalid);
+
+    if(rejected) {
+        // outside of every clip volume, the point is dropped before rasterization
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        gl_PointSize = pointSize;
+        fragColor = vec3(0.0);
+        return;
+    }
+
+    float d = depth * depthFilter.x;
+    vec3 camera_point = vec3((float(v) - intrinsics.y) / intrinsics.w * d, -(float(u) - intrinsics.x) / intrinsics.z * d, d);
+
+    fragColor = vec3(texelFetch(colorTexels, 3 * pixel + 2).r, texelFetch(colorTexels, 3 * pixel + 1).r, texelFetch(colorTexels, 3 * pixel).r);
+    gl_Position = viewProjection * modelMatrix * framePose * vec4(camera_point, 1.0);
+    gl_PointSize = pointSize;
+}
@@ -0,0 +1,23 @@
+#version 330 core
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 color;
+
+layout (std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    vec4 eye;
+    vec4 viewport;
+};
+
+uniform mat4 model;
+
+out vec3 fragColor;
+
+void main()
+{
+    fragColor = color;
+    gl_Position = viewProjection * model * vec4(position, 1.0);
+}
@@ -1,15 +1,26 @@
 #version 330 core
 
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
+layout(location = 0) in vec3 position;      // quantization steps relative to the chunk origin
+layout(location = 1) in vec4 color;         // normalized RGBA8
+
+layout(std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    vec4 eye;
+    vec4 viewport;
+};
 
 out vec3 fragColor;
 
-uniform mat4 projMatrix;
-uniform mat4 viewMatrix;
 uniform mat4 modelMatrix;
+uniform mat4 chunkPose;                     // camera to world of frame-local chunks, identity otherwise
+uniform vec4 chunkOrigin;                   // x, y, z of the chunk origin, scene units per quantization step
+uniform float pointSize;
 
 void main() {
-    fragColor = color;
-    gl_Position = projMatrix * viewMatrix * modelMatrix * vec4(position, 1.0);
+    fragColor = color.rgb;
+    gl_Position = viewProjection * modelMatrix * chunkPose * vec4(chunkOrigin.xyz + position * chunkOrigin.w, 1.0);
+    gl_PointSize = pointSize;
 }
@@ -0,0 +1,32 @@
+#version 330 core
+
+layout(std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    vec4 eye;
+    vec4 viewport;
+};
+
+in vec3 fragColor;
+in vec3 splatCenter;
+in float splatRadius;
+
+out vec4 outputColor;
+
+void main() {
+    vec2 offset = gl_PointCoord * 2.0 - 1.0;
+    float distance_squared = dot(offset, offset);
+
+    if(distance_squared > 1.0) {
+        discard;
+    }
+
+    // depth of a sphere around the point, overlapping splats meet along their intersection instead of
+    // the one drawn first covering the others; writing the depth turns off early depth testing
+    vec4 clip_position = projection * vec4(splatCenter.xy, splatCenter.z + splatRadius * sqrt(1.0 - distance_squared), 1.0);
+    gl_FragDepth = 0.5 * clip_position.z / clip_position.w + 0.5;
+
+    outputColor = vec4(fragColor, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+in vec3 fragColor;
+
+out vec4 outputColor;
+
+void main() {
+    // round sprites, the corners of the point square are left to the neighbouring splats
+    vec2 offset = gl_PointCoord * 2.0 - 1.0;
+
+    if(dot(offset, offset) > 1.0) {
+        discard;
+    }
+
+    outputColor = vec4(fragColor, 1.0);
+}
@@ -0,0 +1,38 @@
+#version 330 core
+
+layout(location = 0) in vec3 position;      // quantization steps relative to the chunk origin
+layout(location = 1) in vec4 color;         // normalized RGBA8
+
+layout(std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    vec4 eye;
+    vec4 viewport;
+};
+
+out vec3 fragColor;
+out vec3 splatCenter;                       // view space
+out float splatRadius;                      // scene units
+
+uniform mat4 modelMatrix;
+uniform mat4 chunkPose;                     // camera to world of frame-local chunks, identity otherwise
+uniform vec4 chunkOrigin;                   // x, y, z of the chunk origin, scene units per quantization step
+uniform float pointSize;                    // pixels, lower bound of the splat size
+uniform float maxPointSize;
+uniform float splatSize;                    // diameter in scene units covering the drawn points of the chunk
+
+void main() {
+    vec4 view_position = view * modelMatrix * chunkPose * vec4(chunkOrigin.xyz + position * chunkOrigin.w, 1.0);
+
+    fragColor = color.rgb;
+    gl_Position = projection * view_position;
+
+    // the diameter projected at the depth of the point, clamped so that close-ups do not fill the screen
+    float pixels = splatSize * 0.5 * viewport.y * projection[1][1] / max(-view_position.z, 1e-4);
+    gl_PointSize = clamp(pixels, pointSize, maxPointSize);
+
+    splatCenter = view_position.xyz;
+    splatRadius = 0.5 * splatSize * gl_PointSize / max(pixels, 1e-4);
+}
@@ -0,0 +1,660 @@
+#include "benchmarksuite.h"
+#include "imageloader.h"
+#include "voxelgrid.h"
+#include "tsdfvolume.h"
+#include "octree.h"
+#include "pointcloudio.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <filesystem>
+
+#include <sys/resource.h>
+
+// constructors/destructors
+BenchmarkSuite::BenchmarkSuite(BenchmarkSettings settings)
+{
+    this->initializeVariables(settings);
+}
+
+BenchmarkSuite::~BenchmarkSuite()
+{
+
+}
+
+// public functions
+bool BenchmarkSuite::run()
+{
+    if(!this->loadFrames())
+    {
+        return false;
+    }
+
+    this->runParsing();
+    this->runDecoding();
+    this->runKernels();
+    this->runAccumulation();
+
+    std::vector<float> reference_points;
+    std::vector<float> vectorized_points;
+
+    this->runIngestion("ingest_reference_float32", TransformKernel::Reference, PointFormat::Float32, 0.f, &reference_points);
+    this->runIngestion("ingest_vectorized_float32", TransformKernel::Vectorized, PointFormat::Float32, 0.f, &vectorized_points);
+
+    if(!this->checkKernelParity(reference_points, vectorized_points))
+    {
+        return false;
+    }
+
+    std::vector<float>().swap(reference_points);
+    std::vector<float>().swap(vectorized_points);
+
+    this->runIngestion("ingest_vectorized_compact", TransformKernel::Vectorized, PointFormat::Compact, 0.f);
+
+    if(this->settings.voxelSize > 0.f)
+    {
+        this->runIngestion("ingest_vectorized_voxel_grid", TransformKernel::Vectorized, PointFormat::Float32, this->settings.voxelSize);
+    }
+
+    this->runUploadPreparation();
+    this->runExport();
+
+    return true;
+}
+
+bool BenchmarkSuite::writeResults(const std::string &path_to_output)
+{
+    std::ostringstream json;
+    json.precision(9);
+
+    BackProjectionKernel kernel;
+
+    // resolution of the images that were loaded, the intrinsics may be calibrated for any other one
+    int width = this->depthImages.empty() ? 0 : this->depthImages[0].cols;
+    int height = this->depthImages.empty() ? 0 : this->depthImages[0].rows;
+
+    json << "{\n"
+         << "  \"dataset\": {\n"
+         << "    \"name\": \"" << BenchmarkSuite::escapeJson(this->settings.datasetName) << "\",\n"
+         << "    \"frames\": " << this->frameIndexes.size() << ",\n"
+         << "    \"width\": " << width << ",\n"
+         << "    \"height\": " << height << "\n"
+         << "  },\n"
+         << "  \"threads\": " << this->settings.threadsCount << ",\n"
+         << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+         << "  \"instruction_set\": \"" << BackProjectionKernel::getInstructionSetName(kernel.getInstructionSet()) << "\",\n"
+         << "  \"repetitions\": " << this->settings.repetitions << ",\n"
+         << "  \"peak_rss_kb\": " << BenchmarkSuite::getPeakRssKilobytes() << ",\n"
+         << "  \"stages\": [\n";
+
+    for(size_t i = 0; i < this->results.size(); ++i)
+    {
+        const BenchmarkResult &result = this->results[i];
+
+        double points_per_second = result.bestSeconds > 0.0 ? result.pointsCount / result.bestSeconds : 0.0;
+        double nanoseconds_per_pixel = result.pixelsCount > 0 ? result.bestSeconds * 1e9 / result.pixelsCount : 0.0;
+
+        json << "    {\n"
+             << "      \"name\": \"" << BenchmarkSuite::escapeJson(result.name) << "\",\n"
+             << "      \"frames\": " << result.framesCount << ",\n"
+             << "      \"pixels\": " << result.pixelsCount << ",\n"
+             << "      \"points\": " << result.pointsCount << ",\n"
+             << "      \"best_seconds\": " << result.bestSeconds << ",\n"
+             << "      \"median_seconds\": " << result.medianSeconds << ",\n"
+             << "      \"points_per_second\": " << points_per_second << ",\n"
+             << "      \"ns_per_pixel\": " << nanoseconds_per_pixel << ",\n"
+             << "      \"peak_rss_kb\": " << result.peakRssKilobytes << "\n"
+             << "    }" << (i + 1 < this->results.size() ? "," : "") << "\n";
+    }
+
+    json << "  ]\n"
+         << "}\n";
+
+    if(path_to_output.empty())
+    {
+        std::cout << json.str();
+        return true;
+    }
+
+    std::ofstream file(path_to_output);
+
+    if(!file.is_open())
+    {
+        std::cerr << "Failed to open benchmark output file: " << path_to_output.c_str() << std::endl;
+        return false;
+    }
+
+    file << json.str();
+
+    return file.good();
+}
+
+// private functions
+//// init functions
+void BenchmarkSuite::initializeVariables(BenchmarkSettings &settings)
+{
+    this->settings = settings;
+
+    if(this->settings.threadsCount == 0)
+    {
+        this->settings.threadsCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    this->settings.repetitions = std::max(1u, this->settings.repetitions);
+    this->settings.kernelFrames = std::max(1u, this->settings.kernelFrames);
+}
+
+bool BenchmarkSuite::loadFrames()
+{
+    if(!DatasetParser::parse(this->settings.pathToTrajectoryFile, this->settings.pathToAssociationFile, this->frameTable))
+    {
+        return false;
+    }
+
+    for(size_t i = 0; i < this->frameTable.frames.size(); ++i)
+    {
+        if(this->settings.maxIndex > 0 && i >= this->settings.maxIndex)
+        {
+            break;
+        }
+
+        if(this->frameTable.getFrame(static_cast<int>(i)) != nullptr)
+        {
+            this->frameIndexes.push_back(static_cast<int>(i));
+        }
+    }
+
+    if(this->frameIndexes.empty())
+    {
+        std::cerr << "Benchmark dataset has no complete frames" << std::endl;
+        return false;
+    }
+
+    // same intrinsics the ingestion stages will use
+    PointCloud point_cloud(this->getInputData(TransformKernel::Vectorized, PointFormat::Float32, 0.f));
+    this->cameraIntrinsics = point_cloud.getCameraIntrinsics();
+
+    // keep a few decoded frames in memory for the stages that must not include I/O
+    size_t kernel_frames = std::min<size_t>(this->settings.kernelFrames, this->frameIndexes.size());
+
+    ImageLoader image_loader(this->settings.threadsCount, 2 * this->settings.threadsCount);
+    image_loader.start(this->getImageRequests(kernel_frames));
+
+    this->rgbImages.resize(kernel_frames);
+    this->depthImages.resize(kernel_frames);
+
+    for(ImageSlot *slot = image_loader.acquire(); slot != nullptr; slot = image_loader.acquire())
+    {
+        if(slot->loaded)
+        {
+            this->rgbImages[slot->position] = slot->rgbImage.clone();
+            this->depthImages[slot->position] = slot->depthImage.clone();
+        }
+
+        image_loader.release(slot);
+    }
+
+    for(size_t i = 0; i < kernel_frames; ++i)
+    {
+        if(this->depthImages[i].empty())
+        {
+            std::cerr << "Failed to load benchmark frame: " << this->frameIndexes[i] << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//// stages
+void BenchmarkSuite::runParsing()
+{
+    FrameTable frame_table;
+    size_t lines_count = this->frameTable.frames.size();
+
+    this->measure("parse", lines_count, 0, 0, [&]()
+    {
+        DatasetParser::parse(this->settings.pathToTrajectoryFile, this->settings.pathToAssociationFile, frame_table);
+    });
+}
+
+void BenchmarkSuite::runDecoding()
+{
+    size_t frames_count = this->frameIndexes.size();
+    size_t pixels_count = frames_count * this->depthImages[0].total();
+    std::vector<ImageRequest> requests = this->getImageRequests(frames_count);
+
+    this->measure("decode", frames_count, pixels_count, 0, [&]()
+    {
+        ImageLoader image_loader(this->settings.threadsCount, 2 * this->settings.threadsCount);
+        image_loader.start(requests);
+
+        for(ImageSlot *slot = image_loader.acquire(); slot != nullptr; slot = image_loader.acquire())
+        {
+            image_loader.release(slot);
+        }
+    });
+}
+
+void BenchmarkSuite::runKernels()
+{
+    const InstructionSet instruction_sets[3] = { InstructionSet::Scalar, InstructionSet::SSE, InstructionSet::AVX2 };
+
+    size_t frames_count = this->depthImages.size();
+    size_t pixels_count = 0;
+
+    for(const cv::Mat &depth_image : this->depthImages)
+    {
+        pixels_count += depth_image.total();
+    }
+
+    std::vector<FramePose> poses(frames_count);
+
+    for(size_t i = 0; i < frames_count; ++i)
+    {
+        const TrajectoryData &trajectory = this->frameTable.frames[this->frameIndexes[i]].pose;
+        poses[i] = BackProjectionKernel::getFramePose(trajectory.cam_x, trajectory.cam_y, trajectory.cam_z, trajectory.qx, trajectory.qy, trajectory.qz, trajectory.qw);
+    }
+
+    this->framePoints.resize(frames_count);
+
+    for(InstructionSet instruction_set : instruction_sets)
+    {
+        BackProjectionKernel kernel;
+        kernel.setIntrinsics(this->cameraIntrinsics);
+        kernel.setInstructionSet(instruction_set);
+
+        // the CPU lacks it, the kernel fell back to another one
+        if(kernel.getInstructionSet() != instruction_set)
+        {
+            continue;
+        }
+
+        size_t points_count = 0;
+
+        std::string name = std::string("transform_") + BackProjectionKernel::getInstructionSetName(instruction_set);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        this->measure(name, frames_count, pixels_count, 0, [&]()
+        {
+            points_count = 0;
+
+            for(size_t i = 0; i < frames_count; ++i)
+            {
+                this->framePoints[i].clear();
+                kernel.transformFrame(poses[i], this->rgbImages[i], this->depthImages[i], this->framePoints[i]);
+                points_count += this->framePoints[i].size() / PointsView::floatsPerPoint;
+            }
+        });
+
+        this->results.back().pointsCount = points_count;
+    }
+
+    // invalid pixels and flying pixels dropped by the fastest kernel, output kept separate from the unfiltered points
+    BackProjectionKernel filtered_kernel;
+    filtered_kernel.setIntrinsics(this->cameraIntrinsics);
+    filtered_kernel.setDepthFilter({ true, 0.f, 0.f, 0.05f, 0 });
+
+    std::vector<float> filtered_points;
+    size_t filtered_points_count = 0;
+
+    this->measure("transform_filtered", frames_count, pixels_count, 0, [&]()
+    {
+        filtered_points_count = 0;
+
+        for(size_t i = 0; i < frames_count; ++i)
+        {
+            filtered_points.clear();
+            filtered_kernel.transformFrame(poses[i], this->rgbImages[i], this->depthImages[i], filtered_points);
+            filtered_points_count += filtered_points.size() / PointsView::floatsPerPoint;
+        }
+    });
+
+    this->results.back().pointsCount = filtered_points_count;
+}
+
+void BenchmarkSuite::runAccumulation()
+{
+    size_t frames_count = this->framePoints.size();
+    size_t points_count = 0;
+
+    for(const std::vector<float> &points : this->framePoints)
+    {
+        points_count += points.size() / PointsView::floatsPerPoint;
+    }
+
+    if(this->settings.voxelSize > 0.f)
+    {
+        VoxelGridAccumulator voxel_grid(this->settings.voxelSize);
+
+        this->measure("accumulate_voxel_grid", frames_count, 0, points_count, [&]()
+        {
+            voxel_grid.clear();
+
+            for(const std::vector<float> &points : this->framePoints)
+            {
+                voxel_grid.integrate(points.data(), points.size() / PointsView::floatsPerPoint);
+            }
+        });
+
+        TSDFVolume tsdf_volume(this->settings.voxelSize);
+
+        this->measure("accumulate_tsdf", frames_count, 0, points_count, [&]()
+        {
+            tsdf_volume.clear();
+
+            for(size_t i = 0; i < frames_count; ++i)
+            {
+                const TrajectoryData &trajectory = this->frameTable.frames[this->frameIndexes[i]].pose;
+                const float camera_position[3] = { trajectory.cam_x, trajectory.cam_y, trajectory.cam_z };
+
+                tsdf_volume.integrate(camera_position, this->framePoints[i].data(), this->framePoints[i].size() / PointsView::floatsPerPoint);
+            }
+        });
+    }
+
+    Octree octree(12);
+    std::vector<float> all_points;
+
+    for(const std::vector<float> &points : this->framePoints)
+    {
+        all_points.insert(all_points.end(), points.begin(), points.end());
+    }
+
+    this->measure("accumulate_octree", frames_count, 0, points_count, [&]()
+    {
+        octree.clear();
+        octree.build(all_points.data(), points_count, this->settings.threadsCount);
+    });
+
+    std::vector<float>().swap(all_points);
+
+    PointChunk chunk;
+
+    this->measure("accumulate_quantize", frames_count, 0, points_count, [&]()
+    {
+        for(const std::vector<float> &points : this->framePoints)
+        {
+            PointQuantizer::quantize(points.data(), points.size() / PointsView::floatsPerPoint, chunk);
+        }
+    });
+}
+
+void BenchmarkSuite::runIngestion(const std::string &name, TransformKernel transform_kernel, PointFormat point_format, float voxel_size, std::vector<float> *points)
+{
+    PointCloud point_cloud(this->getInputData(transform_kernel, point_format, voxel_size));
+
+    size_t frames_count = this->frameIndexes.size();
+    size_t pixels_count = frames_count * this->depthImages[0].total();
+
+    this->measure(name, frames_count, pixels_count, 0, [&]()
+    {
+        point_cloud.iterateThroughImages();
+    });
+
+    size_t points_count = point_cloud.getPointsView().pointsCount;
+
+    for(const PointChunk &chunk : point_cloud.getPointChunks())
+    {
+        points_count += chunk.points.size();
+    }
+
+    this->results.back().pointsCount = points_count;
+
+    if(points != nullptr)
+    {
+        PointsView points_view = point_cloud.getPointsView();
+        points->assign(points_view.data, points_view.data + points_view.pointsCount * PointsView::floatsPerPoint);
+    }
+}
+
+void BenchmarkSuite::runUploadPreparation()
+{
+    // builds the interleaved float buffer a VBO upload would read, from both exported layouts
+    std::vector<float> upload_buffer;
+
+    {
+        PointCloud compact_cloud(this->getInputData(TransformKernel::Vectorized, PointFormat::Compact, 0.f));
+        compact_cloud.iterateThroughImages();
+
+        const std::vector<PointChunk> &chunks = compact_cloud.getPointChunks();
+        size_t compact_points_count = 0;
+
+        for(const PointChunk &chunk : chunks)
+        {
+            compact_points_count += chunk.points.size();
+        }
+
+        this->measure("upload_prepare_compact", chunks.size(), 0, compact_points_count, [&]()
+        {
+            upload_buffer.clear();
+            upload_buffer.reserve(compact_points_count * PointsView::floatsPerPoint);
+
+            // dequantize appends, so chunks land one after another
+            for(const PointChunk &chunk : chunks)
+            {
+                PointQuantizer::dequantize(chunk, upload_buffer);
+            }
+        });
+    }
+
+    PointCloud float_cloud(this->getInputData(TransformKernel::Vectorized, PointFormat::Float32, 0.f));
+    float_cloud.iterateThroughImages();
+
+    PointsView points_view = float_cloud.getPointsView();
+
+    this->measure("upload_prepare_float32", this->frameIndexes.size(), 0, points_view.pointsCount, [&]()
+    {
+        upload_buffer.resize(points_view.pointsCount * PointsView::floatsPerPoint);
+        std::memcpy(upload_buffer.data(), points_view.data, points_view.sizeInBytes());
+    });
+}
+
+void BenchmarkSuite::runExport()
+{
+    // whole cloud to the temporary directory and back, bound by the disk once the conversion runs on all threads
+    PointCloud point_cloud(this->getInputData(TransformKernel::Vectorized, PointFormat::Compact, 0.f));
+    point_cloud.iterateThroughImages();
+
+    const std::vector<PointChunk> &chunks = point_cloud.getPointChunks();
+    size_t points_count = 0;
+
+    for(const PointChunk &chunk : chunks)
+    {
+        points_count += chunk.points.size();
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string path_to_ply = (directory / "pointcloud_benchmark.ply").string();
+    std::string path_to_pcd = (directory / "pointcloud_benchmark.pcd").string();
+
+    std::vector<PointChunk> read_chunks;
+
+    this->measure("export_ply", chunks.size(), 0, points_count, [&]()
+    {
+        PointCloudIO::writePLY(path_to_ply, chunks, this->settings.threadsCount);
+    });
+
+    this->measure("export_pcd", chunks.size(), 0, points_count, [&]()
+    {
+        PointCloudIO::writePCD(path_to_pcd, chunks, this->settings.threadsCount);
+    });
+
+    this->measure("import_ply", chunks.size(), 0, points_count, [&]()
+    {
+        PointCloudIO::readPoints(path_to_ply, read_chunks, this->settings.threadsCount);
+    });
+
+    this->measure("import_pcd", chunks.size(), 0, points_count, [&]()
+    {
+        PointCloudIO::readPoints(path_to_pcd, read_chunks, this->settings.threadsCount);
+    });
+
+    std::error_code error;
+    std::filesystem::remove(path_to_ply, error);
+    std::filesystem::remove(path_to_pcd, error);
+}
+
+//// helpers
+bool BenchmarkSuite::checkKernelParity(const std::vector<float> &reference_points, const std::vector<float> &vectorized_points)
+{
+    // both kernels keep the same pixels in the same order, points are compared one to one
+    size_t reference_count = reference_points.size() / PointsView::floatsPerPoint;
+    size_t vectorized_count = vectorized_points.size() / PointsView::floatsPerPoint;
+
+    if(reference_count != vectorized_count)
+    {
+        std::cerr << "Kernel parity failed: " << reference_count << " reference points, " << vectorized_count << " vectorized points" << std::endl;
+        return false;
+    }
+
+    float max_difference = 0.f;
+
+    for(size_t i = 0; i < reference_points.size(); ++i)
+    {
+        max_difference = std::max(max_difference, std::abs(reference_points[i] - vectorized_points[i]));
+    }
+
+    std::cerr << "Kernel parity: " << reference_count << " points, max abs difference " << max_difference << std::endl;
+
+    if(!(max_difference <= this->settings.parityTolerance))
+    {
+        std::cerr << "Kernel parity failed: difference above " << this->settings.parityTolerance << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+InputData BenchmarkSuite::getInputData(TransformKernel transform_kernel, PointFormat point_format, float voxel_size)
+{
+    InputData input_data;
+    input_data.pathToImagesDirectory = this->settings.pathToImagesDirectory;
+    input_data.pathToTrajectoryFile = this->settings.pathToTrajectoryFile;
+    input_data.pathToAssociationFile = this->settings.pathToAssociationFile;
+    input_data.pathToIntrinsicsFile = this->settings.pathToIntrinsicsFile;
+    input_data.pathToCacheFile = "";
+    input_data.pathToConfidenceDirectory = "";
+    input_data.maxIndex = this->settings.maxIndex;
+    input_data.threadsCount = this->settings.threadsCount;
+    input_data.ioThreadsCount = 0;
+    input_data.prefetchDepth = 0;
+    input_data.transformKernel = transform_kernel;
+    input_data.pointFormat = point_format;
+    input_data.voxelSize = voxel_size;
+    input_data.tsdfVoxelSize = 0.f;
+    input_data.tsdfTruncation = 0.f;
+    input_data.octreeMaxDepth = 0;
+    input_data.frameLocalPoints = false;
+    input_data.rawFrames = false;
+    // unfiltered, every stage processes the same points
+    input_data.depthFilter = { false, 0.f, 0.f, 0.f, 0 };
+
+    return input_data;
+}
+
+std::vector<ImageRequest> BenchmarkSuite::getImageRequests(size_t frames_count)
+{
+    std::vector<ImageRequest> requests(frames_count);
+
+    for(size_t i = 0; i < frames_count; ++i)
+    {
+        const FrameEntry *frame = this->frameTable.getFrame(this->frameIndexes[i]);
+
+        requests[i].position = i;
+        requests[i].rgbPath = this->settings.pathToImagesDirectory + std::string(frame->rgbPath);
+        requests[i].depthPath = this->settings.pathToImagesDirectory + std::string(frame->depthPath);
+    }
+
+    return requests;
+}
+
+void BenchmarkSuite::measure(const std::string &name, size_t frames_count, size_t pixels_count, size_t points_count, const std::function<void()> &stage)
+{
+    std::vector<double> timings(this->settings.repetitions);
+
+    for(unsigned int i = 0; i < this->settings.repetitions; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        stage();
+        timings[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::sort(timings.begin(), timings.end());
+
+    BenchmarkResult result;
+    result.name = name;
+    result.framesCount = frames_count;
+    result.pixelsCount = pixels_count;
+    result.pointsCount = points_count;
+    result.bestSeconds = timings.front();
+    result.medianSeconds = timings[timings.size() / 2];
+    result.peakRssKilobytes = BenchmarkSuite::getPeakRssKilobytes();
+
+    this->results.push_back(result);
+
+    std::cerr << name.c_str() << ": " << result.bestSeconds * 1000.0 << " ms best, " << result.medianSeconds * 1000.0 << " ms median" << std::endl;
+}
+
+long BenchmarkSuite::getPeakRssKilobytes()
+{
+    struct rusage usage;
+
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+
+    // kilobytes on Linux
+    return usage.ru_maxrss;
+}
+
+std::string BenchmarkSuite::escapeJson(const std::string &text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+
+    for(char c : text)
+    {
+        switch(c)
+        {
+        case '"':
+            escaped += "\\\"";
+            break;
+        case '\\':
+            escaped += "\\\\";
+            break;
+        case '\n':
+            escaped += "\\n";
+            break;
+        case '\r':
+            escaped += "\\r";
+            break;
+        case '\t':
+            escaped += "\\t";
+            break;
+        default:
+            if(static_cast<unsigned char>(c) < 0x20)
+            {
+                char code[7];
+                std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+                escaped += code;
+            }
+            else
+            {
+                escaped += c;
+            }
+            break;
+        }
+    }
+
+    return escaped;
+}
@@ -0,0 +1,92 @@
+#ifndef BENCHMARKSUITE_H
+#define BENCHMARKSUITE_H
+
+#include "pointcloud.h"
+#include "datasetparser.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <string>
+#include <vector>
+#include <functional>
+
+struct BenchmarkSettings
+{
+    std::string datasetName;
+    std::string pathToImagesDirectory;
+    std::string pathToTrajectoryFile;
+    std::string pathToAssociationFile;
+    std::string pathToIntrinsicsFile;   // empty - default office_kt0 intrinsics
+    unsigned int maxIndex;          // frames [0, maxIndex) are used, 0 - all frames
+    unsigned int threadsCount;      // ingestion threads, 0 - all hardware threads
+    unsigned int repetitions;       // every stage is timed this many times
+    unsigned int kernelFrames;      // decoded frames kept in memory for the single-threaded stages
+    float voxelSize;
+    float parityTolerance;          // max abs difference between reference and vectorized ingestion, the run fails above it
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    size_t framesCount;
+    size_t pixelsCount;
+    size_t pointsCount;
+    double bestSeconds;
+    double medianSeconds;
+    long peakRssKilobytes;          // process high-water mark once the stage finished
+};
+
+//// times every ingestion stage on its own and end to end, results are written as JSON
+class BenchmarkSuite
+{
+public:
+    // constructors/destructors
+    BenchmarkSuite(BenchmarkSettings settings);
+    ~BenchmarkSuite();
+
+    // public functions
+    bool run();
+    ////// empty path - standard output
+    bool writeResults(const std::string &path_to_output);
+
+private:
+    // private functions
+    //// init functions
+    void initializeVariables(BenchmarkSettings &settings);
+    bool loadFrames();
+
+    //// stages
+    void runParsing();
+    void runDecoding();
+    void runKernels();
+    void runAccumulation();
+    ////// float32 points of the last repetition are copied into points when given
+    void runIngestion(const std::string &name, TransformKernel transform_kernel, PointFormat point_format, float voxel_size, std::vector<float> *points = nullptr);
+    void runUploadPreparation();
+    void runExport();
+
+    //// helpers
+    bool checkKernelParity(const std::vector<float> &reference_points, const std::vector<float> &vectorized_points);
+    InputData getInputData(TransformKernel transform_kernel, PointFormat point_format, float voxel_size);
+    std::vector<ImageRequest> getImageRequests(size_t frames_count);
+    ////// runs stage the configured number of times and records the timings
+    void measure(const std::string &name, size_t frames_count, size_t pixels_count, size_t points_count, const std::function<void()> &stage);
+    static long getPeakRssKilobytes();
+    ////// quotes, backslashes and control characters escaped, e.g. for Windows paths
+    static std::string escapeJson(const std::string &text);
+
+    // private variables
+    BenchmarkSettings settings;
+    FrameTable frameTable;
+    std::vector<int> frameIndexes;
+    CameraIntrinsics cameraIntrinsics;
+
+    //// decoded frames and their points reused by the single-threaded stages
+    std::vector<cv::Mat> rgbImages;
+    std::vector<cv::Mat> depthImages;
+    std::vector<std::vector<float>> framePoints;
+
+    std::vector<BenchmarkResult> results;
+};
+
+#endif // BENCHMARKSUITE_H
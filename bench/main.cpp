@@ -0,0 +1,194 @@
+#include "benchmarksuite.h"
+#include "syntheticdataset.h"
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+static void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  Real dataset:\n"
+              << "    --dataset <dir>          images directory, paths in the association file are relative to it\n"
+              << "    --trajectory <file>      defaults to <dir>/traj0.txt\n"
+              << "    --associations <file>    defaults to <dir>/associations.txt\n"
+              << "    --intrinsics <file>      defaults to office_kt0 intrinsics\n"
+              << "  Synthetic dataset, used when --dataset is not given:\n"
+              << "    --synthetic <dir>        output directory (benchmark_dataset)\n"
+              << "    --scene <room|plane>     (room)\n"
+              << "    --width <n> --height <n> (640 x 480)\n"
+              << "    --frames <n>             (60)\n"
+              << "  Run:\n"
+              << "    --max-index <n>          use frames [0, n), 0 - all (0)\n"
+              << "    --threads <n>            0 - all hardware threads (0)\n"
+              << "    --repetitions <n>        (3)\n"
+              << "    --kernel-frames <n>      decoded frames kept in memory for kernel stages (8)\n"
+              << "    --voxel-size <size>      0 - skip voxel grid stages (0.01)\n"
+              << "    --parity-tolerance <d>   max abs difference between reference and vectorized points (0.001)\n"
+              << "    --output <file>          JSON results, standard output if not given\n";
+}
+
+int main(int argc, char *argv[])
+{
+    BenchmarkSettings settings;
+    settings.maxIndex = 0;
+    settings.threadsCount = 0;
+    settings.repetitions = 3;
+    settings.kernelFrames = 8;
+    settings.voxelSize = 0.01f;
+    settings.parityTolerance = 0.001f;
+
+    SyntheticDatasetSettings synthetic_settings;
+    synthetic_settings.directory = "benchmark_dataset";
+    synthetic_settings.width = 640;
+    synthetic_settings.height = 480;
+    synthetic_settings.framesCount = 60;
+    synthetic_settings.scene = SyntheticScene::Room;
+
+    std::string dataset_directory;
+    std::string path_to_output;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+
+        if(option == "--help" || option == "-h")
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+
+        if(i + 1 >= argc)
+        {
+            std::cerr << "Missing value for option: " << option.c_str() << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        std::string value = argv[++i];
+
+        if(option == "--dataset")
+        {
+            dataset_directory = value;
+        }
+        else if(option == "--trajectory")
+        {
+            settings.pathToTrajectoryFile = value;
+        }
+        else if(option == "--associations")
+        {
+            settings.pathToAssociationFile = value;
+        }
+        else if(option == "--intrinsics")
+        {
+            settings.pathToIntrinsicsFile = value;
+        }
+        else if(option == "--synthetic")
+        {
+            synthetic_settings.directory = value;
+        }
+        else if(option == "--scene" && (value == "room" || value == "plane"))
+        {
+            synthetic_settings.scene = value == "room" ? SyntheticScene::Room : SyntheticScene::Plane;
+        }
+        else if(option == "--width")
+        {
+            synthetic_settings.width = std::atoi(value.c_str());
+        }
+        else if(option == "--height")
+        {
+            synthetic_settings.height = std::atoi(value.c_str());
+        }
+        else if(option == "--frames")
+        {
+            synthetic_settings.framesCount = std::atoi(value.c_str());
+        }
+        else if(option == "--max-index")
+        {
+            settings.maxIndex = static_cast<unsigned int>(std::atoi(value.c_str()));
+        }
+        else if(option == "--threads")
+        {
+            settings.threadsCount = static_cast<unsigned int>(std::atoi(value.c_str()));
+        }
+        else if(option == "--repetitions")
+        {
+            settings.repetitions = static_cast<unsigned int>(std::atoi(value.c_str()));
+        }
+        else if(option == "--kernel-frames")
+        {
+            settings.kernelFrames = static_cast<unsigned int>(std::atoi(value.c_str()));
+        }
+        else if(option == "--voxel-size")
+        {
+            settings.voxelSize = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--parity-tolerance")
+        {
+            settings.parityTolerance = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--output")
+        {
+            path_to_output = value;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << option.c_str() << " " << value.c_str() << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(dataset_directory.empty())
+    {
+        if(synthetic_settings.width <= 0 || synthetic_settings.height <= 0 || synthetic_settings.framesCount <= 0)
+        {
+            std::cerr << "Synthetic dataset needs a positive resolution and frame count" << std::endl;
+            return 1;
+        }
+
+        SyntheticDataset synthetic_dataset(synthetic_settings);
+
+        std::cerr << "Generating synthetic dataset in " << synthetic_settings.directory.c_str() << std::endl;
+
+        if(!synthetic_dataset.generate())
+        {
+            return 1;
+        }
+
+        settings.datasetName = std::string("synthetic_") + (synthetic_settings.scene == SyntheticScene::Room ? "room" : "plane");
+        settings.pathToImagesDirectory = synthetic_dataset.getImagesDirectory();
+        settings.pathToTrajectoryFile = synthetic_dataset.getTrajectoryPath();
+        settings.pathToAssociationFile = synthetic_dataset.getAssociationsPath();
+        settings.pathToIntrinsicsFile = synthetic_dataset.getIntrinsicsPath();
+    }
+    else
+    {
+        if(dataset_directory.back() != '/')
+        {
+            dataset_directory += "/";
+        }
+
+        settings.datasetName = dataset_directory;
+        settings.pathToImagesDirectory = dataset_directory;
+
+        if(settings.pathToTrajectoryFile.empty())
+        {
+            settings.pathToTrajectoryFile = dataset_directory + "traj0.txt";
+        }
+
+        if(settings.pathToAssociationFile.empty())
+        {
+            settings.pathToAssociationFile = dataset_directory + "associations.txt";
+        }
+    }
+
+    BenchmarkSuite benchmark_suite(settings);
+
+    if(!benchmark_suite.run())
+    {
+        return 1;
+    }
+
+    return benchmark_suite.writeResults(path_to_output) ? 0 : 1;
+}
@@ -0,0 +1,307 @@
+#include "syntheticdataset.h"
+#include "backprojection.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cmath>
+#include <algorithm>
+
+static const float roomHalfSize = 3.f;
+static const float orbitRadius = 1.8f;
+static const float planeHeight = -1.f;
+static const float maxRayDistance = 50.f;
+
+// constructors/destructors
+SyntheticDataset::SyntheticDataset(SyntheticDatasetSettings settings)
+{
+    this->initializeVariables(settings);
+}
+
+SyntheticDataset::~SyntheticDataset()
+{
+
+}
+
+// public functions
+bool SyntheticDataset::generate()
+{
+    std::error_code error;
+    std::filesystem::create_directories(this->settings.directory + "/rgb", error);
+    std::filesystem::create_directories(this->settings.directory + "/depth", error);
+
+    if(error)
+    {
+        std::cerr << "Failed to create synthetic dataset directory: " << this->settings.directory.c_str() << std::endl;
+        return false;
+    }
+
+    std::ofstream trajectory_file(this->getTrajectoryPath());
+    std::ofstream associations_file(this->getAssociationsPath());
+
+    if(!trajectory_file.is_open() || !associations_file.is_open())
+    {
+        std::cerr << "Failed to create synthetic dataset files in: " << this->settings.directory.c_str() << std::endl;
+        return false;
+    }
+
+    trajectory_file.precision(9);
+
+    for(int i = 0; i < this->settings.framesCount; ++i)
+    {
+        TrajectoryData trajectory = this->getFramePose(i);
+
+        if(!this->writeFrame(i, trajectory))
+        {
+            return false;
+        }
+
+        trajectory_file << trajectory.id << " " << trajectory.cam_x << " " << trajectory.cam_y << " " << trajectory.cam_z << " "
+                        << trajectory.qx << " " << trajectory.qy << " " << trajectory.qz << " " << trajectory.qw << "\n";
+        associations_file << i << " rgb/" << i << ".png " << i << " depth/" << i << ".png\n";
+    }
+
+    return this->writeIntrinsics() && trajectory_file.good() && associations_file.good();
+}
+
+//// getters
+std::string SyntheticDataset::getImagesDirectory()
+{
+    return this->settings.directory + "/";
+}
+
+std::string SyntheticDataset::getTrajectoryPath()
+{
+    return this->settings.directory + "/traj0.txt";
+}
+
+std::string SyntheticDataset::getAssociationsPath()
+{
+    return this->settings.directory + "/associations.txt";
+}
+
+std::string SyntheticDataset::getIntrinsicsPath()
+{
+    return this->settings.directory + "/intrinsics.txt";
+}
+
+CameraIntrinsics SyntheticDataset::getIntrinsics()
+{
+    return this->intrinsics;
+}
+
+// private functions
+//// init functions
+void SyntheticDataset::initializeVariables(SyntheticDatasetSettings &settings)
+{
+    this->settings = settings;
+
+    // office_kt0 camera scaled to the requested resolution
+    this->intrinsics.width = settings.width;
+    this->intrinsics.height = settings.height;
+    this->intrinsics.focal_x = 481.2f * settings.width / 640.f;
+    this->intrinsics.focal_y = -480.f * settings.height / 480.f;
+    this->intrinsics.cx = (settings.width - 1) * 0.5f;
+    this->intrinsics.cy = (settings.height - 1) * 0.5f;
+    this->intrinsics.depthScale = 1000.f / 65536.f;
+}
+
+TrajectoryData SyntheticDataset::getFramePose(int frame_index)
+{
+    // orbit around the scene center, always looking at it
+    float angle = 2.f * static_cast<float>(M_PI) * frame_index / std::max(1, this->settings.framesCount);
+    float yaw = std::atan2(-std::cos(angle), -std::sin(angle));
+
+    TrajectoryData trajectory;
+    trajectory.id = frame_index;
+    trajectory.cam_x = orbitRadius * std::cos(angle);
+    trajectory.cam_y = this->settings.scene == SyntheticScene::Plane ? 0.5f : 0.25f * std::sin(2.f * angle);
+    trajectory.cam_z = orbitRadius * std::sin(angle);
+
+    // rotation about the y axis, qx holds the scalar part in the trajectory convention
+    trajectory.qx = std::cos(yaw * 0.5f);
+    trajectory.qy = 0.f;
+    trajectory.qz = std::sin(yaw * 0.5f);
+    trajectory.qw = 0.f;
+
+    return trajectory;
+}
+
+bool SyntheticDataset::writeFrame(int frame_index, const TrajectoryData &trajectory)
+{
+    const int width = this->settings.width;
+    const int height = this->settings.height;
+
+    FramePose pose = BackProjectionKernel::getFramePose(trajectory.cam_x, trajectory.cam_y, trajectory.cam_z, trajectory.qx, trajectory.qy, trajectory.qz, trajectory.qw);
+
+    cv::Mat rgb_image(height, width, CV_8UC3);
+    cv::Mat depth_image(height, width, CV_16UC1);
+
+    for(int v = 0; v < height; ++v)
+    {
+        cv::Vec3b *rgb_row = rgb_image.ptr<cv::Vec3b>(v);
+        uint16_t *depth_row = depth_image.ptr<uint16_t>(v);
+
+        for(int u = 0; u < width; ++u)
+        {
+            // camera ray with unit z, so the hit distance along it is the depth
+            float camera_ray[3] = {
+                (v - this->intrinsics.cy) / this->intrinsics.focal_y,
+                -(u - this->intrinsics.cx) / this->intrinsics.focal_x,
+                1.f
+            };
+
+            float world_ray[3];
+
+            for(int k = 0; k < 3; ++k)
+            {
+                world_ray[k] = pose.rotation[k * 3] * camera_ray[0] + pose.rotation[k * 3 + 1] * camera_ray[1] + pose.rotation[k * 3 + 2] * camera_ray[2];
+            }
+
+            float color[3] = { 0.f, 0.f, 0.f };
+            float depth = this->castRay(pose.translation, world_ray, color);
+            float depth_value = std::round(depth / this->intrinsics.depthScale);
+
+            depth_row[u] = static_cast<uint16_t>(std::min(depth_value, 65535.f));
+            rgb_row[u] = cv::Vec3b(static_cast<uchar>(color[2] * 255.f), static_cast<uchar>(color[1] * 255.f), static_cast<uchar>(color[0] * 255.f));
+        }
+    }
+
+    std::string index = std::to_string(frame_index);
+
+    if(!cv::imwrite(this->settings.directory + "/rgb/" + index + ".png", rgb_image)
+        || !cv::imwrite(this->settings.directory + "/depth/" + index + ".png", depth_image))
+    {
+        std::cerr << "Failed to write synthetic frame: " << frame_index << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool SyntheticDataset::writeIntrinsics()
+{
+    std::ofstream file(this->getIntrinsicsPath());
+
+    if(!file.is_open())
+    {
+        std::cerr << "Failed to create intrinsics file: " << this->getIntrinsicsPath().c_str() << std::endl;
+        return false;
+    }
+
+    file.precision(9);
+    file << "# synthetic camera\n"
+         << "fx " << this->intrinsics.focal_x << "\n"
+         << "fy " << this->intrinsics.focal_y << "\n"
+         << "cx " << this->intrinsics.cx << "\n"
+         << "cy " << this->intrinsics.cy << "\n"
+         << "width " << this->intrinsics.width << "\n"
+         << "height " << this->intrinsics.height << "\n"
+         << "depth_scale " << this->intrinsics.depthScale << "\n";
+
+    return file.good();
+}
+
+//// ray casting
+float SyntheticDataset::castRay(const float origin[3], const float direction[3], float color[3])
+{
+    float distance = 0.f;
+
+    if(this->settings.scene == SyntheticScene::Plane)
+    {
+        if(direction[1] >= 0.f)
+        {
+            return 0.f;
+        }
+
+        distance = (planeHeight - origin[1]) / direction[1];
+
+        if(distance > maxRayDistance)
+        {
+            return 0.f;
+        }
+
+        float x = origin[0] + distance * direction[0];
+        float z = origin[2] + distance * direction[2];
+        int checker = (static_cast<int>(std::floor(x * 2.f)) + static_cast<int>(std::floor(z * 2.f))) & 1;
+
+        color[0] = checker ? 0.9f : 0.3f;
+        color[1] = checker ? 0.9f : 0.4f;
+        color[2] = checker ? 0.8f : 0.3f;
+
+        return distance;
+    }
+
+    // room walls, seen from the inside
+    int wall_axis = 0;
+    distance = maxRayDistance;
+
+    for(int k = 0; k < 3; ++k)
+    {
+        if(direction[k] == 0.f)
+        {
+            continue;
+        }
+
+        float wall = direction[k] > 0.f ? roomHalfSize : -roomHalfSize;
+        float wall_distance = (wall - origin[k]) / direction[k];
+
+        if(wall_distance < distance)
+        {
+            distance = wall_distance;
+            wall_axis = k;
+        }
+    }
+
+    float hit_a = origin[(wall_axis + 1) % 3] + distance * direction[(wall_axis + 1) % 3];
+    float hit_b = origin[(wall_axis + 2) % 3] + distance * direction[(wall_axis + 2) % 3];
+    int checker = (static_cast<int>(std::floor(hit_a * 2.f)) + static_cast<int>(std::floor(hit_b * 2.f))) & 1;
+    float brightness = checker ? 1.f : 0.6f;
+
+    color[0] = brightness * (wall_axis == 0 ? 0.9f : 0.5f);
+    color[1] = brightness * (wall_axis == 1 ? 0.9f : 0.5f);
+    color[2] = brightness * (wall_axis == 2 ? 0.9f : 0.5f);
+
+    // two spheres in front of the walls
+    static const float sphere_centers[2][3] = { { 0.f, 0.f, 0.f }, { 0.9f, -0.6f, 0.9f } };
+    static const float sphere_radii[2] = { 0.8f, 0.35f };
+
+    for(int s = 0; s < 2; ++s)
+    {
+        float sphere_distance = SyntheticDataset::intersectSphere(origin, direction, sphere_centers[s], sphere_radii[s]);
+
+        if(sphere_distance > 0.f && sphere_distance < distance)
+        {
+            distance = sphere_distance;
+
+            for(int k = 0; k < 3; ++k)
+            {
+                float normal = (origin[k] + distance * direction[k] - sphere_centers[s][k]) / sphere_radii[s];
+                color[k] = 0.5f + 0.5f * normal;
+            }
+        }
+    }
+
+    return distance;
+}
+
+float SyntheticDataset::intersectSphere(const float origin[3], const float direction[3], const float center[3], float radius)
+{
+    float offset[3] = { origin[0] - center[0], origin[1] - center[1], origin[2] - center[2] };
+
+    float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+    float b = offset[0] * direction[0] + offset[1] * direction[1] + offset[2] * direction[2];
+    float c = offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] - radius * radius;
+    float discriminant = b * b - a * c;
+
+    if(discriminant < 0.f)
+    {
+        return 0.f;
+    }
+
+    float distance = (-b - std::sqrt(discriminant)) / a;
+
+    return distance > 0.f ? distance : 0.f;
+}
@@ -0,0 +1,61 @@
+#ifndef SYNTHETICDATASET_H
+#define SYNTHETICDATASET_H
+
+#include "datasetparser.h"
+#include "raylookuptable.h"
+
+#include <string>
+
+enum class SyntheticScene
+{
+    Room,       // closed box with two spheres, every pixel is valid
+    Plane       // single ground plane, pixels looking above the horizon have no depth
+};
+
+struct SyntheticDatasetSettings
+{
+    std::string directory;
+    int width;
+    int height;
+    int framesCount;
+    SyntheticScene scene;
+};
+
+//// ray casts an analytic scene from a camera orbiting its center and writes it in the office_kt0 layout:
+//// rgb/<i>.png, 16-bit depth/<i>.png, traj0.txt, associations.txt and intrinsics.txt
+class SyntheticDataset
+{
+public:
+    // constructors/destructors
+    SyntheticDataset(SyntheticDatasetSettings settings);
+    ~SyntheticDataset();
+
+    // public functions
+    bool generate();
+
+    //// getters
+    std::string getImagesDirectory();
+    std::string getTrajectoryPath();
+    std::string getAssociationsPath();
+    std::string getIntrinsicsPath();
+    CameraIntrinsics getIntrinsics();
+
+private:
+    // private functions
+    //// init functions
+    void initializeVariables(SyntheticDatasetSettings &settings);
+
+    TrajectoryData getFramePose(int frame_index);
+    bool writeFrame(int frame_index, const TrajectoryData &trajectory);
+    bool writeIntrinsics();
+
+    //// ray casting, returns the hit distance along direction or 0 if nothing was hit
+    float castRay(const float origin[3], const float direction[3], float color[3]);
+    static float intersectSphere(const float origin[3], const float direction[3], const float center[3], float radius);
+
+    // private variables
+    SyntheticDatasetSettings settings;
+    CameraIntrinsics intrinsics;
+};
+
+#endif // SYNTHETICDATASET_H
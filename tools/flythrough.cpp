@@ -0,0 +1,553 @@
+#include "pointcloud.h"
+#include "datasetparser.h"
+#include "spatialchunker.h"
+#include "pointcloudio.h"
+#include "profiler.h"
+#include "offscreenrenderer.h"
+#include "rendererdefaults.h"
+
+#include <QGuiApplication>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/resource.h>
+
+static void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " --dataset <dir> | --trajectory <file> with --cloud or --pages [options]\n"
+              << "Renders a camera path over the ingested cloud without a window and reports frame times;\n"
+              << "on machines without a display run it with QT_QPA_PLATFORM=offscreen, from the repository root\n"
+              << "  --dataset <dir>          images directory, paths in the association file are relative to it\n"
+              << "  --trajectory <file>      defaults to <dir>/traj0.txt\n"
+              << "  --associations <file>    defaults to <dir>/associations.txt\n"
+              << "  --intrinsics <file>      defaults to office_kt0 intrinsics\n"
+              << "  --cache <file>           binary point cache reused between runs\n"
+              << "  --first <n>              first ingested frame (0)\n"
+              << "  --last <n>               frames [first, last) are ingested, 0 - until the end (0)\n"
+              << "  --threads <n>            ingestion and --cloud reading threads, 0 - all hardware threads (0)\n"
+              << "  --format <float32|compact>        in-memory point format (compact)\n"
+              << "  --voxel-size <size>      merge points into voxels while ingesting, 0 - keep all points (0)\n"
+              << "  --chunk-size <size>      edge of the spatial chunks (1)\n"
+              << "  --cloud <file>           binary PLY or PCD point cloud, e.g. of mapbuilder --output, chunked instead of ingesting,\n"
+              << "                           only the trajectory is read for the camera path, no images are needed\n"
+              << "  --pages <file>           page store of mapbuilder --pages streamed in while flying instead of ingesting,\n"
+              << "                           only the trajectory is read for the camera path, no images are needed\n"
+              << "  --host-budget <MB>       pages kept in memory (1024)\n"
+              << "  --gpu-budget <MB>        pages kept on the GPU (512)\n"
+              << "  --loader-threads <n>     page reading threads (2)\n"
+              << "  --camera-path <file>     poses flown through, same formats as --trajectory, defaults to it\n"
+              << "  --stride <n>             every n-th pose of the camera path is rendered (1)\n"
+              << "  --warmup <n>             frames rendered before timing starts (10)\n"
+              << "  --width <pixels>         (1280)\n"
+              << "  --height <pixels>        (720)\n"
+              << "  --fov <degrees>          vertical field of view (60)\n"
+              << "  --follow-distance <d>    camera moved back along its optical axis, 0 - the captured view (0)\n"
+              << "  --point-budget <n>       points drawn per frame (5000000)\n"
+              << "  --point-size <pixels>    smallest splat for the splat modes (1)\n"
+              << "  --render-mode <points|splats|depth-splats>   (points)\n"
+              << "  --points-per-pixel <n>   points drawn per pixel of a chunk, 0 - the viewer's, 1 for points and 0.1 for splats (0)\n"
+              << "  --show-path <0|1>        draw the camera path and keyframes (1)\n"
+              << "  --frames <dir>           timed frames saved as <dir>/frame_<n>.png\n"
+              << "  --profile <file>         per-stage timings and counters, CSV for a .csv extension, JSON otherwise\n"
+              << "  --frames-csv <file>      one row of stage times per frame, the last " << Profiler::framesCapacity << " frames\n";
+}
+
+int main(int argc, char *argv[])
+{
+    // takes Qt options such as -platform offscreen out of argv
+    QGuiApplication application(argc, argv);
+
+    InputData input_data;
+    input_data.pathToImagesDirectory = "";
+    input_data.pathToTrajectoryFile = "";
+    input_data.pathToAssociationFile = "";
+    input_data.pathToIntrinsicsFile = "";
+    input_data.pathToCacheFile = "";
+    input_data.pathToConfidenceDirectory = "";
+    input_data.maxIndex = 0;
+    input_data.threadsCount = 0;
+    input_data.ioThreadsCount = 0;
+    input_data.prefetchDepth = 0;
+    input_data.transformKernel = TransformKernel::Vectorized;
+    input_data.pointFormat = PointFormat::Compact;
+    input_data.voxelSize = 0.f;
+    input_data.tsdfVoxelSize = 0.f;
+    input_data.tsdfTruncation = 0.f;
+    input_data.octreeMaxDepth = 0;
+    input_data.frameLocalPoints = false;
+    input_data.rawFrames = false;
+    input_data.depthFilter = { true, 0.f, 0.f, 0.05f, 1 };
+
+    OffscreenRendererSettings renderer_settings;
+    renderer_settings.width = 1280;
+    renderer_settings.height = 720;
+    renderer_settings.fieldOfView = 60.f;
+    renderer_settings.followDistance = 0.f;
+    renderer_settings.pointBudget = 5000000;
+    renderer_settings.pointsPerPixel = 0.f;
+    renderer_settings.pointSize = 1.f;
+    renderer_settings.renderMode = PointRenderMode::Points;
+    renderer_settings.showTrajectory = true;
+
+    PageStreamerSettings page_streamer_settings = RendererDefaults::getPageStreamerSettings();
+
+    int first_frame = 0;
+    int last_frame = 0;
+    float chunk_size = 1.f;
+    std::string path_to_cloud;
+    std::string path_to_pages;
+    int stride = 1;
+    int warmup_frames = 10;
+    std::string path_to_camera_path;
+    std::string path_to_frames;
+    std::string path_to_profile;
+    std::string path_to_frames_csv;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+
+        if(option == "--help" || option == "-h")
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+
+        if(i + 1 >= argc)
+        {
+            std::cerr << "Missing value for option: " << option.c_str() << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        std::string value = argv[++i];
+
+        if(option == "--dataset")
+        {
+            input_data.pathToImagesDirectory = value;
+        }
+        else if(option == "--trajectory")
+        {
+            input_data.pathToTrajectoryFile = value;
+        }
+        else if(option == "--associations")
+        {
+            input_data.pathToAssociationFile = value;
+        }
+        else if(option == "--intrinsics")
+        {
+            input_data.pathToIntrinsicsFile = value;
+        }
+        else if(option == "--cache")
+        {
+            input_data.pathToCacheFile = value;
+        }
+        else if(option == "--first")
+        {
+            first_frame = std::atoi(value.c_str());
+        }
+        else if(option == "--last")
+        {
+            last_frame = std::atoi(value.c_str());
+        }
+        else if(option == "--threads")
+        {
+            input_data.threadsCount = static_cast<unsigned int>(std::atoi(value.c_str()));
+        }
+        else if(option == "--format" && (value == "float32" || value == "compact"))
+        {
+            input_data.pointFormat = value == "float32" ? PointFormat::Float32 : PointFormat::Compact;
+        }
+        else if(option == "--voxel-size")
+        {
+            input_data.voxelSize = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--chunk-size")
+        {
+            chunk_size = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--cloud")
+        {
+            path_to_cloud = value;
+        }
+        else if(option == "--pages")
+        {
+            path_to_pages = value;
+        }
+        else if(option == "--host-budget")
+        {
+            page_streamer_settings.hostBudgetBytes = static_cast<size_t>(std::atoll(value.c_str())) << 20;
+        }
+        else if(option == "--gpu-budget")
+        {
+            page_streamer_settings.gpuBudgetBytes = static_cast<size_t>(std::atoll(value.c_str())) << 20;
+        }
+        else if(option == "--loader-threads")
+        {
+            page_streamer_settings.loaderThreadsCount = static_cast<unsigned int>(std::max(1, std::atoi(value.c_str())));
+        }
+        else if(option == "--camera-path")
+        {
+            path_to_camera_path = value;
+        }
+        else if(option == "--stride")
+        {
+            stride = std::max(1, std::atoi(value.c_str()));
+        }
+        else if(option == "--warmup")
+        {
+            warmup_frames = std::max(0, std::atoi(value.c_str()));
+        }
+        else if(option == "--width")
+        {
+            renderer_settings.width = std::atoi(value.c_str());
+        }
+        else if(option == "--height")
+        {
+            renderer_settings.height = std::atoi(value.c_str());
+        }
+        else if(option == "--fov")
+        {
+            renderer_settings.fieldOfView = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--follow-distance")
+        {
+            renderer_settings.followDistance = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--point-budget")
+        {
+            renderer_settings.pointBudget = static_cast<size_t>(std::atoll(value.c_str()));
+        }
+        else if(option == "--point-size")
+        {
+            renderer_settings.pointSize = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--render-mode" && (value == "points" || value == "splats" || value == "depth-splats"))
+        {
+            renderer_settings.renderMode = value == "points" ? PointRenderMode::Points
+                                         : value == "splats" ? PointRenderMode::Splats : PointRenderMode::DepthSplats;
+        }
+        else if(option == "--points-per-pixel")
+        {
+            renderer_settings.pointsPerPixel = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--show-path")
+        {
+            renderer_settings.showTrajectory = std::atoi(value.c_str()) != 0;
+        }
+        else if(option == "--frames")
+        {
+            path_to_frames = value;
+        }
+        else if(option == "--profile")
+        {
+            path_to_profile = value;
+        }
+        else if(option == "--frames-csv")
+        {
+            path_to_frames_csv = value;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << option.c_str() << " " << value.c_str() << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(!path_to_cloud.empty() && !path_to_pages.empty())
+    {
+        std::cerr << "--cloud and --pages both provide the points, only one of them can be given" << std::endl;
+        return 1;
+    }
+
+    // points of a file or page store are not ingested, the camera path is all that is read of the dataset
+    const bool ingest = path_to_cloud.empty() && path_to_pages.empty();
+
+    if(!ingest && !input_data.pathToCacheFile.empty())
+    {
+        std::cerr << "--cache holds ingested frames, it can not be combined with --cloud or --pages" << std::endl;
+        return 1;
+    }
+
+    bool has_camera_path = !input_data.pathToImagesDirectory.empty() || (!ingest && !input_data.pathToTrajectoryFile.empty());
+
+    if(!has_camera_path || renderer_settings.width <= 0 || renderer_settings.height <= 0 || chunk_size <= 0.f)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if(!input_data.pathToImagesDirectory.empty())
+    {
+        if(input_data.pathToImagesDirectory.back() != '/')
+        {
+            input_data.pathToImagesDirectory += "/";
+        }
+
+        if(input_data.pathToTrajectoryFile.empty())
+        {
+            input_data.pathToTrajectoryFile = input_data.pathToImagesDirectory + "traj0.txt";
+        }
+
+        if(ingest && input_data.pathToAssociationFile.empty())
+        {
+            input_data.pathToAssociationFile = input_data.pathToImagesDirectory + "associations.txt";
+        }
+    }
+
+    if(!path_to_frames.empty())
+    {
+        if(path_to_frames.back() != '/')
+        {
+            path_to_frames += "/";
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(path_to_frames, error);
+    }
+
+    // the cloud
+    PointCloud point_cloud(input_data);
+
+    size_t points_count = 0;
+    std::vector<PointChunk> chunks;
+    std::vector<BoundingBox> chunk_bounds;
+
+    // a page store is read while flying, nothing is ingested up front
+    if(path_to_pages.empty())
+    {
+        SpatialChunker chunker(chunk_size);
+
+        if(!path_to_cloud.empty())
+        {
+            auto read_start = std::chrono::steady_clock::now();
+
+            std::vector<PointChunk> file_chunks;
+
+            if(!PointCloudIO::readPoints(path_to_cloud, file_chunks, input_data.threadsCount))
+            {
+                return 1;
+            }
+
+            double read_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - read_start).count();
+
+            for(const PointChunk &chunk : file_chunks)
+            {
+                chunker.add(chunk);
+            }
+
+            std::cerr << "Read " << chunker.getPointsCount() << " points in " << read_seconds << " s" << std::endl;
+        }
+        else
+        {
+            int frames_count = static_cast<int>(point_cloud.getFramesCount());
+            int end_frame = last_frame > 0 ? std::min(last_frame, frames_count) : frames_count;
+
+            std::vector<int> frame_indexes;
+
+            for(int i = std::max(0, first_frame); i < end_frame; ++i)
+            {
+                if(point_cloud.hasFrame(i))
+                {
+                    frame_indexes.push_back(i);
+                }
+            }
+
+            if(frame_indexes.empty())
+            {
+                std::cerr << "No frames in range [" << first_frame << ", " << end_frame << ")" << std::endl;
+                return 1;
+            }
+
+            point_cloud.iterateThroughImages(false, frame_indexes.data(), frame_indexes.size());
+
+            if(point_cloud.getPointFormat() == PointFormat::Compact)
+            {
+                for(const PointChunk &chunk : point_cloud.getPointChunks())
+                {
+                    chunker.add(chunk);
+                }
+            }
+            else
+            {
+                PointsView points_view = point_cloud.getPointsView();
+                chunker.add(points_view.data, points_view.pointsCount);
+            }
+        }
+
+        points_count = chunker.getPointsCount();
+        chunker.finish(chunks, chunk_bounds);
+    }
+
+    // the camera path
+    std::vector<FramePose> trajectory = point_cloud.getTrajectory();
+    std::vector<FramePose> camera_path;
+
+    if(path_to_camera_path.empty())
+    {
+        camera_path = trajectory;
+    }
+    else
+    {
+        FrameTable frame_table;
+
+        if(!DatasetParser::parse(path_to_camera_path, input_data.pathToAssociationFile, frame_table))
+        {
+            std::cerr << "Failed to read camera path: " << path_to_camera_path.c_str() << std::endl;
+            return 1;
+        }
+
+        for(const FrameEntry &frame : frame_table.frames)
+        {
+            if(frame.hasPose)
+            {
+                const TrajectoryData &pose = frame.pose;
+                camera_path.push_back(BackProjectionKernel::getFramePose(pose.cam_x, pose.cam_y, pose.cam_z, pose.qx, pose.qy, pose.qz, pose.qw));
+            }
+        }
+    }
+
+    std::vector<FramePose> flown_poses;
+
+    for(size_t i = 0; i < camera_path.size(); i += static_cast<size_t>(stride))
+    {
+        flown_poses.push_back(camera_path[i]);
+    }
+
+    if(flown_poses.empty())
+    {
+        std::cerr << "Camera path has no poses" << std::endl;
+        return 1;
+    }
+
+    // rendering
+    OffscreenRenderer renderer(renderer_settings);
+
+    if(!renderer.initialize())
+    {
+        return 1;
+    }
+
+    if(path_to_pages.empty())
+    {
+        renderer.setChunks(chunks, chunk_bounds);
+    }
+    else if(!renderer.openPageStore(path_to_pages, page_streamer_settings))
+    {
+        return 1;
+    }
+
+    renderer.setTrajectory(trajectory, point_cloud.getCameraIntrinsics());
+
+    std::cerr << "Rendering " << flown_poses.size() << " poses at " << renderer_settings.width << "x" << renderer_settings.height
+              << " on " << renderer.getDeviceName().c_str() << ", ";
+
+    if(path_to_pages.empty())
+    {
+        std::cerr << chunks.size() << " chunks, " << points_count << " points" << std::endl;
+    }
+    else
+    {
+        std::cerr << renderer.getPageStatistics().pagesCount << " pages" << std::endl;
+    }
+
+    // warm-up frames settle uploads, shader compilation and caches and are left out of the report
+    for(int i = 0; i < warmup_frames; ++i)
+    {
+        renderer.setCamera(flown_poses[static_cast<size_t>(i) % flown_poses.size()]);
+        renderer.renderFrame();
+    }
+
+    Profiler::setEnabled(true);
+    Profiler::reset();
+
+    std::vector<double> frame_milliseconds;
+    frame_milliseconds.reserve(flown_poses.size());
+    size_t drawn_points = 0;
+    size_t incomplete_frames = 0;
+    bool written = true;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(size_t i = 0; i < flown_poses.size(); ++i)
+    {
+        auto frame_start = std::chrono::steady_clock::now();
+
+        renderer.setCamera(flown_poses[i]);
+        renderer.renderFrame();
+
+        frame_milliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+
+        drawn_points += renderer.getRenderStatistics().drawnPointsCount;
+        incomplete_frames += renderer.getPageStatistics().pendingPagesCount > 0 ? 1 : 0;
+
+        if(!path_to_frames.empty())
+        {
+            char file_name[32];
+            std::snprintf(file_name, sizeof(file_name), "frame_%05zu.png", i);
+
+            written = renderer.saveFrame(path_to_frames + file_name) && written;
+        }
+
+        Profiler::endFrame();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // report, frame times are submission plus the wait for the GPU, saving frames is not included
+    std::sort(frame_milliseconds.begin(), frame_milliseconds.end());
+
+    auto percentile = [&frame_milliseconds](double p)
+    {
+        return frame_milliseconds[static_cast<size_t>(p * (frame_milliseconds.size() - 1) + 0.5)];
+    };
+
+    std::fprintf(stderr, "%zu frames in %.3f s (%.1f fps), %.0f points per frame\n", frame_milliseconds.size(), seconds,
+                 frame_milliseconds.size() / std::max(seconds, 1e-9), static_cast<double>(drawn_points) / frame_milliseconds.size());
+    std::fprintf(stderr, "%-14s p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f ms\n", "frame", percentile(0.5), percentile(0.9),
+                 percentile(0.99), frame_milliseconds.back());
+
+    for(const ProfileStageSummary &stage : Profiler::getStageSummaries())
+    {
+        std::fprintf(stderr, "%-14s p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f ms\n", stage.name, stage.p50Milliseconds,
+                     stage.p90Milliseconds, stage.p99Milliseconds, stage.maxMilliseconds);
+    }
+
+    // frames drawn while wanted pages were still loading or uploading, and what the budgets cost in reads
+    if(!path_to_pages.empty())
+    {
+        PageStreamerStatistics page_statistics = renderer.getPageStatistics();
+
+        std::fprintf(stderr, "pages: %zu frames incomplete, %zu loaded, %zu evicted from memory, %zu from the GPU, %zu resident (%.1f MB), %zu on the GPU (%.1f MB)\n",
+                     incomplete_frames, page_statistics.cache.loadedPagesCount, page_statistics.cache.evictedPagesCount,
+                     page_statistics.gpuEvictedPagesCount, page_statistics.cache.residentPagesCount, page_statistics.cache.residentBytes / 1048576.0,
+                     page_statistics.gpuPagesCount, page_statistics.gpuBytes / 1048576.0);
+    }
+
+    struct rusage usage;
+
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        std::fprintf(stderr, "peak resident memory %.1f MB\n", usage.ru_maxrss / 1024.0);
+    }
+
+    if(!path_to_profile.empty() && !Profiler::write(path_to_profile))
+    {
+        return 1;
+    }
+
+    if(!path_to_frames_csv.empty() && !Profiler::writeFramesCSV(path_to_frames_csv))
+    {
+        return 1;
+    }
+
+    return written ? 0 : 1;
+}
@@ -0,0 +1,448 @@
+#include "pointcloud.h"
+#include "pointcloudio.h"
+#include "pagestore.h"
+#include "profiler.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+static void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " --dataset <dir> --output <cloud.ply|pcd> | --pages <file> [options]\n"
+              << "  --dataset <dir>          images directory, paths in the association file are relative to it\n"
+              << "  --trajectory <file>      defaults to <dir>/traj0.txt\n"
+              << "  --associations <file>    defaults to <dir>/associations.txt\n"
+              << "  --intrinsics <file>      defaults to office_kt0 intrinsics\n"
+              << "  --cache <file>           binary point cache reused between runs\n"
+              << "  --first <n>              first frame (0)\n"
+              << "  --last <n>               frames [first, last) are processed, 0 - until the end (0)\n"
+              << "  --threads <n>            ingestion and export threads, 0 - all hardware threads (0)\n"
+              << "  --io-threads <n>         image decoding threads, 0 - same as --threads (0)\n"
+              << "  --kernel <reference|vectorized>   (vectorized)\n"
+              << "  --format <float32|compact>        in-memory point format (compact)\n"
+              << "  --voxel-size <size>      merge points into voxels while ingesting, 0 - keep all points (0)\n"
+              << "  --tsdf-voxel-size <size> fuse frames into a truncated signed distance field and keep its surface, 0 - off (0)\n"
+              << "  --truncation <distance>  band around surfaces updated by every frame, 0 - four TSDF voxels (0)\n"
+              << "  --mesh <file>            binary PLY surface mesh extracted from the TSDF, needs --tsdf-voxel-size\n"
+              << "  --frame-local <0|1>      keep points in camera coordinates and apply poses on export, no merging (0)\n"
+              << "  --reload-trajectory <file>  corrected trajectory applied to frame-local points after ingestion\n"
+              << "  --reject-invalid <0|1>   drop pixels without a depth measurement (1)\n"
+              << "  --min-depth <depth>      drop pixels closer than this, 0 - no limit (0)\n"
+              << "  --max-depth <depth>      drop pixels farther than this, 0 - no limit (0)\n"
+              << "  --edge-threshold <ratio> drop pixels whose depth differs from a neighbour by more than ratio * depth, 0 - off (0.05)\n"
+              << "  --confidence <dir>       confidence masks named like the depth images\n"
+              << "  --min-confidence <n>     drop pixels with a lower confidence mask value (1)\n"
+              << "  --output <file>          binary PLY point cloud, binary PCD for a .pcd extension\n"
+              << "  --pages <file>           spatial page store for maps larger than memory; without --output frames are written\n"
+              << "                           as they are ingested and never accumulated, with it the final cloud is paged\n"
+              << "  --chunk-size <size>      edge of the cubic cells pages are split from (1)\n"
+              << "  --page-points <n>        points per page at most (65536)\n"
+              << "  --page-buffer <MB>       points buffered before they are spilled to disk (256)\n"
+              << "  --profile <file>         per-stage timings and counters, CSV for a .csv extension, JSON otherwise\n";
+}
+
+int main(int argc, char *argv[])
+{
+    InputData input_data;
+    input_data.pathToImagesDirectory = "";
+    input_data.pathToTrajectoryFile = "";
+    input_data.pathToAssociationFile = "";
+    input_data.pathToIntrinsicsFile = "";
+    input_data.pathToCacheFile = "";
+    input_data.pathToConfidenceDirectory = "";
+    input_data.maxIndex = 0;
+    input_data.threadsCount = 0;
+    input_data.ioThreadsCount = 0;
+    input_data.prefetchDepth = 0;
+    input_data.transformKernel = TransformKernel::Vectorized;
+    input_data.pointFormat = PointFormat::Compact;
+    input_data.voxelSize = 0.f;
+    input_data.tsdfVoxelSize = 0.f;
+    input_data.tsdfTruncation = 0.f;
+    input_data.octreeMaxDepth = 0;
+    input_data.frameLocalPoints = false;
+    input_data.rawFrames = false;
+    input_data.depthFilter = { true, 0.f, 0.f, 0.05f, 1 };
+
+    int first_frame = 0;
+    int last_frame = 0;
+    std::string path_to_output;
+    std::string path_to_profile;
+    std::string path_to_mesh;
+    std::string path_to_reloaded_trajectory;
+    std::string path_to_pages;
+    float chunk_size = 1.f;
+    size_t page_points = 65536;
+    size_t page_buffer_megabytes = 256;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+
+        if(option == "--help" || option == "-h")
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+
+        if(i + 1 >= argc)
+        {
+            std::cerr << "Missing value for option: " << option.c_str() << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        std::string value = argv[++i];
+
+        if(option == "--dataset")
+        {
+            input_data.pathToImagesDirectory = value;
+        }
+        else if(option == "--trajectory")
+        {
+            input_data.pathToTrajectoryFile = value;
+        }
+        else if(option == "--associations")
+        {
+            input_data.pathToAssociationFile = value;
+        }
+        else if(option == "--intrinsics")
+        {
+            input_data.pathToIntrinsicsFile = value;
+        }
+        else if(option == "--cache")
+        {
+            input_data.pathToCacheFile = value;
+        }
+        else if(option == "--first")
+        {
+            first_frame = std::atoi(value.c_str());
+        }
+        else if(option == "--last")
+        {
+            last_frame = std::atoi(value.c_str());
+        }
+        else if(option == "--threads")
+        {
+            input_data.threadsCount = static_cast<unsigned int>(std::atoi(value.c_str()));
+        }
+        else if(option == "--io-threads")
+        {
+            input_data.ioThreadsCount = static_cast<unsigned int>(std::atoi(value.c_str()));
+        }
+        else if(option == "--kernel" && (value == "reference" || value == "vectorized"))
+        {
+            input_data.transformKernel = value == "reference" ? TransformKernel::Reference : TransformKernel::Vectorized;
+        }
+        else if(option == "--format" && (value == "float32" || value == "compact"))
+        {
+            input_data.pointFormat = value == "float32" ? PointFormat::Float32 : PointFormat::Compact;
+        }
+        else if(option == "--voxel-size")
+        {
+            input_data.voxelSize = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--tsdf-voxel-size")
+        {
+            input_data.tsdfVoxelSize = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--truncation")
+        {
+            input_data.tsdfTruncation = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--mesh")
+        {
+            path_to_mesh = value;
+        }
+        else if(option == "--frame-local")
+        {
+            input_data.frameLocalPoints = std::atoi(value.c_str()) != 0;
+        }
+        else if(option == "--reload-trajectory")
+        {
+            path_to_reloaded_trajectory = value;
+        }
+        else if(option == "--reject-invalid")
+        {
+            input_data.depthFilter.rejectInvalid = std::atoi(value.c_str()) != 0;
+        }
+        else if(option == "--min-depth")
+        {
+            input_data.depthFilter.minDepth = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--max-depth")
+        {
+            input_data.depthFilter.maxDepth = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--edge-threshold")
+        {
+            input_data.depthFilter.discontinuityThreshold = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--confidence")
+        {
+            input_data.pathToConfidenceDirectory = value;
+        }
+        else if(option == "--min-confidence")
+        {
+            input_data.depthFilter.minConfidence = static_cast<uint8_t>(std::atoi(value.c_str()));
+        }
+        else if(option == "--output")
+        {
+            path_to_output = value;
+        }
+        else if(option == "--pages")
+        {
+            path_to_pages = value;
+        }
+        else if(option == "--chunk-size")
+        {
+            chunk_size = static_cast<float>(std::atof(value.c_str()));
+        }
+        else if(option == "--page-points")
+        {
+            page_points = static_cast<size_t>(std::atoll(value.c_str()));
+        }
+        else if(option == "--page-buffer")
+        {
+            page_buffer_megabytes = static_cast<size_t>(std::atoll(value.c_str()));
+        }
+        else if(option == "--profile")
+        {
+            path_to_profile = value;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << option.c_str() << " " << value.c_str() << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(input_data.pathToImagesDirectory.empty() || (path_to_output.empty() && path_to_pages.empty()))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if(!path_to_mesh.empty() && input_data.tsdfVoxelSize <= 0.f)
+    {
+        std::cerr << "--mesh needs --tsdf-voxel-size" << std::endl;
+        return 1;
+    }
+
+    if(!path_to_reloaded_trajectory.empty() && !input_data.frameLocalPoints)
+    {
+        std::cerr << "--reload-trajectory needs --frame-local 1" << std::endl;
+        return 1;
+    }
+
+    // PointCloud turns the TSDF off for points it does not bring to world space
+    if(!path_to_mesh.empty() && (input_data.frameLocalPoints || input_data.rawFrames))
+    {
+        std::cerr << "--mesh needs world space points, it can not be combined with --frame-local 1" << std::endl;
+        return 1;
+    }
+
+    if(!path_to_pages.empty() && input_data.frameLocalPoints)
+    {
+        std::cerr << "--pages needs world space points, it can not be combined with --frame-local 1" << std::endl;
+        return 1;
+    }
+
+    // streamed frames are paged before any merging happens
+    if(!path_to_pages.empty() && path_to_output.empty() && (input_data.voxelSize > 0.f || input_data.tsdfVoxelSize > 0.f))
+    {
+        std::cerr << "--pages merges voxels or a TSDF only together with --output" << std::endl;
+        return 1;
+    }
+
+    if(!path_to_pages.empty() && (chunk_size <= 0.f || page_points == 0))
+    {
+        std::cerr << "--chunk-size and --page-points have to be positive" << std::endl;
+        return 1;
+    }
+
+    if(input_data.pathToImagesDirectory.back() != '/')
+    {
+        input_data.pathToImagesDirectory += "/";
+    }
+
+    if(input_data.pathToTrajectoryFile.empty())
+    {
+        input_data.pathToTrajectoryFile = input_data.pathToImagesDirectory + "traj0.txt";
+    }
+
+    if(input_data.pathToAssociationFile.empty())
+    {
+        input_data.pathToAssociationFile = input_data.pathToImagesDirectory + "associations.txt";
+    }
+
+    Profiler::setEnabled(!path_to_profile.empty());
+
+    auto start = std::chrono::steady_clock::now();
+
+    PointCloud point_cloud(input_data);
+
+    int frames_count = static_cast<int>(point_cloud.getFramesCount());
+    int end_frame = last_frame > 0 ? std::min(last_frame, frames_count) : frames_count;
+
+    std::vector<int> frame_indexes;
+
+    for(int i = std::max(0, first_frame); i < end_frame; ++i)
+    {
+        if(point_cloud.hasFrame(i))
+        {
+            frame_indexes.push_back(i);
+        }
+    }
+
+    if(frame_indexes.empty())
+    {
+        std::cerr << "No frames in range [" << first_frame << ", " << end_frame << ")" << std::endl;
+        return 1;
+    }
+
+    PageStore page_store;
+    std::atomic<size_t> streamed_points(0);
+
+    if(!path_to_pages.empty())
+    {
+        if(!page_store.beginWrite(path_to_pages, chunk_size, page_points, page_buffer_megabytes << 20))
+        {
+            return 1;
+        }
+
+        // frames go straight to the store, memory stays bounded by the frames in flight and the spill buffer
+        if(path_to_output.empty())
+        {
+            point_cloud.setFrameSink([&page_store, &streamed_points](StreamedFrame &frame)
+            {
+                if(!frame.chunk.points.empty())
+                {
+                    page_store.add(frame.chunk);
+                    streamed_points += frame.chunk.points.size();
+                }
+                else
+                {
+                    page_store.add(frame.points.data(), frame.points.size() / PointsView::floatsPerPoint);
+                    streamed_points += frame.points.size() / PointsView::floatsPerPoint;
+                }
+            });
+        }
+    }
+
+    point_cloud.iterateThroughImages(false, frame_indexes.data(), frame_indexes.size());
+
+    auto ingested = std::chrono::steady_clock::now();
+
+    if(!path_to_reloaded_trajectory.empty() && !point_cloud.reloadTrajectory(path_to_reloaded_trajectory))
+    {
+        return 1;
+    }
+
+    size_t points_count = streamed_points;
+    bool written = true;
+
+    // the format follows the extension, PLY unless it is .pcd
+    bool pcd_output = path_to_output.size() >= 4 && path_to_output.compare(path_to_output.size() - 4, 4, ".pcd") == 0;
+
+    if(path_to_output.empty())
+    {
+        written = page_store.finishWrite();
+    }
+    else if(point_cloud.getPointFormat() == PointFormat::Compact)
+    {
+        for(const PointChunk &chunk : point_cloud.getPointChunks())
+        {
+            points_count += chunk.points.size();
+        }
+
+        const std::vector<PointChunk> &point_chunks = point_cloud.getPointChunks();
+
+        if(pcd_output)
+        {
+            written = input_data.frameLocalPoints
+                    ? PointCloudIO::writePCD(path_to_output, point_chunks, point_cloud.getLocalFrames(), point_cloud.getFramePoses(), input_data.threadsCount)
+                    : PointCloudIO::writePCD(path_to_output, point_chunks, input_data.threadsCount);
+        }
+        else
+        {
+            written = input_data.frameLocalPoints
+                    ? PointCloudIO::writePLY(path_to_output, point_chunks, point_cloud.getLocalFrames(), point_cloud.getFramePoses(), input_data.threadsCount)
+                    : PointCloudIO::writePLY(path_to_output, point_chunks, input_data.threadsCount);
+        }
+    }
+    else
+    {
+        points_count = point_cloud.getPointsView().pointsCount;
+
+        PointsView points_view = point_cloud.getPointsView();
+
+        if(pcd_output)
+        {
+            written = input_data.frameLocalPoints
+                    ? PointCloudIO::writePCD(path_to_output, points_view, point_cloud.getLocalFrames(), point_cloud.getFramePoses(), input_data.threadsCount)
+                    : PointCloudIO::writePCD(path_to_output, points_view, input_data.threadsCount);
+        }
+        else
+        {
+            written = input_data.frameLocalPoints
+                    ? PointCloudIO::writePLY(path_to_output, points_view, point_cloud.getLocalFrames(), point_cloud.getFramePoses(), input_data.threadsCount)
+                    : PointCloudIO::writePLY(path_to_output, points_view, input_data.threadsCount);
+        }
+    }
+
+    if(written && !path_to_output.empty() && !path_to_pages.empty())
+    {
+        if(point_cloud.getPointFormat() == PointFormat::Compact)
+        {
+            for(const PointChunk &chunk : point_cloud.getPointChunks())
+            {
+                page_store.add(chunk);
+            }
+        }
+        else
+        {
+            page_store.add(point_cloud.getPointsView().data, point_cloud.getPointsView().pointsCount);
+        }
+
+        written = page_store.finishWrite();
+    }
+
+    if(written && !path_to_mesh.empty() && point_cloud.getTSDFVolume() == nullptr)
+    {
+        std::cerr << "No TSDF volume to extract a mesh from" << std::endl;
+        written = false;
+    }
+
+    if(written && !path_to_mesh.empty())
+    {
+        std::vector<float> mesh_vertices;
+        std::vector<uint32_t> mesh_indices;
+        point_cloud.getTSDFVolume()->extractMesh(mesh_vertices, mesh_indices);
+
+        std::cerr << "Mesh: " << mesh_vertices.size() / PointsView::floatsPerPoint << " vertices, " << mesh_indices.size() / 3 << " triangles" << std::endl;
+
+        written = PointCloudIO::writeMeshPLY(path_to_mesh, mesh_vertices, mesh_indices);
+    }
+
+    auto finished = std::chrono::steady_clock::now();
+
+    double ingest_seconds = std::chrono::duration<double>(ingested - start).count();
+    double write_seconds = std::chrono::duration<double>(finished - ingested).count();
+
+    std::cerr << frame_indexes.size() << " frames, " << points_count << " points in " << ingest_seconds << " s ("
+              << points_count / std::max(ingest_seconds, 1e-9) << " points/s), written in " << write_seconds << " s" << std::endl;
+
+    if(!path_to_profile.empty() && !Profiler::write(path_to_profile))
+    {
+        return 1;
+    }
+
+    return written ? 0 : 1;
+}